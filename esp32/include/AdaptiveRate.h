@@ -0,0 +1,71 @@
+/*
+ * AdaptiveRate - per-sensor read period driven by how fast readings move
+ *
+ * After every read the caller passes the largest change since the
+ * previous read, in units of the channel's significant step (its publish
+ * deadband). A change of a full step or more halves the period, down to
+ * the floor, so a door opening or a heater kicking in is followed
+ * closely from the next read on. While the smoothed activity stays below
+ * ADAPT_QUIET the period grows by ADAPT_BACKOFF_PCT per read, up to the
+ * ceiling.
+ *
+ * A steady drift settles where one read moves about a fraction of a
+ * step, so readings are taken just often enough to catch every
+ * published change.
+ *
+ * Plain C++ with no Arduino dependency so it can be built on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define ADAPT_ALPHA          0.25f  // weight of the newest read in the activity average
+#define ADAPT_QUIET          0.25f  // activity (steps per read) below which the period grows
+#define ADAPT_BACKOFF_PCT    25
+
+class AdaptiveRate {
+ public:
+  // Start at periodMs, kept within [floorMs, ceilingMs]
+  void begin(uint32_t periodMs, uint32_t floorMs, uint32_t ceilingMs) {
+    floor_ = floorMs ? floorMs : 1;
+    ceiling_ = ceilingMs > floor_ ? ceilingMs : floor_;
+    period_ = clamp(periodMs);
+    activity_ = 0;
+  }
+
+  // change = |delta| / step of the read that just completed; returns the
+  // period for the next read
+  uint32_t update(float change) {
+    activity_ += ADAPT_ALPHA * (change - activity_);
+
+    if (change >= 1.0f) {
+      uint32_t next = clamp(period_ / 2);
+      if (next < period_) speedUps++;
+      period_ = next;
+    } else if (activity_ < ADAPT_QUIET) {
+      uint32_t next = clamp(period_ + period_ * ADAPT_BACKOFF_PCT / 100 + 1);
+      if (next > period_) backOffs++;
+      period_ = next;
+    }
+    return period_;
+  }
+
+  uint32_t period() const { return period_; }
+  uint32_t floor() const { return floor_; }
+  uint32_t ceiling() const { return ceiling_; }
+  float activity() const { return activity_; }
+
+  uint32_t speedUps = 0;
+  uint32_t backOffs = 0;
+
+ private:
+  uint32_t clamp(uint32_t ms) const {
+    return ms < floor_ ? floor_ : ms > ceiling_ ? ceiling_ : ms;
+  }
+
+  uint32_t period_ = 0;
+  uint32_t floor_ = 1;
+  uint32_t ceiling_ = 1;
+  float activity_ = 0;
+};
@@ -0,0 +1,105 @@
+/*
+ * Automation - the rule table and its evaluation tick
+ *
+ * Each rule is a compiled RuleVM condition plus up to RULE_MAX_ACTIONS
+ * device actions. tick() evaluates the table round robin under an
+ * instruction budget, so a long table spreads over several ticks instead
+ * of stretching one, and runs actions on edges: "then" actions when a
+ * condition turns true, "release" actions when it turns false.
+ *
+ * The caller passes the time and a sink for the actions, so the same code
+ * runs in the firmware (millis(), setDeviceState) and in the host
+ * simulator (virtual clock, transition trace).
+ *
+ * Plain C++ with no Arduino dependency so it can be built on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "RuleVM.h"
+#include "RollingStats.h"
+
+#define MAX_RULES            10
+#define RULE_MAX_ACTIONS     4
+#define RULE_SOURCE_SIZE     96
+#define RULE_TICK_BUDGET     256  // VM instructions per automation tick
+
+// Rule operands: stat(sensor, window)
+#define STAT_VALUE           0    // instantaneous reading
+#define STAT_MEAN            1
+#define STAT_MIN             2
+#define STAT_MAX             3
+#define STAT_STD             4
+#define STAT_ROC             5    // rate of change per second
+
+extern const char* const STAT_NAMES[];
+
+// Stat index for a name, -1 if unknown
+int statIndex(const char* name, uint8_t length);
+// One aggregate of a window summary; NAN while the window is empty
+float summaryStat(const StatsSummary& s, uint8_t stat);
+
+struct RuleAction {
+  char device[16];
+  bool state;
+  int16_t value;
+  bool onRelease;
+};
+
+struct AutomationRule {
+  uint16_t id;              // stable while the rule exists ("rule<id>"), never 0
+  bool enabled;
+  char source[RULE_SOURCE_SIZE];
+  RuleProgram program;
+  RuleState state;
+  bool active;              // condition result of the last evaluation
+  RuleAction actions[RULE_MAX_ACTIONS];
+  uint8_t actionCount;
+  uint32_t fired;
+};
+
+// Receives every action a rule edge triggers
+class ActionSink {
+ public:
+  virtual ~ActionSink() {}
+  virtual void ruleAction(uint8_t rule, const RuleAction& action, uint32_t nowMs) = 0;
+};
+
+class Automation {
+ public:
+  explicit Automation(RuleSymbols& symbols) : symbols_(symbols) {}
+
+  // Start a rule in the next free slot; nullptr (see error()) if the
+  // table is full or the condition does not compile
+  AutomationRule* compile(const char* when, bool& constant);
+  static bool addAction(AutomationRule& rule, const char* device, bool state, int value, bool onRelease);
+  // Enable the rule from compile(); false (see error()) without actions
+  bool commit();
+  // Drop a rule by id; later rules move down one index. Runs no actions,
+  // so outputs it switched stay as they are.
+  bool remove(uint16_t id);
+
+  // One evaluation pass; true if any rule changed state
+  bool tick(uint32_t nowMs, ActionSink& sink);
+
+  const char* error() const { return error_; }
+  uint16_t errorAt() const { return errorAt_; }
+
+  uint8_t count() const { return count_; }
+  // Bit per sensor channel read by an enabled rule
+  uint32_t sensors() const;
+  const AutomationRule& rule(uint8_t i) const { return rules_[i]; }
+
+  uint32_t instructions = 0;
+  uint32_t budgetHits = 0;
+
+ private:
+  RuleSymbols& symbols_;
+  AutomationRule rules_[MAX_RULES];
+  uint8_t count_ = 0;
+  uint8_t cursor_ = 0;      // next rule to evaluate (round robin)
+  uint16_t nextId_ = 1;
+  const char* error_ = nullptr;
+  uint16_t errorAt_ = 0;
+};
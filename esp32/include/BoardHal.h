@@ -0,0 +1,185 @@
+/*
+ * BoardHal - board pin profiles and the relay output bank
+ *
+ * Each supported board is a profile type. It holds the board's default
+ * pins and the GPIOs its chip can drive as outputs. The relay pins of the
+ * fixed profiles are checked against that set at compile time. ChipBoard
+ * is the fixed profile of the chip being built for (CONFIG_IDF_TARGET_*),
+ * and only it or a custom board is accepted: the other chip's default
+ * pins are flash pins or missing GPIOs here. A custom board starts from
+ * the ChipBoard pins and is checked when the bank is loaded.
+ *
+ * RelayBank turns each relay into a GPIO bit mask once, at setup. When the
+ * configured pins are still the profile's, the masks are the profile's
+ * constant ones. Otherwise (custom board, or pins moved with `pin`) they
+ * are computed from the configured pins. Switching any set of relays is
+ * then one write to the output-set register and one to the output-clear
+ * register (W1TS/W1TC). Relays switched together change within one bus
+ * write of each other, and a write cannot race an interrupt doing its own
+ * read-modify-write of the port, which digitalWrite pin by pin cannot
+ * promise.
+ *
+ * The register writes go through the Port template parameter, so the
+ * bank is plain C++ with no Arduino dependency and can be built on the
+ * host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#if __has_include(<sdkconfig.h>)
+#include <sdkconfig.h>
+#endif
+
+// Board Types
+#define BOARD_ESP32_DEVKIT   0
+#define BOARD_LOLIN_S2_MINI  1
+#define BOARD_CUSTOM         2
+
+#define RELAY_COUNT          4
+
+// ============== DEFAULT PIN CONFIGURATIONS ==============
+
+// ESP32 DevKit Default Pins
+constexpr uint8_t DEVKIT_RELAY_PINS[RELAY_COUNT] = {26, 27, 14, 12};
+const uint8_t DEVKIT_LED_PIN = 25;
+const uint8_t DEVKIT_MOTOR_PIN = 33;
+const uint8_t DEVKIT_DHT_PIN = 32;
+const uint8_t DEVKIT_LIGHT_PIN = 34;
+const uint8_t DEVKIT_MOTION_PIN = 35;
+
+// Wemos Lolin S2 Mini Default Pins
+constexpr uint8_t S2MINI_RELAY_PINS[RELAY_COUNT] = {5, 7, 9, 11};
+const uint8_t S2MINI_LED_PIN = 15;
+const uint8_t S2MINI_MOTOR_PIN = 16;
+const uint8_t S2MINI_DHT_PIN = 33;
+const uint8_t S2MINI_LIGHT_PIN = 1;
+const uint8_t S2MINI_MOTION_PIN = 3;
+
+// GPIO n is bit n of lo (0-31) or bit n-32 of hi (32-63), the split of
+// the chip's OUT and OUT1 registers
+struct PinMask {
+  uint32_t lo;
+  uint32_t hi;
+};
+
+constexpr PinMask pinMask(uint8_t pin) {
+  return pin < 32 ? PinMask{1u << pin, 0} : PinMask{0, 1u << (pin - 32)};
+}
+
+constexpr uint64_t pinRange(uint8_t first, uint8_t last) {
+  return ((~0ULL) >> (63 - last)) & ~((1ULL << first) - 1);
+}
+
+constexpr bool pinsCanOutput(const uint8_t* pins, uint8_t n, uint64_t outputs) {
+  return n == 0 || (pins[0] < 64 && ((outputs >> pins[0]) & 1) && pinsCanOutput(pins + 1, n - 1, outputs));
+}
+
+// ESP32: 6-11 are the flash bus, 34-39 input only
+#define ESP32_OUTPUT_PINS  (pinRange(0, 5) | pinRange(12, 19) | pinRange(21, 23) | \
+                            pinRange(25, 27) | pinRange(32, 33))
+// ESP32-S2: 22-25 do not exist, 26-32 are flash/PSRAM, 46 is input only
+#define ESP32S2_OUTPUT_PINS (pinRange(0, 21) | pinRange(33, 45))
+
+struct DevKitBoard {
+  static constexpr uint8_t ID = BOARD_ESP32_DEVKIT;
+  static constexpr bool FIXED = true;
+  static constexpr uint64_t OUTPUT_PINS = ESP32_OUTPUT_PINS;
+  static constexpr const uint8_t* RELAY_PINS = DEVKIT_RELAY_PINS;
+  static constexpr uint8_t LED_PIN = DEVKIT_LED_PIN;
+  static constexpr uint8_t MOTOR_PIN = DEVKIT_MOTOR_PIN;
+  static constexpr uint8_t DHT_PIN = DEVKIT_DHT_PIN;
+  static constexpr uint8_t LIGHT_PIN = DEVKIT_LIGHT_PIN;
+  static constexpr uint8_t MOTION_PIN = DEVKIT_MOTION_PIN;
+  static const char* name() { return "ESP32 DevKit"; }
+};
+
+struct S2MiniBoard {
+  static constexpr uint8_t ID = BOARD_LOLIN_S2_MINI;
+  static constexpr bool FIXED = true;
+  static constexpr uint64_t OUTPUT_PINS = ESP32S2_OUTPUT_PINS;
+  static constexpr const uint8_t* RELAY_PINS = S2MINI_RELAY_PINS;
+  static constexpr uint8_t LED_PIN = S2MINI_LED_PIN;
+  static constexpr uint8_t MOTOR_PIN = S2MINI_MOTOR_PIN;
+  static constexpr uint8_t DHT_PIN = S2MINI_DHT_PIN;
+  static constexpr uint8_t LIGHT_PIN = S2MINI_LIGHT_PIN;
+  static constexpr uint8_t MOTION_PIN = S2MINI_MOTION_PIN;
+  static const char* name() { return "Lolin S2 Mini"; }
+};
+
+#if CONFIG_IDF_TARGET_ESP32S2
+typedef S2MiniBoard ChipBoard;
+#else
+typedef DevKitBoard ChipBoard;
+#endif
+
+// Any pins, starting from the chip's profile; checked at load time
+struct CustomBoard : ChipBoard {
+  static constexpr uint8_t ID = BOARD_CUSTOM;
+  static constexpr bool FIXED = false;
+  static const char* name() { return "Custom"; }
+};
+
+static_assert(pinsCanOutput(DEVKIT_RELAY_PINS, RELAY_COUNT, ESP32_OUTPUT_PINS),
+              "DevKit relay pin is not an output GPIO");
+static_assert(pinsCanOutput(S2MINI_RELAY_PINS, RELAY_COUNT, ESP32S2_OUTPUT_PINS),
+              "S2 Mini relay pin is not an output GPIO");
+
+// Board types this build can run: its chip's profile or custom pins
+constexpr bool boardFitsChip(uint8_t type) {
+  return type == ChipBoard::ID || type == BOARD_CUSTOM;
+}
+
+class RelayBank {
+ public:
+  // Masks for the enabled relays. Relays on a pin the board cannot drive
+  // are left out; returns them as a bit mask (bit 0 = relay 1).
+  template <typename Board>
+  uint8_t load(const uint8_t pins[RELAY_COUNT], const bool enabled[RELAY_COUNT]) {
+    fixed_ = Board::FIXED;
+    for (uint8_t i = 0; i < RELAY_COUNT; i++) {
+      if (pins[i] != Board::RELAY_PINS[i]) fixed_ = false;
+    }
+
+    uint8_t rejected = 0;
+    enabled_ = 0;
+    for (uint8_t i = 0; i < RELAY_COUNT; i++) {
+      masks_[i] = PinMask{0, 0};
+      if (!enabled[i]) continue;
+      if (fixed_) {
+        masks_[i] = pinMask(Board::RELAY_PINS[i]);
+      } else if (pins[i] < 64 && ((Board::OUTPUT_PINS >> pins[i]) & 1)) {
+        masks_[i] = pinMask(pins[i]);
+      } else {
+        rejected |= 1 << i;
+        continue;
+      }
+      enabled_ |= 1 << i;
+    }
+    return rejected;
+  }
+
+  // Drive the relays in select (bit 0 = relay 1) to the matching bits of
+  // states with one set and one clear write; other relays are untouched
+  template <typename Port>
+  void write(uint8_t select, uint8_t states) const {
+    PinMask on = {0, 0}, off = {0, 0};
+    select &= enabled_;
+    for (uint8_t i = 0; i < RELAY_COUNT; i++) {
+      if (!(select & (1 << i))) continue;
+      PinMask& m = (states & (1 << i)) ? on : off;
+      m.lo |= masks_[i].lo;
+      m.hi |= masks_[i].hi;
+    }
+    Port::write(on, off);
+  }
+
+  uint8_t enabled() const { return enabled_; }
+  // True if the masks came from the board profile unchanged
+  bool fixed() const { return fixed_; }
+
+ private:
+  PinMask masks_[RELAY_COUNT] = {};
+  uint8_t enabled_ = 0;
+  bool fixed_ = false;
+};
@@ -0,0 +1,223 @@
+/*
+ * ConfigSchema - one compile-time table of the persisted config fields
+ *
+ * Every scalar field of a config struct is described once: JSON key,
+ * offset and type (taken from the member, so they cannot drift from the
+ * struct), limits, default and the layout version that added it. The
+ * JSON reader and writer, defaults for a new or upgraded EEPROM layout,
+ * serial setters and the config printout are all generated from it.
+ *
+ * Reading JSON is one pass over the document's keys. Each key is hashed
+ * once and matched against hashes computed at compile time. A field is
+ * only set when the value has the right type and is in range, so 0,
+ * false and "" are ordinary values. Strings that do not fit are rejected
+ * rather than truncated, so what comes back out is exactly what went in.
+ *
+ * Nested and per-channel settings (publish, timing, statWindows) are not
+ * scalar fields and stay with their own code.
+ *
+ * Plain C++; ArduinoJson is the only dependency.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+#include <ArduinoJson.h>
+
+enum ConfigType : uint8_t { CFG_BOOL, CFG_U8, CFG_U16, CFG_U32, CFG_STR };
+
+#define CFG_SECRET    0x01    // accepted, never sent back; "" in JSON keeps it
+#define CFG_PIN       0x02    // GPIO, also settable with the serial `pin` command
+
+#define CFG_MAX_GPIO  48
+
+struct ConfigField {
+  const char* key;
+  const char* alias;        // serial pin name, nullptr if not a pin
+  const char* group;        // printConfig section
+  uint32_t hash;            // configHash(key)
+  uint16_t offset;
+  uint16_t size;
+  uint8_t type;
+  uint8_t flags;
+  uint8_t since;            // EEPROM layout version that added the field
+  int32_t min;
+  int32_t max;
+  int32_t def;
+  const char* defText;      // default of a string field
+};
+
+// FNV-1a; the same function hashes table keys at compile time and
+// document keys at run time
+constexpr uint32_t configHash(const char* s, uint32_t h = 2166136261u) {
+  return *s ? configHash(s + 1, (h ^ (uint8_t)*s) * 16777619u) : h;
+}
+
+template <typename T> struct ConfigTypeOf;
+template <> struct ConfigTypeOf<bool>     { static constexpr uint8_t value = CFG_BOOL; };
+template <> struct ConfigTypeOf<uint8_t>  { static constexpr uint8_t value = CFG_U8; };
+template <> struct ConfigTypeOf<uint16_t> { static constexpr uint8_t value = CFG_U16; };
+template <> struct ConfigTypeOf<uint32_t> { static constexpr uint8_t value = CFG_U32; };
+template <size_t N> struct ConfigTypeOf<char[N]> { static constexpr uint8_t value = CFG_STR; };
+
+// offset, size and type of S::member (member may be an array element)
+#define CFG_MEMBER(S, member) \
+  (uint16_t)offsetof(S, member), (uint16_t)sizeof(((S*)0)->member), \
+  ConfigTypeOf<std::remove_reference<decltype(((S*)0)->member)>::type>::value
+
+#define CONFIG_NUM(S, group, key, member, since, def, min, max) \
+  {key, nullptr, group, configHash(key), CFG_MEMBER(S, member), 0, since, min, max, def, nullptr}
+#define CONFIG_BOOL(S, group, key, member, since, def) \
+  {key, nullptr, group, configHash(key), CFG_MEMBER(S, member), 0, since, 0, 1, def, nullptr}
+#define CONFIG_STR(S, group, key, member, since, def, flags) \
+  {key, nullptr, group, configHash(key), CFG_MEMBER(S, member), flags, since, 0, 0, 0, def}
+#define CONFIG_PIN(S, group, key, alias, member, since, def) \
+  {key, alias, group, configHash(key), CFG_MEMBER(S, member), CFG_PIN, since, 0, CFG_MAX_GPIO, def, nullptr}
+
+template <typename S, size_t N>
+class ConfigSchema {
+ public:
+  constexpr explicit ConfigSchema(const ConfigField (&fields)[N]) : fields_(fields) {}
+
+  static constexpr size_t size() { return N; }
+  const ConfigField& operator[](size_t i) const { return fields_[i]; }
+
+  const ConfigField* find(const char* key) const {
+    uint32_t h = configHash(key);
+    for (size_t i = 0; i < N; i++) {
+      if (fields_[i].hash == h && strcmp(fields_[i].key, key) == 0) return &fields_[i];
+    }
+    return nullptr;
+  }
+
+  const ConfigField* findPin(const char* alias) const {
+    for (size_t i = 0; i < N; i++) {
+      if (fields_[i].alias && strcmp(fields_[i].alias, alias) == 0) return &fields_[i];
+    }
+    return nullptr;
+  }
+
+  // Defaults for the fields added after layout version `since` (0 = all)
+  void defaults(S& obj, uint8_t since = 0) const {
+    for (size_t i = 0; i < N; i++) {
+      const ConfigField& f = fields_[i];
+      if (f.since <= since) continue;
+      if (f.type == CFG_STR) copyText(obj, f, f.defText);
+      else writeNum(obj, f, f.def);
+    }
+  }
+
+  void toJson(const S& obj, JsonObject out) const {
+    for (size_t i = 0; i < N; i++) {
+      const ConfigField& f = fields_[i];
+      if (f.flags & CFG_SECRET) continue;
+      if (f.type == CFG_STR) out[f.key] = text(obj, f);
+      else if (f.type == CFG_BOOL) out[f.key] = readNum(obj, f) != 0;
+      else out[f.key] = (uint32_t)readNum(obj, f);
+    }
+  }
+
+  // Apply every known key of in; unknown keys are left to the caller.
+  // Secrets are never sent back, so a form that shows them blank posts
+  // "": that keeps the stored value (clear a secret over serial).
+  // Returns the first key with a bad value (fields before it are already
+  // set, so apply to a copy to keep a rejected update out), else nullptr.
+  const char* fromJson(S& obj, JsonObjectConst in) const {
+    for (JsonPairConst kv : in) {
+      const ConfigField* f = find(kv.key().c_str());
+      if (!f || kv.value().isNull()) continue;
+      if ((f->flags & CFG_SECRET) && kv.value().is<const char*>() && !kv.value().as<const char*>()[0]) continue;
+      if (!assign(obj, *f, kv.value())) return f->key;
+    }
+    return nullptr;
+  }
+
+  bool assign(S& obj, const ConfigField& f, JsonVariantConst v) const {
+    if (f.type == CFG_STR) {
+      if (!v.is<const char*>()) return false;
+      return storeText(obj, f, v.as<const char*>());
+    }
+    if (f.type == CFG_BOOL && v.is<bool>()) return setNum(obj, f, v.as<bool>());
+    if (!v.is<long>()) return false;
+    return setNum(obj, f, v.as<long>());
+  }
+
+  // From serial text: numbers, on/off/true/false for flags, raw strings
+  bool parse(S& obj, const ConfigField& f, const char* value) const {
+    if (f.type == CFG_STR) return storeText(obj, f, value);
+    if (f.type == CFG_BOOL) {
+      if (!strcmp(value, "on") || !strcmp(value, "true")) return setNum(obj, f, 1);
+      if (!strcmp(value, "off") || !strcmp(value, "false")) return setNum(obj, f, 0);
+    }
+    char* end;
+    long v = strtol(value, &end, 10);
+    if (end == value || *end) return false;
+    return setNum(obj, f, v);
+  }
+
+  // Value for display; secrets are masked
+  void format(const S& obj, const ConfigField& f, char* buf, size_t size) const {
+    if (f.type == CFG_STR) {
+      const char* t = text(obj, f);
+      snprintf(buf, size, "%s", !t[0] ? "(not set)" : (f.flags & CFG_SECRET) ? "********" : t);
+    } else if (f.type == CFG_BOOL) {
+      snprintf(buf, size, "%s", readNum(obj, f) ? "ON" : "OFF");
+    } else {
+      snprintf(buf, size, "%lu", (unsigned long)readNum(obj, f));
+    }
+  }
+
+  static const char* text(const S& obj, const ConfigField& f) {
+    return (const char*)&obj + f.offset;
+  }
+
+ private:
+  static int64_t readNum(const S& obj, const ConfigField& f) {
+    const uint8_t* p = (const uint8_t*)&obj + f.offset;
+    switch (f.type) {
+      case CFG_BOOL: return *(const bool*)p;
+      case CFG_U8:   return *p;
+      case CFG_U16:  { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+      case CFG_U32:  { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+    }
+    return 0;
+  }
+
+  static void writeNum(S& obj, const ConfigField& f, int64_t value) {
+    uint8_t* p = (uint8_t*)&obj + f.offset;
+    switch (f.type) {
+      case CFG_BOOL: *(bool*)p = value != 0; break;
+      case CFG_U8:   *p = (uint8_t)value; break;
+      case CFG_U16:  { uint16_t v = value; memcpy(p, &v, sizeof(v)); break; }
+      case CFG_U32:  { uint32_t v = value; memcpy(p, &v, sizeof(v)); break; }
+    }
+  }
+
+  static bool setNum(S& obj, const ConfigField& f, int64_t value) {
+    if (value < f.min || value > f.max) return false;
+    writeNum(obj, f, value);
+    return true;
+  }
+
+  static bool storeText(S& obj, const ConfigField& f, const char* value) {
+    if (strlen(value) >= f.size) return false;
+    copyText(obj, f, value);
+    return true;
+  }
+
+  static void copyText(S& obj, const ConfigField& f, const char* value) {
+    snprintf((char*)&obj + f.offset, f.size, "%s", value ? value : "");
+  }
+
+  const ConfigField (&fields_)[N];
+};
+
+template <typename S, size_t N>
+constexpr ConfigSchema<S, N> makeConfigSchema(const ConfigField (&fields)[N]) {
+  return ConfigSchema<S, N>(fields);
+}
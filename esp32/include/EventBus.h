@@ -0,0 +1,101 @@
+/*
+ * EventBus - fixed-size events in a ring, read through per-consumer cursors
+ *
+ * Producers publish small fixed events (a sensor reading, a device
+ * change) into a ring of Capacity slots. Nothing is allocated and nothing
+ * is copied per consumer: each consumer owns an EventCursor with its own
+ * position and filter (event types, source indexes, changed-only), and
+ * next() hands out pointers into the ring. A slot stays valid until
+ * Capacity newer events have been published.
+ *
+ * Consumers that fall more than Capacity events behind skip ahead to the
+ * oldest slot still held and count the skipped events as missed; the
+ * producer never waits. Events are sequence numbered, so a consumer can
+ * also tell how far behind it is.
+ *
+ * Single-threaded: publish and next are called from the same task.
+ *
+ * Plain C++ with no Arduino dependency so it can be built on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define EVENT_SENSOR         0    // source = channel, value = reading
+#define EVENT_DEVICE         1    // source = device, value = level (state in flags)
+
+#define EVENT_CHANGED        0x01 // value differs from the source's previous event
+#define EVENT_STATE          0x02 // device on
+
+#define EVENT_TYPE(type)     (1U << (type))
+#define EVENT_ALL_SOURCES    0xFFFFFFFFUL
+
+struct Event {
+  uint32_t seq;
+  uint32_t timeMs;
+  float value;
+  uint8_t type;
+  uint8_t source;           // < 32, so cursors can filter with a bit mask
+  uint8_t flags;
+};
+
+struct EventCursor {
+  uint32_t next;            // seq of the next event to read
+  uint8_t types;            // EVENT_TYPE() bits
+  uint32_t sources;         // bit per source index
+  bool changedOnly;
+  uint32_t delivered;
+  uint32_t missed;          // overwritten before they were read
+};
+
+template <uint16_t Capacity>
+class EventBus {
+ public:
+  static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+  void publish(uint8_t type, uint8_t source, float value, uint8_t flags, uint32_t nowMs) {
+    Event& e = ring_[head_ & (Capacity - 1)];
+    e.seq = head_++;
+    e.timeMs = nowMs;
+    e.value = value;
+    e.type = type;
+    e.source = source;
+    e.flags = flags;
+  }
+
+  // Start reading at the next event published
+  void subscribe(EventCursor& c, uint8_t types, uint32_t sources, bool changedOnly) {
+    c = EventCursor();
+    c.next = head_;
+    c.types = types;
+    c.sources = sources;
+    c.changedOnly = changedOnly;
+  }
+
+  // Next event that passes the cursor's filter, nullptr when caught up
+  const Event* next(EventCursor& c) {
+    if (head_ - c.next > Capacity) {
+      c.missed += head_ - Capacity - c.next;
+      c.next = head_ - Capacity;
+    }
+    while (c.next != head_) {
+      const Event& e = ring_[c.next++ & (Capacity - 1)];
+      if (!(c.types & EVENT_TYPE(e.type))) continue;
+      if (!(c.sources & (1UL << e.source))) continue;
+      if (c.changedOnly && !(e.flags & EVENT_CHANGED)) continue;
+      c.delivered++;
+      return &e;
+    }
+    return nullptr;
+  }
+
+  // Unread events (before filtering)
+  uint32_t behind(const EventCursor& c) const { return head_ - c.next; }
+  uint32_t published() const { return head_; }
+  uint16_t capacity() const { return Capacity; }
+
+ private:
+  Event ring_[Capacity];
+  uint32_t head_ = 0;       // seq of the next event
+};
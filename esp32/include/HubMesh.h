@@ -0,0 +1,216 @@
+/*
+ * HubMesh - LAN discovery and state replication between hubs
+ *
+ * Every hub announces itself on a UDP multicast group. One hub (or more)
+ * runs as aggregator. Each peer picks the online aggregator with the
+ * lowest id and replicates its state to it, so a dashboard connected to
+ * the aggregator sees every hub on one WebSocket.
+ *
+ * State is a small table of entries (sensor readings, device states),
+ * each stamped with the hub's state version when it last changed. A peer
+ * sends a DELTA with every entry newer than the version the aggregator
+ * acknowledged. The aggregator applies a delta only if it starts at or
+ * below the version it holds, and always ACKs the version it holds. A
+ * lost delta or ACK is therefore repaired by resending from the
+ * acknowledged version, and an aggregator that missed something tells
+ * the peer where to restart. Every packet carries the sender's boot
+ * epoch, so a hub that rebooted (its versions start over) is resent or
+ * reset in full.
+ *
+ * Commands for a device on another hub are routed by the aggregator to
+ * the owner, which applies them and answers COMMAND_ACK; the aggregator
+ * retries a few times before giving up. Commands for one owner go out
+ * one at a time, in order: the next is sent once the previous one was
+ * acknowledged or given up. The owner keeps the highest seq it applied
+ * from each sender (and epoch) and only re-ACKs anything at or below it,
+ * so a retry whose ACK was lost, or that arrives late, is never applied
+ * again or over a newer command.
+ *
+ * Wire format, little endian, one packet per datagram:
+ *   header    'H' 'M' proto type | hub id u32 | epoch u32 | port u16
+ *   ANNOUNCE  flags u8 | version u32 | entries u8 | name (len u8 + bytes)
+ *   DELTA     from u32 | to u32 | count u8 | count x entry
+ *             entry: key (len u8 + bytes) | flags u8 | value f32
+ *   ACK       peer epoch u32 | version u32
+ *   COMMAND   target id u32 | seq u16 | state u8 | value i16 | key
+ *   CMD_ACK   seq u16 | ok u8
+ *
+ * The transport is an interface, so the protocol is plain C++ with no
+ * Arduino dependency and can be built on the host (see src/meshnode).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MESH_GROUP_IP        239, 255, 42, 99
+#define MESH_PORT            4210
+#define MESH_PROTO           1
+
+#define MESH_MAX_HUBS        8
+#define MESH_MAX_ENTRIES     24
+#define MESH_KEY_SIZE        12
+#define MESH_NAME_SIZE       24
+#define MESH_PACKET_SIZE     512
+#define MESH_MAX_PENDING     4
+
+#define MESH_ANNOUNCE_MS     2000
+#define MESH_HUB_TIMEOUT_MS  7000      // offline after ~3 missed announces
+#define MESH_DELTA_MIN_MS    100       // between deltas while state changes
+#define MESH_RESEND_MS       1000      // unacknowledged delta resent after
+#define MESH_COMMAND_MS      250       // command retry interval
+#define MESH_COMMAND_TRIES   4
+
+#define MESH_OFF             0
+#define MESH_PEER            1
+#define MESH_AGGREGATOR      2
+
+#define MESH_ANNOUNCE        1
+#define MESH_DELTA           2
+#define MESH_ACK             3
+#define MESH_COMMAND         4
+#define MESH_COMMAND_ACK     5
+
+#define MESH_ENTRY_STATE     0x01      // on/off of a device, motion
+#define MESH_ENTRY_DEVICE    0x02      // controllable (else a sensor)
+
+// ip 0 = the multicast group; ip is in network order as the stack gives it
+struct MeshAddr {
+  uint32_t ip;
+  uint16_t port;
+};
+
+struct MeshEntry {
+  char key[MESH_KEY_SIZE];
+  uint8_t flags;
+  float value;
+  uint32_t version;
+};
+
+struct MeshHub {
+  uint32_t id;
+  uint32_t epoch;
+  char name[MESH_NAME_SIZE];
+  MeshAddr addr;
+  bool aggregator;
+  bool online;
+  uint32_t lastHeard;
+  uint32_t version;           // highest applied (own hub: current)
+  uint16_t commandSeq;        // highest command seq applied from this hub
+  bool commandSeen;           // commandSeq is valid for this epoch
+  bool commandOk;             // result of commandSeq
+  uint8_t count;
+  MeshEntry entries[MESH_MAX_ENTRIES];
+};
+
+class MeshTransport {
+ public:
+  virtual ~MeshTransport() {}
+  virtual void send(const MeshAddr& to, const uint8_t* data, size_t len) = 0;
+};
+
+class MeshHandler {
+ public:
+  virtual ~MeshHandler() {}
+  // A routed command for a device of this hub; true if it was applied
+  virtual bool meshCommand(const char* device, bool state, int16_t value) = 0;
+  // Aggregator: hub i's entries changed, or it came online or went offline
+  virtual void meshChanged(uint8_t hub) {}
+  virtual void meshCommandDone(uint8_t hub, const char* device, bool ok) {}
+};
+
+struct MeshStats {
+  uint32_t sent;
+  uint32_t received;
+  uint32_t rejected;          // malformed or another protocol version
+  uint32_t deltasSent;
+  uint32_t deltasApplied;
+  uint32_t resyncs;           // deltas not starting at the held version
+  uint32_t commandsRouted;
+  uint32_t commandsFailed;
+};
+
+class HubMesh {
+ public:
+  void begin(uint8_t mode, uint32_t id, uint32_t epoch, const char* name, uint16_t port,
+             MeshTransport& transport, MeshHandler& handler);
+  void end() { mode_ = MESH_OFF; }
+
+  // Own state; the version only moves when a value changes
+  void setSensor(const char* key, float value);
+  void setDevice(const char* key, bool state, float value);
+
+  void receive(const MeshAddr& from, const uint8_t* data, size_t len, uint32_t nowMs);
+  // Announces, deltas, command retries and hub timeouts
+  void tick(uint32_t nowMs);
+
+  // Route a command to the hub named (or numbered) hub; the own hub is
+  // handled directly. False if the hub is unknown, offline or the command
+  // queue is full; the outcome of a routed one goes to meshCommandDone.
+  bool command(const char* hub, const char* device, bool state, int16_t value, uint32_t nowMs);
+
+  uint8_t mode() const { return mode_; }
+  uint8_t hubCount() const { return hubCount_; }
+  const MeshHub& hub(uint8_t i) const { return hubs_[i]; }   // 0 = own hub
+  int8_t findHub(const char* nameOrId) const;
+  // Peer: index of the aggregator replicated to, -1 if none
+  int8_t aggregator() const { return aggregator_; }
+  uint32_t acked() const { return acked_; }
+  const MeshStats& stats() const { return stats_; }
+
+ private:
+  struct Pending {
+    bool used;
+    uint8_t hub;
+    uint16_t seq;
+    uint8_t tries;
+    uint32_t sentMs;
+    bool state;
+    int16_t value;
+    char device[MESH_KEY_SIZE];
+  };
+
+  MeshEntry* entry(MeshHub& hub, const char* key, bool create);
+  void set(const char* key, uint8_t flags, float value);
+  int8_t hubById(uint32_t id, const MeshAddr& from, uint32_t nowMs, bool create);
+  void chooseAggregator();
+
+  size_t header(uint8_t* buf, uint8_t type) const;
+  void send(const MeshAddr& to, const uint8_t* buf, size_t len);
+  void announce();
+  void sendDelta(uint32_t nowMs);
+  void sendAck(const MeshHub& peer);
+  void sendCommand(Pending& p, uint32_t nowMs);
+  bool queuedBehind(const Pending& p) const;
+
+  void onAnnounce(uint8_t h, const uint8_t* p, size_t len);
+  void onDelta(uint8_t h, const uint8_t* p, size_t len);
+  void onAck(const uint8_t* p, size_t len);
+  void onCommand(uint8_t h, const uint8_t* p, size_t len);
+  void onCommandAck(uint8_t h, const uint8_t* p, size_t len, uint32_t nowMs);
+
+  uint8_t mode_ = MESH_OFF;
+  uint16_t port_ = 0;
+  MeshTransport* transport_ = nullptr;
+  MeshHandler* handler_ = nullptr;
+
+  MeshHub hubs_[MESH_MAX_HUBS];
+  uint8_t hubCount_ = 0;
+
+  // Peer side of replication
+  int8_t aggregator_ = -1;
+  uint32_t aggregatorId_ = 0;
+  uint32_t aggregatorEpoch_ = 0;
+  uint32_t acked_ = 0;
+  uint32_t sentVersion_ = 0;
+  uint32_t lastDelta_ = 0;
+  uint32_t lastAnnounce_ = 0;
+  bool announced_ = false;
+
+  // Aggregator: commands in flight or queued behind one to the same hub
+  Pending pending_[MESH_MAX_PENDING] = {};
+  uint16_t seq_ = 0;
+
+  MeshStats stats_ = {};
+};
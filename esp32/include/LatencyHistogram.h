@@ -0,0 +1,75 @@
+/*
+ * LatencyHistogram - fixed-size log2 histogram of latencies in microseconds
+ *
+ * Bucket 0 holds values below 2 us, bucket i holds [2^i, 2^(i+1)) us and
+ * the last bucket everything from 2^(LATENCY_BUCKETS-1) us up. Adding is
+ * O(1) (one count-leading-zeros). Percentiles are the upper edge of the
+ * bucket that crosses the rank, so they are exact to a factor of two.
+ * The exact max and the sum are kept too.
+ *
+ * Plain C++ with no Arduino dependency so it can be built on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define LATENCY_BUCKETS 24    // last bucket starts at ~8.4 s
+
+class LatencyHistogram {
+ public:
+  LatencyHistogram() { reset(); }
+
+  void reset() {
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) buckets_[i] = 0;
+    count_ = 0;
+    sumUs_ = 0;
+    maxUs_ = 0;
+  }
+
+  void add(uint32_t us) {
+    uint8_t b = us < 2 ? 0 : 31 - __builtin_clz(us);
+    if (b >= LATENCY_BUCKETS) b = LATENCY_BUCKETS - 1;
+    buckets_[b]++;
+    count_++;
+    sumUs_ += us;
+    if (us > maxUs_) maxUs_ = us;
+  }
+
+  // Upper bound of the p-th percentile (0 < p <= 100), 0 while empty
+  uint32_t percentile(float p) const {
+    if (count_ == 0) return 0;
+    uint32_t rank = (uint32_t)(count_ * p / 100.0f + 0.5f);
+    if (rank == 0) rank = 1;
+
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS - 1; i++) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        uint32_t edge = (2UL << i) - 1;
+        return edge < maxUs_ ? edge : maxUs_;
+      }
+    }
+    return maxUs_;
+  }
+
+  uint32_t count() const { return count_; }
+  uint32_t maxUs() const { return maxUs_; }
+  uint32_t meanUs() const { return count_ ? (uint32_t)(sumUs_ / count_) : 0; }
+  uint32_t bucket(uint8_t i) const { return buckets_[i]; }
+
+  // Buckets above this one are all empty
+  uint8_t highest() const {
+    uint8_t top = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+      if (buckets_[i]) top = i;
+    }
+    return top;
+  }
+
+ private:
+  uint32_t buckets_[LATENCY_BUCKETS];
+  uint32_t count_;
+  uint64_t sumUs_;
+  uint32_t maxUs_;
+};
@@ -0,0 +1,122 @@
+/*
+ * LoopWatchdog - attributes loop() stalls to the stage that caused them
+ *
+ * loop() marks each stage with enter(STAGE) and closes the pass with
+ * endLoop(). Per stage the watchdog keeps the longest run and how often
+ * the stage went over its budget.
+ *
+ * A periodic esp_timer check (WATCHDOG_CHECK_MS, on the esp_timer task)
+ * notices a stage that is still running past its budget. It captures the
+ * loop task's backtrace from its saved context, which is only possible
+ * while the task is switched out (blocked on a socket, delay, ...). That
+ * is when long stalls happen. The stage, duration and backtrace go into
+ * an RTC_NOINIT record that survives a software, watchdog or panic reset
+ * and is reported once at the next boot. When the stage returns, the
+ * record gets its final duration. Every stage run has a sequence number,
+ * and the capture is tagged with it, so a stage that returns while the
+ * monitor is recording it cannot hand its duration to the next run. The
+ * two sides share the record under a spinlock.
+ *
+ * With a panic timeout set, the loop task is also subscribed to the ESP
+ * task watchdog. A loop that stays stuck then resets the chip instead of
+ * hanging, and the record says which stage it was stuck in.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#define WATCHDOG_MAX_STAGES      16
+#define WATCHDOG_BACKTRACE_DEPTH 8
+#define WATCHDOG_CHECK_MS        100
+#define WATCHDOG_NO_STAGE        0xFF
+
+struct StallRecord {
+  uint32_t magic;
+  uint8_t stage;
+  uint8_t depth;              // valid backtrace entries
+  bool live;                  // caught by the monitor while still stalled
+  bool finished;              // stage returned (durationMs is final)
+  uint32_t durationMs;
+  uint32_t budgetMs;
+  uint32_t uptimeS;
+  uint32_t backtrace[WATCHDOG_BACKTRACE_DEPTH];
+  uint16_t crc;
+};
+
+struct StageStats {
+  uint32_t maxUs;
+  uint32_t overruns;
+};
+
+class LoopWatchdog {
+ public:
+  // names/budgetsMs are indexed by stage and must outlive the watchdog.
+  // panicSeconds > 0 subscribes the calling (loop) task to the task WDT.
+  void begin(const char* const* names, const uint16_t* budgetsMs, uint8_t stages,
+             uint16_t panicSeconds);
+
+  // Close the running stage and start the next one
+  inline void enter(uint8_t stage) {
+    uint32_t now = micros();
+    if (current_ != WATCHDOG_NO_STAGE) finish(now);
+    portENTER_CRITICAL(&mux_);
+    enteredAt_ = now;
+    if (++run_ == 0) run_ = 1;
+    current_ = stage;
+    portEXIT_CRITICAL(&mux_);
+  }
+
+  void endLoop();
+
+  // Reset the task WDT from inside a long stage that is making progress
+  // (a firmware upload), without closing the stage
+  void feed();
+
+  // Subscribe the loop task to the task WDT (0 unsubscribes)
+  void setPanic(uint16_t seconds);
+
+  // Record left by the previous boot (valid if hasReport())
+  bool hasReport() const { return hasReport_; }
+  const StallRecord& report() const { return report_; }
+  const char* resetReason() const;
+
+  // Latest stall of this boot (valid if stalls > 0)
+  const StallRecord& last() const;
+
+  const char* stageName(uint8_t stage) const;
+  uint8_t stages() const { return count_; }
+  uint16_t budget(uint8_t stage) const { return budgets_[stage]; }
+  const StageStats& stats(uint8_t stage) const { return stats_[stage]; }
+  uint16_t panicSeconds() const { return panicSeconds_; }
+
+  void printReport(Print& out, const StallRecord& record) const;
+
+  uint32_t stalls = 0;
+
+ private:
+  void finish(uint32_t now);
+  uint32_t limitMs(uint8_t stage) const;
+  void capture(uint8_t stage, uint32_t durationMs, bool live);
+  static void onCheck(void* arg);
+
+  const char* const* names_ = nullptr;
+  const uint16_t* budgets_ = nullptr;
+  uint8_t count_ = 0;
+  uint16_t panicSeconds_ = 0;
+  TaskHandle_t loopTask_ = nullptr;
+  esp_timer_handle_t timer_ = nullptr;
+
+  // Shared by the loop task and the monitor, under mux_
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+  volatile uint8_t current_ = WATCHDOG_NO_STAGE;
+  volatile uint32_t enteredAt_ = 0;
+  volatile uint32_t run_ = 0;            // stage run sequence, never 0
+  volatile uint32_t capturedRun_ = 0;    // run the monitor recorded live
+
+  StageStats stats_[WATCHDOG_MAX_STAGES] = {};
+  StallRecord report_ = {};
+  bool hasReport_ = false;
+  int resetReason_ = 0;
+};
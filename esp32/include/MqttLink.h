@@ -0,0 +1,90 @@
+/*
+ * MqttLink - MQTT client mode so a broker does the dashboard fan-out
+ *
+ * Readings and device states go to retained topics under
+ * <prefix>/<device>/, e.g.
+ *   iothub/esp32-iot-hub/sensor/temp1   {"value":23.4,"unit":"°C"}
+ *   iothub/esp32-iot-hub/state/relay1   {"state":true}
+ *   iothub/esp32-iot-hub/status         online | offline (last will)
+ * and commands are taken from <prefix>/<device>/cmd/<id>.
+ *
+ * Outgoing messages pass through a fixed outbox keyed by topic. A newer
+ * payload for a topic replaces the pending one and an identical payload is
+ * dropped, so while the broker is unreachable the outbox holds the latest
+ * value of every topic rather than a backlog. After a (re)connect every
+ * topic is re-sent, and the outbox drains MQTT_BATCH messages per loop pass.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <MQTTClient.h>
+
+#define MQTT_OUTBOX_SIZE   24
+#define MQTT_TOPIC_SIZE    24    // suffix after <prefix>/<device>/
+#define MQTT_PAYLOAD_SIZE  96
+#define MQTT_BATCH         8
+#define MQTT_RETRY_MS      5000UL
+#define MQTT_RETRY_MAX_MS  60000UL
+
+class MqttLink {
+ public:
+  // Called for <prefix>/<device>/cmd/<id>; payload is NUL terminated
+  typedef void (*CommandHandler)(const char* id, const char* payload, size_t length);
+
+  MqttLink() : client_(512) {}
+
+  void begin(const char* host, uint16_t port, const char* user, const char* password,
+             const char* prefix, const char* device, uint8_t qos, CommandHandler handler);
+
+  // Reconnect with backoff, pump the client and flush one outbox batch
+  void loop(bool networkUp);
+
+  // Retained publish of <prefix>/<device>/<topic> through the outbox
+  bool publish(const char* topic, const char* payload);
+
+  bool enabled() const { return enabled_; }
+  bool connected() { return enabled_ && client_.connected(); }
+  uint8_t pending() const;
+
+  uint32_t published = 0;
+  uint32_t coalesced = 0;      // replaced before it was sent
+  uint32_t unchanged = 0;      // same payload as the topic already holds
+  uint32_t overflow = 0;       // no outbox slot for a new topic
+  uint32_t failures = 0;
+  uint32_t connects = 0;
+  uint32_t commands = 0;
+
+ private:
+  struct Slot {
+    char topic[MQTT_TOPIC_SIZE];
+    char payload[MQTT_PAYLOAD_SIZE];
+    bool used;
+    bool dirty;
+  };
+
+  bool connect();
+  void flush();
+  static void onMessage(MQTTClient* client, char topic[], char bytes[], int length);
+
+  static MqttLink* instance_;
+
+  WiFiClient net_;
+  MQTTClient client_;
+  bool enabled_ = false;
+
+  String base_;                // "<prefix>/<device>/"
+  String host_;
+  String user_;
+  String password_;
+  String clientId_;
+  uint16_t port_ = 1883;
+  uint8_t qos_ = 0;
+  CommandHandler handler_ = nullptr;
+
+  unsigned long lastAttempt_ = 0;
+  unsigned long backoff_ = 0;
+
+  Slot outbox_[MQTT_OUTBOX_SIZE] = {};
+};
@@ -0,0 +1,218 @@
+/*
+ * OtaPipeline - streaming decode and verification of firmware uploads
+ *
+ * An upload is fed in whatever chunks the HTTP server hands over and is
+ * decoded on the fly, so at no point is more than one chunk (plus the
+ * inflate window) held in RAM. The layers are recognised by their magic:
+ *
+ *   [gzip]  ->  [delta]  ->  ESP32 image  ->  SHA-256 + sink
+ *
+ * - gzip (1f 8b): DEFLATE with a 32 KB window, CRC-32 and size trailer
+ *   checked.
+ * - delta ("ODLT"): ops against the running image (see tools/ota_delta.py).
+ *   The header names the base by size and SHA-256, which is checked
+ *   before the first op, and carries the SHA-256 of the image it
+ *   produces. COPY takes a range of the base, ADD a range of the base plus
+ *   per-byte differences (what moved code mostly needs, and it compresses
+ *   well), DATA literal bytes.
+ * - otherwise the payload is the image itself and must start with the
+ *   ESP32 image magic (0xE9).
+ *
+ * The image is hashed as it goes to the sink. finish() only succeeds if
+ * every layer ended cleanly and the hash matches the expected one: given
+ * by the caller, from the delta header, or both. Without an expected hash
+ * a plain or gzip upload is refused when it starts.
+ *
+ * Plain C++ with no Arduino dependency so it can be built on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define OTA_SHA_SIZE         32
+#define OTA_WINDOW_SIZE      32768    // DEFLATE window
+#define OTA_INFLATE_BUFFER   1024     // input held for one block header or symbol
+#define OTA_DELTA_MAGIC      "ODLT"
+#define OTA_DELTA_VERSION    1
+#define OTA_DELTA_HEADER     80       // magic, version, 3 reserved, 2 x (size, sha)
+#define OTA_IMAGE_MAGIC      0xE9
+
+#define OTA_DELTA_END        0x00
+#define OTA_DELTA_COPY       0x01     // u32 offset, u32 length
+#define OTA_DELTA_ADD        0x02     // u32 offset, u32 length, length bytes
+#define OTA_DELTA_DATA       0x03     // u32 length, length bytes
+
+class Sha256 {
+ public:
+  Sha256() { reset(); }
+  void reset();
+  void update(const uint8_t* data, size_t len);
+  void final(uint8_t out[OTA_SHA_SIZE]);
+
+ private:
+  void block(const uint8_t* p);
+
+  uint32_t h_[8];
+  uint8_t buf_[64];
+  uint8_t used_;
+  uint64_t bytes_;
+};
+
+// Next stage of the pipeline; false stops the upload
+class ByteSink {
+ public:
+  virtual ~ByteSink() {}
+  virtual bool put(const uint8_t* data, size_t len) = 0;
+};
+
+// The running image a delta is applied against
+class BaseImage {
+ public:
+  virtual ~BaseImage() {}
+  virtual uint32_t size() const = 0;
+  virtual bool read(uint32_t offset, uint8_t* buf, size_t len) = 0;
+};
+
+// gzip member decoder. Input is consumed in units (gzip header, block
+// header, one literal or match, part of a stored block). A unit cut off
+// by the end of a chunk is rolled back and completed from the next one.
+class Inflater {
+ public:
+  ~Inflater() { end(); }
+  bool begin();               // allocates the window
+  void end();
+
+  bool write(const uint8_t* data, size_t len, ByteSink& out);
+  bool done() const { return state_ == DONE; }
+  const char* error() const { return error_; }
+  uint32_t produced() const { return out_; }
+
+ private:
+  enum State : uint8_t { HEADER, BLOCK, CODES, STORED, TRAILER, DONE, FAILED };
+  struct Huffman {
+    uint16_t count[16];
+    uint16_t symbol[288];
+  };
+
+  int step(ByteSink& out);    // 1 progress, 0 needs input, -1 error
+  int header();
+  int blockHeader();
+  int codes(ByteSink& out);
+  int stored(ByteSink& out);
+  int trailer();
+  int buildDynamic();         // as step()
+
+  uint32_t bits(uint8_t n);
+  int decode(const Huffman& h);
+  static int build(Huffman& h, const uint8_t* lengths, uint16_t n);
+
+  bool emit(uint8_t b, ByteSink& out);
+  bool flush(ByteSink& out);
+  bool fail(const char* message);
+
+  uint8_t in_[OTA_INFLATE_BUFFER];
+  uint16_t inLen_ = 0;
+  uint16_t pos_ = 0;
+  uint32_t bitBuf_ = 0;
+  uint8_t bitCount_ = 0;
+  bool short_ = false;        // a read ran past the buffered input
+
+  State state_ = HEADER;
+  bool last_ = false;         // current block is the final one
+  uint32_t storedLeft_ = 0;
+  Huffman lencode_, distcode_;
+
+  uint8_t* window_ = nullptr;
+  uint32_t out_ = 0;          // bytes produced
+  uint32_t flushed_ = 0;      // bytes handed to the sink
+  uint32_t crc_ = 0;
+  const char* error_ = nullptr;
+};
+
+// Applies an ODLT delta to a base image
+class DeltaDecoder : public ByteSink {
+ public:
+  void begin(BaseImage* base, ByteSink* out);
+  bool put(const uint8_t* data, size_t len) override;
+  bool done() const { return state_ == DONE; }
+  const char* error() const { return error_; }
+  const uint8_t* targetSha() const { return targetSha_; }
+  uint32_t targetSize() const { return targetSize_; }
+
+ private:
+  enum State : uint8_t { HEADER, OP, DATA, ADD, DONE, FAILED };
+
+  bool header();
+  bool op();
+  bool copyBase(uint32_t offset, uint32_t len);
+  bool fail(const char* message);
+
+  BaseImage* base_ = nullptr;
+  ByteSink* out_ = nullptr;
+  State state_ = HEADER;
+  uint8_t hdr_[OTA_DELTA_HEADER];
+  uint8_t have_ = 0;
+  uint8_t need_ = 0;
+  uint32_t baseSize_ = 0;
+  uint32_t offset_ = 0;       // base offset of the running ADD
+  uint32_t left_ = 0;         // bytes left in the running DATA or ADD
+  uint32_t targetSize_ = 0;
+  uint8_t targetSha_[OTA_SHA_SIZE];
+  const char* error_ = nullptr;
+};
+
+class OtaPipeline : public ByteSink {
+ public:
+  // expectedSha may be nullptr; base may be nullptr (deltas refused)
+  void begin(ByteSink& image, BaseImage* base, const uint8_t* expectedSha);
+  bool write(const uint8_t* data, size_t len);
+  // True if every layer ended cleanly and the image hash matches
+  bool finish();
+  void end() { inflater_.end(); }
+
+  const char* error() const { return error_; }
+  const char* format() const;
+  uint32_t received() const { return received_; }
+  uint32_t imageSize() const { return imageSize_; }
+  const uint8_t* sha() const { return sha_; }
+
+  // Image bytes from the last layer
+  bool put(const uint8_t* data, size_t len) override;
+
+ private:
+  // The (inflated) payload: a delta or the image itself
+  class Payload : public ByteSink {
+   public:
+    OtaPipeline* owner = nullptr;
+    bool put(const uint8_t* data, size_t len) override { return owner->route(data, len); }
+  };
+
+  bool outer(const uint8_t* data, size_t len);
+  bool route(const uint8_t* data, size_t len);
+  bool inner(const uint8_t* data, size_t len);
+  bool fail(const char* message);
+
+  ByteSink* image_ = nullptr;
+  BaseImage* base_ = nullptr;
+  bool hasExpected_ = false;
+  uint8_t expected_[OTA_SHA_SIZE];
+
+  // The first bytes of each layer are held back until its magic is known
+  uint8_t outerMagic_[2];
+  uint8_t outerSeen_ = 0;
+  uint8_t innerMagic_[4];
+  uint8_t innerSeen_ = 0;
+  bool gzip_ = false;
+  bool delta_ = false;
+
+  Inflater inflater_;
+  DeltaDecoder deltaDecoder_;
+  Payload payload_;
+  Sha256 hash_;
+  uint8_t sha_[OTA_SHA_SIZE];
+  uint32_t received_ = 0;
+  uint32_t imageSize_ = 0;
+  const char* error_ = nullptr;
+};
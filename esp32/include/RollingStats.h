@@ -0,0 +1,123 @@
+/*
+ * RollingStats - O(1) rolling-window statistics for sensor streams
+ *
+ * A window is split into a fixed ring of time buckets. Each sample is
+ * folded into the current bucket with Welford's update (count, mean, M2,
+ * min, max, first/last sample), so adding is O(1). A summary merges the
+ * live buckets with Chan's parallel formula, which costs a constant
+ * Buckets steps regardless of the sample rate. Buckets age out whole, so
+ * the covered span is between (Buckets-1)/Buckets of the window and the
+ * full window.
+ *
+ * Plain C++ with no Arduino dependency so it can be built on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+struct StatsSummary {
+  uint32_t count;
+  float mean;
+  float variance;   // population variance
+  float min;
+  float max;
+  float rate;       // change per second, newest vs oldest sample
+
+  float stddev() const { return sqrtf(variance); }
+};
+
+template <uint8_t Buckets>
+class RollingWindow {
+ public:
+  RollingWindow() : bucketMs_(0) {}
+
+  void begin(uint32_t windowMs) {
+    bucketMs_ = windowMs / Buckets;
+    if (bucketMs_ == 0) bucketMs_ = 1;
+    for (uint8_t i = 0; i < Buckets; i++) buckets_[i].count = 0;
+  }
+
+  uint32_t windowMs() const { return bucketMs_ * Buckets; }
+
+  void add(float value, uint32_t nowMs) {
+    uint32_t epoch = nowMs / bucketMs_;
+    Bucket& b = buckets_[epoch % Buckets];
+
+    if (b.count == 0 || b.epoch != epoch) {
+      b.epoch = epoch;
+      b.count = 0;
+      b.mean = 0;
+      b.m2 = 0;
+      b.min = value;
+      b.max = value;
+      b.first = value;
+      b.firstAt = nowMs;
+    }
+
+    b.count++;
+    float delta = value - b.mean;
+    b.mean += delta / b.count;
+    b.m2 += delta * (value - b.mean);
+    if (value < b.min) b.min = value;
+    if (value > b.max) b.max = value;
+    b.last = value;
+    b.lastAt = nowMs;
+  }
+
+  StatsSummary summary(uint32_t nowMs) const {
+    StatsSummary s = {0, 0, 0, 0, 0, 0};
+    uint32_t epoch = nowMs / bucketMs_;
+    float m2 = 0;
+    const Bucket* oldest = nullptr;
+    const Bucket* newest = nullptr;
+
+    for (uint8_t i = 0; i < Buckets; i++) {
+      const Bucket& b = buckets_[i];
+      if (b.count == 0 || epoch - b.epoch >= Buckets) continue;
+
+      if (s.count == 0) {
+        s.mean = b.mean;
+        s.min = b.min;
+        s.max = b.max;
+        m2 = b.m2;
+        s.count = b.count;
+      } else {
+        uint32_t n = s.count + b.count;
+        float delta = b.mean - s.mean;
+        s.mean += delta * b.count / n;
+        m2 += b.m2 + delta * delta * ((float)s.count * b.count / n);
+        s.count = n;
+        if (b.min < s.min) s.min = b.min;
+        if (b.max > s.max) s.max = b.max;
+      }
+
+      if (!oldest || (int32_t)(b.firstAt - oldest->firstAt) < 0) oldest = &b;
+      if (!newest || (int32_t)(b.lastAt - newest->lastAt) > 0) newest = &b;
+    }
+
+    if (s.count > 0) s.variance = m2 / s.count;
+    if (oldest && newest && newest->lastAt != oldest->firstAt) {
+      s.rate = (newest->last - oldest->first) * 1000.0f / (int32_t)(newest->lastAt - oldest->firstAt);
+    }
+    return s;
+  }
+
+ private:
+  struct Bucket {
+    uint32_t epoch;
+    uint32_t count;
+    float mean;
+    float m2;
+    float min;
+    float max;
+    float first;
+    float last;
+    uint32_t firstAt;
+    uint32_t lastAt;
+  };
+
+  uint32_t bucketMs_;
+  Bucket buckets_[Buckets];
+};
@@ -0,0 +1,151 @@
+/*
+ * RuleVM - compiled automation conditions
+ *
+ * A rule condition is a small expression, e.g.
+ *
+ *   temp1 > 30 hyst 2 and motion1 for 60s
+ *   mean(temp1, 15m) >= 28 or not (light1 < 20)
+ *
+ * Operands are numbers, sensor channels, stat(sensor, window) aggregates
+ * and + - * / arithmetic. Comparisons are > >= < <= == !=. Conditions
+ * combine with and/or/not (also && || !), and a bare sensor is true when
+ * non-zero. Two modifiers keep state:
+ *   a > t hyst b   latches at a > t and releases only at a <= t - b
+ *                  (for < and <=: releases at a >= t + b)
+ *   cond for 60s   true once cond has held for 60 s without a break
+ * Durations take ms, s, m or h (plain numbers are seconds).
+ *
+ * RuleCompiler turns the text into a fixed-size bytecode program for a
+ * stack VM. It folds constant subexpressions and drops and/or operands
+ * that cannot change the result. The compiler checks the worst-case
+ * stack depth, so the VM never bounds-checks at run time. A program is at
+ * most RULE_MAX_CODE instructions and every instruction is O(1), so one
+ * evaluation has a fixed upper cost.
+ *
+ * Plain C++ with no Arduino dependency so it can be built on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define RULE_MAX_CODE   32
+#define RULE_MAX_SLOTS  8     // hyst + for modifiers per rule
+#define RULE_STACK      8
+
+enum RuleOp : uint8_t {
+  RULE_CONST,     // push f
+  RULE_READ,      // push symbols.read(a = sensor, b = stat, c = window)
+  RULE_ADD, RULE_SUB, RULE_MUL, RULE_DIV, RULE_NEG,
+  RULE_GT, RULE_GE, RULE_LT, RULE_LE, RULE_EQ, RULE_NE,
+  RULE_HYST,      // a = slot, b = comparison op, f = band
+  RULE_TRUTHY,
+  RULE_NOT, RULE_AND, RULE_OR,
+  RULE_HOLD       // a = slot, f = ms
+};
+
+struct RuleInstr {
+  uint8_t op;
+  uint8_t a;
+  uint8_t b;
+  uint8_t c;
+  float f;
+};
+
+struct RuleProgram {
+  RuleInstr code[RULE_MAX_CODE];
+  uint8_t length;
+  uint8_t slots;
+  uint8_t stackDepth;
+};
+
+// Per-rule runtime state of the stateful modifiers
+struct RuleState {
+  uint8_t latched;                 // hyst slots, bit per slot
+  uint8_t holding;                 // for slots with a running timer
+  uint32_t since[RULE_MAX_SLOTS];
+};
+
+// Name resolution at compile time and sensor access at run time
+class RuleSymbols {
+ public:
+  virtual ~RuleSymbols() {}
+
+  // Channel index for a name, -1 if unknown
+  virtual int sensor(const char* name, uint8_t length) = 0;
+  // Aggregate index for a stat name (mean, min, ...), -1 if unknown
+  virtual int stat(const char* name, uint8_t length) = 0;
+  // Window index for a length in seconds, -1 if not configured
+  virtual int window(uint32_t seconds) = 0;
+  // stat 0 is the current value (window ignored); NAN when unknown
+  virtual float read(uint8_t sensor, uint8_t stat, uint8_t window) = 0;
+};
+
+class RuleCompiler {
+ public:
+  explicit RuleCompiler(RuleSymbols& symbols) : symbols_(symbols) {}
+
+  bool compile(const char* text, RuleProgram& out);
+
+  // After a failed compile: what went wrong and at which character
+  const char* error() const { return error_; }
+  uint16_t errorAt() const { return errorAt_; }
+
+  // After a successful compile: the condition never depends on inputs
+  bool constant() const { return constant_; }
+
+ private:
+  struct Val {
+    uint8_t start;      // first instruction of this operand
+    bool isConst;
+    bool isBool;
+    float value;
+  };
+
+  enum TokenType : uint8_t { T_END, T_NUM, T_IDENT, T_OP, T_LPAREN, T_RPAREN, T_COMMA };
+
+  void next();
+  bool accept(const char* word);
+  bool fail(const char* message);
+
+  bool parseOr(Val& v);
+  bool parseAnd(Val& v);
+  bool parseNot(Val& v);
+  bool parseHold(Val& v);
+  bool parseCompare(Val& v);
+  bool parseSum(Val& v);
+  bool parseTerm(Val& v);
+  bool parseFactor(Val& v);
+  bool parseDuration(uint32_t& ms);
+
+  bool emit(uint8_t op, uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, float f = 0);
+  bool emitConst(uint8_t start, float value, bool isBool, Val& v);
+  bool toBool(Val& v);
+  bool binary(uint8_t op, Val& l, const Val& r);
+  bool logic(uint8_t op, Val& l, const Val& r);
+  uint8_t maxDepth() const;
+
+  RuleSymbols& symbols_;
+  RuleProgram* out_ = nullptr;
+  const char* text_ = nullptr;
+  const char* pos_ = nullptr;
+
+  TokenType type_ = T_END;
+  const char* tokStart_ = nullptr;
+  uint8_t tokLen_ = 0;
+  float number_ = 0;
+  uint32_t unitMs_ = 0;        // ms per unit of a number with a suffix, 0 = none
+
+  const char* error_ = nullptr;
+  uint16_t errorAt_ = 0;
+  bool constant_ = false;
+};
+
+class RuleVM {
+ public:
+  // Evaluate once; returns the number of instructions executed
+  static uint8_t run(const RuleProgram& program, RuleState& state, uint32_t nowMs,
+                     RuleSymbols& symbols, bool& result);
+
+  static float compare(uint8_t op, float a, float b);
+};
@@ -0,0 +1,114 @@
+/*
+ * SampleQueue - bounded, crash-safe store-and-forward queue on flash
+ *
+ * Samples are fixed 16-byte records with their own CRC, appended to
+ * numbered segment files of one flash sector each. The read position
+ * lives in a small head file that is replaced atomically (write + rename),
+ * so after a reset the queue resumes at the last acknowledged record and
+ * a torn tail record is simply skipped.
+ *
+ * Flash wear is bounded twice: records are staged in RAM and written in
+ * blocks of STAGE_RECORDS, and the number of segments is capped - when the
+ * cap is reached the oldest segment is dropped and counted. Staging is
+ * also bounded in time: service() writes the stage out once its oldest
+ * record has waited STAGE_MAX_MS, or STAGE_SPAN push intervals when
+ * samples come slower than that. A block therefore holds at least
+ * STAGE_SPAN records (one write per 4 samples, at most one per 30 s at
+ * fast rates) and a power loss costs at most STAGE_SPAN samples or 30 s.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#define SAMPLE_FLAG_MOTION   0x01
+#define SAMPLE_FLAG_RELAYS   0x1E   // relay1..4 in bits 1-4
+#define SAMPLE_FLAG_UPTIME   0x80   // time is seconds since boot, not unix
+
+struct __attribute__((packed)) SampleRecord {
+  uint32_t seq;
+  uint32_t time;            // unix seconds (or uptime, see flags)
+  int16_t temperature;      // 0.01 °C
+  uint16_t humidity;        // 0.01 %
+  uint8_t light;            // %
+  uint8_t flags;
+  uint16_t crc;             // CRC-16/CCITT of the preceding bytes
+};
+
+static_assert(sizeof(SampleRecord) == 16, "SampleRecord must stay 16 bytes");
+
+class SampleQueue {
+ public:
+  static const uint16_t SEGMENT_RECORDS = 256;   // 4 KB per segment
+  static const uint8_t STAGE_RECORDS = 16;
+  static const uint32_t STAGE_MAX_MS = 30000;
+  static const uint8_t STAGE_SPAN = 4;
+  static const uint8_t MAX_BATCH = 64;
+
+  bool begin(fs::FS& fs, const char* dir, uint16_t maxSegments);
+
+  // Stage a sample; it reaches flash once STAGE_RECORDS are pending or
+  // the oldest staged one is maxStageMs() old (see service())
+  void push(SampleRecord record);
+  // Expected ms between pushes; stretches the age limit to STAGE_SPAN of them
+  void setPushInterval(uint32_t ms);
+  uint32_t maxStageMs() const { return maxStageMs_; }
+  void flush();
+  void service();
+
+  // ms until service() writes the stage out, -1 with nothing staged
+  int32_t msUntilFlush() const;
+
+  // Oldest records first. pop(n) acknowledges the first n of the last peek.
+  size_t peek(SampleRecord* out, size_t max);
+  void pop(size_t n);
+
+  uint32_t depth() const { return flashRecords_ + staged_; }
+  uint32_t staged() const { return staged_; }
+  uint32_t segments() const { return flashRecords_ ? tailSeg_ - headSeg_ + 1 : 0; }
+
+  // seq of the first record pushed since begin(); lower seqs were queued
+  // by an earlier boot
+  uint32_t bootSeq() const { return bootSeq_; }
+
+  uint32_t enqueued = 0;
+  uint32_t drained = 0;
+  uint32_t dropped = 0;
+  uint32_t corrupt = 0;
+  uint32_t flashWrites = 0;
+
+  // Pass a previous result as crc to checksum data in pieces
+  static uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF);
+
+ private:
+  String segmentPath(uint32_t seg) const;
+  uint16_t segmentRecords(uint32_t seg) const;
+  void advance(uint32_t raw);
+  void saveHead();
+  void dropOldestSegment();
+
+  fs::FS* fs_ = nullptr;
+  String dir_;
+  uint16_t maxSegments_ = 0;
+
+  uint32_t headSeg_ = 0;      // oldest unacknowledged record on flash
+  uint16_t headIdx_ = 0;
+  uint32_t tailSeg_ = 0;      // segment receiving appends
+  uint16_t tailCount_ = 0;
+  uint32_t flashRecords_ = 0;
+  uint32_t nextSeq_ = 0;
+  uint32_t bootSeq_ = 0;
+
+  SampleRecord stage_[STAGE_RECORDS];
+  uint8_t staged_ = 0;
+  uint32_t stagedSince_ = 0;  // millis() when the oldest staged record arrived
+  uint32_t maxStageMs_ = STAGE_MAX_MS;
+
+  // Flash slots consumed through each record of the last peek(); corrupt
+  // records in between are skipped over by acknowledging past them
+  uint16_t peekRaw_[MAX_BATCH];
+  uint16_t scanRaw_ = 0;
+  size_t peekCount_ = 0;
+  bool peekFromStage_ = false;
+};
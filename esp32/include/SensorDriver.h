@@ -0,0 +1,34 @@
+/*
+ * SensorDriver - interface for one physical sensor (or one sensor bus)
+ *
+ * A driver produces a fixed number of values per read. Reads may be split
+ * in two steps: start() triggers a measurement and returns how long the
+ * hardware needs, and collect() fetches the result once that time has
+ * passed, so slow conversions (e.g. DS18B20, 750 ms) never block the loop.
+ * Drivers that read synchronously keep the default start() and do all the
+ * work in collect().
+ *
+ * Plain C++ with no Arduino dependency so it can be built on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+class SensorDriver {
+ public:
+  virtual ~SensorDriver() {}
+
+  virtual const char* name() const = 0;
+  virtual bool begin() = 0;
+
+  // Number of values collect() fills in
+  virtual uint8_t channels() const = 0;
+
+  // Trigger a measurement; returns ms until collect() may run (0 = now)
+  virtual uint32_t start() { return 0; }
+
+  // Fill values[0..channels()-1], NAN for a value that is missing.
+  // Returns false if the read failed as a whole.
+  virtual bool collect(float* values) = 0;
+};
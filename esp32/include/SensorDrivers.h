@@ -0,0 +1,75 @@
+/*
+ * SensorDrivers - SensorDriver implementations for the hub's hardware
+ *
+ *   DhtDriver       DHT11/DHT22: temperature, humidity
+ *   AnalogDriver    ADC input scaled to 0-100 %
+ *   DigitalDriver   GPIO level as 0/1 (PIR motion)
+ *   OneWireDriver   DS18B20 probes on one 1-Wire bus, non-blocking
+ *                   conversion, one temperature per probe
+ *
+ * A new sensor type only needs another SensorDriver and a scheduler slot.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <DHT.h>
+#include <OneWire.h>
+#include <DallasTemperature.h>
+#include "SensorDriver.h"
+
+#define ONEWIRE_MAX_PROBES   4
+
+class DhtDriver : public SensorDriver {
+ public:
+  DhtDriver(uint8_t pin, uint8_t type) : dht_(pin, type) {}
+  const char* name() const override { return "dht"; }
+  bool begin() override;
+  uint8_t channels() const override { return 2; }
+  bool collect(float* values) override;
+
+ private:
+  DHT dht_;
+};
+
+class AnalogDriver : public SensorDriver {
+ public:
+  explicit AnalogDriver(uint8_t pin) : pin_(pin) {}
+  const char* name() const override { return "analog"; }
+  bool begin() override;
+  uint8_t channels() const override { return 1; }
+  bool collect(float* values) override;
+
+ private:
+  uint8_t pin_;
+};
+
+class DigitalDriver : public SensorDriver {
+ public:
+  explicit DigitalDriver(uint8_t pin) : pin_(pin) {}
+  const char* name() const override { return "digital"; }
+  bool begin() override;
+  uint8_t channels() const override { return 1; }
+  bool collect(float* values) override;
+
+ private:
+  uint8_t pin_;
+};
+
+class OneWireDriver : public SensorDriver {
+ public:
+  explicit OneWireDriver(uint8_t pin) : bus_(pin), sensors_(&bus_) {}
+  const char* name() const override { return "ds18b20"; }
+  bool begin() override;
+  uint8_t channels() const override { return ONEWIRE_MAX_PROBES; }
+  uint32_t start() override;
+  bool collect(float* values) override;
+
+  uint8_t probes() const { return probes_; }
+
+ private:
+  OneWire bus_;
+  DallasTemperature sensors_;
+  DeviceAddress addresses_[ONEWIRE_MAX_PROBES];
+  uint8_t probes_ = 0;
+};
@@ -0,0 +1,177 @@
+/*
+ * SensorScheduler - per-sensor acquisition with periods and phase offsets
+ *
+ * Each task polls one SensorDriver every periodMs, starting phaseMs after
+ * begin(). poll() performs at most one driver step per call, so drivers
+ * that fall due together are serialized across loop passes instead of
+ * stacking their read times into one long iteration; a finished two-step
+ * conversion is collected before any new read is started. Missed periods
+ * are skipped rather than replayed, keeping the phase grid.
+ *
+ * For every task the scheduler keeps read duration (start + collect, in
+ * us) and jitter (how late a read started against its slot, in ms).
+ *
+ * Plain C++ with no Arduino dependency so it can be built on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "SensorDriver.h"
+
+struct SensorTaskStats {
+  uint32_t reads;
+  uint32_t failures;
+  float avgReadUs;
+  uint32_t maxReadUs;
+  float avgJitterMs;
+  uint32_t maxJitterMs;
+};
+
+template <uint8_t Capacity>
+class SensorScheduler {
+ public:
+  typedef uint32_t (*MicrosFn)();
+
+  explicit SensorScheduler(MicrosFn micros) : micros_(micros), count_(0) {}
+
+  // Returns the task index, or -1 when full
+  int8_t add(SensorDriver* driver, uint32_t periodMs, uint32_t phaseMs) {
+    if (count_ >= Capacity || !driver) return -1;
+    Task& t = tasks_[count_];
+    t.driver = driver;
+    t.periodMs = periodMs ? periodMs : 1;
+    t.phaseMs = phaseMs;
+    t.collecting = false;
+    t.started = 0;
+    t.stats = SensorTaskStats();
+    return count_++;
+  }
+
+  // Align every task to its phase, counted from nowMs
+  void begin(uint32_t nowMs) {
+    for (uint8_t i = 0; i < count_; i++) {
+      tasks_[i].nextDue = nowMs + tasks_[i].phaseMs;
+      tasks_[i].collecting = false;
+    }
+  }
+
+  void setTiming(uint8_t i, uint32_t periodMs, uint32_t phaseMs, uint32_t nowMs) {
+    if (i >= count_) return;
+    tasks_[i].periodMs = periodMs ? periodMs : 1;
+    tasks_[i].phaseMs = phaseMs;
+    tasks_[i].nextDue = nowMs + phaseMs;
+  }
+
+  // New period counted from the slot of the last read, so the grid moves
+  // with the rate instead of restarting at the phase; never in the past
+  void setPeriod(uint8_t i, uint32_t periodMs, uint32_t nowMs) {
+    if (i >= count_) return;
+    Task& t = tasks_[i];
+    if (periodMs == 0) periodMs = 1;
+    uint32_t due = t.nextDue - t.periodMs + periodMs;
+    t.periodMs = periodMs;
+    t.nextDue = (int32_t)(due - nowMs) < 0 ? nowMs : due;
+  }
+
+  // Run at most one driver step. When a read completes its values are in
+  // values[] (sized for the driver's channels()) and the task index is
+  // returned; otherwise -1.
+  int8_t poll(uint32_t nowMs, float* values) {
+    // A finished conversion goes first
+    for (uint8_t i = 0; i < count_; i++) {
+      Task& t = tasks_[i];
+      if (t.collecting && (int32_t)(nowMs - t.readyAt) >= 0) {
+        return finish(i, values);
+      }
+    }
+
+    // Otherwise the most overdue idle task
+    int8_t pick = -1;
+    int32_t worst = -1;
+    for (uint8_t i = 0; i < count_; i++) {
+      Task& t = tasks_[i];
+      int32_t late = (int32_t)(nowMs - t.nextDue);
+      if (!t.collecting && late > worst) {
+        worst = late;
+        pick = i;
+      }
+    }
+    if (pick < 0) return -1;
+
+    Task& t = tasks_[pick];
+    t.started++;
+    t.stats.avgJitterMs += ((float)worst - t.stats.avgJitterMs) / t.started;
+    if ((uint32_t)worst > t.stats.maxJitterMs) t.stats.maxJitterMs = worst;
+
+    // Next slot on the phase grid after now
+    uint32_t missed = worst / t.periodMs;
+    t.nextDue += (missed + 1) * t.periodMs;
+
+    uint32_t t0 = micros_();
+    uint32_t waitMs = t.driver->start();
+    t.startUs = micros_() - t0;
+
+    if (waitMs > 0) {
+      t.collecting = true;
+      t.readyAt = nowMs + waitMs;
+      return -1;
+    }
+    return finish(pick, values);
+  }
+
+  // ms until poll() has a step to run (0 = now), at most limitMs
+  uint32_t msUntilDue(uint32_t nowMs, uint32_t limitMs) const {
+    uint32_t wait = limitMs;
+    for (uint8_t i = 0; i < count_; i++) {
+      const Task& t = tasks_[i];
+      int32_t left = (int32_t)((t.collecting ? t.readyAt : t.nextDue) - nowMs);
+      if (left <= 0) return 0;
+      if ((uint32_t)left < wait) wait = left;
+    }
+    return wait;
+  }
+
+  uint8_t size() const { return count_; }
+  SensorDriver* driver(uint8_t i) const { return tasks_[i].driver; }
+  uint32_t period(uint8_t i) const { return tasks_[i].periodMs; }
+  uint32_t phase(uint8_t i) const { return tasks_[i].phaseMs; }
+  const SensorTaskStats& stats(uint8_t i) const { return tasks_[i].stats; }
+
+ private:
+  struct Task {
+    SensorDriver* driver;
+    uint32_t periodMs;
+    uint32_t phaseMs;
+    uint32_t nextDue;
+    uint32_t readyAt;
+    uint32_t startUs;
+    uint32_t started;
+    bool collecting;
+    SensorTaskStats stats;
+  };
+
+  int8_t finish(uint8_t i, float* values) {
+    Task& t = tasks_[i];
+    t.collecting = false;
+
+    uint32_t t0 = micros_();
+    bool ok = t.driver->collect(values);
+    uint32_t us = t.startUs + (micros_() - t0);
+
+    SensorTaskStats& s = t.stats;
+    s.reads++;
+    s.avgReadUs += ((float)us - s.avgReadUs) / s.reads;
+    if (us > s.maxReadUs) s.maxReadUs = us;
+
+    if (!ok) {
+      s.failures++;
+      return -1;
+    }
+    return i;
+  }
+
+  MicrosFn micros_;
+  Task tasks_[Capacity];
+  uint8_t count_;
+};
@@ -0,0 +1,196 @@
+/*
+ * TimerWheel - hierarchical timing wheel for delayed actions
+ *
+ * Four levels of 64 slots cover 2^24 ticks. Timers live in a fixed pool
+ * (no heap), linked into per-slot doubly linked lists, so insert and
+ * cancel are O(1) and advancing one tick touches a single slot. Entries
+ * in higher levels cascade down as the wheel turns; delays beyond the
+ * wheel range park in the top level and are re-placed when reached.
+ *
+ * Plain C++ with no Arduino dependency so it can be built on the host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+template <typename Payload, uint16_t Capacity>
+class TimerWheel {
+ public:
+  typedef uint32_t Handle;  // (generation << 16) | index, 0 = invalid
+
+  static const uint8_t LEVEL_BITS = 6;
+  static const uint8_t LEVELS = 4;
+  static const uint16_t SLOTS = 1 << LEVEL_BITS;
+  static const uint32_t MAX_DELAY = (1UL << (LEVEL_BITS * LEVELS)) - 1;
+
+  TimerWheel() { clear(0); }
+
+  void clear(uint32_t nowTick) {
+    now_ = nowTick;
+    count_ = 0;
+    for (uint8_t l = 0; l < LEVELS; l++) {
+      for (uint16_t s = 0; s < SLOTS; s++) heads_[l][s] = NIL;
+    }
+    for (uint16_t i = 0; i < Capacity; i++) {
+      nodes_[i].level = FREE;
+      nodes_[i].gen = 1;
+      nodes_[i].next = (i + 1 < Capacity) ? i + 1 : NIL;
+    }
+    freeHead_ = Capacity > 0 ? 0 : NIL;
+  }
+
+  // Schedule payload to fire delayTicks from now (0 fires on the next tick)
+  Handle schedule(uint32_t delayTicks, const Payload& payload) {
+    if (freeHead_ == NIL) return 0;
+
+    uint16_t i = freeHead_;
+    freeHead_ = nodes_[i].next;
+
+    Node& n = nodes_[i];
+    n.expiry = now_ + (delayTicks == 0 ? 1 : delayTicks);
+    n.payload = payload;
+    place(i);
+    count_++;
+
+    return ((uint32_t)n.gen << 16) | i;
+  }
+
+  bool cancel(Handle h) {
+    uint16_t i = h & 0xFFFF;
+    if (i >= Capacity) return false;
+
+    Node& n = nodes_[i];
+    if (n.level == FREE || n.gen != (h >> 16)) return false;
+
+    unlink(i);
+    release(i);
+    return true;
+  }
+
+  // Payload of a pending timer, or nullptr if it already fired/was cancelled
+  Payload* find(Handle h) {
+    uint16_t i = h & 0xFFFF;
+    if (i >= Capacity) return nullptr;
+    Node& n = nodes_[i];
+    if (n.level == FREE || n.gen != (h >> 16)) return nullptr;
+    return &n.payload;
+  }
+
+  // Ticks until the timer fires, or -1 if it is no longer pending
+  int32_t remaining(Handle h) {
+    if (!find(h)) return -1;
+    return (int32_t)(nodes_[h & 0xFFFF].expiry - now_);
+  }
+
+  // Turn the wheel up to nowTick, calling fire(handle, payload) for each
+  // expired timer. The payload is copied out and the slot freed first, so
+  // the callback may schedule or cancel timers freely.
+  template <typename Fn>
+  void advance(uint32_t nowTick, Fn fire) {
+    if (count_ == 0) {
+      now_ = nowTick;
+      return;
+    }
+
+    while ((int32_t)(nowTick - now_) > 0) {
+      now_++;
+
+      uint16_t idx = now_ & MASK;
+      for (uint8_t l = 1; idx == 0 && l < LEVELS; l++) {
+        idx = (now_ >> (LEVEL_BITS * l)) & MASK;
+        cascade(l, idx);
+      }
+
+      uint16_t slot = now_ & MASK;
+      while (heads_[0][slot] != NIL) {
+        uint16_t i = heads_[0][slot];
+        unlink(i);
+
+        if ((int32_t)(nodes_[i].expiry - now_) > 0) {
+          place(i);
+          continue;
+        }
+
+        Handle h = ((uint32_t)nodes_[i].gen << 16) | i;
+        Payload p = nodes_[i].payload;
+        release(i);
+        fire(h, p);
+      }
+
+      if (count_ == 0) {
+        now_ = nowTick;
+        return;
+      }
+    }
+  }
+
+  uint32_t now() const { return now_; }
+  uint16_t size() const { return count_; }
+  uint16_t capacity() const { return Capacity; }
+
+ private:
+  static const uint16_t NIL = 0xFFFF;
+  static const uint8_t FREE = 0xFF;
+  static const uint16_t MASK = SLOTS - 1;
+
+  struct Node {
+    uint32_t expiry;
+    uint16_t next;
+    uint16_t prev;
+    uint16_t gen;
+    uint8_t level;
+    uint8_t slot;
+    Payload payload;
+  };
+
+  void place(uint16_t i) {
+    Node& n = nodes_[i];
+    uint32_t delta = n.expiry - now_;
+    if ((int32_t)delta < 0) delta = 0;  // due now: current slot, swept this tick
+    if (delta > MAX_DELAY) delta = MAX_DELAY;
+
+    uint32_t at = now_ + delta;
+    uint8_t level = 0;
+    while (level < LEVELS - 1 && delta >= (1UL << (LEVEL_BITS * (level + 1)))) level++;
+
+    n.level = level;
+    n.slot = (at >> (LEVEL_BITS * level)) & MASK;
+    n.prev = NIL;
+    n.next = heads_[level][n.slot];
+    if (n.next != NIL) nodes_[n.next].prev = i;
+    heads_[level][n.slot] = i;
+  }
+
+  void unlink(uint16_t i) {
+    Node& n = nodes_[i];
+    if (n.prev != NIL) nodes_[n.prev].next = n.next;
+    else heads_[n.level][n.slot] = n.next;
+    if (n.next != NIL) nodes_[n.next].prev = n.prev;
+  }
+
+  void release(uint16_t i) {
+    Node& n = nodes_[i];
+    n.level = FREE;
+    n.gen = (n.gen == 0xFFFF) ? 1 : n.gen + 1;
+    n.next = freeHead_;
+    freeHead_ = i;
+    count_--;
+  }
+
+  void cascade(uint8_t level, uint16_t slot) {
+    uint16_t i = heads_[level][slot];
+    heads_[level][slot] = NIL;
+    while (i != NIL) {
+      uint16_t next = nodes_[i].next;
+      place(i);
+      i = next;
+    }
+  }
+
+  Node nodes_[Capacity];
+  uint16_t heads_[LEVELS][SLOTS];
+  uint16_t freeHead_;
+  uint16_t count_;
+  uint32_t now_;
+};
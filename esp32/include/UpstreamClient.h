@@ -0,0 +1,59 @@
+/*
+ * UpstreamClient - persistent HTTP(S) client for the Apps Script endpoint
+ *
+ * Keeps the TLS connection to the script host open between requests
+ * (HTTP/1.1 keep-alive), so the handshake is paid once per connection
+ * instead of once per sample. Apps Script answers a POST with a 302 to
+ * script.googleusercontent.com; that host gets its own persistent
+ * connection, so following the redirect does not reconnect either.
+ *
+ * Bodies are sent as application/x-www-form-urlencoded from a caller
+ * supplied buffer, which Apps Script exposes as e.parameter just like a
+ * query string.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+
+// Following the redirect confirms the script's {"success":true} but keeps
+// a second TLS session (~40 KB heap) alive
+#ifndef UPSTREAM_FOLLOW_REDIRECT
+#define UPSTREAM_FOLLOW_REDIRECT 1
+#endif
+
+class UpstreamClient {
+ public:
+  void begin(const char* url);
+
+  // POST a form-encoded body; true once the script accepted it
+  bool post(const char* body, size_t length);
+
+  // Close kept-alive connections the server has ended. Nothing else
+  // reads them between requests, so one left at EOF stays readable.
+  void dropClosed();
+
+  uint32_t requests = 0;
+  uint32_t failures = 0;
+  uint32_t handshakes = 0;     // connections opened (TLS handshakes for https)
+  uint32_t redirects = 0;
+  uint32_t lastLatencyMs = 0;
+  uint32_t maxLatencyMs = 0;
+  float avgLatencyMs = 0;      // EWMA
+
+ private:
+  int send(const char* body, size_t length, String& location);
+  bool follow(const String& location);
+  WiFiClient& scriptClient() { return secure_ ? (WiFiClient&)scriptTls_ : scriptPlain_; }
+
+  String url_;
+  bool secure_ = false;
+
+  WiFiClientSecure scriptTls_;
+  WiFiClient scriptPlain_;
+  WiFiClientSecure redirectTls_;
+  HTTPClient scriptHttp_;
+  HTTPClient redirectHttp_;
+};
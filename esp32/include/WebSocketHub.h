@@ -0,0 +1,96 @@
+/*
+ * WebSocketHub - WebSocketsServer with per-client bounded send queues
+ *
+ * The library's sendTXT()/broadcastTXT() write synchronously and wait up
+ * to the TCP timeout for a socket that is not draining, so one phone on a
+ * weak link stalls the loop for everyone. Here every outgoing text frame
+ * goes into the client's own queue instead. pump() writes each queue to
+ * its socket with non-blocking send(), continuing a partly written frame
+ * on the next pass.
+ *
+ * Frames of a replaceable kind (sensor data, device state) take the place
+ * of a queued frame of the same kind that has not started sending yet.
+ * The key is a bit set of what the frame covers: a frame only replaces
+ * one whose key it includes, so a partial sensor_data update never hides
+ * readings that are only in the older frame. A full queue evicts its
+ * oldest replaceable frame, and a reply that still does not fit is
+ * dropped. A client that accepts nothing for WS_STALL_TIMEOUT_MS is
+ * disconnected.
+ *
+ * Every write goes through the queue to keep frames in order. The library
+ * itself only writes handshakes, pongs and close frames. While a frame is
+ * partly written, loop() takes that client's control frames before the
+ * library sees them: a ping gets its pong queued behind the partial frame
+ * and a close ends the connection, so nothing is written into the middle
+ * of a frame.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+
+#define WS_QUEUE_DEPTH       8
+#define WS_QUEUE_BYTES       8192      // per client, queued payload bytes
+#define WS_STALL_TIMEOUT_MS  10000UL
+
+#define WS_KIND_REPLY        0         // never replaced
+#define WS_KIND_SENSOR       1
+#define WS_KIND_STATE        2
+#define WS_KIND_HUBS         3         // mesh aggregator view of the other hubs
+
+struct WsClientStats {
+  uint32_t sent;
+  uint32_t replaced;       // superseded while queued
+  uint32_t dropped;        // evicted or did not fit
+  uint32_t blocked;        // socket buffer full on a write attempt
+  uint8_t maxDepth;
+};
+
+class WebSocketHub : public WebSocketsServer {
+ public:
+  explicit WebSocketHub(uint16_t port) : WebSocketsServer(port) {}
+
+  bool queueTXT(uint8_t num, const String& payload, uint8_t kind = WS_KIND_REPLY, uint32_t key = 0);
+  void broadcastQueued(const String& payload, uint8_t kind, uint32_t key = 0);
+
+  // Library loop, minus control frames that would cut into a partial frame
+  void loop();
+
+  // Write whatever each socket accepts right now; call every loop pass
+  void pump();
+
+  // Drop a client's queue (on disconnect)
+  void forget(uint8_t num);
+
+  bool linked(uint8_t num) const;
+  uint8_t depth(uint8_t num) const { return out_[num].count; }
+  uint16_t queuedBytes(uint8_t num) const { return out_[num].bytes; }
+  const WsClientStats& stats(uint8_t num) const { return out_[num].stats; }
+
+ private:
+  struct Frame {
+    String payload;
+    uint8_t kind;
+    uint32_t key;
+    uint8_t opcode;
+  };
+
+  struct Outbox {
+    Frame frames[WS_QUEUE_DEPTH];
+    uint8_t count = 0;
+    uint16_t bytes = 0;
+    uint32_t offset = 0;          // bytes of frames[0] (header + payload) written
+    uint8_t header[4];
+    uint8_t headerLen = 0;
+    unsigned long lastProgress = 0;
+    WsClientStats stats = {};
+  };
+
+  bool takeControl(uint8_t num);
+  bool evictOne(Outbox& o);
+  void removeAt(Outbox& o, uint8_t i);
+  bool writeFront(uint8_t num);
+
+  Outbox out_[WEBSOCKETS_SERVER_CLIENT_MAX];
+};
@@ -0,0 +1,130 @@
+#include "Automation.h"
+#include <stdio.h>
+#include <string.h>
+
+const char* const STAT_NAMES[] = {"value", "mean", "min", "max", "std", "roc"};
+
+int statIndex(const char* name, uint8_t length) {
+  for (int s = STAT_VALUE; s <= STAT_ROC; s++) {
+    if (strlen(STAT_NAMES[s]) == length && strncmp(STAT_NAMES[s], name, length) == 0) return s;
+  }
+  return -1;
+}
+
+float summaryStat(const StatsSummary& s, uint8_t stat) {
+  if (s.count == 0) return NAN;
+  switch (stat) {
+    case STAT_MEAN: return s.mean;
+    case STAT_MIN:  return s.min;
+    case STAT_MAX:  return s.max;
+    case STAT_STD:  return s.stddev();
+    case STAT_ROC:  return s.rate;
+  }
+  return NAN;
+}
+
+AutomationRule* Automation::compile(const char* when, bool& constant) {
+  if (count_ >= MAX_RULES) {
+    error_ = "Rule table full";
+    errorAt_ = 0;
+    return nullptr;
+  }
+
+  AutomationRule& rule = rules_[count_];
+  rule = AutomationRule();
+  RuleCompiler compiler(symbols_);
+  if (!compiler.compile(when, rule.program)) {
+    error_ = compiler.error();
+    errorAt_ = compiler.errorAt();
+    return nullptr;
+  }
+  constant = compiler.constant();
+  snprintf(rule.source, RULE_SOURCE_SIZE, "%s", when);
+  return &rule;
+}
+
+bool Automation::addAction(AutomationRule& rule, const char* device, bool state, int value, bool onRelease) {
+  if (!device || !device[0] || rule.actionCount >= RULE_MAX_ACTIONS) return false;
+  RuleAction& action = rule.actions[rule.actionCount++];
+  snprintf(action.device, sizeof(action.device), "%s", device);
+  action.state = state;
+  action.value = value;
+  action.onRelease = onRelease;
+  return true;
+}
+
+bool Automation::commit() {
+  AutomationRule& rule = rules_[count_];
+  if (rule.actionCount == 0) {
+    error_ = "No actions";
+    errorAt_ = 0;
+    return false;
+  }
+  // After a wrap, skip ids that long-lived rules still hold
+  bool taken;
+  do {
+    rule.id = nextId_++;
+    if (nextId_ == 0) nextId_ = 1;
+    taken = false;
+    for (uint8_t r = 0; r < count_; r++) taken |= rules_[r].id == rule.id;
+  } while (taken);
+  rule.enabled = true;
+  count_++;
+  return true;
+}
+
+bool Automation::remove(uint16_t id) {
+  uint8_t index = 0;
+  while (index < count_ && rules_[index].id != id) index++;
+  if (index == count_) return false;
+  for (uint8_t r = index; r + 1 < count_; r++) rules_[r] = rules_[r + 1];
+  count_--;
+  if (cursor_ > index) cursor_--;
+  if (cursor_ >= count_) cursor_ = 0;
+  return true;
+}
+
+bool Automation::tick(uint32_t nowMs, ActionSink& sink) {
+  uint16_t budget = RULE_TICK_BUDGET;
+  bool changed = false;
+
+  for (uint8_t n = 0; n < count_; n++) {
+    AutomationRule& rule = rules_[cursor_];
+    if (rule.enabled) {
+      if (rule.program.length > budget) {
+        budgetHits++;
+        return changed;
+      }
+
+      bool active;
+      uint8_t used = RuleVM::run(rule.program, rule.state, nowMs, symbols_, active);
+      budget -= used;
+      instructions += used;
+
+      if (active != rule.active) {
+        rule.active = active;
+        if (active) rule.fired++;
+        for (uint8_t a = 0; a < rule.actionCount; a++) {
+          const RuleAction& action = rule.actions[a];
+          if (action.onRelease == active) continue;
+          sink.ruleAction(cursor_, action, nowMs);
+        }
+        changed = true;
+      }
+    }
+    cursor_ = (cursor_ + 1) % count_;
+  }
+  return changed;
+}
+
+uint32_t Automation::sensors() const {
+  uint32_t mask = 0;
+  for (uint8_t r = 0; r < count_; r++) {
+    if (!rules_[r].enabled) continue;
+    const RuleProgram& program = rules_[r].program;
+    for (uint8_t i = 0; i < program.length; i++) {
+      if (program.code[i].op == RULE_READ && program.code[i].a < 32) mask |= 1UL << program.code[i].a;
+    }
+  }
+  return mask;
+}
@@ -0,0 +1,524 @@
+#include "HubMesh.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MESH_HEADER_SIZE     14
+#define MESH_ENTRY_MAX_SIZE  (1 + (MESH_KEY_SIZE - 1) + 1 + 4)
+
+static_assert(MESH_HEADER_SIZE + 9 + MESH_MAX_ENTRIES * MESH_ENTRY_MAX_SIZE <= MESH_PACKET_SIZE,
+              "A full delta must fit one packet");
+static_assert(MESH_MAX_HUBS <= 127, "Hub indexes are int8_t");
+
+namespace {
+
+struct Writer {
+  uint8_t* buf;
+  size_t len;
+
+  void u8(uint8_t v) { buf[len++] = v; }
+  void u16(uint16_t v) { u8(v); u8(v >> 8); }
+  void u32(uint32_t v) { u16(v); u16(v >> 16); }
+  void f32(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    u32(bits);
+  }
+  void str(const char* s, size_t max) {
+    size_t n = strnlen(s, max);
+    u8(n);
+    memcpy(buf + len, s, n);
+    len += n;
+  }
+};
+
+// Reads past the end return zeros and clear ok
+struct Reader {
+  const uint8_t* buf;
+  size_t len;
+  size_t pos;
+  bool ok;
+
+  uint8_t u8() {
+    if (pos >= len) {
+      ok = false;
+      return 0;
+    }
+    return buf[pos++];
+  }
+  uint16_t u16() { uint16_t lo = u8(); return lo | (uint16_t)u8() << 8; }
+  uint32_t u32() { uint32_t lo = u16(); return lo | (uint32_t)u16() << 16; }
+  float f32() {
+    uint32_t bits = u32();
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+  }
+  // Text of at most size - 1 bytes, NUL terminated
+  void str(char* out, size_t size) {
+    uint8_t n = u8();
+    if (n >= size || pos + n > len) {
+      ok = false;
+      out[0] = '\0';
+      return;
+    }
+    memcpy(out, buf + pos, n);
+    out[n] = '\0';
+    pos += n;
+  }
+};
+
+}  // namespace
+
+void HubMesh::begin(uint8_t mode, uint32_t id, uint32_t epoch, const char* name, uint16_t port,
+                    MeshTransport& transport, MeshHandler& handler) {
+  mode_ = mode;
+  port_ = port;
+  transport_ = &transport;
+  handler_ = &handler;
+
+  memset(hubs_, 0, sizeof(hubs_));
+  MeshHub& self = hubs_[0];
+  self.id = id;
+  self.epoch = epoch;
+  strncpy(self.name, name, MESH_NAME_SIZE - 1);
+  self.addr = MeshAddr{0, port};
+  self.aggregator = mode == MESH_AGGREGATOR;
+  self.online = true;
+  hubCount_ = 1;
+
+  aggregator_ = -1;
+  aggregatorId_ = 0;
+  aggregatorEpoch_ = 0;
+  acked_ = 0;
+  sentVersion_ = 0;
+  announced_ = false;
+  memset(pending_, 0, sizeof(pending_));
+  seq_ = 0;
+}
+
+// ============== OWN STATE ==============
+
+MeshEntry* HubMesh::entry(MeshHub& hub, const char* key, bool create) {
+  for (uint8_t i = 0; i < hub.count; i++) {
+    if (strcmp(hub.entries[i].key, key) == 0) return &hub.entries[i];
+  }
+  if (!create || hub.count >= MESH_MAX_ENTRIES) return nullptr;
+  MeshEntry& e = hub.entries[hub.count++];
+  memset(&e, 0, sizeof(e));
+  strncpy(e.key, key, MESH_KEY_SIZE - 1);
+  return &e;
+}
+
+void HubMesh::set(const char* key, uint8_t flags, float value) {
+  MeshHub& self = hubs_[0];
+  MeshEntry* e = entry(self, key, false);
+  if (e && e->flags == flags && e->value == value) return;
+  if (!e) e = entry(self, key, true);
+  if (!e) return;
+  e->flags = flags;
+  e->value = value;
+  e->version = ++self.version;
+}
+
+void HubMesh::setSensor(const char* key, float value) {
+  set(key, 0, value);
+}
+
+void HubMesh::setDevice(const char* key, bool state, float value) {
+  set(key, MESH_ENTRY_DEVICE | (state ? MESH_ENTRY_STATE : 0), value);
+}
+
+// ============== HUB TABLE ==============
+
+int8_t HubMesh::hubById(uint32_t id, const MeshAddr& from, uint32_t nowMs, bool create) {
+  for (uint8_t i = 1; i < hubCount_; i++) {
+    if (hubs_[i].id == id) return i;
+  }
+  if (!create || hubCount_ >= MESH_MAX_HUBS) return -1;
+  MeshHub& hub = hubs_[hubCount_];
+  memset(&hub, 0, sizeof(hub));
+  hub.id = id;
+  hub.addr = from;
+  hub.lastHeard = nowMs;
+  return hubCount_++;
+}
+
+int8_t HubMesh::findHub(const char* nameOrId) const {
+  for (uint8_t i = 0; i < hubCount_; i++) {
+    if (strcmp(hubs_[i].name, nameOrId) == 0) return i;
+  }
+  char* end;
+  unsigned long id = strtoul(nameOrId, &end, 10);
+  if (end == nameOrId || *end) return -1;
+  for (uint8_t i = 0; i < hubCount_; i++) {
+    if (hubs_[i].id == id) return i;
+  }
+  return -1;
+}
+
+// Lowest online aggregator id; replication restarts from scratch when
+// the choice changes or the aggregator rebooted
+void HubMesh::chooseAggregator() {
+  int8_t best = -1;
+  for (uint8_t i = 1; i < hubCount_; i++) {
+    if (!hubs_[i].online || !hubs_[i].aggregator) continue;
+    if (best < 0 || hubs_[i].id < hubs_[best].id) best = i;
+  }
+  aggregator_ = best;
+  if (best < 0) return;
+  if (hubs_[best].id != aggregatorId_ || hubs_[best].epoch != aggregatorEpoch_) {
+    aggregatorId_ = hubs_[best].id;
+    aggregatorEpoch_ = hubs_[best].epoch;
+    acked_ = 0;
+    sentVersion_ = 0;
+  }
+}
+
+// ============== SEND ==============
+
+size_t HubMesh::header(uint8_t* buf, uint8_t type) const {
+  Writer w = {buf, 0};
+  w.u8('H');
+  w.u8('M');
+  w.u8(MESH_PROTO);
+  w.u8(type);
+  w.u32(hubs_[0].id);
+  w.u32(hubs_[0].epoch);
+  w.u16(port_);
+  return w.len;
+}
+
+void HubMesh::send(const MeshAddr& to, const uint8_t* buf, size_t len) {
+  transport_->send(to, buf, len);
+  stats_.sent++;
+}
+
+void HubMesh::announce() {
+  uint8_t buf[MESH_PACKET_SIZE];
+  Writer w = {buf, header(buf, MESH_ANNOUNCE)};
+  w.u8(mode_ == MESH_AGGREGATOR ? 1 : 0);
+  w.u32(hubs_[0].version);
+  w.u8(hubs_[0].count);
+  w.str(hubs_[0].name, MESH_NAME_SIZE - 1);
+  send(MeshAddr{0, 0}, buf, w.len);
+}
+
+void HubMesh::sendDelta(uint32_t nowMs) {
+  const MeshHub& self = hubs_[0];
+  uint8_t buf[MESH_PACKET_SIZE];
+  Writer w = {buf, header(buf, MESH_DELTA)};
+  w.u32(acked_);
+  w.u32(self.version);
+  size_t countAt = w.len;
+  w.u8(0);
+
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < self.count; i++) {
+    const MeshEntry& e = self.entries[i];
+    if (e.version <= acked_) continue;
+    w.str(e.key, MESH_KEY_SIZE - 1);
+    w.u8(e.flags);
+    w.f32(e.value);
+    count++;
+  }
+  buf[countAt] = count;
+
+  send(hubs_[aggregator_].addr, buf, w.len);
+  stats_.deltasSent++;
+  sentVersion_ = self.version;
+  lastDelta_ = nowMs;
+}
+
+void HubMesh::sendAck(const MeshHub& peer) {
+  uint8_t buf[MESH_PACKET_SIZE];
+  Writer w = {buf, header(buf, MESH_ACK)};
+  w.u32(peer.epoch);
+  w.u32(peer.version);
+  send(peer.addr, buf, w.len);
+}
+
+void HubMesh::sendCommand(Pending& p, uint32_t nowMs) {
+  const MeshHub& owner = hubs_[p.hub];
+  uint8_t buf[MESH_PACKET_SIZE];
+  Writer w = {buf, header(buf, MESH_COMMAND)};
+  w.u32(owner.id);
+  w.u16(p.seq);
+  w.u8(p.state);
+  w.u16((uint16_t)p.value);
+  w.str(p.device, MESH_KEY_SIZE - 1);
+  send(owner.addr, buf, w.len);
+  p.tries++;
+  p.sentMs = nowMs;
+}
+
+bool HubMesh::command(const char* hub, const char* device, bool state, int16_t value, uint32_t nowMs) {
+  if (mode_ == MESH_OFF) return false;
+  int8_t h = findHub(hub);
+  if (h < 0) return false;
+  if (h == 0) return handler_->meshCommand(device, state, value);
+  if (!hubs_[h].online) return false;
+
+  for (uint8_t i = 0; i < MESH_MAX_PENDING; i++) {
+    Pending& p = pending_[i];
+    if (p.used) continue;
+    p.used = true;
+    p.hub = h;
+    p.seq = ++seq_;
+    p.tries = 0;
+    p.state = state;
+    p.value = value;
+    strncpy(p.device, device, MESH_KEY_SIZE - 1);
+    p.device[MESH_KEY_SIZE - 1] = '\0';
+    if (!queuedBehind(p)) sendCommand(p, nowMs);
+    stats_.commandsRouted++;
+    return true;
+  }
+  return false;
+}
+
+// ============== TICK ==============
+
+void HubMesh::tick(uint32_t nowMs) {
+  if (mode_ == MESH_OFF) return;
+
+  if (!announced_ || nowMs - lastAnnounce_ >= MESH_ANNOUNCE_MS) {
+    announce();
+    announced_ = true;
+    lastAnnounce_ = nowMs;
+  }
+
+  bool lost = false;
+  for (uint8_t i = 1; i < hubCount_; i++) {
+    MeshHub& hub = hubs_[i];
+    if (!hub.online || nowMs - hub.lastHeard < MESH_HUB_TIMEOUT_MS) continue;
+    hub.online = false;
+    lost = true;
+    handler_->meshChanged(i);
+  }
+  if (lost && mode_ == MESH_PEER) chooseAggregator();
+
+  // Changes go out at most every MESH_DELTA_MIN_MS; an unacknowledged
+  // delta is repeated every MESH_RESEND_MS
+  if (mode_ == MESH_PEER && aggregator_ >= 0 && hubs_[0].version > acked_) {
+    uint32_t since = nowMs - lastDelta_;
+    if ((hubs_[0].version != sentVersion_ && since >= MESH_DELTA_MIN_MS) || since >= MESH_RESEND_MS) {
+      sendDelta(nowMs);
+    }
+  }
+
+  // A queued command goes out as soon as the one ahead of it is done
+  for (uint8_t i = 0; i < MESH_MAX_PENDING; i++) {
+    Pending& p = pending_[i];
+    if (!p.used || queuedBehind(p)) continue;
+    if (p.tries > 0 && nowMs - p.sentMs < MESH_COMMAND_MS) continue;
+    if (p.tries < MESH_COMMAND_TRIES && hubs_[p.hub].online) {
+      sendCommand(p, nowMs);
+      continue;
+    }
+    p.used = false;
+    stats_.commandsFailed++;
+    handler_->meshCommandDone(p.hub, p.device, false);
+  }
+}
+
+// ============== RECEIVE ==============
+
+void HubMesh::receive(const MeshAddr& from, const uint8_t* data, size_t len, uint32_t nowMs) {
+  if (mode_ == MESH_OFF) return;
+  Reader r = {data, len, 0, true};
+  bool magic = r.u8() == 'H' && r.u8() == 'M' && r.u8() == MESH_PROTO;
+  uint8_t type = r.u8();
+  uint32_t id = r.u32();
+  uint32_t epoch = r.u32();
+  uint16_t port = r.u16();
+  if (!magic || !r.ok) {
+    stats_.rejected++;
+    return;
+  }
+  if (id == hubs_[0].id) return;   // own multicast looped back
+  stats_.received++;
+
+  MeshAddr addr = {from.ip, port};
+  int8_t h = hubById(id, addr, nowMs, type == MESH_ANNOUNCE || type == MESH_DELTA);
+  if (h < 0) return;
+
+  MeshHub& hub = hubs_[h];
+  bool changed = !hub.online;
+  if (hub.epoch != epoch) {
+    // Rebooted: its versions start over
+    hub.epoch = epoch;
+    hub.version = 0;
+    hub.commandSeen = false;
+    hub.count = 0;
+    changed = true;
+  }
+  hub.addr = addr;
+  hub.online = true;
+  hub.lastHeard = nowMs;
+
+  const uint8_t* body = data + MESH_HEADER_SIZE;
+  size_t bodyLen = len - MESH_HEADER_SIZE;
+  switch (type) {
+    case MESH_ANNOUNCE:     onAnnounce(h, body, bodyLen); break;
+    case MESH_DELTA:        onDelta(h, body, bodyLen); break;
+    case MESH_ACK:          if (h == aggregator_) onAck(body, bodyLen); break;
+    case MESH_COMMAND:      onCommand(h, body, bodyLen); break;
+    case MESH_COMMAND_ACK:  onCommandAck(h, body, bodyLen, nowMs); break;
+    default:                stats_.rejected++; break;
+  }
+  if (changed) handler_->meshChanged(h);
+}
+
+void HubMesh::onAnnounce(uint8_t h, const uint8_t* p, size_t len) {
+  Reader r = {p, len, 0, true};
+  uint8_t flags = r.u8();
+  r.u32();                       // version, informational
+  r.u8();                        // entries
+  char name[MESH_NAME_SIZE];
+  r.str(name, sizeof(name));
+  if (!r.ok) {
+    stats_.rejected++;
+    return;
+  }
+
+  MeshHub& hub = hubs_[h];
+  bool renamed = strcmp(hub.name, name) != 0;
+  strcpy(hub.name, name);
+  hub.aggregator = flags & 1;
+  if (renamed) handler_->meshChanged(h);
+  if (mode_ == MESH_PEER) chooseAggregator();
+}
+
+void HubMesh::onDelta(uint8_t h, const uint8_t* p, size_t len) {
+  if (mode_ != MESH_AGGREGATOR) return;
+  MeshHub& hub = hubs_[h];
+
+  Reader r = {p, len, 0, true};
+  uint32_t from = r.u32();
+  uint32_t to = r.u32();
+  uint8_t count = r.u8();
+  if (!r.ok || count > MESH_MAX_ENTRIES || from >= to) {
+    stats_.rejected++;
+    return;
+  }
+
+  // A delta that starts past what is held cannot be applied; one that
+  // ends at or below it is a stale duplicate. Either way the ACK tells the
+  // peer where to continue.
+  if (from > hub.version) {
+    stats_.resyncs++;
+    sendAck(hub);
+    return;
+  }
+  if (to <= hub.version) {
+    sendAck(hub);
+    return;
+  }
+
+  MeshEntry entries[MESH_MAX_ENTRIES];
+  for (uint8_t i = 0; i < count; i++) {
+    r.str(entries[i].key, MESH_KEY_SIZE);
+    entries[i].flags = r.u8();
+    entries[i].value = r.f32();
+  }
+  if (!r.ok) {
+    stats_.rejected++;
+    return;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    MeshEntry* e = entry(hub, entries[i].key, true);
+    if (!e) continue;
+    e->flags = entries[i].flags;
+    e->value = entries[i].value;
+    e->version = to;
+  }
+  hub.version = to;
+  stats_.deltasApplied++;
+  sendAck(hub);
+  handler_->meshChanged(h);
+}
+
+void HubMesh::onAck(const uint8_t* p, size_t len) {
+  Reader r = {p, len, 0, true};
+  uint32_t epoch = r.u32();
+  uint32_t version = r.u32();
+  if (!r.ok) {
+    stats_.rejected++;
+    return;
+  }
+  if (epoch != hubs_[0].epoch || version > hubs_[0].version) return;
+
+  // Below what was sent means the aggregator lost some: resend from there
+  if (version < sentVersion_) sentVersion_ = version;
+  acked_ = version;
+}
+
+void HubMesh::onCommand(uint8_t h, const uint8_t* p, size_t len) {
+  Reader r = {p, len, 0, true};
+  uint32_t target = r.u32();
+  uint16_t seq = r.u16();
+  bool state = r.u8() != 0;
+  int16_t value = (int16_t)r.u16();
+  char device[MESH_KEY_SIZE];
+  r.str(device, sizeof(device));
+  if (!r.ok || target != hubs_[0].id) {
+    stats_.rejected++;
+    return;
+  }
+
+  // Seqs compare by serial arithmetic. Anything at or below the highest
+  // one applied is a retry or a late copy: the latest gets its result
+  // again, an older one (given up by the sender) is reported not applied.
+  MeshHub& hub = hubs_[h];
+  bool ok;
+  if (!hub.commandSeen || (int16_t)(seq - hub.commandSeq) > 0) {
+    ok = handler_->meshCommand(device, state, value);
+    hub.commandSeen = true;
+    hub.commandSeq = seq;
+    hub.commandOk = ok;
+  } else {
+    ok = seq == hub.commandSeq && hub.commandOk;
+  }
+
+  uint8_t buf[MESH_PACKET_SIZE];
+  Writer w = {buf, header(buf, MESH_COMMAND_ACK)};
+  w.u16(seq);
+  w.u8(ok);
+  send(hub.addr, buf, w.len);
+}
+
+void HubMesh::onCommandAck(uint8_t h, const uint8_t* p, size_t len, uint32_t nowMs) {
+  Reader r = {p, len, 0, true};
+  uint16_t seq = r.u16();
+  bool ok = r.u8() != 0;
+  if (!r.ok) {
+    stats_.rejected++;
+    return;
+  }
+
+  for (uint8_t i = 0; i < MESH_MAX_PENDING; i++) {
+    Pending& pend = pending_[i];
+    if (!pend.used || pend.hub != h || pend.seq != seq) continue;
+    pend.used = false;
+    if (!ok) stats_.commandsFailed++;
+    handler_->meshCommandDone(h, pend.device, ok);
+    break;
+  }
+
+  // Next command for the same hub
+  for (uint8_t i = 0; i < MESH_MAX_PENDING; i++) {
+    Pending& next = pending_[i];
+    if (next.used && next.hub == h && next.tries == 0 && !queuedBehind(next)) sendCommand(next, nowMs);
+  }
+}
+
+// True if an older command to the same hub is still pending
+bool HubMesh::queuedBehind(const Pending& p) const {
+  for (uint8_t i = 0; i < MESH_MAX_PENDING; i++) {
+    const Pending& q = pending_[i];
+    if (q.used && &q != &p && q.hub == p.hub && (int16_t)(p.seq - q.seq) > 0) return true;
+  }
+  return false;
+}
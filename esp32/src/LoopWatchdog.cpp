@@ -0,0 +1,205 @@
+#include "LoopWatchdog.h"
+#include "SampleQueue.h"
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+#include <esp_cpu.h>
+#include <esp_debug_helpers.h>
+#include <soc/soc_memory_layout.h>
+#include <xtensa_context.h>
+#endif
+
+#define STALL_MAGIC 0x57444731UL   // "WDG1"
+
+// Not cleared by a software, watchdog or panic reset
+RTC_NOINIT_ATTR static StallRecord stallRecord;
+
+static uint16_t recordCrc(const StallRecord& r) {
+  return SampleQueue::crc16((const uint8_t*)&r, offsetof(StallRecord, crc));
+}
+
+// Walks the stack of a switched-out task from the context the port saved
+// at pxTopOfStack (the first TCB member), the same way core dumps do.
+// Returns 0 if the task is running, since its saved context is stale.
+static uint8_t taskBacktrace(TaskHandle_t task, uint32_t* out, uint8_t max) {
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+  if (!task) return 0;
+  for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+    if (xTaskGetCurrentTaskHandleForCPU(core) == task) return 0;
+  }
+
+  const void* top = *(void* const*)task;
+  esp_backtrace_frame_t frame = {};
+  const XtSolFrame* sol = (const XtSolFrame*)top;
+  if (sol->exit == 0) {
+    frame.pc = sol->pc;
+    frame.sp = sol->a1;
+    frame.next_pc = sol->a0;
+  } else {
+    const XtExcFrame* exc = (const XtExcFrame*)top;
+    frame.pc = exc->pc;
+    frame.sp = exc->a1;
+    frame.next_pc = exc->a0;
+  }
+
+  uint8_t depth = 0;
+  while (depth < max) {
+    uint32_t pc = (uint32_t)(uintptr_t)esp_cpu_process_stack_pc(frame.pc);
+    if (!esp_stack_ptr_is_sane(frame.sp) || !esp_ptr_executable((void*)(uintptr_t)pc)) break;
+    out[depth++] = pc;
+    if (frame.next_pc == 0 || !esp_backtrace_get_next_frame(&frame)) break;
+  }
+  return depth;
+#else
+  return 0;
+#endif
+}
+
+void LoopWatchdog::begin(const char* const* names, const uint16_t* budgetsMs, uint8_t stages,
+                         uint16_t panicSeconds) {
+  names_ = names;
+  budgets_ = budgetsMs;
+  count_ = min<uint8_t>(stages, WATCHDOG_MAX_STAGES);
+  loopTask_ = xTaskGetCurrentTaskHandle();
+  resetReason_ = esp_reset_reason();
+
+  // Report what the previous boot left behind, once
+  if (stallRecord.magic == STALL_MAGIC && stallRecord.crc == recordCrc(stallRecord) &&
+      stallRecord.stage < count_) {
+    report_ = stallRecord;
+    hasReport_ = true;
+  }
+  stallRecord.magic = 0;
+
+  esp_timer_create_args_t args = {};
+  args.callback = onCheck;
+  args.arg = this;
+  args.name = "loopwdt";
+  if (esp_timer_create(&args, &timer_) == ESP_OK) {
+    esp_timer_start_periodic(timer_, WATCHDOG_CHECK_MS * 1000ULL);
+  }
+
+  setPanic(panicSeconds);
+}
+
+void LoopWatchdog::setPanic(uint16_t seconds) {
+  if (seconds > 0) {
+    esp_task_wdt_init(seconds, true);
+    if (panicSeconds_ == 0) esp_task_wdt_add(loopTask_);
+  } else if (panicSeconds_ > 0) {
+    esp_task_wdt_delete(loopTask_);
+  }
+  panicSeconds_ = seconds;
+}
+
+void LoopWatchdog::endLoop() {
+  if (current_ != WATCHDOG_NO_STAGE) finish(micros());
+  if (panicSeconds_ > 0) esp_task_wdt_reset();
+}
+
+void LoopWatchdog::feed() {
+  if (panicSeconds_ > 0) esp_task_wdt_reset();
+}
+
+// Only the loop task writes current_ and enteredAt_, so it reads them
+// unlocked; the record is shared with the monitor
+void LoopWatchdog::finish(uint32_t now) {
+  uint8_t stage = current_;
+  uint32_t us = now - enteredAt_;
+
+  StageStats& st = stats_[stage];
+  if (us > st.maxUs) st.maxUs = us;
+
+  bool over = true;
+  portENTER_CRITICAL(&mux_);
+  current_ = WATCHDOG_NO_STAGE;
+  if (capturedRun_ == run_) {
+    // The monitor caught this run mid-stall; keep its backtrace, fix the duration
+    stallRecord.durationMs = us / 1000;
+    stallRecord.finished = true;
+    stallRecord.crc = recordCrc(stallRecord);
+    capturedRun_ = 0;
+  } else if (us > budgets_[stage] * 1000UL) {
+    capture(stage, us / 1000, false);
+  } else {
+    over = false;
+  }
+  portEXIT_CRITICAL(&mux_);
+  if (!over) return;
+
+  st.overruns++;
+  Serial.printf("[WDT] Stage %s took %lu ms (budget %u ms)\n",
+    names_[stage], (unsigned long)(us / 1000), budgets_[stage]);
+}
+
+// A stage must leave room for the record before the task WDT fires
+uint32_t LoopWatchdog::limitMs(uint8_t stage) const {
+  uint32_t limit = budgets_[stage];
+  if (panicSeconds_ > 0) limit = min<uint32_t>(limit, panicSeconds_ * 500UL);
+  return limit;
+}
+
+void LoopWatchdog::capture(uint8_t stage, uint32_t durationMs, bool live) {
+  StallRecord& r = stallRecord;
+  r.magic = STALL_MAGIC;
+  r.stage = stage;
+  r.live = live;
+  r.finished = !live;
+  r.durationMs = durationMs;
+  r.budgetMs = budgets_[stage];
+  r.uptimeS = millis() / 1000;
+  r.depth = live ? taskBacktrace(loopTask_, r.backtrace, WATCHDOG_BACKTRACE_DEPTH) : 0;
+  r.crc = recordCrc(r);
+  stalls++;
+}
+
+// Runs on the esp_timer task. The stage, its start and the run number
+// are read and the record written in one critical section, so the loop
+// task cannot close the stage halfway through.
+void LoopWatchdog::onCheck(void* arg) {
+  LoopWatchdog* self = (LoopWatchdog*)arg;
+  portENTER_CRITICAL(&self->mux_);
+  uint8_t stage = self->current_;
+  if (stage != WATCHDOG_NO_STAGE && self->capturedRun_ != self->run_) {
+    uint32_t elapsedMs = (micros() - self->enteredAt_) / 1000;
+    if (elapsedMs > self->limitMs(stage)) {
+      self->capture(stage, elapsedMs, true);
+      self->capturedRun_ = self->run_;
+    }
+  }
+  portEXIT_CRITICAL(&self->mux_);
+}
+
+const StallRecord& LoopWatchdog::last() const {
+  return stallRecord;
+}
+
+const char* LoopWatchdog::stageName(uint8_t stage) const {
+  return stage < count_ ? names_[stage] : "?";
+}
+
+const char* LoopWatchdog::resetReason() const {
+  switch (resetReason_) {
+    case ESP_RST_POWERON:  return "power-on";
+    case ESP_RST_SW:       return "software";
+    case ESP_RST_PANIC:    return "panic";
+    case ESP_RST_INT_WDT:  return "interrupt-wdt";
+    case ESP_RST_TASK_WDT: return "task-wdt";
+    case ESP_RST_WDT:      return "wdt";
+    case ESP_RST_BROWNOUT: return "brownout";
+    case ESP_RST_DEEPSLEEP: return "deep-sleep";
+  }
+  return "other";
+}
+
+void LoopWatchdog::printReport(Print& out, const StallRecord& r) const {
+  out.printf("Stall in %s: %lu ms (budget %lu ms) at uptime %lu s%s\n",
+    stageName(r.stage), (unsigned long)r.durationMs, (unsigned long)r.budgetMs,
+    (unsigned long)r.uptimeS, r.finished ? "" : ", never returned");
+  if (r.depth == 0) return;
+
+  out.print("Backtrace:");
+  for (uint8_t i = 0; i < r.depth; i++) out.printf(" 0x%08lx", (unsigned long)r.backtrace[i]);
+  out.println();
+}
@@ -0,0 +1,159 @@
+#include "MqttLink.h"
+
+MqttLink* MqttLink::instance_ = nullptr;
+
+// Topic-safe form of a free-text name: lowercase, [a-z0-9-] only
+static String topicName(const char* text) {
+  String out;
+  for (const char* p = text; *p; p++) {
+    char c = tolower(*p);
+    bool keep = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+    if (keep) out += c;
+    else if (out.length() > 0 && !out.endsWith("-")) out += '-';
+  }
+  if (out.endsWith("-")) out.remove(out.length() - 1);
+  return out.length() > 0 ? out : String("hub");
+}
+
+void MqttLink::begin(const char* host, uint16_t port, const char* user, const char* password,
+                     const char* prefix, const char* device, uint8_t qos, CommandHandler handler) {
+  enabled_ = strlen(host) > 0;
+  if (!enabled_) return;
+
+  host_ = host;
+  port_ = port ? port : 1883;
+  user_ = user;
+  password_ = password;
+  qos_ = qos > 2 ? 2 : qos;
+  handler_ = handler;
+
+  String name = topicName(device);
+  base_ = String(prefix[0] ? prefix : "iothub") + "/" + name + "/";
+
+  String mac = WiFi.macAddress();
+  mac.replace(":", "");
+  clientId_ = name + "-" + mac.substring(6);
+
+  instance_ = this;
+  client_.begin(host_.c_str(), port_, net_);
+  client_.onMessageAdvanced(onMessage);
+  client_.setKeepAlive(30);
+  client_.setTimeout(2000);   // bounds QoS 1/2 waits inside loop()
+
+  Serial.printf("✓ MQTT broker %s:%u, topics %s#\n", host_.c_str(), port_, base_.c_str());
+}
+
+bool MqttLink::connect() {
+  String status = base_ + "status";
+  client_.setWill(status.c_str(), "offline", true, qos_);
+
+  bool ok = user_.length() > 0
+    ? client_.connect(clientId_.c_str(), user_.c_str(), password_.c_str())
+    : client_.connect(clientId_.c_str());
+  if (!ok) return false;
+
+  connects++;
+  client_.publish(status.c_str(), "online", 6, true, qos_);
+
+  String commands = base_ + "cmd/+";
+  client_.subscribe(commands.c_str(), qos_);
+
+  // A broker without persistence forgets retained topics; resend them all
+  for (uint8_t i = 0; i < MQTT_OUTBOX_SIZE; i++) {
+    if (outbox_[i].used) outbox_[i].dirty = true;
+  }
+  return true;
+}
+
+void MqttLink::loop(bool networkUp) {
+  if (!enabled_ || !networkUp) return;
+
+  if (!client_.connected()) {
+    unsigned long now = millis();
+    if (now - lastAttempt_ < backoff_) return;
+    lastAttempt_ = now;
+
+    if (!connect()) {
+      failures++;
+      backoff_ = backoff_ == 0 ? MQTT_RETRY_MS : min(backoff_ * 2, MQTT_RETRY_MAX_MS);
+      Serial.printf("[MQTT] Connect to %s:%u failed (%d), retry in %lus\n",
+        host_.c_str(), port_, (int)client_.lastError(), backoff_ / 1000);
+      return;
+    }
+    backoff_ = 0;
+    Serial.printf("[MQTT] Connected as %s\n", clientId_.c_str());
+  }
+
+  client_.loop();
+  flush();
+}
+
+bool MqttLink::publish(const char* topic, const char* payload) {
+  if (!enabled_) return false;
+
+  Slot* empty = nullptr;
+  for (uint8_t i = 0; i < MQTT_OUTBOX_SIZE; i++) {
+    Slot& s = outbox_[i];
+    if (!s.used) {
+      if (!empty) empty = &s;
+      continue;
+    }
+    if (strcmp(s.topic, topic) != 0) continue;
+
+    if (strcmp(s.payload, payload) == 0) {
+      unchanged++;
+      return true;
+    }
+    if (s.dirty) coalesced++;
+    strlcpy(s.payload, payload, sizeof(s.payload));
+    s.dirty = true;
+    return true;
+  }
+
+  if (!empty) {
+    overflow++;
+    return false;
+  }
+  strlcpy(empty->topic, topic, sizeof(empty->topic));
+  strlcpy(empty->payload, payload, sizeof(empty->payload));
+  empty->used = true;
+  empty->dirty = true;
+  return true;
+}
+
+void MqttLink::flush() {
+  uint8_t sent = 0;
+  for (uint8_t i = 0; i < MQTT_OUTBOX_SIZE && sent < MQTT_BATCH; i++) {
+    Slot& s = outbox_[i];
+    if (!s.used || !s.dirty) continue;
+
+    String topic = base_ + s.topic;
+    if (!client_.publish(topic.c_str(), s.payload, strlen(s.payload), true, qos_)) {
+      failures++;
+      return;   // stays dirty; retried after the client reconnects
+    }
+    s.dirty = false;
+    published++;
+    sent++;
+  }
+}
+
+uint8_t MqttLink::pending() const {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < MQTT_OUTBOX_SIZE; i++) {
+    if (outbox_[i].used && outbox_[i].dirty) n++;
+  }
+  return n;
+}
+
+void MqttLink::onMessage(MQTTClient* client, char topic[], char bytes[], int length) {
+  MqttLink* self = instance_;
+  if (!self || !self->handler_) return;
+
+  String prefix = self->base_ + "cmd/";
+  if (strncmp(topic, prefix.c_str(), prefix.length()) != 0) return;
+
+  // The library NUL-terminates the payload in its read buffer
+  self->commands++;
+  self->handler_(topic + prefix.length(), bytes, length);
+}
@@ -0,0 +1,714 @@
+#include "OtaPipeline.h"
+#include <stdlib.h>
+#include <string.h>
+
+// ============== SHA-256 ==============
+
+static const uint32_t SHA_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t ror(uint32_t x, uint8_t n) { return (x >> n) | (x << (32 - n)); }
+
+void Sha256::reset() {
+  static const uint32_t init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  memcpy(h_, init, sizeof(h_));
+  used_ = 0;
+  bytes_ = 0;
+}
+
+void Sha256::block(const uint8_t* p) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = h_[0], b = h_[1], c = h_[2], d = h_[3], e = h_[4], f = h_[5], g = h_[6], h = h_[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + SHA_K[i] + w[i];
+    uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  h_[0] += a; h_[1] += b; h_[2] += c; h_[3] += d;
+  h_[4] += e; h_[5] += f; h_[6] += g; h_[7] += h;
+}
+
+void Sha256::update(const uint8_t* data, size_t len) {
+  bytes_ += len;
+  if (used_ > 0) {
+    size_t n = 64u - used_ < len ? 64u - used_ : len;
+    memcpy(buf_ + used_, data, n);
+    used_ += n;
+    data += n;
+    len -= n;
+    if (used_ < 64) return;
+    block(buf_);
+    used_ = 0;
+  }
+  for (; len >= 64; data += 64, len -= 64) block(data);
+  memcpy(buf_, data, len);
+  used_ = len;
+}
+
+void Sha256::final(uint8_t out[OTA_SHA_SIZE]) {
+  uint64_t bits = bytes_ * 8;
+  uint8_t pad = 0x80;
+  update(&pad, 1);
+  pad = 0;
+  while (used_ != 56) update(&pad, 1);
+  uint8_t len[8];
+  for (int i = 0; i < 8; i++) len[i] = bits >> (56 - 8 * i);
+  update(len, 8);
+  for (int i = 0; i < 8; i++) {
+    out[4 * i] = h_[i] >> 24;
+    out[4 * i + 1] = h_[i] >> 16;
+    out[4 * i + 2] = h_[i] >> 8;
+    out[4 * i + 3] = h_[i];
+  }
+}
+
+// ============== INFLATE ==============
+
+static const uint16_t LEN_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LEN_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DIST_BASE[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DIST_EXTRA[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t CODE_ORDER[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// CRC-32 (gzip) by nibbles: a 64-byte table instead of 1 KB
+static const uint32_t CRC_NIBBLE[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+bool Inflater::begin() {
+  end();
+  window_ = (uint8_t*)malloc(OTA_WINDOW_SIZE);
+  inLen_ = pos_ = 0;
+  bitBuf_ = 0;
+  bitCount_ = 0;
+  short_ = false;
+  state_ = HEADER;
+  last_ = false;
+  storedLeft_ = 0;
+  out_ = flushed_ = 0;
+  crc_ = 0xFFFFFFFF;
+  error_ = nullptr;
+  if (!window_) return fail("Out of memory");
+  return true;
+}
+
+void Inflater::end() {
+  free(window_);
+  window_ = nullptr;
+}
+
+bool Inflater::fail(const char* message) {
+  if (!error_) error_ = message;
+  state_ = FAILED;
+  return false;
+}
+
+bool Inflater::write(const uint8_t* data, size_t len, ByteSink& out) {
+  if (state_ == FAILED) return false;
+
+  for (;;) {
+    // Keep the unconsumed tail, top up from the chunk
+    if (pos_ > 0) {
+      memmove(in_, in_ + pos_, inLen_ - pos_);
+      inLen_ -= pos_;
+      pos_ = 0;
+    }
+    size_t n = sizeof(in_) - inLen_;
+    if (n > len) n = len;
+    memcpy(in_ + inLen_, data, n);
+    inLen_ += n;
+    data += n;
+    len -= n;
+
+    int r;
+    while ((r = step(out)) > 0) {}
+    if (r < 0) return false;
+    if (len == 0) break;
+    if (pos_ == 0 && inLen_ == sizeof(in_)) return fail("Deflate block header too large");
+  }
+  return flush(out) || fail("Output refused");
+}
+
+int Inflater::step(ByteSink& out) {
+  // Units roll back to here when the input runs out
+  uint16_t pos = pos_;
+  uint32_t bitBuf = bitBuf_;
+  uint8_t bitCount = bitCount_;
+
+  int r;
+  switch (state_) {
+    case HEADER:  r = header(); break;
+    case BLOCK:   r = blockHeader(); break;
+    case CODES:   r = codes(out); break;
+    case STORED:  r = stored(out); break;
+    case TRAILER: r = trailer(); break;
+    case DONE:    return pos_ < inLen_ ? (fail("Data after end of gzip stream"), -1) : 0;
+    default:      return -1;
+  }
+
+  if (r >= 0 && short_) {
+    pos_ = pos;
+    bitBuf_ = bitBuf;
+    bitCount_ = bitCount;
+    short_ = false;
+    return 0;
+  }
+  return r;
+}
+
+uint32_t Inflater::bits(uint8_t n) {
+  while (bitCount_ < n) {
+    if (pos_ >= inLen_) {
+      short_ = true;
+      return 0;
+    }
+    bitBuf_ |= (uint32_t)in_[pos_++] << bitCount_;
+    bitCount_ += 8;
+  }
+  uint32_t v = bitBuf_ & ((1UL << n) - 1);
+  bitBuf_ >>= n;
+  bitCount_ -= n;
+  return v;
+}
+
+// Canonical code, one bit at a time (as in zlib's puff)
+int Inflater::decode(const Huffman& h) {
+  int code = 0, first = 0, index = 0;
+  for (int len = 1; len < 16; len++) {
+    code |= bits(1);
+    if (short_) return -1;
+    int count = h.count[len];
+    if (code - count < first) return h.symbol[index + (code - first)];
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+// 0 complete, > 0 incomplete, < 0 over-subscribed
+int Inflater::build(Huffman& h, const uint8_t* lengths, uint16_t n) {
+  memset(h.count, 0, sizeof(h.count));
+  for (uint16_t s = 0; s < n; s++) h.count[lengths[s]]++;
+  if (h.count[0] == n) return 0;
+
+  int left = 1;
+  for (int len = 1; len < 16; len++) {
+    left <<= 1;
+    left -= h.count[len];
+    if (left < 0) return left;
+  }
+
+  uint16_t offs[16];
+  offs[1] = 0;
+  for (int len = 1; len < 15; len++) offs[len + 1] = offs[len] + h.count[len];
+  for (uint16_t s = 0; s < n; s++) {
+    if (lengths[s] != 0) h.symbol[offs[lengths[s]]++] = s;
+  }
+  return left;
+}
+
+int Inflater::header() {
+  uint8_t id1 = bits(8), id2 = bits(8), method = bits(8), flags = bits(8);
+  bits(16); bits(16); bits(16);            // mtime, extra flags, OS
+  if (short_) return 0;
+  if (id1 != 0x1f || id2 != 0x8b || method != 8 || (flags & 0xE0)) {
+    fail("Not a gzip stream");
+    return -1;
+  }
+
+  if (flags & 0x04) {                      // FEXTRA
+    uint16_t n = bits(16);
+    while (n-- > 0 && !short_) bits(8);
+  }
+  if (flags & 0x08) while (bits(8) != 0) {}  // FNAME
+  if (flags & 0x10) while (bits(8) != 0) {}  // FCOMMENT
+  if (flags & 0x02) bits(16);                // FHCRC
+  if (short_) return 0;
+
+  state_ = BLOCK;
+  return 1;
+}
+
+int Inflater::blockHeader() {
+  last_ = bits(1);
+  uint8_t type = bits(2);
+  if (short_) return 0;
+
+  if (type == 0) {
+    bitBuf_ = 0;                           // stored blocks start on a byte
+    bitCount_ = 0;
+    uint16_t len = bits(16), nlen = bits(16);
+    if (short_) return 0;
+    if (len != (uint16_t)~nlen) {
+      fail("Bad stored block length");
+      return -1;
+    }
+    storedLeft_ = len;
+    state_ = STORED;
+    return 1;
+  }
+
+  if (type == 1) {
+    uint8_t lengths[288 + 30];
+    uint16_t s = 0;
+    for (; s < 144; s++) lengths[s] = 8;
+    for (; s < 256; s++) lengths[s] = 9;
+    for (; s < 280; s++) lengths[s] = 7;
+    for (; s < 288; s++) lengths[s] = 8;
+    for (; s < 288 + 30; s++) lengths[s] = 5;
+    build(lencode_, lengths, 288);
+    build(distcode_, lengths + 288, 30);
+    state_ = CODES;
+    return 1;
+  }
+
+  if (type == 2) {
+    int r = buildDynamic();
+    if (r > 0) state_ = CODES;
+    return r;
+  }
+
+  fail("Bad block type");
+  return -1;
+}
+
+int Inflater::buildDynamic() {
+  uint16_t nlen = bits(5) + 257;
+  uint16_t ndist = bits(5) + 1;
+  uint8_t ncode = bits(4) + 4;
+  if (short_) return 0;
+  if (nlen > 286 || ndist > 30) {
+    fail("Bad dynamic block counts");
+    return -1;
+  }
+
+  uint8_t lengths[286 + 30];
+  memset(lengths, 0, 19);
+  for (uint8_t i = 0; i < ncode; i++) lengths[CODE_ORDER[i]] = bits(3);
+  if (short_) return 0;
+  if (build(lencode_, lengths, 19) != 0) {
+    fail("Bad code length code");
+    return -1;
+  }
+
+  uint16_t index = 0;
+  while (index < nlen + ndist) {
+    int sym = decode(lencode_);
+    if (short_) return 0;
+    if (sym < 0) {
+      fail("Bad code length");
+      return -1;
+    }
+    if (sym < 16) {
+      lengths[index++] = sym;
+      continue;
+    }
+
+    uint8_t len = 0;
+    uint8_t repeat;
+    if (sym == 16) {
+      if (index == 0) {
+        fail("Repeat with no length");
+        return -1;
+      }
+      len = lengths[index - 1];
+      repeat = 3 + bits(2);
+    } else if (sym == 17) {
+      repeat = 3 + bits(3);
+    } else {
+      repeat = 11 + bits(7);
+    }
+    if (short_) return 0;
+    if (index + repeat > nlen + ndist) {
+      fail("Too many code lengths");
+      return -1;
+    }
+    while (repeat-- > 0) lengths[index++] = len;
+  }
+
+  if (lengths[256] == 0) {
+    fail("No end-of-block code");
+    return -1;
+  }
+  // Incomplete codes are only allowed with a single length
+  int err = build(lencode_, lengths, nlen);
+  if (err < 0 || (err > 0 && nlen - lencode_.count[0] != 1)) {
+    fail("Bad literal/length code");
+    return -1;
+  }
+  err = build(distcode_, lengths + nlen, ndist);
+  if (err < 0 || (err > 0 && ndist - distcode_.count[0] != 1)) {
+    fail("Bad distance code");
+    return -1;
+  }
+  return 1;
+}
+
+int Inflater::codes(ByteSink& out) {
+  int sym = decode(lencode_);
+  if (short_) return 0;
+  if (sym < 0) {
+    fail("Bad literal/length code");
+    return -1;
+  }
+  if (sym < 256) return emit(sym, out) ? 1 : -1;
+  if (sym == 256) {
+    state_ = last_ ? TRAILER : BLOCK;
+    return 1;
+  }
+
+  sym -= 257;
+  if (sym >= 29) {
+    fail("Bad length symbol");
+    return -1;
+  }
+  uint16_t len = LEN_BASE[sym] + bits(LEN_EXTRA[sym]);
+  int dsym = decode(distcode_);
+  if (short_) return 0;
+  if (dsym < 0 || dsym >= 30) {
+    fail("Bad distance symbol");
+    return -1;
+  }
+  uint32_t dist = DIST_BASE[dsym] + bits(DIST_EXTRA[dsym]);
+  if (short_) return 0;
+  if (dist > out_) {
+    fail("Distance too far back");
+    return -1;
+  }
+
+  while (len-- > 0) {
+    if (!emit(window_[(out_ - dist) & (OTA_WINDOW_SIZE - 1)], out)) return -1;
+  }
+  return 1;
+}
+
+int Inflater::stored(ByteSink& out) {
+  if (storedLeft_ == 0) {
+    state_ = last_ ? TRAILER : BLOCK;
+    return 1;
+  }
+  uint32_t n = inLen_ - pos_;
+  if (n == 0) return 0;
+  if (n > storedLeft_) n = storedLeft_;
+  for (uint32_t i = 0; i < n; i++) {
+    if (!emit(in_[pos_ + i], out)) return -1;
+  }
+  pos_ += n;
+  storedLeft_ -= n;
+  return 1;
+}
+
+int Inflater::trailer() {
+  bitBuf_ = 0;                             // the trailer starts on a byte
+  bitCount_ = 0;
+  uint32_t crc = bits(16);
+  crc |= bits(16) << 16;
+  uint32_t size = bits(16);
+  size |= bits(16) << 16;
+  if (short_) return 0;
+
+  if (crc != ~crc_) {
+    fail("gzip CRC mismatch");
+    return -1;
+  }
+  if (size != out_) {
+    fail("gzip size mismatch");
+    return -1;
+  }
+  state_ = DONE;
+  return 1;
+}
+
+bool Inflater::emit(uint8_t b, ByteSink& out) {
+  if (out_ - flushed_ == OTA_WINDOW_SIZE && !flush(out)) return fail("Output refused");
+  window_[out_ & (OTA_WINDOW_SIZE - 1)] = b;
+  out_++;
+  crc_ ^= b;
+  crc_ = (crc_ >> 4) ^ CRC_NIBBLE[crc_ & 15];
+  crc_ = (crc_ >> 4) ^ CRC_NIBBLE[crc_ & 15];
+  return true;
+}
+
+bool Inflater::flush(ByteSink& out) {
+  while (flushed_ != out_) {
+    uint32_t start = flushed_ & (OTA_WINDOW_SIZE - 1);
+    uint32_t n = out_ - flushed_;
+    if (start + n > OTA_WINDOW_SIZE) n = OTA_WINDOW_SIZE - start;
+    if (!out.put(window_ + start, n)) return false;
+    flushed_ += n;
+  }
+  return true;
+}
+
+// ============== DELTA ==============
+
+static uint32_t le32(const uint8_t* p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void DeltaDecoder::begin(BaseImage* base, ByteSink* out) {
+  base_ = base;
+  out_ = out;
+  state_ = HEADER;
+  have_ = 0;
+  need_ = OTA_DELTA_HEADER;
+  baseSize_ = offset_ = left_ = targetSize_ = 0;
+  error_ = nullptr;
+}
+
+bool DeltaDecoder::fail(const char* message) {
+  if (!error_) error_ = message;
+  state_ = FAILED;
+  return false;
+}
+
+bool DeltaDecoder::put(const uint8_t* data, size_t len) {
+  while (len > 0) {
+    switch (state_) {
+      case HEADER:
+      case OP: {
+        if (state_ == OP && have_ == 0) {
+          uint8_t code = data[0];
+          need_ = code == OTA_DELTA_END ? 1 : code == OTA_DELTA_DATA ? 5 : 9;
+        }
+        size_t n = need_ - have_;
+        if (n > len) n = len;
+        memcpy(hdr_ + have_, data, n);
+        have_ += n;
+        data += n;
+        len -= n;
+        if (have_ < need_) return true;
+        have_ = 0;
+        if (!(state_ == HEADER ? header() : op())) return false;
+        break;
+      }
+
+      case DATA: {
+        size_t n = left_ < len ? left_ : len;
+        if (!out_->put(data, n)) return fail("Output refused");
+        data += n;
+        len -= n;
+        left_ -= n;
+        if (left_ == 0) state_ = OP;
+        break;
+      }
+
+      case ADD: {
+        uint8_t buf[256];
+        size_t n = left_ < len ? left_ : len;
+        if (n > sizeof(buf)) n = sizeof(buf);
+        if (!base_->read(offset_, buf, n)) return fail("Base image read failed");
+        for (size_t i = 0; i < n; i++) buf[i] += data[i];
+        if (!out_->put(buf, n)) return fail("Output refused");
+        data += n;
+        len -= n;
+        offset_ += n;
+        left_ -= n;
+        if (left_ == 0) state_ = OP;
+        break;
+      }
+
+      case DONE:
+        return fail("Data after end of delta");
+
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+bool DeltaDecoder::header() {
+  if (memcmp(hdr_, OTA_DELTA_MAGIC, 4) != 0 || hdr_[4] != OTA_DELTA_VERSION) {
+    return fail("Unsupported delta format");
+  }
+  baseSize_ = le32(hdr_ + 8);
+  targetSize_ = le32(hdr_ + 44);
+  memcpy(targetSha_, hdr_ + 48, OTA_SHA_SIZE);
+  if (!base_ || baseSize_ > base_->size()) return fail("Delta is for a different firmware");
+
+  Sha256 sha;
+  uint8_t buf[256];
+  for (uint32_t off = 0; off < baseSize_; off += sizeof(buf)) {
+    uint32_t n = baseSize_ - off < sizeof(buf) ? baseSize_ - off : sizeof(buf);
+    if (!base_->read(off, buf, n)) return fail("Base image read failed");
+    sha.update(buf, n);
+  }
+  uint8_t digest[OTA_SHA_SIZE];
+  sha.final(digest);
+  if (memcmp(digest, hdr_ + 12, OTA_SHA_SIZE) != 0) return fail("Delta is for a different firmware");
+
+  state_ = OP;
+  return true;
+}
+
+bool DeltaDecoder::op() {
+  uint8_t code = hdr_[0];
+  if (code == OTA_DELTA_END) {
+    state_ = DONE;
+    return true;
+  }
+  if (code == OTA_DELTA_DATA) {
+    left_ = le32(hdr_ + 1);
+    state_ = left_ > 0 ? DATA : OP;
+    return true;
+  }
+  if (code != OTA_DELTA_COPY && code != OTA_DELTA_ADD) return fail("Bad delta op");
+
+  uint32_t offset = le32(hdr_ + 1), len = le32(hdr_ + 5);
+  if (offset > baseSize_ || len > baseSize_ - offset) return fail("Delta op outside the base image");
+  if (code == OTA_DELTA_COPY) return copyBase(offset, len);
+
+  offset_ = offset;
+  left_ = len;
+  state_ = left_ > 0 ? ADD : OP;
+  return true;
+}
+
+bool DeltaDecoder::copyBase(uint32_t offset, uint32_t len) {
+  uint8_t buf[256];
+  while (len > 0) {
+    uint32_t n = len < sizeof(buf) ? len : sizeof(buf);
+    if (!base_->read(offset, buf, n)) return fail("Base image read failed");
+    if (!out_->put(buf, n)) return fail("Output refused");
+    offset += n;
+    len -= n;
+  }
+  return true;
+}
+
+// ============== PIPELINE ==============
+
+void OtaPipeline::begin(ByteSink& image, BaseImage* base, const uint8_t* expectedSha) {
+  image_ = &image;
+  base_ = base;
+  hasExpected_ = expectedSha != nullptr;
+  if (hasExpected_) memcpy(expected_, expectedSha, OTA_SHA_SIZE);
+  outerSeen_ = innerSeen_ = 0;
+  gzip_ = delta_ = false;
+  inflater_.end();
+  payload_.owner = this;
+  hash_.reset();
+  memset(sha_, 0, sizeof(sha_));
+  received_ = imageSize_ = 0;
+  error_ = nullptr;
+}
+
+bool OtaPipeline::fail(const char* message) {
+  if (!error_) error_ = message;
+  return false;
+}
+
+const char* OtaPipeline::format() const {
+  if (gzip_ && delta_) return "gzip+delta";
+  if (gzip_) return "gzip";
+  if (delta_) return "delta";
+  return "bin";
+}
+
+bool OtaPipeline::write(const uint8_t* data, size_t len) {
+  if (error_) return false;
+  received_ += len;
+
+  if (outerSeen_ < sizeof(outerMagic_)) {
+    while (outerSeen_ < sizeof(outerMagic_) && len > 0) {
+      outerMagic_[outerSeen_++] = *data++;
+      len--;
+    }
+    if (outerSeen_ < sizeof(outerMagic_)) return true;
+    gzip_ = outerMagic_[0] == 0x1f && outerMagic_[1] == 0x8b;
+    if (gzip_ && !inflater_.begin()) return fail(inflater_.error());
+    if (!outer(outerMagic_, sizeof(outerMagic_))) return false;
+  }
+  return len == 0 || outer(data, len);
+}
+
+bool OtaPipeline::outer(const uint8_t* data, size_t len) {
+  if (!gzip_) return route(data, len);
+  // A refusal further down is the more useful message
+  return inflater_.write(data, len, payload_) || fail(inflater_.error());
+}
+
+bool OtaPipeline::route(const uint8_t* data, size_t len) {
+  if (innerSeen_ < sizeof(innerMagic_)) {
+    while (innerSeen_ < sizeof(innerMagic_) && len > 0) {
+      innerMagic_[innerSeen_++] = *data++;
+      len--;
+    }
+    if (innerSeen_ < sizeof(innerMagic_)) return true;
+
+    delta_ = memcmp(innerMagic_, OTA_DELTA_MAGIC, 4) == 0;
+    if (delta_) {
+      if (!base_) return fail("Delta updates need the running image");
+      deltaDecoder_.begin(base_, this);
+    } else if (!hasExpected_) {
+      return fail("SHA-256 of the image required");
+    }
+    if (!inner(innerMagic_, sizeof(innerMagic_))) return false;
+  }
+  return len == 0 || inner(data, len);
+}
+
+bool OtaPipeline::inner(const uint8_t* data, size_t len) {
+  if (!delta_) return put(data, len);
+  return deltaDecoder_.put(data, len) || fail(deltaDecoder_.error());
+}
+
+bool OtaPipeline::put(const uint8_t* data, size_t len) {
+  if (len == 0) return true;
+  if (imageSize_ == 0 && data[0] != OTA_IMAGE_MAGIC) return fail("Not an ESP32 image");
+  hash_.update(data, len);
+  imageSize_ += len;
+  return image_->put(data, len) || fail("Image write failed");
+}
+
+bool OtaPipeline::finish() {
+  if (error_) return false;
+  if (innerSeen_ < sizeof(innerMagic_)) return fail("Upload too short");
+  if (gzip_ && !inflater_.done()) return fail("gzip stream truncated");
+  if (delta_ && !deltaDecoder_.done()) return fail("Delta truncated");
+
+  hash_.final(sha_);
+  if (delta_) {
+    if (imageSize_ != deltaDecoder_.targetSize()) return fail("Image size does not match the delta");
+    if (memcmp(sha_, deltaDecoder_.targetSha(), OTA_SHA_SIZE) != 0) return fail("SHA-256 mismatch");
+  }
+  if (hasExpected_ && memcmp(sha_, expected_, OTA_SHA_SIZE) != 0) return fail("SHA-256 mismatch");
+  inflater_.end();
+  return true;
+}
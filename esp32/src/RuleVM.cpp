@@ -0,0 +1,434 @@
+#include "RuleVM.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool isCompare(uint8_t op) {
+  return op >= RULE_GT && op <= RULE_NE;
+}
+
+static bool isLetter(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// ============== COMPILER ==============
+
+bool RuleCompiler::compile(const char* text, RuleProgram& out) {
+  out_ = &out;
+  out.length = 0;
+  out.slots = 0;
+  out.stackDepth = 0;
+  text_ = pos_ = text;
+  error_ = nullptr;
+  errorAt_ = 0;
+  constant_ = false;
+
+  Val v;
+  next();
+  if (!parseOr(v)) return false;
+  if (type_ != T_END) return fail("Unexpected text");
+  if (!toBool(v)) return false;
+
+  out.stackDepth = maxDepth();
+  if (out.stackDepth > RULE_STACK) return fail("Expression too deep");
+  constant_ = v.isConst;
+  return true;
+}
+
+void RuleCompiler::next() {
+  while (*pos_ == ' ' || *pos_ == '\t') pos_++;
+  tokStart_ = pos_;
+  unitMs_ = 0;
+
+  char c = *pos_;
+  if (c == 0) {
+    type_ = T_END;
+  } else if (isDigit(c) || (c == '.' && isDigit(pos_[1]))) {
+    char* end;
+    number_ = strtof(pos_, &end);
+    pos_ = end;
+    type_ = T_NUM;
+
+    // Duration suffix: 500ms, 90s, 15m, 1h
+    const char* unit = pos_;
+    while (isLetter(*pos_)) pos_++;
+    size_t n = pos_ - unit;
+    if (n == 2 && strncmp(unit, "ms", 2) == 0) unitMs_ = 1;
+    else if (n == 1 && *unit == 's') unitMs_ = 1000;
+    else if (n == 1 && *unit == 'm') unitMs_ = 60000;
+    else if (n == 1 && *unit == 'h') unitMs_ = 3600000;
+    else if (n > 0) fail("Unknown unit");
+  } else if (isLetter(c)) {
+    while (isLetter(*pos_) || isDigit(*pos_)) pos_++;
+    type_ = T_IDENT;
+  } else if (c == '(' || c == ')' || c == ',') {
+    pos_++;
+    type_ = c == '(' ? T_LPAREN : (c == ')' ? T_RPAREN : T_COMMA);
+  } else {
+    static const char* const ops[] = {">=", "<=", "==", "!=", "&&", "||",
+                                      ">", "<", "!", "+", "-", "*", "/"};
+    type_ = T_END;
+    for (const char* op : ops) {
+      size_t n = strlen(op);
+      if (strncmp(pos_, op, n) == 0) {
+        pos_ += n;
+        type_ = T_OP;
+        break;
+      }
+    }
+    if (type_ != T_OP) fail("Unexpected character");
+  }
+  tokLen_ = pos_ - tokStart_;
+}
+
+bool RuleCompiler::accept(const char* word) {
+  if (type_ != T_IDENT && type_ != T_OP) return false;
+  if (strlen(word) != tokLen_ || strncmp(tokStart_, word, tokLen_) != 0) return false;
+  next();
+  return true;
+}
+
+// Keeps the first error; every parse step returns its result
+bool RuleCompiler::fail(const char* message) {
+  if (!error_) {
+    error_ = message;
+    errorAt_ = tokStart_ - text_;
+  }
+  return false;
+}
+
+bool RuleCompiler::parseOr(Val& v) {
+  if (!parseAnd(v)) return false;
+  while (accept("or") || accept("||")) {
+    Val r;
+    if (!toBool(v) || !parseAnd(r) || !toBool(r) || !logic(RULE_OR, v, r)) return false;
+  }
+  return !error_;
+}
+
+bool RuleCompiler::parseAnd(Val& v) {
+  if (!parseNot(v)) return false;
+  while (accept("and") || accept("&&")) {
+    Val r;
+    if (!toBool(v) || !parseNot(r) || !toBool(r) || !logic(RULE_AND, v, r)) return false;
+  }
+  return !error_;
+}
+
+bool RuleCompiler::parseNot(Val& v) {
+  if (!accept("not") && !accept("!")) return parseHold(v);
+
+  if (!parseNot(v) || !toBool(v)) return false;
+  if (v.isConst) return emitConst(v.start, v.value == 0, true, v);
+  return emit(RULE_NOT);
+}
+
+bool RuleCompiler::parseHold(Val& v) {
+  if (!parseCompare(v)) return false;
+  while (accept("for")) {
+    uint32_t ms;
+    if (!toBool(v) || !parseDuration(ms)) return false;
+    if (out_->slots >= RULE_MAX_SLOTS) return fail("Too many hyst/for modifiers");
+    if (!emit(RULE_HOLD, out_->slots++, 0, 0, ms)) return false;
+    v.isConst = false;
+  }
+  return !error_;
+}
+
+bool RuleCompiler::parseCompare(Val& v) {
+  if (!parseSum(v)) return false;
+  if (type_ != T_OP) return true;
+
+  static const char* const names[] = {">", ">=", "<", "<=", "==", "!="};
+  uint8_t op = 0;
+  for (uint8_t i = 0; i < 6; i++) {
+    if (strlen(names[i]) == tokLen_ && strncmp(tokStart_, names[i], tokLen_) == 0) op = RULE_GT + i;
+  }
+  if (!op) return true;
+  next();
+
+  Val r;
+  if (!parseSum(r)) return false;
+  if (!accept("hyst")) return binary(op, v, r);
+
+  if (type_ != T_NUM || unitMs_) return fail("hyst needs a number");
+  if (op == RULE_EQ || op == RULE_NE) return fail("hyst needs > >= < <=");
+  float band = number_;
+  next();
+
+  if (v.isConst && r.isConst) return binary(op, v, r);
+  if (out_->slots >= RULE_MAX_SLOTS) return fail("Too many hyst/for modifiers");
+  if (!emit(RULE_HYST, out_->slots++, op, 0, band)) return false;
+  v.isConst = false;
+  v.isBool = true;
+  return true;
+}
+
+bool RuleCompiler::parseSum(Val& v) {
+  if (!parseTerm(v)) return false;
+  while (type_ == T_OP && tokLen_ == 1 && (*tokStart_ == '+' || *tokStart_ == '-')) {
+    uint8_t op = *tokStart_ == '+' ? RULE_ADD : RULE_SUB;
+    next();
+    Val r;
+    if (!parseTerm(r) || !binary(op, v, r)) return false;
+  }
+  return !error_;
+}
+
+bool RuleCompiler::parseTerm(Val& v) {
+  if (!parseFactor(v)) return false;
+  while (type_ == T_OP && tokLen_ == 1 && (*tokStart_ == '*' || *tokStart_ == '/')) {
+    uint8_t op = *tokStart_ == '*' ? RULE_MUL : RULE_DIV;
+    next();
+    Val r;
+    if (!parseFactor(r) || !binary(op, v, r)) return false;
+  }
+  return !error_;
+}
+
+bool RuleCompiler::parseFactor(Val& v) {
+  if (error_) return false;
+  uint8_t start = out_->length;
+
+  if (type_ == T_NUM) {
+    if (unitMs_) return fail("Duration not allowed here");
+    float value = number_;
+    next();
+    return emitConst(start, value, false, v);
+  }
+
+  if (type_ == T_LPAREN) {
+    next();
+    if (!parseOr(v)) return false;
+    if (type_ != T_RPAREN) return fail("Expected )");
+    next();
+    return true;
+  }
+
+  if (type_ == T_OP && tokLen_ == 1 && *tokStart_ == '-') {
+    next();
+    if (!parseFactor(v)) return false;
+    if (v.isConst) return emitConst(v.start, -v.value, false, v);
+    v.isBool = false;
+    return emit(RULE_NEG);
+  }
+
+  if (type_ != T_IDENT) return fail("Expected a value");
+
+  if (accept("true")) return emitConst(start, 1, true, v);
+  if (accept("false")) return emitConst(start, 0, true, v);
+
+  const char* name = tokStart_;
+  uint8_t nameLen = tokLen_;
+  next();
+
+  v = {start, false, false, 0};
+
+  // stat(sensor, window)
+  if (type_ == T_LPAREN) {
+    int stat = symbols_.stat(name, nameLen);
+    if (stat < 1) return fail("Unknown stat");
+    next();
+
+    if (type_ != T_IDENT) return fail("Expected a sensor");
+    int sensor = symbols_.sensor(tokStart_, tokLen_);
+    if (sensor < 0) return fail("Unknown sensor");
+    next();
+
+    if (type_ != T_COMMA) return fail("Expected ,");
+    next();
+    uint32_t ms;
+    if (!parseDuration(ms)) return false;
+    int window = symbols_.window(ms / 1000);
+    if (window < 0) return fail("Window not configured (see statWindows)");
+
+    if (type_ != T_RPAREN) return fail("Expected )");
+    next();
+    return emit(RULE_READ, sensor, stat, window);
+  }
+
+  int sensor = symbols_.sensor(name, nameLen);
+  if (sensor < 0) {
+    tokStart_ = name;
+    return fail("Unknown sensor");
+  }
+  return emit(RULE_READ, sensor, 0, 0);
+}
+
+bool RuleCompiler::parseDuration(uint32_t& ms) {
+  if (type_ != T_NUM || number_ < 0) return fail("Expected a duration");
+  ms = (uint32_t)(number_ * (unitMs_ ? unitMs_ : 1000));
+  next();
+  return true;
+}
+
+bool RuleCompiler::emit(uint8_t op, uint8_t a, uint8_t b, uint8_t c, float f) {
+  if (out_->length >= RULE_MAX_CODE) return fail("Rule too long");
+  out_->code[out_->length++] = {op, a, b, c, f};
+  return true;
+}
+
+// Replace everything from start on with one constant
+bool RuleCompiler::emitConst(uint8_t start, float value, bool isBool, Val& v) {
+  out_->length = start;
+  v = {start, true, isBool, value};
+  return emit(RULE_CONST, 0, 0, 0, value);
+}
+
+bool RuleCompiler::toBool(Val& v) {
+  if (v.isBool) return true;
+  if (v.isConst) return emitConst(v.start, v.value == v.value && v.value != 0, true, v);
+  v.isBool = true;
+  return emit(RULE_TRUTHY);
+}
+
+bool RuleCompiler::binary(uint8_t op, Val& l, const Val& r) {
+  bool boolean = isCompare(op);
+  if (!l.isConst || !r.isConst) {
+    l.isConst = false;
+    l.isBool = boolean;
+    return emit(op);
+  }
+
+  float a = l.value, b = r.value, value = 0;
+  switch (op) {
+    case RULE_ADD: value = a + b; break;
+    case RULE_SUB: value = a - b; break;
+    case RULE_MUL: value = a * b; break;
+    case RULE_DIV: value = a / b; break;
+    default:       value = RuleVM::compare(op, a, b); break;
+  }
+  return emitConst(l.start, value, boolean, l);
+}
+
+// Operands are already 0/1; a constant side either decides the result or
+// drops out
+bool RuleCompiler::logic(uint8_t op, Val& l, const Val& r) {
+  float identity = op == RULE_AND ? 1 : 0;
+
+  if (l.isConst && r.isConst) {
+    bool value = op == RULE_AND ? (l.value && r.value) : (l.value || r.value);
+    return emitConst(l.start, value, true, l);
+  }
+  if (r.isConst) {
+    if (r.value == identity) {
+      out_->length = r.start;
+      return true;
+    }
+    return emitConst(l.start, r.value, true, l);
+  }
+  if (l.isConst) {
+    if (l.value != identity) return emitConst(l.start, l.value, true, l);
+    memmove(&out_->code[l.start], &out_->code[l.start + 1],
+            (out_->length - l.start - 1) * sizeof(RuleInstr));
+    out_->length--;
+    l = {l.start, false, true, 0};
+    return true;
+  }
+
+  l.isConst = false;
+  return emit(op);
+}
+
+uint8_t RuleCompiler::maxDepth() const {
+  int depth = 0, most = 0;
+  for (uint8_t i = 0; i < out_->length; i++) {
+    uint8_t op = out_->code[i].op;
+    if (op == RULE_CONST || op == RULE_READ) depth++;
+    else if (op != RULE_NEG && op != RULE_TRUTHY && op != RULE_NOT && op != RULE_HOLD) depth--;
+    if (depth > most) most = depth;
+  }
+  return most;
+}
+
+// ============== VM ==============
+
+float RuleVM::compare(uint8_t op, float a, float b) {
+  if (a != a || b != b) return 0;   // NAN never matches
+  switch (op) {
+    case RULE_GT: return a > b;
+    case RULE_GE: return a >= b;
+    case RULE_LT: return a < b;
+    case RULE_LE: return a <= b;
+    case RULE_EQ: return fabsf(a - b) < 0.01f;
+    case RULE_NE: return fabsf(a - b) >= 0.01f;
+  }
+  return 0;
+}
+
+uint8_t RuleVM::run(const RuleProgram& program, RuleState& state, uint32_t nowMs,
+                    RuleSymbols& symbols, bool& result) {
+  float stack[RULE_STACK];
+  uint8_t sp = 0;
+
+  for (uint8_t pc = 0; pc < program.length; pc++) {
+    const RuleInstr& in = program.code[pc];
+    switch (in.op) {
+      case RULE_CONST:
+        stack[sp++] = in.f;
+        break;
+      case RULE_READ:
+        stack[sp++] = symbols.read(in.a, in.b, in.c);
+        break;
+      case RULE_ADD: sp--; stack[sp - 1] += stack[sp]; break;
+      case RULE_SUB: sp--; stack[sp - 1] -= stack[sp]; break;
+      case RULE_MUL: sp--; stack[sp - 1] *= stack[sp]; break;
+      case RULE_DIV: sp--; stack[sp - 1] /= stack[sp]; break;
+      case RULE_NEG: stack[sp - 1] = -stack[sp - 1]; break;
+
+      case RULE_GT: case RULE_GE: case RULE_LT:
+      case RULE_LE: case RULE_EQ: case RULE_NE:
+        sp--;
+        stack[sp - 1] = compare(in.op, stack[sp - 1], stack[sp]);
+        break;
+
+      case RULE_HYST: {
+        sp--;
+        float value = stack[sp - 1];
+        float threshold = stack[sp];
+        uint8_t bit = 1 << in.a;
+        bool on = state.latched & bit;
+
+        // A missing reading keeps the latch where it is
+        if (value == value && threshold == threshold) {
+          if (!on) on = compare(in.b, value, threshold) != 0;
+          else if (in.b == RULE_GT || in.b == RULE_GE) on = value > threshold - in.f;
+          else on = value < threshold + in.f;
+        }
+        state.latched = on ? (state.latched | bit) : (state.latched & ~bit);
+        stack[sp - 1] = on;
+        break;
+      }
+
+      case RULE_TRUTHY: {
+        float v = stack[sp - 1];
+        stack[sp - 1] = v == v && v != 0;
+        break;
+      }
+      case RULE_NOT: stack[sp - 1] = stack[sp - 1] == 0; break;
+      case RULE_AND: sp--; stack[sp - 1] = stack[sp - 1] != 0 && stack[sp] != 0; break;
+      case RULE_OR:  sp--; stack[sp - 1] = stack[sp - 1] != 0 || stack[sp] != 0; break;
+
+      case RULE_HOLD: {
+        uint8_t bit = 1 << in.a;
+        if (stack[sp - 1] != 0) {
+          if (!(state.holding & bit)) {
+            state.holding |= bit;
+            state.since[in.a] = nowMs;
+          }
+          stack[sp - 1] = nowMs - state.since[in.a] >= in.f;
+        } else {
+          state.holding &= ~bit;
+        }
+        break;
+      }
+    }
+  }
+
+  result = sp > 0 && stack[sp - 1] != 0;
+  return program.length;
+}
@@ -0,0 +1,305 @@
+#include "SampleQueue.h"
+
+struct __attribute__((packed)) QueueHead {
+  uint32_t seg;
+  uint16_t idx;
+  uint16_t crc;
+};
+
+uint16_t SampleQueue::crc16(const uint8_t* data, size_t len, uint16_t crc) {
+  while (len--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static inline bool recordValid(const SampleRecord& r) {
+  return SampleQueue::crc16((const uint8_t*)&r, sizeof(r) - 2) == r.crc;
+}
+
+String SampleQueue::segmentPath(uint32_t seg) const {
+  char name[16];
+  snprintf(name, sizeof(name), "/%08lx.bin", (unsigned long)seg);
+  return dir_ + name;
+}
+
+uint16_t SampleQueue::segmentRecords(uint32_t seg) const {
+  if (seg == tailSeg_) return tailCount_;
+  File f = fs_->open(segmentPath(seg), FILE_READ);
+  if (!f) return 0;
+  size_t size = f.size();
+  f.close();
+  return size / sizeof(SampleRecord);
+}
+
+bool SampleQueue::begin(fs::FS& fs, const char* dir, uint16_t maxSegments) {
+  fs_ = &fs;
+  dir_ = dir;
+  maxSegments_ = maxSegments < 2 ? 2 : maxSegments;
+
+  if (!fs.exists(dir)) fs.mkdir(dir);
+  File root = fs.open(dir);
+  if (!root || !root.isDirectory()) return false;
+
+  // Find the segment range on flash
+  bool any = false;
+  uint32_t minSeg = 0, maxSeg = 0;
+  for (File f = root.openNextFile(); f; f = root.openNextFile()) {
+    String name = f.name();
+    name = name.substring(name.lastIndexOf('/') + 1);
+    f.close();
+    if (!name.endsWith(".bin")) continue;
+
+    uint32_t seg = strtoul(name.c_str(), nullptr, 16);
+    if (!any || seg < minSeg) minSeg = seg;
+    if (!any || seg > maxSeg) maxSeg = seg;
+    any = true;
+  }
+  root.close();
+
+  if (!any) {
+    headSeg_ = tailSeg_ = 1;
+    headIdx_ = tailCount_ = 0;
+    flashRecords_ = 0;
+    bootSeq_ = nextSeq_;
+    return true;
+  }
+
+  // Resume at the acknowledged position, if it is still on flash
+  headSeg_ = minSeg;
+  headIdx_ = 0;
+  File hf = fs.open(dir_ + "/head", FILE_READ);
+  if (hf) {
+    QueueHead head;
+    if (hf.read((uint8_t*)&head, sizeof(head)) == sizeof(head) &&
+        crc16((const uint8_t*)&head, sizeof(head) - 2) == head.crc &&
+        head.seg >= minSeg && head.seg <= maxSeg) {
+      headSeg_ = head.seg;
+      headIdx_ = head.idx;
+    }
+    hf.close();
+  }
+
+  // Segments below the head were acknowledged before a reset cut the cleanup
+  for (uint32_t seg = minSeg; seg < headSeg_; seg++) fs.remove(segmentPath(seg));
+
+  // A torn tail (partial record) is left behind; appends start a new segment
+  tailSeg_ = maxSeg;
+  File tf = fs.open(segmentPath(maxSeg), FILE_READ);
+  size_t tailSize = tf ? tf.size() : 0;
+  tailCount_ = tailSize / sizeof(SampleRecord);
+  // Sequence numbers continue from the last intact record, so records of
+  // earlier boots always sort below bootSeq()
+  for (uint16_t i = tailCount_; tf && i > 0; i--) {
+    SampleRecord last;
+    tf.seek((i - 1) * sizeof(SampleRecord));
+    if (tf.read((uint8_t*)&last, sizeof(last)) == sizeof(last) && recordValid(last)) {
+      nextSeq_ = last.seq + 1;
+      break;
+    }
+  }
+  if (tf) tf.close();
+  bootSeq_ = nextSeq_;
+
+  flashRecords_ = 0;
+  for (uint32_t seg = headSeg_; seg <= maxSeg; seg++) flashRecords_ += segmentRecords(seg);
+  flashRecords_ = flashRecords_ > headIdx_ ? flashRecords_ - headIdx_ : 0;
+
+  if (tailSize % sizeof(SampleRecord) != 0) {
+    tailSeg_++;
+    tailCount_ = 0;
+  }
+  return true;
+}
+
+void SampleQueue::push(SampleRecord record) {
+  record.seq = nextSeq_++;
+  record.crc = crc16((const uint8_t*)&record, sizeof(record) - 2);
+
+  // Flash unavailable and the stage is full: lose the oldest staged sample
+  if (staged_ == STAGE_RECORDS) {
+    memmove(stage_, stage_ + 1, (STAGE_RECORDS - 1) * sizeof(SampleRecord));
+    staged_--;
+    dropped++;
+  }
+
+  if (staged_ == 0) stagedSince_ = millis();
+  stage_[staged_++] = record;
+  enqueued++;
+  peekCount_ = 0;
+
+  if (staged_ == STAGE_RECORDS) flush();
+}
+
+void SampleQueue::flush() {
+  if (!fs_ || staged_ == 0) return;
+
+  uint8_t written = 0;
+  while (written < staged_) {
+    if (tailCount_ >= SEGMENT_RECORDS) {
+      tailSeg_++;
+      tailCount_ = 0;
+    }
+    if (tailSeg_ - headSeg_ + 1 > maxSegments_) dropOldestSegment();
+
+    size_t n = staged_ - written;
+    if (n > (size_t)(SEGMENT_RECORDS - tailCount_)) n = SEGMENT_RECORDS - tailCount_;
+
+    File f = fs_->open(segmentPath(tailSeg_), FILE_APPEND);
+    if (!f) break;
+    size_t bytes = f.write((const uint8_t*)&stage_[written], n * sizeof(SampleRecord));
+    f.close();
+    flashWrites++;
+
+    n = bytes / sizeof(SampleRecord);
+    if (n == 0) break;
+    tailCount_ += n;
+    flashRecords_ += n;
+    written += n;
+  }
+
+  memmove(stage_, stage_ + written, (staged_ - written) * sizeof(SampleRecord));
+  staged_ -= written;
+  peekCount_ = 0;
+
+  // Whatever flash refused is retried a full period later
+  if (staged_) stagedSince_ = millis();
+}
+
+void SampleQueue::setPushInterval(uint32_t ms) {
+  uint32_t span = ms * STAGE_SPAN;
+  maxStageMs_ = span > STAGE_MAX_MS ? span : STAGE_MAX_MS;
+}
+
+void SampleQueue::service() {
+  if (staged_ && millis() - stagedSince_ >= maxStageMs_) flush();
+}
+
+int32_t SampleQueue::msUntilFlush() const {
+  if (!fs_ || staged_ == 0) return -1;
+  uint32_t age = millis() - stagedSince_;
+  return age >= maxStageMs_ ? 0 : maxStageMs_ - age;
+}
+
+size_t SampleQueue::peek(SampleRecord* out, size_t max) {
+  if (max > MAX_BATCH) max = MAX_BATCH;
+  peekCount_ = 0;
+  scanRaw_ = 0;
+
+  // Nothing on flash: serve straight from the RAM stage
+  if (flashRecords_ == 0) {
+    peekFromStage_ = true;
+    size_t n = staged_ < max ? staged_ : max;
+    memcpy(out, stage_, n * sizeof(SampleRecord));
+    peekCount_ = n;
+    return n;
+  }
+
+  peekFromStage_ = false;
+  uint32_t seg = headSeg_;
+  uint16_t idx = headIdx_;
+  size_t n = 0;
+
+  while (n < max && seg <= tailSeg_) {
+    uint16_t count = segmentRecords(seg);
+    File f = idx < count ? fs_->open(segmentPath(seg), FILE_READ) : File();
+    if (f) {
+      f.seek(idx * sizeof(SampleRecord));
+      while (n < max && idx < count) {
+        SampleRecord r;
+        if (f.read((uint8_t*)&r, sizeof(r)) != sizeof(r)) break;
+        idx++;
+        scanRaw_++;
+        if (!recordValid(r)) {
+          corrupt++;
+          continue;
+        }
+        out[n] = r;
+        peekRaw_[n] = scanRaw_;
+        n++;
+      }
+      f.close();
+    }
+    if (n < max) {
+      seg++;
+      idx = 0;
+    }
+  }
+
+  peekCount_ = n;
+
+  // Only corrupt records ahead: step over them now
+  if (n == 0 && scanRaw_ > 0) {
+    advance(scanRaw_);
+    saveHead();
+  }
+  return n;
+}
+
+void SampleQueue::pop(size_t n) {
+  if (n == 0 || n > peekCount_) return;
+
+  if (peekFromStage_) {
+    memmove(stage_, stage_ + n, (staged_ - n) * sizeof(SampleRecord));
+    staged_ -= n;
+  } else {
+    advance(n == peekCount_ ? scanRaw_ : peekRaw_[n - 1]);
+    saveHead();
+  }
+
+  drained += n;
+  peekCount_ = 0;
+}
+
+// Move the head forward over raw flash slots, deleting emptied segments
+void SampleQueue::advance(uint32_t raw) {
+  while (raw > 0 || (headSeg_ < tailSeg_ && headIdx_ >= segmentRecords(headSeg_))) {
+    uint16_t count = segmentRecords(headSeg_);
+    uint16_t avail = count > headIdx_ ? count - headIdx_ : 0;
+    uint16_t take = raw < avail ? raw : avail;
+
+    headIdx_ += take;
+    raw -= take;
+    flashRecords_ -= take;
+
+    if (headIdx_ < count) break;
+    if (headSeg_ == tailSeg_) {
+      if (tailCount_ < SEGMENT_RECORDS) break;
+      tailSeg_++;
+      tailCount_ = 0;
+    }
+    fs_->remove(segmentPath(headSeg_));
+    headSeg_++;
+    headIdx_ = 0;
+  }
+}
+
+void SampleQueue::saveHead() {
+  QueueHead head;
+  head.seg = headSeg_;
+  head.idx = headIdx_;
+  head.crc = crc16((const uint8_t*)&head, sizeof(head) - 2);
+
+  String tmp = dir_ + "/head.tmp";
+  File f = fs_->open(tmp, FILE_WRITE);
+  if (!f) return;
+  f.write((const uint8_t*)&head, sizeof(head));
+  f.close();
+  fs_->rename(tmp, dir_ + "/head");
+}
+
+void SampleQueue::dropOldestSegment() {
+  uint16_t count = segmentRecords(headSeg_);
+  uint32_t lost = count > headIdx_ ? count - headIdx_ : 0;
+
+  fs_->remove(segmentPath(headSeg_));
+  dropped += lost;
+  flashRecords_ -= lost;
+  headSeg_++;
+  headIdx_ = 0;
+  peekCount_ = 0;
+  saveHead();
+}
@@ -0,0 +1,73 @@
+#include "SensorDrivers.h"
+
+// ============== DHT ==============
+
+bool DhtDriver::begin() {
+  dht_.begin();
+  return true;
+}
+
+bool DhtDriver::collect(float* values) {
+  values[0] = dht_.readTemperature();
+  values[1] = dht_.readHumidity();
+  return !isnan(values[0]) || !isnan(values[1]);
+}
+
+// ============== ANALOG ==============
+
+bool AnalogDriver::begin() {
+  pinMode(pin_, INPUT);
+  return true;
+}
+
+bool AnalogDriver::collect(float* values) {
+  values[0] = map(analogRead(pin_), 0, 4095, 0, 100);
+  return true;
+}
+
+// ============== DIGITAL ==============
+
+bool DigitalDriver::begin() {
+  pinMode(pin_, INPUT);
+  return true;
+}
+
+bool DigitalDriver::collect(float* values) {
+  values[0] = digitalRead(pin_) == HIGH ? 1 : 0;
+  return true;
+}
+
+// ============== DS18B20 (1-Wire) ==============
+
+bool OneWireDriver::begin() {
+  sensors_.begin();
+  sensors_.setWaitForConversion(false);
+
+  probes_ = 0;
+  uint8_t found = sensors_.getDeviceCount();
+  for (uint8_t i = 0; i < found && probes_ < ONEWIRE_MAX_PROBES; i++) {
+    if (sensors_.getAddress(addresses_[probes_], i)) probes_++;
+  }
+  return probes_ > 0;
+}
+
+// One conversion command covers every probe on the bus
+uint32_t OneWireDriver::start() {
+  if (probes_ == 0) return 0;
+  sensors_.requestTemperatures();
+  return sensors_.millisToWaitForConversion(sensors_.getResolution());
+}
+
+bool OneWireDriver::collect(float* values) {
+  bool any = false;
+  for (uint8_t i = 0; i < ONEWIRE_MAX_PROBES; i++) {
+    values[i] = NAN;
+    if (i >= probes_) continue;
+    float t = sensors_.getTempC(addresses_[i]);
+    if (t != DEVICE_DISCONNECTED_C) {
+      values[i] = t;
+      any = true;
+    }
+  }
+  return any;
+}
@@ -0,0 +1,97 @@
+#include "UpstreamClient.h"
+#include <lwip/sockets.h>
+
+static const char* LOCATION_HEADER[] = {"Location"};
+
+void UpstreamClient::begin(const char* url) {
+  url_ = url;
+  secure_ = url_.startsWith("https://");
+
+  // Same trust model as the previous per-request HTTPClient: encrypted but
+  // unauthenticated, which also lets a local TLS stand-in server be used
+  scriptTls_.setInsecure();
+  redirectTls_.setInsecure();
+
+  scriptHttp_.setReuse(true);
+  scriptHttp_.setTimeout(5000);
+  scriptHttp_.setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
+  redirectHttp_.setReuse(true);
+  redirectHttp_.setTimeout(5000);
+}
+
+int UpstreamClient::send(const char* body, size_t length, String& location) {
+  WiFiClient& client = scriptClient();
+  if (!client.connected()) handshakes++;
+
+  if (!scriptHttp_.begin(client, url_)) return -1;
+  scriptHttp_.addHeader("Content-Type", "application/x-www-form-urlencoded");
+  scriptHttp_.collectHeaders(LOCATION_HEADER, 1);
+
+  int code = scriptHttp_.POST((uint8_t*)body, length);
+  if (code == 301 || code == 302 || code == 303) location = scriptHttp_.header("Location");
+  scriptHttp_.end();  // keeps the socket when the server allows keep-alive
+  return code;
+}
+
+bool UpstreamClient::follow(const String& location) {
+  if (!redirectTls_.connected()) handshakes++;
+  redirects++;
+
+  if (!redirectHttp_.begin(redirectTls_, location)) return false;
+  int code = redirectHttp_.GET();
+  bool ok = code == 200 && redirectHttp_.getString().indexOf("\"success\":true") >= 0;
+  redirectHttp_.end();
+  return ok;
+}
+
+bool UpstreamClient::post(const char* body, size_t length) {
+  if (url_.length() == 0) return false;
+
+  uint32_t start = millis();
+  bool reused = scriptClient().connected();
+  String location;
+
+  int code = send(body, length, location);
+
+  // The server may have dropped an idle keep-alive socket; retry once fresh,
+  // but only if the request never went out. After the body was written
+  // the script may have run, and a resend would log the batch twice.
+  bool unsent = code == HTTPC_ERROR_CONNECTION_REFUSED || code == HTTPC_ERROR_SEND_HEADER_FAILED ||
+                code == HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+  if (unsent && reused) {
+    scriptClient().stop();
+    code = send(body, length, location);
+  }
+
+  bool ok;
+  if (location.length() > 0) {
+    // The script already ran; the redirect only fetches its result
+    ok = UPSTREAM_FOLLOW_REDIRECT ? follow(location) : true;
+  } else {
+    ok = code >= 200 && code < 300;
+  }
+
+  requests++;
+  if (!ok) failures++;
+
+  lastLatencyMs = millis() - start;
+  if (lastLatencyMs > maxLatencyMs) maxLatencyMs = lastLatencyMs;
+  avgLatencyMs = requests == 1 ? lastLatencyMs : avgLatencyMs * 0.9f + lastLatencyMs * 0.1f;
+
+  return ok;
+}
+
+void UpstreamClient::dropClosed() {
+  // WiFiClientSecure::connected() reads pending TLS records and stops the
+  // client itself on close_notify or EOF
+  if (secure_) scriptTls_.connected();
+  redirectTls_.connected();
+
+  // Between requests an idle socket has nothing to read unless the
+  // server closed it
+  int fd = scriptPlain_.fd();
+  if (!secure_ && fd >= 0) {
+    uint8_t b;
+    if (recv(fd, &b, 1, MSG_PEEK | MSG_DONTWAIT) >= 0 || errno != EWOULDBLOCK) scriptPlain_.stop();
+  }
+}
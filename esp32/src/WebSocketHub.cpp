@@ -0,0 +1,208 @@
+#include "WebSocketHub.h"
+#include <lwip/sockets.h>
+#include <errno.h>
+
+bool WebSocketHub::linked(uint8_t num) const {
+  return num < WEBSOCKETS_SERVER_CLIENT_MAX && _clients[num].status == WSC_CONNECTED &&
+         _clients[num].tcp;
+}
+
+bool WebSocketHub::queueTXT(uint8_t num, const String& payload, uint8_t kind, uint32_t key) {
+  if (!linked(num)) return false;
+  Outbox& o = out_[num];
+
+  // Replace a superseded frame that has not started sending
+  if (kind != WS_KIND_REPLY) {
+    for (uint8_t i = o.offset > 0 ? 1 : 0; i < o.count; i++) {
+      Frame& f = o.frames[i];
+      if (f.kind != kind || (f.key & ~key) != 0) continue;
+      o.bytes = o.bytes - f.payload.length() + payload.length();
+      f.payload = payload;
+      f.key = key;
+      o.stats.replaced++;
+      return true;
+    }
+  }
+
+  while (o.count >= WS_QUEUE_DEPTH || o.bytes + payload.length() > WS_QUEUE_BYTES) {
+    if (!evictOne(o)) {
+      o.stats.dropped++;
+      return false;
+    }
+  }
+
+  if (o.count == 0) o.lastProgress = millis();
+  Frame& f = o.frames[o.count++];
+  f.payload = payload;
+  f.kind = kind;
+  f.key = key;
+  f.opcode = 0x1;
+  o.bytes += payload.length();
+  if (o.count > o.stats.maxDepth) o.stats.maxDepth = o.count;
+  return true;
+}
+
+void WebSocketHub::broadcastQueued(const String& payload, uint8_t kind, uint32_t key) {
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (linked(num)) queueTXT(num, payload, kind, key);
+  }
+}
+
+// Oldest replaceable frame that is not being written
+bool WebSocketHub::evictOne(Outbox& o) {
+  for (uint8_t i = o.offset > 0 ? 1 : 0; i < o.count; i++) {
+    if (o.frames[i].kind == WS_KIND_REPLY) continue;
+    removeAt(o, i);
+    o.stats.dropped++;
+    return true;
+  }
+  return false;
+}
+
+void WebSocketHub::removeAt(Outbox& o, uint8_t i) {
+  o.bytes -= o.frames[i].payload.length();
+  for (uint8_t j = i; j + 1 < o.count; j++) {
+    o.frames[j] = std::move(o.frames[j + 1]);
+  }
+  o.count--;
+  o.frames[o.count].payload = String();
+}
+
+void WebSocketHub::forget(uint8_t num) {
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX) return;
+  Outbox& o = out_[num];
+  while (o.count > 0) removeAt(o, o.count - 1);
+  o.offset = 0;
+  o.stats = WsClientStats();
+}
+
+void WebSocketHub::loop() {
+  bool hold = false;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (out_[num].offset > 0 && linked(num) && !takeControl(num)) hold = true;
+  }
+  // A control frame still arriving would be read by the library, which
+  // answers it at once; wait for the rest (or the stall timeout)
+  if (!hold) WebSocketsServer::loop();
+}
+
+// Consumes the client's leading control frames; false if one is incomplete
+bool WebSocketHub::takeControl(uint8_t num) {
+  Outbox& o = out_[num];
+  int fd = _clients[num].tcp->fd();
+
+  while (true) {
+    // Client frames are masked: 2 header bytes, 4 mask bytes, <= 125 payload
+    uint8_t buf[2 + 4 + 125];
+    int n = recv(fd, buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT);
+    if (n < 2 || !(buf[0] & 0x08)) return true;  // nothing, or a data frame
+
+    uint8_t length = buf[1] & 0x7F;
+    bool masked = buf[1] & 0x80;
+    if (length > 125) return true;                // malformed, the library rejects it
+    int total = 2 + (masked ? 4 : 0) + length;
+    if (n < total) return false;
+    recv(fd, buf, total, MSG_DONTWAIT);
+
+    uint8_t opcode = buf[0] & 0x0F;
+    if (opcode == 0x8) {
+      // Close: drop the connection rather than interrupt the frame
+      Serial.printf("[WS] Client %u closed mid-frame\n", num);
+      forget(num);
+      _clients[num].tcp->stop();
+      return true;
+    }
+    if (opcode != 0x9) continue;                  // unsolicited pong
+
+    uint8_t* payload = buf + total - length;
+    for (uint8_t i = 0; masked && i < length; i++) payload[i] ^= buf[2 + (i & 3)];
+
+    // Pong right behind the partial frame; without room the ping goes unanswered
+    if (o.count >= WS_QUEUE_DEPTH && !evictOne(o)) continue;
+    for (uint8_t i = o.count; i > 1; i--) o.frames[i] = std::move(o.frames[i - 1]);
+    o.count++;
+    Frame& f = o.frames[1];
+    f.payload = String();
+    f.payload.concat((const char*)payload, length);
+    f.kind = WS_KIND_REPLY;
+    f.key = 0;
+    f.opcode = 0xA;
+    o.bytes += length;
+  }
+}
+
+void WebSocketHub::pump() {
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    Outbox& o = out_[num];
+    if (o.count == 0) continue;
+    if (!linked(num)) {
+      forget(num);
+      continue;
+    }
+    while (o.count > 0 && writeFront(num)) {}
+  }
+}
+
+// Returns true once frames[0] is fully written
+bool WebSocketHub::writeFront(uint8_t num) {
+  Outbox& o = out_[num];
+  Frame& f = o.frames[0];
+  size_t length = f.payload.length();
+
+  // Unmasked FIN frame; WS_QUEUE_BYTES keeps payloads below 64 KiB
+  if (o.offset == 0) {
+    o.header[0] = 0x80 | f.opcode;
+    if (length < 126) {
+      o.header[1] = length;
+      o.headerLen = 2;
+    } else {
+      o.header[1] = 126;
+      o.header[2] = length >> 8;
+      o.header[3] = length & 0xFF;
+      o.headerLen = 4;
+    }
+  }
+
+  int fd = _clients[num].tcp->fd();
+  size_t total = o.headerLen + length;
+  while (o.offset < total) {
+    const uint8_t* data;
+    size_t size;
+    if (o.offset < o.headerLen) {
+      data = o.header + o.offset;
+      size = o.headerLen - o.offset;
+    } else {
+      data = (const uint8_t*)f.payload.c_str() + (o.offset - o.headerLen);
+      size = total - o.offset;
+    }
+
+    int n = send(fd, data, size, MSG_DONTWAIT);
+    if (n > 0) {
+      o.offset += n;
+      o.lastProgress = millis();
+      continue;
+    }
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      o.stats.blocked++;
+      if (millis() - o.lastProgress > WS_STALL_TIMEOUT_MS) {
+        // Closed at the TCP level: a close frame would be written into the
+        // stalled socket, and in the middle of the partial frame
+        Serial.printf("[WS] Client %u stalled with %u frames queued, disconnecting\n", num, o.count);
+        forget(num);
+        _clients[num].tcp->stop();
+      }
+      return false;
+    }
+
+    // Socket error: the library notices on its next read and disconnects
+    forget(num);
+    return false;
+  }
+
+  o.offset = 0;
+  o.stats.sent++;
+  removeAt(o, 0);
+  o.lastProgress = millis();
+  return true;
+}
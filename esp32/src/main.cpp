@@ -17,6 +17,7 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
+#include <WiFiUdp.h>
 #include <WebServer.h>
 #include <WebSocketsServer.h>
 #include <ArduinoJson.h>
@@ -24,51 +25,181 @@
 #include <EEPROM.h>
 #include <DHT.h>
 #include <DNSServer.h>
+#include <driver/ledc.h>
+#include <esp_idf_version.h>
+#include <time.h>
+#include <sys/time.h>
+#include <esp_timer.h>
+#include <esp_sntp.h>
+#include <LittleFS.h>
+#include <soc/gpio_struct.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_pm.h>
+#include <fcntl.h>
+#include <lwip/sockets.h>
+#include "TimerWheel.h"
+#include "RollingStats.h"
+#include "SampleQueue.h"
+#include "UpstreamClient.h"
+#include "MqttLink.h"
+#include "SensorScheduler.h"
+#include "SensorDrivers.h"
+#include "LoopWatchdog.h"
+#include "LatencyHistogram.h"
+#include "WebSocketHub.h"
+#include "RuleVM.h"
+#include "Automation.h"
+#include "ConfigSchema.h"
+#include "BoardHal.h"
+#include "OtaPipeline.h"
+#include "HubMesh.h"
+#include "EventBus.h"
+#include "AdaptiveRate.h"
 
 // ============== EEPROM STRUCTURE ==============
 #define EEPROM_SIZE 2048
 #define EEPROM_MAGIC 0xA5B7  // Magic number to verify EEPROM initialized
-#define EEPROM_VERSION 1
-
-// EEPROM Addresses
-#define ADDR_MAGIC        0
-#define ADDR_VERSION      2
-#define ADDR_BOARD_TYPE   3
-#define ADDR_WIFI_SSID    10
-#define ADDR_WIFI_PASS    74
-#define ADDR_AP_SSID      138
-#define ADDR_AP_PASS      170
-#define ADDR_DEVICE_NAME  202
-#define ADDR_SCRIPT_URL   266
-#define ADDR_PIN_CONFIG   530
-#define ADDR_SENSOR_CFG   630
-#define ADDR_AUTOMATION   730
-
-// Board Types
-#define BOARD_ESP32_DEVKIT   0
-#define BOARD_LOLIN_S2_MINI  1
-#define BOARD_CUSTOM         2
-
-// ============== DEFAULT PIN CONFIGURATIONS ==============
-
-// ESP32 DevKit Default Pins
-const uint8_t DEVKIT_RELAY_PINS[4] = {26, 27, 14, 12};
-const uint8_t DEVKIT_LED_PIN = 25;
-const uint8_t DEVKIT_MOTOR_PIN = 33;
-const uint8_t DEVKIT_DHT_PIN = 32;
-const uint8_t DEVKIT_LIGHT_PIN = 34;
-const uint8_t DEVKIT_MOTION_PIN = 35;
-
-// Wemos Lolin S2 Mini Default Pins
-const uint8_t S2MINI_RELAY_PINS[4] = {5, 7, 9, 11};
-const uint8_t S2MINI_LED_PIN = 15;
-const uint8_t S2MINI_MOTOR_PIN = 16;
-const uint8_t S2MINI_DHT_PIN = 33;
-const uint8_t S2MINI_LIGHT_PIN = 1;
-const uint8_t S2MINI_MOTION_PIN = 3;
+#define EEPROM_VERSION 13
+
+// PWM (LEDC) channels
+#define LED_PWM_CHANNEL      0
+#define MOTOR_PWM_CHANNEL    1
+#define PWM_CHANNEL_COUNT    2
+#define MAX_TRANSITION_MS    30000
+#define PWM_FADE_SLICE_MS    200    // longest single hardware fade; a new target waits at most this long
+
+// Action scheduler
+#define TIMER_TICK_MS        100
+#define SCHEDULER_CAPACITY   64     // pending timers; 32 bytes of DRAM each
+#define DAILY_MARGIN_S       60     // a daily action due sooner than this after firing moves to the next day
+
+// Sensor channels
+#define SENSOR_TEMP          0
+#define SENSOR_HUM           1
+#define SENSOR_LIGHT         2
+#define SENSOR_MOTION        3
+#define SENSOR_COUNT         4    // primary channels (logged, per-sensor publish config)
+#define CHANNEL_AUX_DHT      4    // temp2, hum2
+#define CHANNEL_PROBE        6    // probe1..probe4 (DS18B20)
+#define CHANNEL_COUNT        (CHANNEL_PROBE + ONEWIRE_MAX_PROBES)
+
+// Acquisition drivers (scheduler slots)
+#define DRIVER_DHT           0
+#define DRIVER_LIGHT         1
+#define DRIVER_MOTION        2
+#define DRIVER_AUX_DHT       3
+#define DRIVER_ONEWIRE       4
+#define DRIVER_COUNT         5
+#define ADAPT_MIN_STEP       0.01f  // step of channels without a deadband (motion)
+
+// Outputs as event sources, relays first
+#define DEVICE_LED           RELAY_COUNT
+#define DEVICE_MOTOR         (RELAY_COUNT + 1)
+#define DEVICE_COUNT         (RELAY_COUNT + 2)
+
+// In-process event bus (EventBus.h)
+#define EVENT_BUS_SIZE       64     // power of two; many passes of readings and changes
+
+// Rolling statistics
+#define STAT_WINDOWS         3
+#define STAT_BUCKETS         12
+
+// Offline store-and-forward queue
+#define QUEUE_DIR            "/queue"
+#define QUEUE_MAX_SEGMENTS   64     // x 256 samples, oldest dropped beyond
+#define QUEUE_DRAIN_BATCH    48
+#define QUEUE_RETRY_MS       30000UL
+#define QUEUE_RETRY_MAX_MS   300000UL
+
+// Upstream logging
+#define UPSTREAM_BODY_SIZE   256
+#define UPSTREAM_BATCH_SIZE  2048
+
+// Local REST gateway (GET /api)
+#define HISTORY_SAMPLES      512    // newest logged samples kept in RAM, 16 bytes each
+#define API_CHUNK_SIZE       512    // response bytes buffered per HTTP chunk
+#define API_DEFAULT_LIMIT    100
+
+// Access point lifecycle
+#define AP_POLICY_ALWAYS     0    // soft-AP and captive DNS stay up
+#define AP_POLICY_AUTO       1    // dropped while the station link is up
+#define AP_BUTTON_PIN        0    // BOOT button, hold to reopen the portal
+#define AP_BUTTON_HOLD_MS    2000
+
+// Firmware updates (POST /ota)
+#define OTA_CONFIRM_MS       60000    // healthy uptime before a new image is kept
+#define OTA_TRIAL_MS         300000   // a new image not kept by then rolls back
+
+// Multi-hub mesh (protocol in HubMesh.h)
+#define MESH_RX_BATCH        8        // datagrams handled per loop pass
+#define MESH_PUSH_MS         250      // aggregator: min gap between "hubs" broadcasts
+
+// Power modes: between deadlines loop() waits on its sockets instead of spinning
+#define POWER_PERFORMANCE    0        // no waiting, radio always listening
+#define POWER_MODEM          1        // wait, WiFi modem sleep between beacons
+#define POWER_LIGHT          2        // wait, automatic light sleep (CONFIG_PM_ENABLE)
+#define POWER_MAX_IDLE_MS    250      // serial console and AP button are polled
+#define POWER_MIN_IDLE_MS    2        // shorter waits are not worth a select()
+#define POWER_MESH_IDLE_MS   100      // mesh announces, deltas and retries
+#define POWER_MQTT_IDLE_MS   1000     // MQTT keepalive and reconnects
+
+// Loop stages watched for stalls (LoopWatchdog)
+#define STAGE_WEBSOCKET      0
+#define STAGE_HTTP           1
+#define STAGE_DNS            2
+#define STAGE_SERIAL         3
+#define STAGE_OUTPUTS        4    // PWM fades and timers
+#define STAGE_SENSORS        5
+#define STAGE_AUTOMATION     6
+#define STAGE_WIFI           7
+#define STAGE_UPSTREAM       8
+#define STAGE_MQTT           9
+#define STAGE_LOGGING        10
+#define STAGE_OTA            11   // per upload chunk
+#define STAGE_MESH           12
+#define STAGE_COUNT          13
+
+// Serial console: text lines, or binary frames starting with FRAME_SYNC
+// [sync][type][len lo][len hi][payload...][crc lo][crc hi], CRC-16/CCITT
+// over type, length and payload
+#define SERIAL_LINE_SIZE     256
+#define FRAME_SYNC           0xA5
+#define FRAME_MAX_PAYLOAD    4096   // both ways; the host drops longer frames
+#define FRAME_TIMEOUT_MS     250
+#define FRAME_MIN_STREAM_MS  20
+
+#define FRAME_GET_CONFIG     0x01   // -> FRAME_CONFIG
+#define FRAME_SET_CONFIG     0x02   // JSON as for POST /config -> FRAME_ACK
+#define FRAME_GET_STATE      0x03   // -> FRAME_STATE
+#define FRAME_STREAM         0x04   // uint16 period ms (0 stops) -> FRAME_SAMPLE
+#define FRAME_ACK            0x80   // {"success":..,"message":..}
+#define FRAME_CONFIG         0x81   // config JSON
+#define FRAME_STATE          0x83   // state JSON
+#define FRAME_SAMPLE         0x84   // uint32 uptime ms + SampleRecord
 
 // ============== CONFIGURATION STRUCTURE ==============
 
+// Acquisition schedule for one sensor driver
+struct SensorTiming {
+  uint16_t period;          // ms between reads
+  uint16_t phase;           // ms offset of the first read
+};
+
+// Adaptive sampling bounds for one driver
+struct SensorAdaptive {
+  uint16_t floor;           // shortest period while readings move, ms
+  uint16_t ceiling;         // longest period while they are steady, ms
+};
+
+// Report-by-exception settings for one sensor channel
+struct SensorPublish {
+  float deadband;           // change needed before a reading is sent
+  uint16_t minInterval;     // ms, rate limit for changing readings
+  uint16_t maxSilence;      // s, heartbeat when nothing changes
+};
+
 struct Config {
   uint16_t magic;
   uint8_t version;
@@ -85,7 +216,7 @@ struct Config {
   char scriptURL[256];
   
   // Pin Configuration
-  uint8_t relayPins[4];
+  uint8_t relayPins[RELAY_COUNT];
   uint8_t ledPin;
   uint8_t motorPin;
   uint8_t dhtPin;
@@ -97,7 +228,7 @@ struct Config {
   bool enableDHT;
   bool enableLight;
   bool enableMotion;
-  bool enableRelays[4];
+  bool enableRelays[RELAY_COUNT];
   bool enableLED;
   bool enableMotor;
   bool enableLogging;
@@ -105,51 +236,414 @@ struct Config {
   // Intervals (in seconds)
   uint16_t sensorInterval;
   uint16_t logInterval;
+  
+  // PWM output (v2)
+  uint32_t pwmFrequency;    // Hz
+  uint8_t pwmResolution;    // duty bits
+  uint16_t fadeTime;        // default transition in ms
+  
+  // Time (v3)
+  char ntpServer[64];
+  char timezone[48];        // POSIX TZ string, e.g. "WIB-7"
+  
+  // Report-by-exception (v4)
+  SensorPublish sensorPublish[SENSOR_COUNT];
+  uint16_t logHeartbeat;    // s, log even without changes after this long
+  
+  // Rolling statistics (v5)
+  uint16_t statWindows[STAT_WINDOWS];  // s
+  
+  // MQTT client mode (v6)
+  bool mqttEnabled;
+  char mqttHost[64];
+  uint16_t mqttPort;
+  char mqttUser[32];
+  char mqttPassword[32];
+  char mqttPrefix[32];      // topics are <prefix>/<device>/...
+  uint8_t mqttQos;
+  
+  // Access point lifecycle (v7)
+  uint8_t apPolicy;         // AP_POLICY_*
+  uint16_t apGrace;         // s of station uptime (or after a manual reopen) before the AP goes down
+  uint16_t apRestore;       // s of station outage before the AP comes back
+  
+  // Acquisition scheduler (v8), indexed by DRIVER_*
+  SensorTiming sensorTiming[DRIVER_COUNT];
+  bool enableAuxDHT;
+  uint8_t auxDhtPin;
+  bool enableOneWire;
+  uint8_t oneWirePin;
+  
+  // Stall watchdog (v9)
+  uint16_t watchdogPanic;   // s a stuck loop may hang before a reset, 0 = off
+  
+  // WebSocket fan-out (v10)
+  uint8_t wsMaxClients;     // <= WEBSOCKETS_SERVER_CLIENT_MAX (build flag)
+  
+  // Multi-hub mesh (v11)
+  uint8_t meshMode;         // MESH_OFF, MESH_PEER, MESH_AGGREGATOR
+  
+  // Power (v12)
+  uint8_t powerMode;        // POWER_*
+  
+  // Adaptive sampling (v13), indexed by DRIVER_*
+  bool adaptiveSampling;
+  SensorAdaptive sensorAdaptive[DRIVER_COUNT];
+};
+
+// The struct is the EEPROM layout: EEPROM.get/put(0, config)
+static_assert(sizeof(Config) <= EEPROM_SIZE, "Config does not fit the EEPROM area");
+
+// Scalar fields: JSON keys, limits, defaults and the layout version that
+// added each one. Order is the printConfig order.
+constexpr ConfigField CONFIG_FIELDS[] = {
+  CONFIG_NUM (Config, "Device", "boardType",  boardType,  1, BOARD_ESP32_DEVKIT, 0, BOARD_CUSTOM),
+  CONFIG_STR (Config, "Device", "deviceName", deviceName, 1, "ESP32 IoT Hub", 0),
+  
+  CONFIG_STR (Config, "WiFi", "wifiSSID",     wifiSSID,     1, "", 0),
+  CONFIG_STR (Config, "WiFi", "wifiPassword", wifiPassword, 1, "", CFG_SECRET),
+  CONFIG_STR (Config, "WiFi", "apSSID",       apSSID,       1, "ESP32_IoT_Hub", 0),
+  CONFIG_STR (Config, "WiFi", "apPassword",   apPassword,   1, "iot12345", CFG_SECRET),
+  CONFIG_NUM (Config, "WiFi", "apPolicy",     apPolicy,     7, AP_POLICY_AUTO, AP_POLICY_ALWAYS, AP_POLICY_AUTO),
+  CONFIG_NUM (Config, "WiFi", "apGrace",      apGrace,      7, 120, 0, 65535),
+  CONFIG_NUM (Config, "WiFi", "apRestore",    apRestore,    7, 60, 0, 65535),
+  
+  CONFIG_PIN (Config, "Pins", "relay1",     "relay1",  relayPins[0], 1, DEVKIT_RELAY_PINS[0]),
+  CONFIG_PIN (Config, "Pins", "relay2",     "relay2",  relayPins[1], 1, DEVKIT_RELAY_PINS[1]),
+  CONFIG_PIN (Config, "Pins", "relay3",     "relay3",  relayPins[2], 1, DEVKIT_RELAY_PINS[2]),
+  CONFIG_PIN (Config, "Pins", "relay4",     "relay4",  relayPins[3], 1, DEVKIT_RELAY_PINS[3]),
+  CONFIG_PIN (Config, "Pins", "ledPin",     "led",     ledPin,       1, DEVKIT_LED_PIN),
+  CONFIG_PIN (Config, "Pins", "motorPin",   "motor",   motorPin,     1, DEVKIT_MOTOR_PIN),
+  CONFIG_PIN (Config, "Pins", "dhtPin",     "dht",     dhtPin,       1, DEVKIT_DHT_PIN),
+  CONFIG_NUM (Config, "Pins", "dhtType",               dhtType,      1, DHT22, DHT11, DHT22),
+  CONFIG_PIN (Config, "Pins", "lightPin",   "light",   lightPin,     1, DEVKIT_LIGHT_PIN),
+  CONFIG_PIN (Config, "Pins", "motionPin",  "motion",  motionPin,    1, DEVKIT_MOTION_PIN),
+  CONFIG_PIN (Config, "Pins", "auxDhtPin",  "dht2",    auxDhtPin,    8, 4),
+  CONFIG_PIN (Config, "Pins", "oneWirePin", "onewire", oneWirePin,   8, 13),
+  
+  CONFIG_BOOL(Config, "Features", "enableDHT",     enableDHT,       1, true),
+  CONFIG_BOOL(Config, "Features", "enableLight",   enableLight,     1, true),
+  CONFIG_BOOL(Config, "Features", "enableMotion",  enableMotion,    1, true),
+  CONFIG_BOOL(Config, "Features", "enableAuxDHT",  enableAuxDHT,    8, false),
+  CONFIG_BOOL(Config, "Features", "enableOneWire", enableOneWire,   8, false),
+  CONFIG_BOOL(Config, "Features", "enableRelay1",  enableRelays[0], 1, true),
+  CONFIG_BOOL(Config, "Features", "enableRelay2",  enableRelays[1], 1, true),
+  CONFIG_BOOL(Config, "Features", "enableRelay3",  enableRelays[2], 1, true),
+  CONFIG_BOOL(Config, "Features", "enableRelay4",  enableRelays[3], 1, true),
+  CONFIG_BOOL(Config, "Features", "enableLED",     enableLED,       1, true),
+  CONFIG_BOOL(Config, "Features", "enableMotor",   enableMotor,     1, true),
+  
+  CONFIG_NUM (Config, "PWM", "pwmFrequency",  pwmFrequency,  2, 5000, 1, 40000000),
+  CONFIG_NUM (Config, "PWM", "pwmResolution", pwmResolution, 2, 10, 1, 14),
+  CONFIG_NUM (Config, "PWM", "fadeTime",      fadeTime,      2, 500, 0, MAX_TRANSITION_MS),
+  
+  CONFIG_NUM (Config, "Intervals", "sensorInterval", sensorInterval, 1, 2, 1, 3600),
+  CONFIG_NUM (Config, "Intervals", "logInterval",    logInterval,    1, 60, 1, 65535),
+  CONFIG_NUM (Config, "Intervals", "logHeartbeat",   logHeartbeat,   4, 900, 1, 65535),
+  CONFIG_BOOL(Config, "Intervals", "adaptiveSampling", adaptiveSampling, 13, false),
+  
+  CONFIG_BOOL(Config, "Logging", "enableLogging", enableLogging, 1, false),
+  CONFIG_STR (Config, "Logging", "scriptURL",     scriptURL,     1, "", 0),
+  
+  CONFIG_STR (Config, "Time", "ntpServer", ntpServer, 3, "pool.ntp.org", 0),
+  CONFIG_STR (Config, "Time", "timezone",  timezone,  3, "UTC0", 0),
+  
+  CONFIG_BOOL(Config, "MQTT", "mqttEnabled",  mqttEnabled,  6, false),
+  CONFIG_STR (Config, "MQTT", "mqttHost",     mqttHost,     6, "", 0),
+  CONFIG_NUM (Config, "MQTT", "mqttPort",     mqttPort,     6, 1883, 1, 65535),
+  CONFIG_STR (Config, "MQTT", "mqttUser",     mqttUser,     6, "", 0),
+  CONFIG_STR (Config, "MQTT", "mqttPassword", mqttPassword, 6, "", CFG_SECRET),
+  CONFIG_STR (Config, "MQTT", "mqttPrefix",   mqttPrefix,   6, "iothub", 0),
+  CONFIG_NUM (Config, "MQTT", "mqttQos",      mqttQos,      6, 0, 0, 2),
+  
+  CONFIG_NUM (Config, "Watchdog",  "watchdogPanic", watchdogPanic, 9, 0, 0, 60),
+  CONFIG_NUM (Config, "WebSocket", "wsMaxClients",  wsMaxClients, 10,
+              WEBSOCKETS_SERVER_CLIENT_MAX, 1, WEBSOCKETS_SERVER_CLIENT_MAX),
+  CONFIG_NUM (Config, "Mesh",      "meshMode",      meshMode,     11, MESH_OFF, MESH_OFF, MESH_AGGREGATOR),
+  CONFIG_NUM (Config, "Power",     "powerMode",     powerMode,    12,
+              POWER_PERFORMANCE, POWER_PERFORMANCE, POWER_LIGHT),
 };
 
+constexpr auto configSchema = makeConfigSchema<Config>(CONFIG_FIELDS);
+
 Config config;
 
 // ============== GLOBAL VARIABLES ==============
 
 WebServer webServer(80);
-WebSocketsServer webSocket(81);
+WebSocketHub webSocket(81);
 DNSServer dnsServer;
-DHT* dhtSensor = nullptr;
 
 // Device states
-bool relayStates[4] = {false, false, false, false};
+bool relayStates[RELAY_COUNT] = {};
+RelayBank relays;
 bool ledState = false;
 bool motorState = false;
 int ledBrightness = 100;
 int motorSpeed = 50;
 
+// Hardware fade tracking (the LEDC fade engine runs one fade per channel).
+// A transition runs as slices of at most PWM_FADE_SLICE_MS; the rest of
+// the ramp is the pending target.
+struct PwmFade {
+  unsigned long endTime;      // end of the running slice
+  bool pending;
+  uint32_t pendingDuty;
+  int pendingTime;
+};
+
+PwmFade pwmFades[PWM_CHANNEL_COUNT];
+bool fadeEngineReady = false;
+
 // Sensor values
 float temperature = 0;
 float humidity = 0;
 int lightLevel = 0;
 bool motionDetected = false;
 
+// Sensor channel table: SENSOR_* first, then channels of bus/extra sensors
+struct SensorChannel {
+  const char* id;
+  const char* type;
+  const char* unit;
+  uint8_t publishAs;        // SENSOR_* whose publish settings apply
+  bool active;
+  float value;
+  uint64_t readUs;          // monoUs() of the read behind value
+  uint64_t sentUs;          // monoUs() of the last frame queued with it
+  float lastSent;
+  unsigned long lastSentAt;
+  bool published;
+  float lastLogged;
+};
+
+SensorChannel sensorChannels[CHANNEL_COUNT] = {
+  {"temp1",   "temperature", "°C", SENSOR_TEMP},
+  {"hum1",    "humidity",    "%",  SENSOR_HUM},
+  {"light1",  "light",       "%",  SENSOR_LIGHT},
+  {"motion1", "motion",      "",   SENSOR_MOTION},
+  {"temp2",   "temperature", "°C", SENSOR_TEMP},
+  {"hum2",    "humidity",    "%",  SENSOR_HUM},
+  {"probe1",  "temperature", "°C", SENSOR_TEMP},
+  {"probe2",  "temperature", "°C", SENSOR_TEMP},
+  {"probe3",  "temperature", "°C", SENSOR_TEMP},
+  {"probe4",  "temperature", "°C", SENSOR_TEMP},
+};
+
+RollingWindow<STAT_BUCKETS> sensorStats[CHANNEL_COUNT][STAT_WINDOWS];
+
+// Acquisition: one driver per slot, first channel it fills
+const char* const DRIVER_NAMES[DRIVER_COUNT] = {"dht", "light", "motion", "dht2", "onewire"};
+const uint8_t DRIVER_CHANNEL[DRIVER_COUNT] = {SENSOR_TEMP, SENSOR_LIGHT, SENSOR_MOTION, CHANNEL_AUX_DHT, CHANNEL_PROBE};
+
+static uint32_t microsClock() { return micros(); }
+
+SensorScheduler<DRIVER_COUNT> sensorScheduler(microsClock);
+SensorDriver* sensorDrivers[DRIVER_COUNT];
+int8_t driverTask[DRIVER_COUNT];          // scheduler task, -1 = not running
+
+// Adaptive sampling: one rate per driver, fed by the readings on the bus
+AdaptiveRate sensorRates[DRIVER_COUNT];
+float rateLast[CHANNEL_COUNT];            // previous reading per channel, NAN = none yet
+
+// Publish counters (per sensor reading)
+uint32_t readingsSent = 0;
+uint32_t readingsSuppressed = 0;
+uint32_t framesSuppressed = 0;
+uint32_t logsSent = 0;
+uint32_t logsSuppressed = 0;
+uint32_t samplesUnplaced = 0;       // queued without a clock by an earlier boot, not uploaded
+unsigned long lastLogSent = 0;
+uint8_t lastLoggedRelays = 0;
+
+// Latency tracing (monoUs() timestamps)
+LatencyHistogram commandLatency;    // command received -> output written
+LatencyHistogram sensorLatency;     // read completed -> frame queued to clients
+uint64_t commandRecvUs = 0;
+uint64_t outputWrittenUs = 0;
+uint32_t sensorTrace = 0;
+uint32_t timeSyncs = 0;
+unsigned long lastTimeSync = 0;
+
+// Upstream logging
+UpstreamClient upstream;
+SampleQueue sampleQueue;
+bool queueReady = false;
+unsigned long lastDrainAttempt = 0;
+unsigned long drainBackoff = 0;
+
+// Logged samples served by /api; the upstream queue only replicates them
+SampleRecord history[HISTORY_SAMPLES];
+uint16_t historyHead = 0;            // slot of the next sample
+uint16_t historyCount = 0;
+
+// MQTT fan-out
+MqttLink mqtt;
+
+// Sensor readings and output changes; every consumer reads at its own cursor
+EventBus<EVENT_BUS_SIZE> events;
+EventCursor wsFeed;                 // readings -> WebSocket frames, MQTT and mesh sensors
+EventCursor ruleFeed;               // changes of the sensors the rules read
+EventCursor logFeed;                // primary readings -> change-triggered logging
+EventCursor mqttFeed;               // device changes -> retained state topics
+EventCursor meshFeed;               // device changes -> mesh state table
+EventCursor rateFeed;               // readings -> adaptive sampling rates
+bool logChanged = false;            // a logged reading left its deadband since the last log
+const char* const DEVICE_IDS[DEVICE_COUNT] = {"relay1", "relay2", "relay3", "relay4", "led1", "motor1"};
+
+// Stall watchdog: stage names and budgets (ms) indexed by STAGE_*
+LoopWatchdog watchdog;
+const char* const STAGE_NAMES[STAGE_COUNT] = {
+  "websocket", "http", "dns", "serial", "outputs", "sensors",
+  "automation", "wifi", "upstream", "mqtt", "logging", "ota", "mesh"
+};
+const uint16_t STAGE_BUDGET_MS[STAGE_COUNT] = {
+  100, 250, 50, 50, 20, 100,
+  50, 100, 5000, 3000, 5000, 2000, 50
+};
+
+// Serial console
+char serialLine[SERIAL_LINE_SIZE];
+uint16_t serialLineLen = 0;
+bool serialLineOverflow = false;
+uint8_t frameBuf[FRAME_MAX_PAYLOAD + 5];   // type, length, payload, crc
+uint16_t frameLen = 0;
+bool inFrame = false;
+unsigned long frameStart = 0;
+uint16_t streamPeriod = 0;
+unsigned long lastStreamed = 0;
+uint32_t streamSeq = 0;
+uint32_t framesIn = 0;
+uint32_t framesOut = 0;
+uint32_t frameErrors = 0;
+
+// Access point lifecycle and loop timing per radio mode
+struct LoopStats {
+  uint32_t loops;
+  uint64_t busyUs;          // time inside loop()
+  uint64_t wallUs;          // time between loop() starts
+  uint32_t maxUs;
+};
+
+bool stationUp = false;
+unsigned long stationChangedAt = 0;
+unsigned long apHoldUntil = 0;
+bool apButtonEnabled = false;
+bool apButtonHandled = false;
+unsigned long apButtonDownAt = 0;
+uint32_t apTransitions = 0;
+LoopStats loopStats[2];     // [0] AP off, [1] AP on
+unsigned long lastLoopStart = 0;
+
 // System state
 bool wifiConnected = false;
 bool apMode = true;
 bool configMode = false;
-unsigned long lastSensorRead = 0;
+unsigned long lastAutomationRun = 0;
 unsigned long lastDataLog = 0;
 unsigned long lastHeartbeat = 0;
 
-// Automation rules
-struct AutomationRule {
-  bool enabled;
-  char triggerDevice[32];
-  char condition[8];
-  float triggerValue;
-  char actionDevice[32];
-  bool actionState;
-  int actionValue;
+// Channel, stat and window names for the rule compiler and VM
+class HubSymbols : public RuleSymbols {
+ public:
+  int sensor(const char* name, uint8_t length) override;
+  int stat(const char* name, uint8_t length) override;
+  int window(uint32_t seconds) override;
+  float read(uint8_t sensor, uint8_t stat, uint8_t window) override;
+};
+
+// Rule actions drive the outputs
+class DeviceSink : public ActionSink {
+ public:
+  void ruleAction(uint8_t rule, const RuleAction& action, uint32_t nowMs) override;
+};
+
+HubSymbols ruleSymbols;
+DeviceSink ruleOutputs;
+Automation automation(ruleSymbols);
+
+// Firmware update: decoded image -> inactive partition (Update library)
+class UpdateSink : public ByteSink {
+ public:
+  bool put(const uint8_t* data, size_t len) override {
+    return Update.write((uint8_t*)data, len) == len;
+  }
+};
+
+// The running app partition, base of delta updates
+class RunningImage : public BaseImage {
+ public:
+  const esp_partition_t* part = nullptr;
+  uint32_t size() const override { return part ? part->size : 0; }
+  bool read(uint32_t offset, uint8_t* buf, size_t len) override {
+    return part && esp_partition_read(part, offset, buf, len) == ESP_OK;
+  }
+};
+
+OtaPipeline ota;
+UpdateSink otaImage;
+RunningImage otaBase;
+bool otaActive = false;             // upload in progress
+bool otaInstalled = false;          // last upload is set to boot
+bool otaTrial = false;              // this image was just installed, not yet kept
+const char* otaError = nullptr;     // why the last upload failed
+unsigned long otaStarted = 0;
+unsigned long otaMs = 0;
+
+// Multi-hub mesh over UDP multicast; one socket takes the group and
+// unicast replies, so MESH_PORT is the advertised port
+class MeshUdp : public MeshTransport {
+ public:
+  WiFiUDP udp;
+  void send(const MeshAddr& to, const uint8_t* data, size_t len) override {
+    if (to.ip) udp.beginPacket(IPAddress(to.ip), to.port);
+    else udp.beginMulticastPacket();
+    udp.write(data, len);
+    udp.endPacket();
+  }
+};
+
+class MeshEvents : public MeshHandler {
+ public:
+  bool meshCommand(const char* device, bool state, int16_t value) override;
+  void meshChanged(uint8_t hub) override;
+  void meshCommandDone(uint8_t hub, const char* device, bool ok) override;
 };
 
-AutomationRule rules[10];
-int ruleCount = 0;
+HubMesh mesh;
+MeshUdp meshUdp;
+MeshEvents meshEvents;
+bool meshJoined = false;            // group joined on the current station link
+bool meshDirty = false;             // aggregator: hubs changed since the last broadcast
+unsigned long lastMeshPush = 0;
+
+// Power: time spent waiting between deadlines and what ended each wait
+struct PowerStats {
+  uint32_t waits;
+  uint32_t busy;            // passes that left work for the next one
+  uint32_t wakeNetwork;     // a socket became readable
+  uint32_t wakeDeadline;    // the next deadline came up
+  uint64_t idleUs;
+  uint64_t sinceUs;         // monoUs() when counting started
+  uint32_t readsAtStart;
+};
+
+const char* const POWER_NAMES[] = {"performance", "modem", "light"};
+PowerStats power;
+bool lightSleep = false;            // automatic light sleep is configured
+
+// Scheduled actions
+struct ScheduledAction {
+  char deviceId[12];
+  bool state;
+  int16_t value;
+  int16_t transition;
+  int16_t dailyMinute;      // minute of day for daily rules, -1 = one-shot
+};
+
+TimerWheel<ScheduledAction, SCHEDULER_CAPACITY> timers;
+uint32_t timerTicks = 0;
+unsigned long lastTimerTick = 0;
 
 // ============== FUNCTION DECLARATIONS ==============
 
@@ -157,21 +651,103 @@ void loadConfig();
 void saveConfig();
 void resetConfig();
 void applyBoardDefaults();
+const char* boardName(uint8_t type);
+void upgradeConfig(uint8_t fromVersion);
 void setupWiFi();
 void setupPins();
+uint8_t loadRelayBank();
+void setRelays(uint8_t select, uint8_t states);
+void runRelayBench(uint32_t rounds);
 void setupWebSocket();
 void setupWebServer();
+bool nestedNum(JsonVariantConst v, uint16_t& out, long lo, long hi);
+const char* applyConfigJSON(JsonDocument& doc);
 void setupDNS();
-void readSensors();
+void serviceAccessPoint();
+void startAccessPoint(const char* reason);
+void stopAccessPoint(const char* reason);
+void openPortal(const char* reason);
+void recordLoopTime(unsigned long startUs);
+void stallJson(JsonObject out, const StallRecord& record);
+uint32_t pwmMaxDuty();
+void writePWM(uint8_t channel, uint32_t duty, int transitionMs);
+void servicePwmFades();
+void setupTime();
+bool timeSynced();
+uint64_t monoUs();
+uint64_t wallMs();
+void onTimeSync(struct timeval* tv);
+void histogramJson(JsonObject out, const LatencyHistogram& h);
+long secondsUntil(int minuteOfDay);
+uint32_t scheduleAction(const char* deviceId, bool state, int value, int transitionMs,
+                        uint32_t delayMs, int dailyMinute = -1);
+void processTimers();
+void setupSensors();
+void serviceSensors();
+int driverIndex(const char* name);
+void setSensorTiming(uint8_t driver, uint16_t period, uint16_t phase);
+uint32_t sensorPeriod(uint8_t driver);
+void restartRates();
+void adaptSampling();
 void sendSensorData();
+bool sensorEnabled(uint8_t idx);
+float sensorValue(uint8_t idx);
+int sensorIndex(const String& id);
+bool loggingDue();
+void setupStats();
+void updateSensorStats(uint8_t first, uint8_t count);
+float statValue(uint8_t sensor, uint8_t window, uint8_t stat);
+int statWindowIndex(uint32_t seconds);
+uint32_t parseDuration(const char* text);
+String windowLabel(uint16_t seconds);
+String getMetricsJSON();
 void processAutomation();
 void logToGoogleSheets();
+void setupQueue();
+SampleRecord captureSample();
+bool uploadSample(const SampleRecord& sample);
+size_t encodeSample(char* buf, size_t size, const SampleRecord& sample);
+size_t encodeBatch(char* buf, size_t size, const SampleRecord* samples, size_t count, size_t& encoded);
+void drainQueue();
+void recordHistory(const SampleRecord& sample);
+void handleApi();
+void setupMqtt();
+void mqttCommand(const char* id, const char* payload, size_t length);
+void mqttPublishSensor(uint8_t idx);
+void mqttPublishState(const String& deviceId);
+void mqttPublishChanges();
+void setupEvents();
+void publishDevice(uint8_t device, bool state, float level, bool changed);
+void trackLoggedChanges();
+void restartDevice();
+void startMesh();
+void serviceMesh();
+void setupPower();
+uint32_t nextDeadlineMs();
+bool powerBusy();
+void idleUntilDeadline();
+uint32_t sensorReads();
+String getHubsJSON();
+void setupOta();
+void serviceOta();
+void handleOtaUpload();
+void otaFailed(const char* message);
+String otaStatusJSON();
+bool otaRollback();
 void handleSerial();
+bool setField(Config& target, const char* key, const char* value);
+void runSerialCommand(String cmd);
+void feedFrame(uint8_t c);
+void handleFrame(uint8_t type, const uint8_t* payload, uint16_t length);
+bool sendFrame(uint8_t type, const uint8_t* payload, size_t length);
+void sendFrameAck(bool success, const char* message);
+void streamSamples();
 void printHelp();
 void printConfig();
 void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length);
 void handleCommand(uint8_t num, JsonDocument& doc);
-void setDeviceState(String deviceId, bool state, int value = -1);
+void setDeviceState(String deviceId, bool state, int value = -1, int transitionMs = -1);
+int deviceIndex(const String& deviceId);
 void broadcastState();
 String getConfigJSON();
 String getStateJSON();
@@ -319,16 +895,22 @@ const char CAPTIVE_PORTAL_HTML[] PROGMEM = R"rawliteral(
           <input type="text" name="wifiSSID" placeholder="Your WiFi network">
           
           <label>WiFi Password</label>
-          <input type="password" name="wifiPassword" placeholder="WiFi password">
+          <input type="password" name="wifiPassword" placeholder="Unchanged if left blank">
           
           <label>AP SSID (Fallback)</label>
           <input type="text" name="apSSID" value="ESP32_IoT_Hub">
           
           <label>AP Password</label>
-          <input type="password" name="apPassword" value="iot12345">
+          <input type="password" name="apPassword" placeholder="Unchanged if left blank">
           
           <label>Google Script URL (Optional)</label>
           <input type="text" name="scriptURL" placeholder="https://script.google.com/...">
+          
+          <label>NTP Server</label>
+          <input type="text" name="ntpServer" value="pool.ntp.org">
+          
+          <label>Timezone (POSIX TZ)</label>
+          <input type="text" name="timezone" value="UTC0">
         </div>
         
         <div id="pins" class="tab-content">
@@ -346,6 +928,9 @@ const char CAPTIVE_PORTAL_HTML[] PROGMEM = R"rawliteral(
           <div class="pin-grid">
             <div><label>LED Pin</label><input type="number" name="ledPin" min="0" max="40"></div>
             <div><label>Motor Pin</label><input type="number" name="motorPin" min="0" max="40"></div>
+            <div><label>PWM Frequency (Hz)</label><input type="number" name="pwmFrequency" value="5000" min="100" max="40000"></div>
+            <div><label>PWM Resolution (bits)</label><input type="number" name="pwmResolution" value="10" min="1" max="14"></div>
+            <div><label>Fade Time (ms)</label><input type="number" name="fadeTime" value="500" min="0" max="30000"></div>
           </div>
           
           <div class="section-title">Sensor Pins</div>
@@ -378,7 +963,7 @@ const char CAPTIVE_PORTAL_HTML[] PROGMEM = R"rawliteral(
           <div class="section">
             <div class="section-title">Intervals</div>
             <div class="pin-grid">
-              <div><label>Sensor Read (sec)</label><input type="number" name="sensorInterval" value="2" min="1" max="60"></div>
+              <div><label>Automation (sec)</label><input type="number" name="sensorInterval" value="2" min="1" max="60"></div>
               <div><label>Log Data (sec)</label><input type="number" name="logInterval" value="60" min="10" max="3600"></div>
             </div>
           </div>
@@ -420,6 +1005,9 @@ const char CAPTIVE_PORTAL_HTML[] PROGMEM = R"rawliteral(
       const config = {};
       formData.forEach((v, k) => config[k] = v);
       
+      // Passwords are never sent to the page; blank means keep the stored one
+      ['wifiPassword','apPassword'].forEach(name => { if (!config[name]) delete config[name]; });
+      
       // Handle checkboxes
       ['enableDHT','enableLight','enableMotion','enableRelay1','enableRelay2','enableRelay3','enableRelay4','enableLED','enableMotor','enableLogging'].forEach(name => {
         config[name] = document.querySelector(`[name="${name}"]`).checked;
@@ -489,17 +1077,29 @@ void setup() {
   EEPROM.begin(EEPROM_SIZE);
   loadConfig();
   
+  watchdog.begin(STAGE_NAMES, STAGE_BUDGET_MS, STAGE_COUNT, config.watchdogPanic);
+  Serial.printf("Reset reason: %s\n", watchdog.resetReason());
+  if (watchdog.hasReport()) {
+    Serial.print("! Previous boot: ");
+    watchdog.printReport(Serial, watchdog.report());
+  }
+  
   Serial.println("Type 'help' for serial commands\n");
   
+  setupEvents();
   setupPins();
   setupWiFi();
   setupWebServer();
   setupWebSocket();
-  
-  if (config.enableDHT) {
-    dhtSensor = new DHT(config.dhtPin, config.dhtType);
-    dhtSensor->begin();
-  }
+  setupTime();
+  setupStats();
+  setupQueue();
+  upstream.begin(config.scriptURL);
+  setupMqtt();
+  startMesh();
+  setupSensors();
+  setupOta();
+  setupPower();
   
   Serial.println("\n✓ System Ready!");
   Serial.println("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━");
@@ -509,29 +1109,65 @@ void setup() {
 // ============== MAIN LOOP ==============
 
 void loop() {
+  unsigned long loopStart = micros();
+  
+  watchdog.enter(STAGE_WEBSOCKET);
   webSocket.loop();
+  webSocket.pump();
+  watchdog.enter(STAGE_HTTP);
   webServer.handleClient();
   
   if (apMode) {
+    watchdog.enter(STAGE_DNS);
     dnsServer.processNextRequest();
   }
   
+  watchdog.enter(STAGE_SERIAL);
   handleSerial();
+  watchdog.enter(STAGE_OUTPUTS);
+  servicePwmFades();
+  processTimers();
   
   unsigned long currentMillis = millis();
   
-  // Read sensors
-  if (currentMillis - lastSensorRead >= config.sensorInterval * 1000UL) {
-    lastSensorRead = currentMillis;
-    readSensors();
-    sendSensorData();
+  // Read sensors (one driver step per pass, publishes what changed)
+  watchdog.enter(STAGE_SENSORS);
+  serviceSensors();
+  adaptSampling();
+  
+  // Evaluate automation rules on their interval, and early when a sensor
+  // they read has changed
+  bool ruleInput = false;
+  while (events.next(ruleFeed)) ruleInput = true;
+  if (ruleInput || currentMillis - lastAutomationRun >= config.sensorInterval * 1000UL) {
+    lastAutomationRun = currentMillis;
+    watchdog.enter(STAGE_AUTOMATION);
     processAutomation();
   }
   
-  // Log to Google Sheets
-  if (config.enableLogging && currentMillis - lastDataLog >= config.logInterval * 1000UL) {
+  watchdog.enter(STAGE_WIFI);
+  wifiConnected = WiFi.status() == WL_CONNECTED;
+  serviceAccessPoint();
+  serviceOta();
+  watchdog.enter(STAGE_UPSTREAM);
+  drainQueue();
+  watchdog.enter(STAGE_MQTT);
+  mqttPublishChanges();
+  mqtt.loop(wifiConnected);
+  watchdog.enter(STAGE_MESH);
+  serviceMesh();
+  
+  // Log to Google Sheets (only on change or after logHeartbeat)
+  watchdog.enter(STAGE_LOGGING);
+  trackLoggedChanges();
+  if (queueReady) sampleQueue.service();
+  if (currentMillis - lastDataLog >= config.logInterval * 1000UL) {
     lastDataLog = currentMillis;
-    logToGoogleSheets();
+    if (loggingDue()) {
+      logToGoogleSheets();
+    } else {
+      logsSuppressed++;
+    }
   }
   
   // Heartbeat
@@ -539,12 +1175,18 @@ void loop() {
     lastHeartbeat = currentMillis;
     Serial.println("[♥] System running - Uptime: " + String(millis()/1000) + "s");
   }
+  
+  watchdog.endLoop();
+  recordLoopTime(loopStart);
+  
+  // Sleep off the time to the next deadline (power modes)
+  idleUntilDeadline();
 }
 
 // ============== CONFIGURATION ==============
 
 void loadConfig() {
-  EEPROM.get(ADDR_MAGIC, config.magic);
+  EEPROM.get(offsetof(Config, magic), config.magic);
   
   if (config.magic != EEPROM_MAGIC) {
     Serial.println("! EEPROM not initialized, loading defaults...");
@@ -554,9 +1196,58 @@ void loadConfig() {
   
   // Load full config
   EEPROM.get(0, config);
+  
+  if (config.version < EEPROM_VERSION) {
+    Serial.printf("! EEPROM layout v%d, upgrading to v%d\n", config.version, EEPROM_VERSION);
+    upgradeConfig(config.version);
+    saveConfig();
+  }
+  
+  // A config from the other chip would drive its flash pins here
+  if (!boardFitsChip(config.boardType)) {
+    Serial.printf("! Board %s does not match this chip, using %s pins\n",
+      boardName(config.boardType), ChipBoard::name());
+    config.boardType = ChipBoard::ID;
+    applyBoardDefaults();
+    saveConfig();
+  }
   Serial.println("✓ Configuration loaded from EEPROM");
 }
 
+// Fill in defaults for fields appended after the stored layout version;
+// version 0 is a factory reset
+void upgradeConfig(uint8_t fromVersion) {
+  configSchema.defaults(config, fromVersion);
+  
+  if (fromVersion < 4) {
+    config.sensorPublish[SENSOR_TEMP]   = {0.2f, 2000, 300};
+    config.sensorPublish[SENSOR_HUM]    = {1.0f, 2000, 300};
+    config.sensorPublish[SENSOR_LIGHT]  = {2.0f, 1000, 300};
+    config.sensorPublish[SENSOR_MOTION] = {0.0f, 0,    300};
+  }
+  if (fromVersion < 5) {
+    config.statWindows[0] = 60;
+    config.statWindows[1] = 900;
+    config.statWindows[2] = 3600;
+  }
+  if (fromVersion < 8) {
+    // DHT keeps the old shared interval; phases keep reads apart
+    uint16_t dhtPeriod = constrain(config.sensorInterval * 1000UL, 2000UL, 60000UL);
+    config.sensorTiming[DRIVER_DHT]     = {dhtPeriod, 0};
+    config.sensorTiming[DRIVER_LIGHT]   = {500,  50};
+    config.sensorTiming[DRIVER_MOTION]  = {200,  100};
+    config.sensorTiming[DRIVER_AUX_DHT] = {dhtPeriod, (uint16_t)(dhtPeriod / 2)};
+    config.sensorTiming[DRIVER_ONEWIRE] = {5000, 250};
+  }
+  if (fromVersion < 13) {
+    config.sensorAdaptive[DRIVER_DHT]     = {2000, 30000};   // DHT22 needs 2 s between reads
+    config.sensorAdaptive[DRIVER_LIGHT]   = {100,  5000};
+    config.sensorAdaptive[DRIVER_MOTION]  = {50,   1000};
+    config.sensorAdaptive[DRIVER_AUX_DHT] = {2000, 30000};
+    config.sensorAdaptive[DRIVER_ONEWIRE] = {1000, 30000};   // 12-bit conversion takes 750 ms
+  }
+}
+
 void saveConfig() {
   config.magic = EEPROM_MAGIC;
   config.version = EEPROM_VERSION;
@@ -566,55 +1257,32 @@ void saveConfig() {
 }
 
 void resetConfig() {
-  config.magic = EEPROM_MAGIC;
-  config.version = EEPROM_VERSION;
-  config.boardType = BOARD_ESP32_DEVKIT;
-  
-  strcpy(config.wifiSSID, "");
-  strcpy(config.wifiPassword, "");
-  strcpy(config.apSSID, "ESP32_IoT_Hub");
-  strcpy(config.apPassword, "iot12345");
-  strcpy(config.deviceName, "ESP32 IoT Hub");
-  strcpy(config.scriptURL, "");
-  
-  applyBoardDefaults();
-  
-  config.enableDHT = true;
-  config.enableLight = true;
-  config.enableMotion = true;
-  config.enableRelays[0] = true;
-  config.enableRelays[1] = true;
-  config.enableRelays[2] = true;
-  config.enableRelays[3] = true;
-  config.enableLED = true;
-  config.enableMotor = true;
-  config.enableLogging = false;
-  
-  config.sensorInterval = 2;
-  config.logInterval = 60;
-  
+  memset(&config, 0, sizeof(config));
+  upgradeConfig(0);
   saveConfig();
 }
 
+template <typename Board>
+void applyBoardPins() {
+  memcpy(config.relayPins, Board::RELAY_PINS, RELAY_COUNT);
+  config.ledPin = Board::LED_PIN;
+  config.motorPin = Board::MOTOR_PIN;
+  config.dhtPin = Board::DHT_PIN;
+  config.lightPin = Board::LIGHT_PIN;
+  config.motionPin = Board::MOTION_PIN;
+}
+
 void applyBoardDefaults() {
-  if (config.boardType == BOARD_LOLIN_S2_MINI) {
-    memcpy(config.relayPins, S2MINI_RELAY_PINS, 4);
-    config.ledPin = S2MINI_LED_PIN;
-    config.motorPin = S2MINI_MOTOR_PIN;
-    config.dhtPin = S2MINI_DHT_PIN;
-    config.lightPin = S2MINI_LIGHT_PIN;
-    config.motionPin = S2MINI_MOTION_PIN;
-  } else {
-    memcpy(config.relayPins, DEVKIT_RELAY_PINS, 4);
-    config.ledPin = DEVKIT_LED_PIN;
-    config.motorPin = DEVKIT_MOTOR_PIN;
-    config.dhtPin = DEVKIT_DHT_PIN;
-    config.lightPin = DEVKIT_LIGHT_PIN;
-    config.motionPin = DEVKIT_MOTION_PIN;
-  }
+  applyBoardPins<ChipBoard>();
   config.dhtType = DHT22;
 }
 
+const char* boardName(uint8_t type) {
+  if (type == BOARD_LOLIN_S2_MINI) return S2MiniBoard::name();
+  if (type == BOARD_CUSTOM) return CustomBoard::name();
+  return DevKitBoard::name();
+}
+
 // ============== WIFI SETUP ==============
 
 void setupWiFi() {
@@ -666,33 +1334,184 @@ void setupDNS() {
   Serial.println("✓ DNS Server started for captive portal");
 }
 
+// ============== ACCESS POINT POLICY ==============
+
+// Once the station link has been up for apGrace seconds (and nobody is on
+// the portal) the soft-AP and captive DNS go down, so the radio stops
+// beaconing a second network and loop() stops polling DNS. They come back
+// after apRestore seconds without a station link, or on demand.
+void serviceAccessPoint() {
+  unsigned long now = millis();
+  
+  if (wifiConnected != stationUp) {
+    stationUp = wifiConnected;
+    stationChangedAt = now;
+  }
+  
+  // Holding the BOOT button reopens the portal
+  if (apButtonEnabled) {
+    if (digitalRead(AP_BUTTON_PIN) == LOW) {
+      if (apButtonDownAt == 0) apButtonDownAt = now | 1;   // 0 means released
+      if (!apButtonHandled && now - apButtonDownAt >= AP_BUTTON_HOLD_MS) {
+        apButtonHandled = true;
+        openPortal("button");
+      }
+    } else {
+      apButtonDownAt = 0;
+      apButtonHandled = false;
+    }
+  }
+  
+  if (config.apPolicy != AP_POLICY_AUTO || strlen(config.wifiSSID) == 0) {
+    if (!apMode) startAccessPoint("policy");
+    return;
+  }
+  
+  unsigned long since = now - stationChangedAt;
+  if (apMode) {
+    bool held = (long)(apHoldUntil - now) > 0;
+    if (stationUp && since >= config.apGrace * 1000UL && !held && WiFi.softAPgetStationNum() == 0) {
+      stopAccessPoint("station connected");
+    }
+  } else if (!stationUp && since >= config.apRestore * 1000UL) {
+    startAccessPoint("station lost");
+  }
+}
+
+void startAccessPoint(const char* reason) {
+  WiFi.mode(WIFI_AP_STA);
+  WiFi.softAP(config.apSSID, config.apPassword);
+  setupDNS();
+  apMode = true;
+  apTransitions++;
+  Serial.printf("[WiFi] AP up (%s): %s\n", reason, WiFi.softAPIP().toString().c_str());
+}
+
+void stopAccessPoint(const char* reason) {
+  dnsServer.stop();
+  WiFi.softAPdisconnect(true);
+  apMode = false;
+  apTransitions++;
+  Serial.printf("[WiFi] AP down (%s), station IP %s\n", reason, WiFi.localIP().toString().c_str());
+}
+
+// Manual reopen: stays up for at least apGrace seconds
+void openPortal(const char* reason) {
+  apHoldUntil = millis() + config.apGrace * 1000UL;
+  if (!apMode) startAccessPoint(reason);
+  else Serial.printf("[WiFi] AP held open for %u s (%s)\n", config.apGrace, reason);
+}
+
+// Percentiles are bucket upper bounds; buckets[i] counts [2^i, 2^(i+1)) us
+void histogramJson(JsonObject out, const LatencyHistogram& h) {
+  out["count"] = h.count();
+  out["meanUs"] = h.meanUs();
+  out["p50Us"] = h.percentile(50);
+  out["p90Us"] = h.percentile(90);
+  out["p99Us"] = h.percentile(99);
+  out["maxUs"] = h.maxUs();
+  
+  JsonArray buckets = out["buckets"].to<JsonArray>();
+  if (h.count() == 0) return;
+  for (uint8_t i = 0; i <= h.highest(); i++) buckets.add(h.bucket(i));
+}
+
+void stallJson(JsonObject out, const StallRecord& record) {
+  out["stage"] = watchdog.stageName(record.stage);
+  out["durationMs"] = record.durationMs;
+  out["budgetMs"] = record.budgetMs;
+  out["uptime"] = record.uptimeS;
+  out["returned"] = record.finished;
+  
+  char addr[12];
+  JsonArray backtrace = out["backtrace"].to<JsonArray>();
+  for (uint8_t i = 0; i < record.depth; i++) {
+    snprintf(addr, sizeof(addr), "0x%08lx", (unsigned long)record.backtrace[i]);
+    backtrace.add(addr);
+  }
+}
+
+void recordLoopTime(unsigned long startUs) {
+  unsigned long now = micros();
+  LoopStats& stats = loopStats[apMode ? 1 : 0];
+  uint32_t busy = now - startUs;
+  
+  stats.loops++;
+  stats.busyUs += busy;
+  if (busy > stats.maxUs) stats.maxUs = busy;
+  if (lastLoopStart != 0) stats.wallUs += startUs - lastLoopStart;
+  lastLoopStart = startUs;
+}
+
 // ============== PIN SETUP ==============
 
+// Relay port: W1TS/W1TC set or clear every pin of a mask in one write
+struct GpioRegs {
+  static inline void write(PinMask on, PinMask off) {
+    if (on.lo) GPIO.out_w1ts = on.lo;
+    if (on.hi) GPIO.out1_w1ts.val = on.hi;
+    if (off.lo) GPIO.out_w1tc = off.lo;
+    if (off.hi) GPIO.out1_w1tc.val = off.hi;
+  }
+};
+
+// Relay masks for the configured board; returns the relays whose pin
+// cannot be an output
+uint8_t loadRelayBank() {
+  if (config.boardType == BOARD_CUSTOM) {
+    return relays.load<CustomBoard>(config.relayPins, config.enableRelays);
+  }
+  return relays.load<ChipBoard>(config.relayPins, config.enableRelays);
+}
+
 void setupPins() {
   Serial.println("\n[Pins] Configuring...");
   
-  // Relay pins
-  for (int i = 0; i < 4; i++) {
-    if (config.enableRelays[i]) {
+  // Relay pins: latch LOW before enabling the output driver
+  uint8_t rejected = loadRelayBank();
+  relays.write<GpioRegs>(relays.enabled(), 0);
+  for (int i = 0; i < RELAY_COUNT; i++) {
+    if (rejected & (1 << i)) {
+      Serial.printf("  ! Relay %d: GPIO %d is not an output pin, disabled\n", i+1, config.relayPins[i]);
+    } else if (relays.enabled() & (1 << i)) {
       pinMode(config.relayPins[i], OUTPUT);
-      digitalWrite(config.relayPins[i], LOW);
       Serial.printf("  Relay %d: GPIO %d\n", i+1, config.relayPins[i]);
     }
   }
+  if (relays.enabled()) {
+    Serial.printf("  Relay masks: %s\n", relays.fixed() ? boardName(config.boardType) : "configured pins");
+  }
+  
+  // PWM timer: both channels share LEDC timer 0, so frequency and
+  // resolution are global. Fall back to 5 kHz / 8 bit if the clock
+  // cannot satisfy the requested combination.
+  if (config.enableLED || config.enableMotor) {
+    if (config.pwmResolution < 1 || config.pwmResolution > 14 ||
+        ledcSetup(LED_PWM_CHANNEL, config.pwmFrequency, config.pwmResolution) == 0) {
+      Serial.printf("  ! PWM %u Hz / %u bit not supported, using 5000 Hz / 8 bit\n",
+        config.pwmFrequency, config.pwmResolution);
+      config.pwmFrequency = 5000;
+      config.pwmResolution = 8;
+      ledcSetup(LED_PWM_CHANNEL, config.pwmFrequency, config.pwmResolution);
+    }
+    ledcSetup(MOTOR_PWM_CHANNEL, config.pwmFrequency, config.pwmResolution);
+    
+    fadeEngineReady = ledc_fade_func_install(0) == ESP_OK;
+    Serial.printf("  PWM: %u Hz, %u bit, fade %s\n", config.pwmFrequency, config.pwmResolution,
+      fadeEngineReady ? "hardware" : "unavailable");
+  }
   
   // LED pin (PWM)
   if (config.enableLED) {
     pinMode(config.ledPin, OUTPUT);
-    ledcSetup(0, 5000, 8);
-    ledcAttachPin(config.ledPin, 0);
+    ledcAttachPin(config.ledPin, LED_PWM_CHANNEL);
     Serial.printf("  LED: GPIO %d (PWM)\n", config.ledPin);
   }
   
   // Motor pin (PWM)
   if (config.enableMotor) {
     pinMode(config.motorPin, OUTPUT);
-    ledcSetup(1, 5000, 8);
-    ledcAttachPin(config.motorPin, 1);
+    ledcAttachPin(config.motorPin, MOTOR_PWM_CHANNEL);
     Serial.printf("  Motor: GPIO %d (PWM)\n", config.motorPin);
   }
   
@@ -711,9 +1530,108 @@ void setupPins() {
     Serial.printf("  DHT%d: GPIO %d\n", config.dhtType, config.dhtPin);
   }
   
+  // Portal button, unless the pin was assigned to something else
+  apButtonEnabled = true;
+  const uint8_t usedPins[] = {config.relayPins[0], config.relayPins[1], config.relayPins[2],
+    config.relayPins[3], config.ledPin, config.motorPin, config.dhtPin, config.lightPin, config.motionPin};
+  for (uint8_t pin : usedPins) {
+    if (pin == AP_BUTTON_PIN) apButtonEnabled = false;
+  }
+  if (apButtonEnabled) {
+    pinMode(AP_BUTTON_PIN, INPUT_PULLUP);
+    Serial.printf("  Portal button: GPIO %d (hold %d s)\n", AP_BUTTON_PIN, AP_BUTTON_HOLD_MS / 1000);
+  }
+  
   Serial.println("✓ Pins configured");
 }
 
+// ============== PWM FADING ==============
+
+// Arduino LEDC channels 0-7 live in speed mode 0 (high speed on ESP32,
+// low speed on S2), hardware channel n % 8.
+static inline ledc_mode_t pwmSpeedMode(uint8_t channel) {
+  return (ledc_mode_t)(channel / 8);
+}
+
+uint32_t pwmMaxDuty() {
+  return (1UL << config.pwmResolution) - 1;
+}
+
+void writePWM(uint8_t channel, uint32_t duty, int transitionMs) {
+  if (!fadeEngineReady) {
+    ledcWrite(channel, duty);
+    return;
+  }
+  
+  PwmFade& fade = pwmFades[channel];
+  unsigned long now = millis();
+  ledc_mode_t mode = pwmSpeedMode(channel);
+  ledc_channel_t ch = (ledc_channel_t)(channel % 8);
+  
+  // The fade engine holds a channel until its fade completes: on IDF 4
+  // even ledc_set_duty() waits for it. A new target is therefore parked
+  // here and started by servicePwmFades() when the running slice ends,
+  // replacing the rest of any ramp. Off cuts the output at once; on
+  // IDF 5 so does any immediate target.
+  if ((long)(fade.endTime - now) > 0) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    if (transitionMs <= 0 || duty == 0) {
+      ledc_fade_stop(mode, ch);
+      fade.endTime = now;
+      fade.pending = false;
+    }
+#else
+    if (duty == 0) {
+      // Output low now; the slice runs out unseen and the next duty
+      // written enables the output again
+      ledc_stop(mode, ch, 0);
+      fade.pending = false;
+      return;
+    }
+#endif
+    if ((long)(fade.endTime - now) > 0) {
+      fade.pending = true;
+      fade.pendingDuty = duty;
+      fade.pendingTime = transitionMs;
+      return;
+    }
+  }
+  
+  fade.pending = false;
+  if (transitionMs > PWM_FADE_SLICE_MS) {
+    // This slice's share of a linear ramp; the rest is parked
+    int32_t from = ledc_get_duty(mode, ch);
+    uint32_t step = from + (int32_t)(((int64_t)duty - from) * PWM_FADE_SLICE_MS / transitionMs);
+    fade.pending = true;
+    fade.pendingDuty = duty;
+    fade.pendingTime = transitionMs - PWM_FADE_SLICE_MS;
+    duty = step;
+    transitionMs = PWM_FADE_SLICE_MS;
+  }
+  
+  if (transitionMs > 0) {
+    ledc_set_fade_with_time(mode, ch, duty, transitionMs);
+    ledc_fade_start(mode, ch, LEDC_FADE_NO_WAIT);
+    fade.endTime = now + transitionMs;
+  } else {
+    ledc_set_duty_and_update(mode, ch, duty, 0);
+  }
+}
+
+// Only starts parked targets and ramp slices; the ramps themselves run in
+// hardware.
+void servicePwmFades() {
+  unsigned long now = millis();
+  
+  for (uint8_t ch = 0; ch < PWM_CHANNEL_COUNT; ch++) {
+    PwmFade& fade = pwmFades[ch];
+    if (fade.pending && (long)(now - fade.endTime) >= 0) {
+      fade.pending = false;
+      writePWM(ch, fade.pendingDuty, fade.pendingTime);
+    }
+  }
+}
+
 // ============== WEB SERVER SETUP ==============
 
 void setupWebServer() {
@@ -735,48 +1653,15 @@ void setupWebServer() {
       JsonDocument doc;
       DeserializationError error = deserializeJson(doc, webServer.arg("plain"));
       
-      if (!error) {
-        // Update config
-        if (doc["boardType"]) config.boardType = doc["boardType"].as<int>();
-        if (doc["deviceName"]) strlcpy(config.deviceName, doc["deviceName"], 64);
-        if (doc["wifiSSID"]) strlcpy(config.wifiSSID, doc["wifiSSID"], 64);
-        if (doc["wifiPassword"]) strlcpy(config.wifiPassword, doc["wifiPassword"], 64);
-        if (doc["apSSID"]) strlcpy(config.apSSID, doc["apSSID"], 32);
-        if (doc["apPassword"]) strlcpy(config.apPassword, doc["apPassword"], 32);
-        if (doc["scriptURL"]) strlcpy(config.scriptURL, doc["scriptURL"], 256);
-        
-        // Pins
-        if (doc["relay1"]) config.relayPins[0] = doc["relay1"].as<int>();
-        if (doc["relay2"]) config.relayPins[1] = doc["relay2"].as<int>();
-        if (doc["relay3"]) config.relayPins[2] = doc["relay3"].as<int>();
-        if (doc["relay4"]) config.relayPins[3] = doc["relay4"].as<int>();
-        if (doc["ledPin"]) config.ledPin = doc["ledPin"].as<int>();
-        if (doc["motorPin"]) config.motorPin = doc["motorPin"].as<int>();
-        if (doc["dhtPin"]) config.dhtPin = doc["dhtPin"].as<int>();
-        if (doc["dhtType"]) config.dhtType = doc["dhtType"].as<int>();
-        if (doc["lightPin"]) config.lightPin = doc["lightPin"].as<int>();
-        if (doc["motionPin"]) config.motionPin = doc["motionPin"].as<int>();
-        
-        // Features
-        config.enableDHT = doc["enableDHT"] | config.enableDHT;
-        config.enableLight = doc["enableLight"] | config.enableLight;
-        config.enableMotion = doc["enableMotion"] | config.enableMotion;
-        config.enableRelays[0] = doc["enableRelay1"] | config.enableRelays[0];
-        config.enableRelays[1] = doc["enableRelay2"] | config.enableRelays[1];
-        config.enableRelays[2] = doc["enableRelay3"] | config.enableRelays[2];
-        config.enableRelays[3] = doc["enableRelay4"] | config.enableRelays[3];
-        config.enableLED = doc["enableLED"] | config.enableLED;
-        config.enableMotor = doc["enableMotor"] | config.enableMotor;
-        config.enableLogging = doc["enableLogging"] | config.enableLogging;
-        
-        if (doc["sensorInterval"]) config.sensorInterval = doc["sensorInterval"].as<int>();
-        if (doc["logInterval"]) config.logInterval = doc["logInterval"].as<int>();
-        
+      const char* bad = error ? nullptr : applyConfigJSON(doc);
+      if (bad) {
+        webServer.send(400, "application/json", String("{\"success\":false,\"message\":\"Invalid value for ") + bad + "\"}");
+      } else if (!error) {
         saveConfig();
         
         webServer.send(200, "application/json", "{\"success\":true,\"message\":\"Configuration saved! Restarting...\"}");
         delay(1000);
-        ESP.restart();
+        restartDevice();
       } else {
         webServer.send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
       }
@@ -787,21 +1672,56 @@ void setupWebServer() {
     webServer.send(200, "application/json", getStateJSON());
   });
   
+  webServer.on("/metrics", HTTP_GET, []() {
+    webServer.send(200, "application/json", getMetricsJSON());
+  });
+  
+  webServer.on("/ota", HTTP_GET, []() {
+    webServer.send(200, "application/json", otaStatusJSON());
+  });
+  
+  webServer.on("/ota", HTTP_POST, []() {
+    if (!otaInstalled) {
+      String message = otaError ? otaError : "No image uploaded";
+      webServer.send(400, "application/json", "{\"success\":false,\"message\":\"" + message + "\"}");
+      return;
+    }
+    webServer.send(200, "application/json", "{\"success\":true,\"message\":\"Firmware installed! Restarting...\"}");
+    delay(500);
+    restartDevice();
+  }, handleOtaUpload);
+  
+  webServer.on("/ota/rollback", HTTP_POST, []() {
+    if (!otaRollback()) {
+      webServer.send(400, "application/json", "{\"success\":false,\"message\":\"No previous firmware\"}");
+      return;
+    }
+    webServer.send(200, "application/json", "{\"success\":true,\"message\":\"Rolling back. Restarting...\"}");
+    delay(500);
+    restartDevice();
+  });
+  
+  webServer.on("/api", HTTP_GET, handleApi);
+  
   webServer.on("/restart", HTTP_GET, []() {
     webServer.send(200, "application/json", "{\"success\":true,\"message\":\"Restarting...\"}");
     delay(500);
-    ESP.restart();
+    restartDevice();
   });
   
   webServer.on("/reset", HTTP_GET, []() {
     resetConfig();
     webServer.send(200, "application/json", "{\"success\":true,\"message\":\"Configuration reset. Restarting...\"}");
     delay(500);
-    ESP.restart();
+    restartDevice();
   });
   
   // Handle captive portal redirects
   webServer.onNotFound([]() {
+    if (!apMode) {
+      webServer.send(404, "application/json", "{\"success\":false,\"message\":\"Not found\"}");
+      return;
+    }
     webServer.sendHeader("Location", "http://" + WiFi.softAPIP().toString());
     webServer.send(302, "text/plain", "");
   });
@@ -810,30 +1730,293 @@ void setupWebServer() {
   Serial.println("✓ Web server started on port 80");
 }
 
-// ============== WEBSOCKET SETUP ==============
+// ============== LOCAL API ==============
+//
+// GET /api?action=... answers the read actions of the Apps Script web app
+// from the hub's own state, with the same response shape, so the dashboard
+// can ask the hub first and only fall back to the cloud. Parameters are
+// accepted bare or JSON-encoded (the Apps Script client quotes them).
+// Responses are chunked: rows are serialized one at a time into a small
+// buffer, so a long history never needs a String of its own.
 
-void setupWebSocket() {
-  webSocket.begin();
-  webSocket.onEvent(webSocketEvent);
-  Serial.println("✓ WebSocket server started on port 81");
+class ChunkedResponse : public Print {
+ public:
+  void begin() {
+    webServer.sendHeader("Access-Control-Allow-Origin", "*");
+    webServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    webServer.send(200, "application/json", "");
+  }
+  
+  size_t write(uint8_t c) override {
+    buf_[len_++] = c;
+    if (len_ == sizeof(buf_)) sendChunk();
+    return 1;
+  }
+  
+  size_t write(const uint8_t* data, size_t n) override {
+    for (size_t i = 0; i < n; i++) write(data[i]);
+    return n;
+  }
+  
+  // One row as its own JSON document
+  void row(JsonDocument& doc) {
+    if (rows_++) write(',');
+    serializeJson(doc, *this);
+  }
+  
+  void end() {
+    sendChunk();
+    webServer.sendContent("");
+  }
+  
+ private:
+  void sendChunk() {
+    if (len_) webServer.sendContent((const char*)buf_, len_);
+    len_ = 0;
+  }
+  
+  uint8_t buf_[API_CHUNK_SIZE];
+  size_t len_ = 0;
+  uint16_t rows_ = 0;
+};
+
+static String apiParam(const char* name) {
+  String value = webServer.arg(name);
+  if (value.length() >= 2 && value[0] == '"' && value[value.length() - 1] == '"') {
+    value = value.substring(1, value.length() - 1);
+  }
+  return value;
 }
 
-// ============== WEBSOCKET EVENT HANDLER ==============
+static void apiError(int code, const String& error) {
+  JsonDocument doc;
+  doc["success"] = false;
+  doc["error"] = error;
+  String output;
+  serializeJson(doc, output);
+  webServer.sendHeader("Access-Control-Allow-Origin", "*");
+  webServer.send(code, "application/json", output);
+}
 
-void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
-  switch(type) {
-    case WStype_DISCONNECTED:
-      Serial.printf("[WS] Client %u disconnected\n", num);
-      break;
-      
-    case WStype_CONNECTED: {
-      IPAddress ip = webSocket.remoteIP(num);
+// ISO 8601 UTC like the sheet's timestamp column. Samples taken before
+// the clock was set are placed using the current offset; false while
+// there is none. History lives in RAM, so its uptimes all count from
+// this boot; one ahead of the clock cannot be placed either.
+static bool apiTimestamp(const SampleRecord& sample, char* text, size_t size) {
+  time_t t = sample.time;
+  if (sample.flags & SAMPLE_FLAG_UPTIME) {
+    uint32_t uptime = monoUs() / 1000000;
+    if (!timeSynced() || sample.time > uptime) return false;
+    t = time(nullptr) - (uptime - sample.time);
+  }
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  strftime(text, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+  return true;
+}
+
+static void apiSample(JsonDocument& doc, const SampleRecord& sample) {
+  char text[24];
+  if (apiTimestamp(sample, text, sizeof(text))) doc["timestamp"] = text;
+  else doc["timestamp"] = nullptr;
+  if (sample.flags & SAMPLE_FLAG_UPTIME) doc["uptime"] = (uint32_t)sample.time;
+  doc["temperature"] = sample.temperature / 100.0;
+  doc["humidity"] = sample.humidity / 100.0;
+  doc["light"] = sample.light;
+  doc["motion"] = sample.flags & SAMPLE_FLAG_MOTION ? 1 : 0;
+  for (uint8_t r = 0; r < RELAY_COUNT; r++) {
+    doc["relay" + String(r + 1)] = (sample.flags >> (r + 1)) & 1;
+  }
+}
+
+void recordHistory(const SampleRecord& sample) {
+  history[historyHead] = sample;
+  historyHead = (historyHead + 1) % HISTORY_SAMPLES;
+  if (historyCount < HISTORY_SAMPLES) historyCount++;
+}
+
+void handleApi() {
+  String action = apiParam("action");
+  bool hub = true;
+  if (webServer.hasArg("deviceId")) hub = apiParam("deviceId") == config.deviceName;
+  
+  if (action == "getSensorHistory" && !hub) {
+    // Other hubs' sheets only exist in the cloud
+    apiError(404, "Unknown device: " + apiParam("deviceId"));
+    return;
+  }
+  if (action != "getDevices" && action != "getDeviceStates" &&
+      action != "getSensorHistory" && action != "getAutomationRules") {
+    apiError(400, "Unknown action: " + action);
+    return;
+  }
+  
+  ChunkedResponse out;
+  JsonDocument doc;
+  out.begin();
+  out.print("{\"success\":true,\"data\":[");
+  
+  if (action == "getDevices") {
+    doc["id"] = config.deviceName;
+    doc["name"] = String("ESP32_") + config.deviceName;
+    doc["type"] = "ESP32";
+    doc["ip"] = (wifiConnected ? WiFi.localIP() : WiFi.softAPIP()).toString();
+    char text[24];
+    if (apiTimestamp(captureSample(), text, sizeof(text))) doc["lastSeen"] = text;
+    else doc["lastSeen"] = nullptr;
+    doc["status"] = "Active";
+    out.row(doc);
+  }
+  else if (action == "getDeviceStates") {
+    doc["deviceId"] = config.deviceName;
+    apiSample(doc, captureSample());
+    out.row(doc);
+  }
+  else if (action == "getSensorHistory") {
+    long limit = webServer.hasArg("limit") ? apiParam("limit").toInt() : API_DEFAULT_LIMIT;
+    uint16_t n = limit < 0 ? 0 : limit > historyCount ? historyCount : limit;
+    // Oldest first, like the sheet
+    for (uint16_t i = 0; i < n; i++) {
+      uint16_t slot = (historyHead + HISTORY_SAMPLES - n + i) % HISTORY_SAMPLES;
+      doc.clear();
+      apiSample(doc, history[slot]);
+      out.row(doc);
+    }
+  }
+  else {
+    // One rule is one condition with any number of actions; the sheet's
+    // columns get the whole condition as trigger and the first action
+    for (uint8_t i = 0; i < automation.count(); i++) {
+      const AutomationRule& rule = automation.rule(i);
+      doc.clear();
+      doc["id"] = "rule" + String(rule.id);
+      doc["name"] = rule.source;
+      doc["trigger"] = rule.source;
+      doc["condition"] = "";
+      doc["value"] = "";
+      doc["action"] = rule.actionCount ? rule.actions[0].device : "";
+      doc["actionState"] = rule.actionCount && rule.actions[0].state;
+      doc["enabled"] = rule.enabled;
+      doc["active"] = rule.active;
+      doc["fired"] = rule.fired;
+      JsonArray actions = doc["actions"].to<JsonArray>();
+      for (uint8_t a = 0; a < rule.actionCount; a++) {
+        JsonObject act = actions.add<JsonObject>();
+        act["device"] = rule.actions[a].device;
+        act["state"] = rule.actions[a].state;
+        if (rule.actions[a].onRelease) act["onRelease"] = true;
+      }
+      out.row(doc);
+    }
+  }
+  
+  out.print("]}");
+  out.end();
+}
+
+// Update config from a JSON object (POST /config, serial SET_CONFIG frame);
+// fields that are absent keep their current value. Returns the key of a
+// rejected value (wrong type or out of range), nullptr on success; a
+// rejected update changes nothing.
+// An integer of a nested config block: missing keeps out, anything else
+// must be in [lo, hi]
+bool nestedNum(JsonVariantConst v, uint16_t& out, long lo, long hi) {
+  if (v.isNull()) return true;
+  if (!v.is<long>() || v.as<long>() < lo || v.as<long>() > hi) return false;
+  out = v.as<long>();
+  return true;
+}
+
+// Every field is checked on a copy first, so a rejected update changes
+// nothing; returns the first bad key
+const char* applyConfigJSON(JsonDocument& doc) {
+  Config next = config;
+  const char* bad = configSchema.fromJson(next, doc.as<JsonObjectConst>());
+  if (bad) return bad;
+  if (!boardFitsChip(next.boardType)) return "boardType";
+  
+  // Report-by-exception: {"publish": {"temp1": {"deadband": 0.5, ...}}}
+  for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+    JsonObjectConst pub = doc["publish"][sensorChannels[i].id];
+    if (pub.isNull()) continue;
+    SensorPublish& sp = next.sensorPublish[i];
+    JsonVariantConst deadband = pub["deadband"];
+    if (!deadband.isNull()) {
+      if (!deadband.is<float>() || deadband.as<float>() < 0) return "deadband";
+      sp.deadband = deadband.as<float>();
+    }
+    if (!nestedNum(pub["minInterval"], sp.minInterval, 0, 65535)) return "minInterval";
+    if (!nestedNum(pub["maxSilence"], sp.maxSilence, 0, 65535)) return "maxSilence";
+  }
+  
+  // Acquisition: {"timing": {"dht": {"period": 2000, "phase": 0, "floor": 2000, "ceiling": 30000}, ...}}
+  bool timed[DRIVER_COUNT] = {};
+  for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+    JsonObjectConst timing = doc["timing"][DRIVER_NAMES[d]];
+    if (timing.isNull()) continue;
+    timed[d] = true;
+    SensorTiming& t = next.sensorTiming[d];
+    SensorAdaptive& bounds = next.sensorAdaptive[d];
+    if (!nestedNum(timing["period"], t.period, 10, 65535)) return "period";
+    if (!nestedNum(timing["phase"], t.phase, 0, 65535)) return "phase";
+    if (!nestedNum(timing["floor"], bounds.floor, 10, 65535)) return "floor";
+    if (!nestedNum(timing["ceiling"], bounds.ceiling, 10, 65535) || bounds.ceiling < bounds.floor) return "ceiling";
+  }
+  
+  JsonVariantConst windows = doc["statWindows"];
+  if (!windows.isNull()) {
+    if (!windows.is<JsonArrayConst>() || windows.size() > STAT_WINDOWS) return "statWindows";
+    for (uint8_t w = 0; w < windows.size(); w++) {
+      if (!nestedNum(windows[w], next.statWindows[w], 1, 65535)) return "statWindows";
+    }
+  }
+  
+  bool panicChanged = next.watchdogPanic != config.watchdogPanic;
+  bool powerChanged = next.powerMode != config.powerMode;
+  bool adaptChanged = next.adaptiveSampling != config.adaptiveSampling;
+  config = next;
+  if (panicChanged) watchdog.setPanic(config.watchdogPanic);
+  if (powerChanged) setupPower();
+  if (adaptChanged) restartRates();
+  for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+    if (timed[d]) setSensorTiming(d, config.sensorTiming[d].period, config.sensorTiming[d].phase);
+  }
+  return nullptr;
+}
+
+// ============== WEBSOCKET SETUP ==============
+
+void setupWebSocket() {
+  webSocket.begin();
+  webSocket.onEvent(webSocketEvent);
+  Serial.println("✓ WebSocket server started on port 81");
+}
+
+// ============== WEBSOCKET EVENT HANDLER ==============
+
+void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
+  switch(type) {
+    case WStype_DISCONNECTED:
+      webSocket.forget(num);
+      Serial.printf("[WS] Client %u disconnected\n", num);
+      break;
+      
+    case WStype_CONNECTED: {
+      IPAddress ip = webSocket.remoteIP(num);
+      if (webSocket.connectedClients() > config.wsMaxClients) {
+        Serial.printf("[WS] Client %u from %s refused, %u clients max\n",
+          num, ip.toString().c_str(), config.wsMaxClients);
+        webSocket.disconnect(num);
+        break;
+      }
       Serial.printf("[WS] Client %u connected from %s\n", num, ip.toString().c_str());
       broadcastState();
+      if (mesh.mode() == MESH_AGGREGATOR) webSocket.queueTXT(num, getHubsJSON(), WS_KIND_HUBS);
       break;
     }
     
     case WStype_TEXT: {
+      commandRecvUs = monoUs();
       Serial.printf("[WS] Received from %u: %s\n", num, payload);
       
       JsonDocument doc;
@@ -859,139 +2042,789 @@ void handleCommand(uint8_t num, JsonDocument& doc) {
     String id = doc["id"] | "";
     bool state = doc["state"] | false;
     int value = doc["value"] | -1;
+    int transition = doc["transition"] | -1;
+    uint32_t delayMs = doc["delay"] | 0;
+    String hub = doc["hub"] | "";
     
-    setDeviceState(id, state, value);
-    broadcastState();
+    if (hub.length() && hub != config.deviceName) {
+      // A device of another hub: routed through the mesh, the owner's
+      // answer comes back as {"type":"routed",...}
+      if (!mesh.command(hub.c_str(), id.c_str(), state, value, millis())) {
+        JsonDocument response;
+        response["type"] = "routed";
+        response["hub"] = hub;
+        response["id"] = id;
+        response["success"] = false;
+        response["message"] = "Unknown or offline hub";
+        String output;
+        serializeJson(response, output);
+        webSocket.queueTXT(num, output);
+      }
+    } else if (delayMs > 0) {
+      JsonDocument response;
+      response["type"] = "scheduled";
+      if (deviceIndex(id) < 0) {
+        response["success"] = false;
+        response["message"] = "Unknown device";
+      } else {
+        uint32_t timerId = scheduleAction(id.c_str(), state, value, transition, delayMs);
+        response["success"] = timerId != 0;
+        response["timerId"] = timerId;
+        response["dueIn"] = delayMs;
+        if (timerId == 0) response["message"] = "Scheduler full";
+      }
+      String output;
+      serializeJson(response, output);
+      webSocket.queueTXT(num, output);
+    } else {
+      setDeviceState(id, state, value, transition);
+      uint32_t latencyUs = outputWrittenUs - commandRecvUs;
+      commandLatency.add(latencyUs);
+      
+      // Optional trace id: echo the timestamps so the client can split
+      // its round trip into network and hub time
+      if (!doc["trace"].isNull()) {
+        JsonDocument response;
+        response["type"] = "trace";
+        response["trace"] = doc["trace"];
+        response["recvUs"] = commandRecvUs;
+        response["outputUs"] = outputWrittenUs;
+        response["latencyUs"] = latencyUs;
+        String output;
+        serializeJson(response, output);
+        webSocket.queueTXT(num, output);
+      }
+      broadcastState();
+    }
+  }
+  else if (type == "schedule") {
+    // {"type":"schedule","id":"relay2","state":false,"delay":600000}
+    // {"type":"schedule","id":"motor1","state":true,"value":60,"at":"06:00","daily":true}
+    String id = doc["id"] | "";
+    bool state = doc["state"] | false;
+    int value = doc["value"] | -1;
+    int transition = doc["transition"] | -1;
+    uint32_t delayMs = doc["delay"] | 0;
+    String at = doc["at"] | "";
+    int dailyMinute = -1;
+    
+    JsonDocument response;
+    response["type"] = "scheduled";
+    
+    if (deviceIndex(id) < 0) {
+      response["success"] = false;
+      response["message"] = "Unknown device";
+      delayMs = 0;
+    } else if (at.length() > 0) {
+      int hh = -1, mm = -1;
+      sscanf(at.c_str(), "%d:%d", &hh, &mm);
+      long wait = (hh >= 0 && hh < 24 && mm >= 0 && mm < 60) ? secondsUntil(hh * 60 + mm) : -1;
+      
+      if (wait < 0) {
+        response["success"] = false;
+        response["message"] = timeSynced() ? "Invalid time, use HH:MM" : "Clock not synced";
+      } else {
+        delayMs = wait * 1000UL;
+        if (doc["daily"] | false) dailyMinute = hh * 60 + mm;
+      }
+    }
+    
+    if (delayMs > 0) {
+      uint32_t timerId = scheduleAction(id.c_str(), state, value, transition, delayMs, dailyMinute);
+      response["success"] = timerId != 0;
+      response["timerId"] = timerId;
+      response["dueIn"] = delayMs;
+      if (timerId == 0) response["message"] = "Scheduler full";
+    } else if (response["success"].isNull()) {
+      response["success"] = false;
+      response["message"] = "Missing delay or at";
+    }
+    
+    String output;
+    serializeJson(response, output);
+    webSocket.queueTXT(num, output);
+  }
+  else if (type == "cancel") {
+    uint32_t timerId = doc["timerId"] | 0;
+    
+    JsonDocument response;
+    response["type"] = "cancelled";
+    response["timerId"] = timerId;
+    response["success"] = timers.cancel(timerId);
+    String output;
+    serializeJson(response, output);
+    webSocket.queueTXT(num, output);
   }
   else if (type == "get_state") {
     broadcastState();
   }
   else if (type == "get_config") {
     String configJSON = getConfigJSON();
-    webSocket.sendTXT(num, configJSON);
+    webSocket.queueTXT(num, configJSON);
   }
   else if (type == "add_rule") {
-    if (ruleCount < 10) {
-      rules[ruleCount].enabled = true;
-      strlcpy(rules[ruleCount].triggerDevice, doc["trigger"] | "", 32);
-      strlcpy(rules[ruleCount].condition, doc["condition"] | "", 8);
-      rules[ruleCount].triggerValue = doc["value"] | 0.0f;
-      strlcpy(rules[ruleCount].actionDevice, doc["action"] | "", 32);
-      rules[ruleCount].actionState = doc["actionState"] | false;
-      rules[ruleCount].actionValue = doc["actionValue"] | -1;
-      ruleCount++;
+    // {"when": "temp1 > 30 hyst 2 and motion1 for 60s",
+    //  "actions": [{"id": "relay3", "state": true}], "release": [{"id": "relay3", "state": false}]}
+    // or the single-comparison form: trigger, condition, value, stat, window, action...
+    JsonDocument response;
+    response["type"] = "rule_added";
+    
+    String when = doc["when"] | "";
+    if (when.length() == 0 && !doc["trigger"].isNull()) {
+      String stat = doc["stat"] | "value";
+      String operand = doc["trigger"] | "";
+      if (stat != "value") {
+        String window = doc["window"] | windowLabel(config.statWindows[0]);
+        operand = stat + "(" + operand + ", " + window + ")";
+      }
+      when = operand + " " + (doc["condition"] | ">") + " " + String(doc["value"] | 0.0f);
+    }
+    
+    String message;
+    bool constant = false;
+    AutomationRule* rule = automation.compile(when.c_str(), constant);
+    
+    if (!rule) {
+      message = automation.error();
+      if (automation.count() < MAX_RULES) message += String(" at ") + automation.errorAt();
+    } else {
+      if (!doc["action"].isNull()) {
+        Automation::addAction(*rule, doc["action"], doc["actionState"] | false, doc["actionValue"] | -1, false);
+      }
+      for (JsonObject a : doc["actions"].as<JsonArray>()) {
+        Automation::addAction(*rule, a["id"], a["state"] | false, a["value"] | -1, false);
+      }
+      for (JsonObject a : doc["release"].as<JsonArray>()) {
+        Automation::addAction(*rule, a["id"], a["state"] | false, a["value"] | -1, true);
+      }
       
+      if (!automation.commit()) {
+        message = automation.error();
+      } else {
+        ruleFeed.sources = automation.sensors();
+        response["id"] = "rule" + String(rule->id);
+        response["instructions"] = rule->program.length;
+        if (constant) response["constant"] = true;
+      }
+    }
+    
+    response["success"] = message.length() == 0;
+    if (message.length() > 0) response["message"] = message;
+    response["ruleCount"] = automation.count();
+    String output;
+    serializeJson(response, output);
+    webSocket.queueTXT(num, output);
+  }
+  else if (type == "delete_rule") {
+    // {"type":"delete_rule","id":"rule3"}: ids as in rule_added and
+    // /api getAutomationRules
+    String id = doc["id"] | "";
+    long ruleId = id.startsWith("rule") ? id.substring(4).toInt() : 0;
+    
+    JsonDocument response;
+    response["type"] = "rule_deleted";
+    response["id"] = id;
+    bool removed = ruleId > 0 && ruleId <= 0xFFFF && automation.remove(ruleId);
+    response["success"] = removed;
+    if (removed) ruleFeed.sources = automation.sensors();
+    else response["message"] = "Unknown rule";
+    response["ruleCount"] = automation.count();
+    String output;
+    serializeJson(response, output);
+    webSocket.queueTXT(num, output);
+  }
+  else if (type == "scene") {
+    // {"type":"scene","relays":{"relay1":true,"relay3":false}}
+    // All listed relays switch in one register write
+    uint8_t select = 0, states = 0;
+    String bad;
+    for (JsonPair kv : doc["relays"].as<JsonObject>()) {
+      String id = kv.key().c_str();
+      int idx = id.startsWith("relay") ? id.substring(5).toInt() - 1 : -1;
+      if (idx < 0 || idx >= RELAY_COUNT || !(relays.enabled() & (1 << idx)) || !kv.value().is<bool>()) {
+        bad = id;
+        break;
+      }
+      select |= 1 << idx;
+      if (kv.value().as<bool>()) states |= 1 << idx;
+    }
+    
+    if (bad.length() > 0 || select == 0) {
       JsonDocument response;
-      response["type"] = "rule_added";
-      response["ruleCount"] = ruleCount;
+      response["type"] = "scene";
+      response["success"] = false;
+      response["message"] = bad.length() > 0 ? "Unknown or disabled relay: " + bad : String("No relays");
       String output;
       serializeJson(response, output);
-      webSocket.sendTXT(num, output);
+      webSocket.queueTXT(num, output);
+    } else {
+      setRelays(select, states);
+      commandLatency.add(outputWrittenUs - commandRecvUs);
+      broadcastState();
     }
   }
   else if (type == "ping") {
-    webSocket.sendTXT(num, "{\"type\":\"pong\"}");
+    webSocket.queueTXT(num, "{\"type\":\"pong\"}");
   }
 }
 
+// ============== EVENT BUS ==============
+
+// Producers: serviceSensors() (a reading per channel) and the output
+// setters (a device change). Consumers drain their cursor once per pass.
+void setupEvents() {
+  events.subscribe(wsFeed, EVENT_TYPE(EVENT_SENSOR), EVENT_ALL_SOURCES, false);
+  events.subscribe(ruleFeed, EVENT_TYPE(EVENT_SENSOR), automation.sensors(), true);
+  events.subscribe(logFeed, EVENT_TYPE(EVENT_SENSOR), (1UL << SENSOR_COUNT) - 1, false);
+  events.subscribe(mqttFeed, EVENT_TYPE(EVENT_DEVICE), EVENT_ALL_SOURCES, true);
+  events.subscribe(meshFeed, EVENT_TYPE(EVENT_DEVICE), EVENT_ALL_SOURCES, true);
+  events.subscribe(rateFeed, EVENT_TYPE(EVENT_SENSOR), EVENT_ALL_SOURCES, false);
+}
+
+// level is the brightness or speed in %, 0 for relays
+void publishDevice(uint8_t device, bool state, float level, bool changed) {
+  events.publish(EVENT_DEVICE, device, level, (state ? EVENT_STATE : 0) | (changed ? EVENT_CHANGED : 0), millis());
+}
+
 // ============== DEVICE CONTROL ==============
 
-void setDeviceState(String deviceId, bool state, int value) {
+// DEVICE_* index of an enabled device, -1 for unknown or disabled ids
+int deviceIndex(const String& deviceId) {
+  for (int d = 0; d < DEVICE_COUNT; d++) {
+    if (deviceId != DEVICE_IDS[d]) continue;
+    if (d < RELAY_COUNT) return (relays.enabled() & (1 << d)) ? d : -1;
+    if (d == DEVICE_LED) return config.enableLED ? d : -1;
+    return config.enableMotor ? d : -1;
+  }
+  return -1;
+}
+
+void setDeviceState(String deviceId, bool state, int value, int transitionMs) {
+  if (transitionMs < 0) transitionMs = config.fadeTime;
+  if (transitionMs > MAX_TRANSITION_MS) transitionMs = MAX_TRANSITION_MS;
+  
+  int device = -1;
+  bool changed = false;
+  float level = 0;
+  if (value > 100) value = 100;
+  
   if (deviceId.startsWith("relay")) {
     int idx = deviceId.substring(5).toInt() - 1;
-    if (idx >= 0 && idx < 4 && config.enableRelays[idx]) {
+    if (idx >= 0 && idx < RELAY_COUNT && (relays.enabled() & (1 << idx))) {
+      device = idx;
+      changed = relayStates[idx] != state;
       relayStates[idx] = state;
-      digitalWrite(config.relayPins[idx], state ? HIGH : LOW);
+      relays.write<GpioRegs>(1 << idx, state ? 1 << idx : 0);
     }
   }
   else if (deviceId == "led1" && config.enableLED) {
+    device = DEVICE_LED;
+    changed = ledState != state || (value >= 0 && value != ledBrightness);
     ledState = state;
     if (value >= 0) ledBrightness = value;
-    ledcWrite(0, state ? map(ledBrightness, 0, 100, 0, 255) : 0);
+    level = ledBrightness;
+    writePWM(LED_PWM_CHANNEL, state ? map(ledBrightness, 0, 100, 0, pwmMaxDuty()) : 0, transitionMs);
   }
   else if (deviceId == "motor1" && config.enableMotor) {
+    device = DEVICE_MOTOR;
+    changed = motorState != state || (value >= 0 && value != motorSpeed);
     motorState = state;
     if (value >= 0) motorSpeed = value;
-    ledcWrite(1, state ? map(motorSpeed, 0, 100, 0, 255) : 0);
+    level = motorSpeed;
+    writePWM(MOTOR_PWM_CHANNEL, state ? map(motorSpeed, 0, 100, 0, pwmMaxDuty()) : 0, transitionMs);
   }
+  outputWrittenUs = monoUs();
   
   Serial.printf("[Control] %s = %s", deviceId.c_str(), state ? "ON" : "OFF");
   if (value >= 0) Serial.printf(" (value: %d)", value);
+  if (deviceId == "led1" || deviceId == "motor1") Serial.printf(" [%d ms]", transitionMs);
   Serial.println();
+  
+  if (device >= 0) publishDevice(device, state, level, changed);
+}
+
+// Switch several relays with one set and one clear register write.
+// select and states are bit masks, bit 0 = relay 1.
+void setRelays(uint8_t select, uint8_t states) {
+  select &= relays.enabled();
+  relays.write<GpioRegs>(select, states);
+  outputWrittenUs = monoUs();
+  
+  for (int i = 0; i < RELAY_COUNT; i++) {
+    if (!(select & (1 << i))) continue;
+    bool was = relayStates[i];
+    relayStates[i] = states & (1 << i);
+    Serial.printf("[Control] relay%d = %s (scene)\n", i + 1, relayStates[i] ? "ON" : "OFF");
+    publishDevice(i, relayStates[i], 0, relayStates[i] != was);
+  }
+}
+
+// Compares switching the enabled relays with digitalWrite pin by pin and
+// with the bank's register writes. Both rewrite the current states, so
+// no relay actually changes. Latency runs from the call to the last pin
+// written, skew from the first pin written to the last.
+void runRelayBench(uint32_t rounds) {
+  uint8_t mask = relays.enabled();
+  if (mask == 0) {
+    Serial.println("! No relays enabled");
+    return;
+  }
+  uint8_t states = 0;
+  for (int i = 0; i < RELAY_COUNT; i++) {
+    if (relayStates[i]) states |= 1 << i;
+  }
+  uint8_t on = mask & states, off = mask & ~states;
+  
+  uint64_t pinLatency = 0, pinSkew = 0, regLatency = 0, regSkew = 0;
+  uint32_t pinMax = 0, regMax = 0;
+  
+  for (uint32_t r = 0; r < rounds; r++) {
+    uint32_t start = ESP.getCycleCount(), first = 0, last = 0;
+    for (int i = 0; i < RELAY_COUNT; i++) {
+      if (!(mask & (1 << i))) continue;
+      digitalWrite(config.relayPins[i], relayStates[i] ? HIGH : LOW);
+      last = ESP.getCycleCount();
+      if (first == 0) first = last;
+    }
+    pinLatency += last - start;
+    pinSkew += last - first;
+    if (last - start > pinMax) pinMax = last - start;
+    
+    // Timed as its two halves so the gap between them is the skew; the
+    // combined write in setRelays() is the same two stores
+    start = ESP.getCycleCount();
+    relays.write<GpioRegs>(on, states);
+    first = ESP.getCycleCount();
+    relays.write<GpioRegs>(off, states);
+    last = ESP.getCycleCount();
+    if (!on || !off) first = last;
+    regLatency += last - start;
+    regSkew += last - first;
+    if (last - start > regMax) regMax = last - start;
+  }
+  
+  float nsPerCycle = 1000.0f / ESP.getCpuFreqMHz();
+  Serial.printf("[Bench] %d relays, %lu rounds, current states rewritten\n",
+    __builtin_popcount(mask), (unsigned long)rounds);
+  Serial.printf("  digitalWrite: latency %.0f ns avg / %.0f max, skew %.0f ns avg\n",
+    pinLatency * nsPerCycle / rounds, pinMax * nsPerCycle, pinSkew * nsPerCycle / rounds);
+  Serial.printf("  registers:    latency %.0f ns avg / %.0f max, skew %.0f ns avg\n",
+    regLatency * nsPerCycle / rounds, regMax * nsPerCycle, regSkew * nsPerCycle / rounds);
+}
+
+// ============== TIME & SCHEDULER ==============
+
+void setupTime() {
+  // SNTP keeps retrying in the background, so this also covers a station
+  // link that comes up later. Any reachable host works as the server.
+  sntp_set_time_sync_notification_cb(onTimeSync);
+  configTzTime(config.timezone, config.ntpServer);
+  Serial.printf("✓ SNTP: %s (TZ %s)\n", config.ntpServer, config.timezone);
+}
+
+// Runs on the lwIP task after each SNTP adjustment
+void onTimeSync(struct timeval* tv) {
+  timeSyncs++;
+  lastTimeSync = millis();
+}
+
+bool timeSynced() {
+  return time(nullptr) > 1609459200;  // 2021-01-01
+}
+
+// Monotonic microseconds since boot; 64-bit, so it does not wrap
+uint64_t monoUs() {
+  return esp_timer_get_time();
+}
+
+// Unix time in ms from the SNTP-disciplined clock, 0 until synced.
+// wallMs() * 1000 - monoUs() is the offset between the two clocks.
+uint64_t wallMs() {
+  if (!timeSynced()) return 0;
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// Seconds from now until the next local hh:mm (always > 0), -1 if unsynced
+long secondsUntil(int minuteOfDay) {
+  if (!timeSynced()) return -1;
+  
+  time_t now = time(nullptr);
+  struct tm local;
+  localtime_r(&now, &local);
+  
+  long nowSec = local.tm_hour * 3600L + local.tm_min * 60L + local.tm_sec;
+  long delta = minuteOfDay * 60L - nowSec;
+  if (delta <= 0) delta += 86400L;
+  return delta;
+}
+
+uint32_t scheduleAction(const char* deviceId, bool state, int value, int transitionMs,
+                        uint32_t delayMs, int dailyMinute) {
+  ScheduledAction action;
+  strlcpy(action.deviceId, deviceId, sizeof(action.deviceId));
+  action.state = state;
+  action.value = value;
+  action.transition = transitionMs;
+  action.dailyMinute = dailyMinute;
+  
+  uint32_t ticks = (delayMs + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+  return timers.schedule(ticks, action);
+}
+
+void processTimers() {
+  // Count whole ticks off millis() so the wheel stays exact across wrap
+  unsigned long now = millis();
+  while (now - lastTimerTick >= TIMER_TICK_MS) {
+    lastTimerTick += TIMER_TICK_MS;
+    timerTicks++;
+  }
+  
+  bool changed = false;
+  timers.advance(timerTicks, [&](uint32_t handle, ScheduledAction& action) {
+    setDeviceState(action.deviceId, action.state, action.value, action.transition);
+    changed = true;
+    
+    // Next day from the intended time: a wheel that fired a little early
+    // (tick rounding, SNTP steps) must not land on today's slot again
+    if (action.dailyMinute >= 0) {
+      long wait = secondsUntil(action.dailyMinute);
+      if (wait < 0) wait = 86400L;
+      else if (wait < DAILY_MARGIN_S) wait += 86400L;
+      timers.schedule(wait * (1000 / TIMER_TICK_MS), action);
+    }
+  });
+  
+  if (changed) broadcastState();
 }
 
 // ============== SENSOR READING ==============
 
-void readSensors() {
-  // Read DHT sensor
-  if (config.enableDHT && dhtSensor != nullptr) {
-    float newTemp = dhtSensor->readTemperature();
-    float newHum = dhtSensor->readHumidity();
+void setupSensors() {
+  for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+    sensorDrivers[d] = nullptr;
+    driverTask[d] = -1;
+  }
+  
+  if (config.enableDHT) sensorDrivers[DRIVER_DHT] = new DhtDriver(config.dhtPin, config.dhtType);
+  if (config.enableLight) sensorDrivers[DRIVER_LIGHT] = new AnalogDriver(config.lightPin);
+  if (config.enableMotion) sensorDrivers[DRIVER_MOTION] = new DigitalDriver(config.motionPin);
+  if (config.enableAuxDHT) sensorDrivers[DRIVER_AUX_DHT] = new DhtDriver(config.auxDhtPin, config.dhtType);
+  if (config.enableOneWire) sensorDrivers[DRIVER_ONEWIRE] = new OneWireDriver(config.oneWirePin);
+  
+  for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+    SensorDriver* driver = sensorDrivers[d];
+    if (!driver) continue;
+    
+    if (!driver->begin()) {
+      Serial.printf("  ! Sensor %s: not found\n", DRIVER_NAMES[d]);
+      continue;
+    }
+    
+    const SensorTiming& timing = config.sensorTiming[d];
+    const SensorAdaptive& bounds = config.sensorAdaptive[d];
+    sensorRates[d].begin(timing.period, bounds.floor, bounds.ceiling);
+    driverTask[d] = sensorScheduler.add(driver, sensorPeriod(d), timing.phase);
     
-    if (!isnan(newTemp)) temperature = newTemp;
-    if (!isnan(newHum)) humidity = newHum;
+    uint8_t channels = driver->channels();
+    if (d == DRIVER_ONEWIRE) channels = ((OneWireDriver*)driver)->probes();
+    for (uint8_t c = 0; c < channels; c++) sensorChannels[DRIVER_CHANNEL[d] + c].active = true;
+    
+    Serial.printf("  Sensor %s: every %u ms, phase %u ms, %u value(s)\n",
+      DRIVER_NAMES[d], timing.period, timing.phase, channels);
   }
+  for (uint8_t c = 0; c < CHANNEL_COUNT; c++) rateLast[c] = NAN;
+  if (config.adaptiveSampling) Serial.println("  Adaptive sampling on");
   
-  // Read light sensor
-  if (config.enableLight) {
-    int raw = analogRead(config.lightPin);
-    lightLevel = map(raw, 0, 4095, 0, 100);
+  sensorScheduler.begin(millis());
+  Serial.printf("✓ Sensor scheduler: %u driver(s)\n", sensorScheduler.size());
+}
+
+// Runs at most one driver step; a completed read updates its channels,
+// their rolling stats, and publishes by exception
+void serviceSensors() {
+  float values[ONEWIRE_MAX_PROBES];
+  int8_t task = sensorScheduler.poll(millis(), values);
+  if (task < 0) return;
+  
+  uint8_t d = 0;
+  while (d < DRIVER_COUNT && driverTask[d] != task) d++;
+  if (d == DRIVER_COUNT) return;
+  
+  uint8_t first = DRIVER_CHANNEL[d];
+  uint64_t readUs = monoUs();
+  uint8_t count = sensorDrivers[d]->channels();
+  for (uint8_t c = 0; c < count; c++) {
+    if (isnan(values[c])) continue;
+    SensorChannel& ch = sensorChannels[first + c];
+    bool changed = values[c] != ch.value;
+    ch.value = values[c];
+    ch.readUs = readUs;
+    events.publish(EVENT_SENSOR, first + c, values[c], changed ? EVENT_CHANGED : 0, millis());
   }
   
-  // Read motion sensor
-  if (config.enableMotion) {
-    motionDetected = digitalRead(config.motionPin) == HIGH;
+  // Primary readings also live in the globals used across the firmware
+  switch (d) {
+    case DRIVER_DHT:
+      if (!isnan(values[0])) temperature = values[0];
+      if (!isnan(values[1])) humidity = values[1];
+      break;
+    case DRIVER_LIGHT:
+      lightLevel = values[0];
+      break;
+    case DRIVER_MOTION:
+      motionDetected = values[0] > 0;
+      break;
+  }
+  
+  updateSensorStats(first, count);
+  sendSensorData();
+  
+  // One latency sample per read that went out in this pass
+  for (uint8_t c = 0; c < count; c++) {
+    if (sensorChannels[first + c].sentUs >= readUs) {
+      sensorLatency.add(sensorChannels[first + c].sentUs - readUs);
+      break;
+    }
+  }
+}
+
+int driverIndex(const char* name) {
+  for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+    if (strcmp(name, DRIVER_NAMES[d]) == 0) return d;
+  }
+  return -1;
+}
+
+// Updates the stored timing and re-phases a running driver from now
+void setSensorTiming(uint8_t driver, uint16_t period, uint16_t phase) {
+  config.sensorTiming[driver].period = max<uint16_t>(period, 10);
+  config.sensorTiming[driver].phase = phase;
+  const SensorAdaptive& bounds = config.sensorAdaptive[driver];
+  sensorRates[driver].begin(config.sensorTiming[driver].period, bounds.floor, bounds.ceiling);
+  if (driverTask[driver] >= 0) {
+    sensorScheduler.setTiming(driverTask[driver], sensorPeriod(driver), phase, millis());
+  }
+}
+
+// Period a driver runs at: its adaptive rate, or the configured period
+uint32_t sensorPeriod(uint8_t driver) {
+  return config.adaptiveSampling ? sensorRates[driver].period() : config.sensorTiming[driver].period;
+}
+
+// Start every rate over from the configured period (mode or bounds changed)
+void restartRates() {
+  for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+    const SensorAdaptive& bounds = config.sensorAdaptive[d];
+    sensorRates[d].begin(config.sensorTiming[d].period, bounds.floor, bounds.ceiling);
+    if (driverTask[d] >= 0) sensorScheduler.setPeriod(driverTask[d], sensorPeriod(d), millis());
   }
 }
 
+// Driver that fills a channel (DRIVER_CHANNEL is ascending)
+int8_t channelDriver(uint8_t channel) {
+  int8_t d = DRIVER_COUNT - 1;
+  while (d > 0 && DRIVER_CHANNEL[d] > channel) d--;
+  return d;
+}
+
+// Every pass: the largest change of each driver's channels since its
+// previous read, in deadbands, moves that driver's period
+void adaptSampling() {
+  float change[DRIVER_COUNT] = {};
+  bool read[DRIVER_COUNT] = {};
+  const Event* e;
+  while ((e = events.next(rateFeed))) {
+    uint8_t c = e->source;
+    float last = rateLast[c];
+    rateLast[c] = e->value;
+    if (isnan(last)) continue;
+    
+    int8_t d = channelDriver(c);
+    float step = max(config.sensorPublish[sensorChannels[c].publishAs].deadband, ADAPT_MIN_STEP);
+    change[d] = max(change[d], fabsf(e->value - last) / step);
+    read[d] = true;
+  }
+  if (!config.adaptiveSampling) return;
+  
+  for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+    if (!read[d] || driverTask[d] < 0) continue;
+    uint32_t before = sensorRates[d].period();
+    uint32_t period = sensorRates[d].update(change[d]);
+    if (period != before) sensorScheduler.setPeriod(driverTask[d], period, millis());
+  }
+}
+
+// ============== ROLLING STATISTICS ==============
+
+void setupStats() {
+  for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+    for (uint8_t w = 0; w < STAT_WINDOWS; w++) {
+      sensorStats[i][w].begin(config.statWindows[w] * 1000UL);
+    }
+  }
+}
+
+// O(1) per window: each reading is folded into the current bucket only
+void updateSensorStats(uint8_t first, uint8_t count) {
+  unsigned long now = millis();
+  for (uint8_t i = first; i < first + count; i++) {
+    if (!sensorEnabled(i)) continue;
+    float value = sensorValue(i);
+    for (uint8_t w = 0; w < STAT_WINDOWS; w++) {
+      sensorStats[i][w].add(value, now);
+    }
+  }
+}
+
+// Aggregate of one sensor over one window; NAN until it has samples
+float statValue(uint8_t sensor, uint8_t window, uint8_t stat) {
+  if (stat == STAT_VALUE) return sensorValue(sensor);
+  
+  return summaryStat(sensorStats[sensor][window].summary(millis()), stat);
+}
+
+int statWindowIndex(uint32_t seconds) {
+  for (int w = 0; w < STAT_WINDOWS; w++) {
+    if (config.statWindows[w] == seconds) return w;
+  }
+  return -1;
+}
+
+// "90", "90s", "5m", "1h" -> seconds (0 if invalid)
+uint32_t parseDuration(const char* text) {
+  char unit = 's';
+  long n = 0;
+  if (sscanf(text, "%ld%c", &n, &unit) < 1 || n <= 0) return 0;
+  if (unit == 'm') return n * 60;
+  if (unit == 'h') return n * 3600;
+  return unit == 's' ? n : 0;
+}
+
+String windowLabel(uint16_t seconds) {
+  if (seconds % 3600 == 0) return String(seconds / 3600) + "h";
+  if (seconds % 60 == 0) return String(seconds / 60) + "m";
+  return String(seconds) + "s";
+}
+
 // ============== SEND SENSOR DATA ==============
 
+// Set by setupSensors() for every channel a running driver fills
+bool sensorEnabled(uint8_t idx) {
+  return idx < CHANNEL_COUNT && sensorChannels[idx].active;
+}
+
+float sensorValue(uint8_t idx) {
+  switch (idx) {
+    case SENSOR_TEMP:   return temperature;
+    case SENSOR_HUM:    return humidity;
+    case SENSOR_LIGHT:  return lightLevel;
+    case SENSOR_MOTION: return motionDetected ? 1 : 0;
+  }
+  return idx < CHANNEL_COUNT ? sensorChannels[idx].value : 0;
+}
+
+int sensorIndex(const String& id) {
+  for (int i = 0; i < CHANNEL_COUNT; i++) {
+    if (id == sensorChannels[i].id) return i;
+  }
+  return -1;
+}
+
+// Report by exception over the channels read since the last call: a
+// reading goes out when it moved more than its deadband (no sooner than
+// minInterval), or after maxSilence as a keepalive.
 void sendSensorData() {
+  unsigned long now = millis();
+  
+  uint32_t fresh = 0;
+  const Event* e;
+  while ((e = events.next(wsFeed))) fresh |= 1UL << e->source;
+  
   JsonDocument doc;
   doc["type"] = "sensor_data";
-  doc["timestamp"] = millis();
+  doc["timestamp"] = now;           // millis(), kept for older clients
+  doc["tsUs"] = monoUs();
+  uint64_t wall = wallMs();
+  if (wall) doc["wallMs"] = wall;
   
   JsonArray sensors = doc["sensors"].to<JsonArray>();
+  uint8_t sent[CHANNEL_COUNT];
+  int count = 0;
   
-  if (config.enableDHT) {
-    JsonObject temp = sensors.add<JsonObject>();
-    temp["id"] = "temp1";
-    temp["type"] = "temperature";
-    temp["value"] = temperature;
-    temp["unit"] = "°C";
+  for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+    if (!(fresh & (1UL << i)) || !sensorEnabled(i)) continue;
+    
+    SensorChannel& ch = sensorChannels[i];
+    const SensorPublish& pub = config.sensorPublish[ch.publishAs];
+    float value = sensorValue(i);
+    unsigned long since = now - ch.lastSentAt;
+    
+    bool changed = !ch.published || fabs(value - ch.lastSent) > pub.deadband;
+    bool due = (changed && since >= pub.minInterval) || since >= pub.maxSilence * 1000UL;
     
-    JsonObject hum = sensors.add<JsonObject>();
-    hum["id"] = "hum1";
-    hum["type"] = "humidity";
-    hum["value"] = humidity;
-    hum["unit"] = "%";
+    if (!due) {
+      readingsSuppressed++;
+      continue;
+    }
+    
+    JsonObject sensor = sensors.add<JsonObject>();
+    sensor["id"] = ch.id;
+    sensor["type"] = ch.type;
+    if (i == SENSOR_MOTION) sensor["value"] = motionDetected;
+    else if (i == SENSOR_LIGHT) sensor["value"] = lightLevel;
+    else sensor["value"] = value;
+    if (ch.unit[0]) sensor["unit"] = ch.unit;
+    sensor["readUs"] = ch.readUs;
+    
+    JsonObject stats = sensor["stats"].to<JsonObject>();
+    for (uint8_t w = 0; w < STAT_WINDOWS; w++) {
+      StatsSummary sum = sensorStats[i][w].summary(now);
+      if (sum.count == 0) continue;
+      JsonObject win = stats[windowLabel(config.statWindows[w])].to<JsonObject>();
+      win["n"] = sum.count;
+      win["mean"] = sum.mean;
+      win["min"] = sum.min;
+      win["max"] = sum.max;
+      win["std"] = sum.stddev();
+      win["roc"] = sum.rate;
+    }
+    
+    ch.lastSent = value;
+    ch.lastSentAt = now;
+    ch.published = true;
+    readingsSent++;
+    sent[count++] = i;
+    
+    mqttPublishSensor(i);
+    mesh.setSensor(ch.id, value);
   }
   
-  if (config.enableLight) {
-    JsonObject light = sensors.add<JsonObject>();
-    light["id"] = "light1";
-    light["type"] = "light";
-    light["value"] = lightLevel;
-    light["unit"] = "%";
+  if (count == 0) {
+    framesSuppressed++;
+    return;
   }
+  doc["trace"] = ++sensorTrace;
   
-  if (config.enableMotion) {
-    JsonObject motion = sensors.add<JsonObject>();
-    motion["id"] = "motion1";
-    motion["type"] = "motion";
-    motion["value"] = motionDetected;
-  }
+  // Key = channels in this frame; a client that is behind gets it in place
+  // of a queued frame whose channels it covers
+  uint32_t key = 0;
+  for (int i = 0; i < count; i++) key |= 1UL << sent[i];
   
   String output;
   serializeJson(doc, output);
-  webSocket.broadcastTXT(output);
+  webSocket.broadcastQueued(output, WS_KIND_SENSOR, key);
+  
+  uint64_t sentUs = monoUs();
+  for (int i = 0; i < count; i++) sensorChannels[sent[i]].sentUs = sentUs;
 }
 
 // ============== BROADCAST STATE ==============
 
 void broadcastState() {
   String output = getStateJSON();
-  webSocket.broadcastTXT(output);
+  webSocket.broadcastQueued(output, WS_KIND_STATE);
 }
 
 String getStateJSON() {
@@ -1001,6 +2834,8 @@ String getStateJSON() {
   doc["wifiConnected"] = wifiConnected;
   doc["apMode"] = apMode;
   doc["uptime"] = millis() / 1000;
+  doc["timeSynced"] = timeSynced();
+  doc["pendingTimers"] = timers.size();
   
   // Sensor values
   doc["temperature"] = temperature;
@@ -1011,7 +2846,7 @@ String getStateJSON() {
   JsonArray devices = doc["devices"].to<JsonArray>();
   
   // Relays
-  for (int i = 0; i < 4; i++) {
+  for (int i = 0; i < RELAY_COUNT; i++) {
     if (config.enableRelays[i]) {
       JsonObject relay = devices.add<JsonObject>();
       relay["id"] = "relay" + String(i + 1);
@@ -1048,237 +2883,1537 @@ String getStateJSON() {
 
 String getConfigJSON() {
   JsonDocument doc;
+  configSchema.toJson(config, doc.to<JsonObject>());
   
-  doc["boardType"] = config.boardType;
-  doc["deviceName"] = config.deviceName;
-  doc["wifiSSID"] = config.wifiSSID;
-  doc["apSSID"] = config.apSSID;
-  doc["scriptURL"] = config.scriptURL;
-  
-  doc["relay1"] = config.relayPins[0];
-  doc["relay2"] = config.relayPins[1];
-  doc["relay3"] = config.relayPins[2];
-  doc["relay4"] = config.relayPins[3];
-  doc["ledPin"] = config.ledPin;
-  doc["motorPin"] = config.motorPin;
-  doc["dhtPin"] = config.dhtPin;
-  doc["dhtType"] = config.dhtType;
-  doc["lightPin"] = config.lightPin;
-  doc["motionPin"] = config.motionPin;
-  
-  doc["enableDHT"] = config.enableDHT;
-  doc["enableLight"] = config.enableLight;
-  doc["enableMotion"] = config.enableMotion;
-  doc["enableRelay1"] = config.enableRelays[0];
-  doc["enableRelay2"] = config.enableRelays[1];
-  doc["enableRelay3"] = config.enableRelays[2];
-  doc["enableRelay4"] = config.enableRelays[3];
-  doc["enableLED"] = config.enableLED;
-  doc["enableMotor"] = config.enableMotor;
-  doc["enableLogging"] = config.enableLogging;
-  
-  doc["sensorInterval"] = config.sensorInterval;
-  doc["logInterval"] = config.logInterval;
+  JsonObject publish = doc["publish"].to<JsonObject>();
+  for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+    JsonObject pub = publish[sensorChannels[i].id].to<JsonObject>();
+    pub["deadband"] = config.sensorPublish[i].deadband;
+    pub["minInterval"] = config.sensorPublish[i].minInterval;
+    pub["maxSilence"] = config.sensorPublish[i].maxSilence;
+  }
+  
+  JsonObject timing = doc["timing"].to<JsonObject>();
+  for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+    JsonObject t = timing[DRIVER_NAMES[d]].to<JsonObject>();
+    t["period"] = config.sensorTiming[d].period;
+    t["phase"] = config.sensorTiming[d].phase;
+    t["floor"] = config.sensorAdaptive[d].floor;
+    t["ceiling"] = config.sensorAdaptive[d].ceiling;
+  }
+  
+  JsonArray windows = doc["statWindows"].to<JsonArray>();
+  for (uint8_t w = 0; w < STAT_WINDOWS; w++) windows.add(config.statWindows[w]);
   
   String output;
   serializeJson(doc, output);
   return output;
 }
 
-// ============== AUTOMATION PROCESSING ==============
-
-void processAutomation() {
-  for (int i = 0; i < ruleCount; i++) {
-    if (!rules[i].enabled) continue;
-    
-    float sensorValue = 0;
-    String trigger = String(rules[i].triggerDevice);
-    
-    if (trigger == "temp1") sensorValue = temperature;
-    else if (trigger == "hum1") sensorValue = humidity;
-    else if (trigger == "light1") sensorValue = lightLevel;
-    else if (trigger == "motion1") sensorValue = motionDetected ? 1 : 0;
-    
-    bool conditionMet = false;
-    String cond = String(rules[i].condition);
-    
-    if (cond == ">") conditionMet = sensorValue > rules[i].triggerValue;
-    else if (cond == "<") conditionMet = sensorValue < rules[i].triggerValue;
-    else if (cond == "==") conditionMet = abs(sensorValue - rules[i].triggerValue) < 0.01;
-    else if (cond == ">=") conditionMet = sensorValue >= rules[i].triggerValue;
-    else if (cond == "<=") conditionMet = sensorValue <= rules[i].triggerValue;
-    
-    if (conditionMet) {
-      setDeviceState(String(rules[i].actionDevice), rules[i].actionState, rules[i].actionValue);
+String getMetricsJSON() {
+  JsonDocument doc;
+  
+  doc["uptime"] = millis() / 1000;
+  doc["freeHeap"] = ESP.getFreeHeap();
+  
+  JsonObject clock = doc["clock"].to<JsonObject>();
+  uint64_t mono = monoUs();
+  uint64_t wall = wallMs();
+  clock["monoUs"] = mono;
+  clock["synced"] = wall != 0;
+  clock["server"] = config.ntpServer;
+  clock["syncs"] = timeSyncs;
+  if (wall) {
+    clock["wallMs"] = wall;
+    clock["offsetUs"] = (int64_t)(wall * 1000 - mono);
+    clock["lastSyncAgo"] = (millis() - lastTimeSync) / 1000;
+  }
+  
+  JsonObject rules = doc["automation"].to<JsonObject>();
+  rules["rules"] = automation.count();
+  rules["instructions"] = automation.instructions;
+  rules["budgetHits"] = automation.budgetHits;
+  
+  JsonObject latency = doc["latency"].to<JsonObject>();
+  histogramJson(latency["command"].to<JsonObject>(), commandLatency);
+  histogramJson(latency["sensor"].to<JsonObject>(), sensorLatency);
+  
+  JsonObject publish = doc["publish"].to<JsonObject>();
+  publish["readingsSent"] = readingsSent;
+  publish["readingsSuppressed"] = readingsSuppressed;
+  publish["framesSuppressed"] = framesSuppressed;
+  publish["logsSent"] = logsSent;
+  publish["logsSuppressed"] = logsSuppressed;
+  
+  JsonObject up = doc["upstream"].to<JsonObject>();
+  up["requests"] = upstream.requests;
+  up["failures"] = upstream.failures;
+  up["handshakes"] = upstream.handshakes;
+  up["redirects"] = upstream.redirects;
+  up["lastLatencyMs"] = upstream.lastLatencyMs;
+  up["avgLatencyMs"] = upstream.avgLatencyMs;
+  up["maxLatencyMs"] = upstream.maxLatencyMs;
+  
+  JsonObject queue = doc["queue"].to<JsonObject>();
+  queue["ready"] = queueReady;
+  queue["depth"] = sampleQueue.depth();
+  queue["staged"] = sampleQueue.staged();
+  queue["segments"] = sampleQueue.segments();
+  queue["enqueued"] = sampleQueue.enqueued;
+  queue["drained"] = sampleQueue.drained;
+  queue["dropped"] = sampleQueue.dropped;
+  queue["corrupt"] = sampleQueue.corrupt;
+  queue["flashWrites"] = sampleQueue.flashWrites;
+  queue["unplaced"] = samplesUnplaced;
+  
+  JsonObject radio = doc["wifi"].to<JsonObject>();
+  radio["apActive"] = apMode;
+  radio["apStations"] = apMode ? WiFi.softAPgetStationNum() : 0;
+  radio["apTransitions"] = apTransitions;
+  radio["stationUp"] = stationUp;
+  
+  // Loop cost with the AP up vs down; gain is the relative drop in busy time
+  float avgUs[2] = {0, 0};
+  for (uint8_t m = 0; m < 2; m++) {
+    const LoopStats& stats = loopStats[m];
+    JsonObject mode = radio[m ? "loopApOn" : "loopApOff"].to<JsonObject>();
+    avgUs[m] = stats.loops ? (float)stats.busyUs / stats.loops : 0;
+    mode["loops"] = stats.loops;
+    mode["avgUs"] = avgUs[m];
+    mode["maxUs"] = stats.maxUs;
+    mode["loopsPerSec"] = stats.wallUs ? stats.loops * 1e6f / stats.wallUs : 0;
+  }
+  if (avgUs[0] > 0 && avgUs[1] > 0) radio["loopGainPct"] = (avgUs[1] - avgUs[0]) * 100 / avgUs[1];
+  
+  JsonObject ws = doc["websocket"].to<JsonObject>();
+  ws["clients"] = webSocket.connectedClients();
+  ws["maxClients"] = config.wsMaxClients;
+  ws["buildMaxClients"] = WEBSOCKETS_SERVER_CLIENT_MAX;
+  JsonArray wsClients = ws["perClient"].to<JsonArray>();
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (!webSocket.linked(num)) continue;
+    const WsClientStats& st = webSocket.stats(num);
+    JsonObject client = wsClients.add<JsonObject>();
+    client["num"] = num;
+    client["depth"] = webSocket.depth(num);
+    client["bytes"] = webSocket.queuedBytes(num);
+    client["maxDepth"] = st.maxDepth;
+    client["sent"] = st.sent;
+    client["replaced"] = st.replaced;
+    client["dropped"] = st.dropped;
+    client["blocked"] = st.blocked;
+  }
+  
+  JsonObject wdt = doc["watchdog"].to<JsonObject>();
+  wdt["resetReason"] = watchdog.resetReason();
+  wdt["panicSeconds"] = watchdog.panicSeconds();
+  wdt["stalls"] = watchdog.stalls;
+  JsonArray stages = wdt["stages"].to<JsonArray>();
+  for (uint8_t i = 0; i < watchdog.stages(); i++) {
+    JsonObject stage = stages.add<JsonObject>();
+    stage["name"] = watchdog.stageName(i);
+    stage["budgetMs"] = watchdog.budget(i);
+    stage["maxUs"] = watchdog.stats(i).maxUs;
+    stage["overruns"] = watchdog.stats(i).overruns;
+  }
+  if (watchdog.stalls > 0) stallJson(wdt["last"].to<JsonObject>(), watchdog.last());
+  if (watchdog.hasReport()) stallJson(wdt["previousBoot"].to<JsonObject>(), watchdog.report());
+  
+  JsonObject serial = doc["serial"].to<JsonObject>();
+  serial["framesIn"] = framesIn;
+  serial["framesOut"] = framesOut;
+  serial["frameErrors"] = frameErrors;
+  serial["streamPeriodMs"] = streamPeriod;
+  
+  JsonObject broker = doc["mqtt"].to<JsonObject>();
+  broker["enabled"] = mqtt.enabled();
+  broker["connected"] = mqtt.connected();
+  broker["pending"] = mqtt.pending();
+  broker["published"] = mqtt.published;
+  broker["coalesced"] = mqtt.coalesced;
+  broker["unchanged"] = mqtt.unchanged;
+  broker["overflow"] = mqtt.overflow;
+  broker["failures"] = mqtt.failures;
+  broker["connects"] = mqtt.connects;
+  broker["commands"] = mqtt.commands;
+  
+  JsonObject meshInfo = doc["mesh"].to<JsonObject>();
+  const MeshStats& ms = mesh.stats();
+  meshInfo["mode"] = mesh.mode();
+  meshInfo["hubs"] = mesh.hubCount();
+  meshInfo["version"] = mesh.hub(0).version;
+  meshInfo["acked"] = mesh.acked();
+  meshInfo["sent"] = ms.sent;
+  meshInfo["received"] = ms.received;
+  meshInfo["rejected"] = ms.rejected;
+  meshInfo["deltasSent"] = ms.deltasSent;
+  meshInfo["deltasApplied"] = ms.deltasApplied;
+  meshInfo["resyncs"] = ms.resyncs;
+  meshInfo["commandsRouted"] = ms.commandsRouted;
+  meshInfo["commandsFailed"] = ms.commandsFailed;
+  
+  // Duty cycle is the awake share since the mode was set; awake time per
+  // sensor read times the board's awake current gives the energy per sample
+  JsonObject pwr = doc["power"].to<JsonObject>();
+  uint64_t elapsedUs = monoUs() - power.sinceUs;
+  uint64_t awakeUs = elapsedUs - power.idleUs;
+  uint32_t reads = sensorReads() - power.readsAtStart;
+  pwr["mode"] = POWER_NAMES[config.powerMode];
+  pwr["lightSleep"] = lightSleep;
+  pwr["waits"] = power.waits;
+  pwr["busy"] = power.busy;
+  pwr["wakeNetwork"] = power.wakeNetwork;
+  pwr["wakeDeadline"] = power.wakeDeadline;
+  pwr["idleMs"] = (uint32_t)(power.idleUs / 1000);
+  pwr["awakeMs"] = (uint32_t)(awakeUs / 1000);
+  pwr["dutyPct"] = elapsedUs ? awakeUs * 100.0f / elapsedUs : 100;
+  pwr["reads"] = reads;
+  pwr["awakeMsPerRead"] = reads ? awakeUs / 1000.0f / reads : 0;
+  
+  JsonObject bus = doc["events"].to<JsonObject>();
+  bus["published"] = events.published();
+  bus["capacity"] = events.capacity();
+  const char* const feedNames[] = {"websocket", "rules", "logging", "mqtt", "mesh"};
+  const EventCursor* feeds[] = {&wsFeed, &ruleFeed, &logFeed, &mqttFeed, &meshFeed};
+  for (uint8_t i = 0; i < 5; i++) {
+    JsonObject feed = bus[feedNames[i]].to<JsonObject>();
+    feed["delivered"] = feeds[i]->delivered;
+    feed["missed"] = feeds[i]->missed;
+    feed["behind"] = events.behind(*feeds[i]);
+  }
+  
+  JsonArray acquisition = doc["sensors"].to<JsonArray>();
+  for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+    if (driverTask[d] < 0) continue;
+    const SensorTaskStats& st = sensorScheduler.stats(driverTask[d]);
+    JsonObject task = acquisition.add<JsonObject>();
+    task["name"] = DRIVER_NAMES[d];
+    task["period"] = sensorScheduler.period(driverTask[d]);
+    task["phase"] = sensorScheduler.phase(driverTask[d]);
+    task["readsPerMin"] = 60000.0f / sensorScheduler.period(driverTask[d]);
+    task["basePeriod"] = config.sensorTiming[d].period;
+    if (config.adaptiveSampling) {
+      const AdaptiveRate& rate = sensorRates[d];
+      task["floor"] = rate.floor();
+      task["ceiling"] = rate.ceiling();
+      task["activity"] = rate.activity();
+      task["speedUps"] = rate.speedUps;
+      task["backOffs"] = rate.backOffs;
     }
+    task["reads"] = st.reads;
+    task["failures"] = st.failures;
+    task["avgReadUs"] = (uint32_t)st.avgReadUs;
+    task["maxReadUs"] = st.maxReadUs;
+    task["avgJitterMs"] = st.avgJitterMs;
+    task["maxJitterMs"] = st.maxJitterMs;
   }
+  
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+// ============== AUTOMATION PROCESSING ==============
+
+// The rule table itself lives in Automation (host-buildable, see
+// esp32/src/sim); here it only gets the clock and the outputs.
+void processAutomation() {
+  if (automation.tick(millis(), ruleOutputs)) broadcastState();
+}
+
+void DeviceSink::ruleAction(uint8_t rule, const RuleAction& action, uint32_t nowMs) {
+  setDeviceState(String(action.device), action.state, action.value);
+}
+
+int HubSymbols::sensor(const char* name, uint8_t length) {
+  for (int i = 0; i < CHANNEL_COUNT; i++) {
+    const char* id = sensorChannels[i].id;
+    if (strlen(id) == length && strncmp(id, name, length) == 0) return i;
+  }
+  return -1;
+}
+
+int HubSymbols::stat(const char* name, uint8_t length) {
+  return statIndex(name, length);
+}
+
+int HubSymbols::window(uint32_t seconds) {
+  return statWindowIndex(seconds);
+}
+
+float HubSymbols::read(uint8_t sensor, uint8_t stat, uint8_t window) {
+  return statValue(sensor, window, stat);
 }
 
 // ============== GOOGLE SHEETS LOGGING ==============
 
+uint8_t relayMask() {
+  uint8_t mask = 0;
+  for (int i = 0; i < RELAY_COUNT; i++) {
+    if (relayStates[i]) mask |= 1 << i;
+  }
+  return mask;
+}
+
+// A row is worth logging if any sensor left its deadband or a relay
+// switched since the last row, or the heartbeat is due.
+bool loggingDue() {
+  if (logsSent == 0 || millis() - lastLogSent >= config.logHeartbeat * 1000UL) return true;
+  if (relayMask() != lastLoggedRelays) return true;
+  return logChanged;
+}
+
+// Every pass: readings of the logged channels against the values last
+// logged, so a change between two log ticks is not lost
+void trackLoggedChanges() {
+  const Event* e;
+  while ((e = events.next(logFeed))) {
+    if (fabs(e->value - sensorChannels[e->source].lastLogged) > config.sensorPublish[e->source].deadband) {
+      logChanged = true;
+    }
+  }
+}
+
+// Every logged sample goes to the local history; Google Sheets, when
+// enabled, receives a copy through the upload path and offline queue
 void logToGoogleSheets() {
+  for (uint8_t i = 0; i < SENSOR_COUNT; i++) sensorChannels[i].lastLogged = sensorValue(i);
+  lastLoggedRelays = relayMask();
+  lastLogSent = millis();
+  logChanged = false;
+  logsSent++;
+  
+  SampleRecord sample = captureSample();
+  recordHistory(sample);
+  
+  if (!config.enableLogging || strlen(config.scriptURL) == 0) return;
+  
+  // Keep upstream order: while a backlog exists, new samples queue behind it
+  if (wifiConnected && (!queueReady || sampleQueue.depth() == 0) && uploadSample(sample)) {
+    return;
+  }
+  
+  if (queueReady) {
+    sampleQueue.setPushInterval(config.logInterval * 1000UL);
+    sampleQueue.push(sample);
+    Serial.printf("[Sheets] Queued offline (%u pending)\n", sampleQueue.depth());
+  }
+}
+
+SampleRecord captureSample() {
+  SampleRecord sample;
+  memset(&sample, 0, sizeof(sample));
+  
+  if (timeSynced()) {
+    sample.time = time(nullptr);
+  } else {
+    sample.time = monoUs() / 1000000;
+    sample.flags |= SAMPLE_FLAG_UPTIME;
+  }
+  sample.temperature = lroundf(temperature * 100);
+  sample.humidity = lroundf(humidity * 100);
+  sample.light = lightLevel;
+  if (motionDetected) sample.flags |= SAMPLE_FLAG_MOTION;
+  sample.flags |= relayMask() << 1;
+  
+  return sample;
+}
+
+// Percent-encode text into buf at pos; returns the new length
+static size_t appendUrlEncoded(char* buf, size_t pos, size_t size, const char* text) {
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+  for (; *text && pos + 4 < size; text++) {
+    char c = *text;
+    if (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      buf[pos++] = c;
+    } else {
+      buf[pos++] = '%';
+      buf[pos++] = HEX_DIGITS[(c >> 4) & 0x0F];
+      buf[pos++] = HEX_DIGITS[c & 0x0F];
+    }
+  }
+  buf[pos] = '\0';
+  return pos;
+}
+
+// Form-encode one sample into a caller-sized buffer (0 if it does not fit)
+size_t encodeSample(char* buf, size_t size, const SampleRecord& sample) {
+  size_t len = snprintf(buf, size, "action=log&deviceId=");
+  len = appendUrlEncoded(buf, len, size, config.deviceName);
+  
+  len += snprintf(buf + len, size - len,
+    "&temp=%.2f&humidity=%.2f&light=%u&motion=%u&relay1=%u&relay2=%u&relay3=%u&relay4=%u&seq=%lu",
+    sample.temperature / 100.0f, sample.humidity / 100.0f, sample.light,
+    sample.flags & SAMPLE_FLAG_MOTION ? 1 : 0,
+    sample.flags & 0x02 ? 1 : 0, sample.flags & 0x04 ? 1 : 0,
+    sample.flags & 0x08 ? 1 : 0, sample.flags & 0x10 ? 1 : 0,
+    (unsigned long)sample.seq);
+  if (len < size && !(sample.flags & SAMPLE_FLAG_UPTIME)) {
+    len += snprintf(buf + len, size - len, "&ts=%lu", (unsigned long)sample.time);
+  }
+  
+  return len < size ? len : 0;
+}
+
+// An uptime sample queued by an earlier boot: its clock is gone
+static bool sampleUnplaced(const SampleRecord& sample) {
+  return (sample.flags & SAMPLE_FLAG_UPTIME) && sample.seq < sampleQueue.bootSeq();
+}
+
+// Form-encode a logBatch request: rows "time_temp_hum_light_flags" joined
+// by '~' (all URL-safe). Stops at the first row that would not fit and
+// reports how many samples the body accounts for. Uptime samples queued
+// by an earlier boot have no clock to resolve against and are skipped;
+// they count as encoded so the queue moves past them. Returns 0 when no
+// row made it into the body.
+size_t encodeBatch(char* buf, size_t size, const SampleRecord* samples, size_t count, size_t& encoded) {
+  encoded = 0;
+  size_t len = snprintf(buf, size, "action=logBatch&deviceId=");
+  len = appendUrlEncoded(buf, len, size, config.deviceName);
+  len += snprintf(buf + len, size - len, "&uptime=%lu&rows=", (unsigned long)(monoUs() / 1000000));
+  if (len >= size) return 0;
+  
+  size_t rows = 0;
+  for (size_t i = 0; i < count; i++) {
+    const SampleRecord& s = samples[i];
+    if (sampleUnplaced(s)) {
+      encoded++;
+      continue;
+    }
+    
+    char row[48];
+    int n = snprintf(row, sizeof(row), "%s%s%lu_%d_%u_%u_%u",
+      rows > 0 ? "~" : "", s.flags & SAMPLE_FLAG_UPTIME ? "u" : "",
+      (unsigned long)s.time, s.temperature, s.humidity, s.light,
+      s.flags & (SAMPLE_FLAG_MOTION | SAMPLE_FLAG_RELAYS));
+    
+    if (len + n >= size) break;
+    memcpy(buf + len, row, n + 1);
+    len += n;
+    encoded++;
+    rows++;
+  }
+  
+  return rows > 0 ? len : 0;
+}
+
+bool uploadSample(const SampleRecord& sample) {
+  char body[UPSTREAM_BODY_SIZE];
+  size_t len = encodeSample(body, sizeof(body), sample);
+  if (len == 0) return false;
+  
+  if (upstream.post(body, len)) {
+    Serial.printf("[Sheets] Data logged successfully (%lu ms)\n", (unsigned long)upstream.lastLatencyMs);
+    return true;
+  }
+  
+  Serial.printf("[Sheets] Failed after %lu ms\n", (unsigned long)upstream.lastLatencyMs);
+  return false;
+}
+
+// ============== OFFLINE QUEUE ==============
+
+void setupQueue() {
+  if (!LittleFS.begin(true)) {
+    Serial.println("✗ LittleFS mount failed - offline queue disabled");
+    return;
+  }
+  
+  queueReady = sampleQueue.begin(LittleFS, QUEUE_DIR, QUEUE_MAX_SEGMENTS);
+  Serial.printf("✓ Offline queue: %u samples pending\n", sampleQueue.depth());
+}
+
+// Replays the backlog oldest-first as one logBatch request per pass. A
+// failed upload leaves the batch in place and backs off exponentially.
+void drainQueue() {
+  if (!queueReady || sampleQueue.depth() == 0) return;
   if (!wifiConnected || strlen(config.scriptURL) == 0) return;
   
-  HTTPClient http;
+  unsigned long now = millis();
+  if (now - lastDrainAttempt < drainBackoff) return;
+  lastDrainAttempt = now;
+  
+  static SampleRecord batch[QUEUE_DRAIN_BATCH];
+  static char body[UPSTREAM_BATCH_SIZE];
+  
+  size_t count = sampleQueue.peek(batch, QUEUE_DRAIN_BATCH);
+  size_t encoded = 0;
+  size_t len = encodeBatch(body, sizeof(body), batch, count, encoded);
+  
+  size_t unplaced = 0;
+  for (size_t i = 0; i < encoded; i++) {
+    if (sampleUnplaced(batch[i])) unplaced++;
+  }
+  
+  // A batch of nothing but unplaced samples has no body to send
+  bool sent = len > 0 ? upstream.post(body, len) : encoded > 0;
+  
+  if (sent) {
+    sampleQueue.pop(encoded);
+    samplesUnplaced += unplaced;
+    drainBackoff = 0;
+    Serial.printf("[Queue] Uploaded %u samples (%lu ms), %u pending\n",
+      (unsigned)(encoded - unplaced), (unsigned long)upstream.lastLatencyMs, sampleQueue.depth());
+    if (unplaced) Serial.printf("[Queue] Dropped %u samples without a time from an earlier boot\n", (unsigned)unplaced);
+  } else {
+    drainBackoff = drainBackoff == 0 ? QUEUE_RETRY_MS : min(drainBackoff * 2, QUEUE_RETRY_MAX_MS);
+    Serial.printf("[Queue] Upload failed, %u pending, retry in %lus\n",
+      sampleQueue.depth(), drainBackoff / 1000);
+  }
+}
+
+// ============== MQTT ==============
+
+void setupMqtt() {
+  if (!config.mqttEnabled) return;
+  
+  mqtt.begin(config.mqttHost, config.mqttPort, config.mqttUser, config.mqttPassword,
+             config.mqttPrefix, config.deviceName, config.mqttQos, mqttCommand);
+  
+  // Seed the retained state topics
+  for (int i = 0; i < RELAY_COUNT; i++) mqttPublishState("relay" + String(i + 1));
+  mqttPublishState("led1");
+  mqttPublishState("motor1");
+}
+
+// Retained state topics follow the device events
+void mqttPublishChanges() {
+  const Event* e;
+  while ((e = events.next(mqttFeed))) mqttPublishState(DEVICE_IDS[e->source]);
+}
+
+// cmd/<id> accepts ON/OFF/true/false/1/0 or {"state":..,"value":..,"transition":..}
+void mqttCommand(const char* id, const char* payload, size_t length) {
+  uint64_t recvUs = monoUs();
+  JsonDocument doc;
+  bool state;
+  int value = -1;
+  int transition = -1;
+  
+  if (deserializeJson(doc, payload, length) == DeserializationError::Ok && doc.is<JsonObject>()) {
+    state = doc["state"] | false;
+    value = doc["value"] | -1;
+    transition = doc["transition"] | -1;
+  } else {
+    state = strcasecmp(payload, "ON") == 0 || strcasecmp(payload, "true") == 0 ||
+            strcmp(payload, "1") == 0;
+  }
+  
+  Serial.printf("[MQTT] Command %s: %s\n", id, payload);
+  setDeviceState(String(id), state, value, transition);
+  commandLatency.add(outputWrittenUs - recvUs);
+  broadcastState();
+}
+
+void mqttPublishSensor(uint8_t idx) {
+  if (!mqtt.enabled()) return;
+  
+  char topic[MQTT_TOPIC_SIZE];
+  char payload[MQTT_PAYLOAD_SIZE];
+  snprintf(topic, sizeof(topic), "sensor/%s", sensorChannels[idx].id);
+  
+  if (idx == SENSOR_MOTION) {
+    snprintf(payload, sizeof(payload), "{\"value\":%s}", motionDetected ? "true" : "false");
+  } else if (idx == SENSOR_LIGHT) {
+    snprintf(payload, sizeof(payload), "{\"value\":%d,\"unit\":\"%s\"}", lightLevel, sensorChannels[idx].unit);
+  } else {
+    snprintf(payload, sizeof(payload), "{\"value\":%.2f,\"unit\":\"%s\"}", sensorValue(idx), sensorChannels[idx].unit);
+  }
+  mqtt.publish(topic, payload);
+}
+
+void mqttPublishState(const String& deviceId) {
+  if (!mqtt.enabled()) return;
+  
+  char payload[MQTT_PAYLOAD_SIZE];
+  if (deviceId.startsWith("relay")) {
+    int idx = deviceId.substring(5).toInt() - 1;
+    if (idx < 0 || idx >= 4 || !config.enableRelays[idx]) return;
+    snprintf(payload, sizeof(payload), "{\"state\":%s}", relayStates[idx] ? "true" : "false");
+  } else if (deviceId == "led1" && config.enableLED) {
+    snprintf(payload, sizeof(payload), "{\"state\":%s,\"brightness\":%d}", ledState ? "true" : "false", ledBrightness);
+  } else if (deviceId == "motor1" && config.enableMotor) {
+    snprintf(payload, sizeof(payload), "{\"state\":%s,\"speed\":%d}", motorState ? "true" : "false", motorSpeed);
+  } else {
+    return;
+  }
+  
+  String topic = "state/" + deviceId;
+  mqtt.publish(topic.c_str(), payload);
+}
+
+// ============== HUB MESH ==============
+
+// (Re)start with the configured mode; replication starts over under a
+// new epoch, seeded with the readings already published
+void startMesh() {
+  meshUdp.udp.stop();
+  meshJoined = false;
+  mesh.end();
+  if (config.meshMode == MESH_OFF) return;
+  
+  // Last four bytes of the factory MAC (getEfuseMac has the first byte
+  // lowest): stable across reboots and unique on a LAN
+  mesh.begin(config.meshMode, (uint32_t)(ESP.getEfuseMac() >> 16), esp_random(), config.deviceName,
+             MESH_PORT, meshUdp, meshEvents);
+  for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+    if (sensorChannels[i].published) mesh.setSensor(sensorChannels[i].id, sensorValue(i));
+  }
+  for (uint8_t i = 0; i < RELAY_COUNT; i++) {
+    if (config.enableRelays[i]) mesh.setDevice(DEVICE_IDS[i], relayStates[i], 0);
+  }
+  if (config.enableLED) mesh.setDevice("led1", ledState, ledBrightness);
+  if (config.enableMotor) mesh.setDevice("motor1", motorState, motorSpeed);
+  Serial.printf("✓ Mesh %s, hub id %lu\n", config.meshMode == MESH_AGGREGATOR ? "aggregator" : "peer",
+    (unsigned long)mesh.hub(0).id);
+}
+
+void serviceMesh() {
+  // Own devices as they change; the state version only moves when one did
+  const Event* e;
+  while ((e = events.next(meshFeed))) {
+    if (mesh.mode() != MESH_OFF) mesh.setDevice(DEVICE_IDS[e->source], e->flags & EVENT_STATE, e->value);
+  }
+  if (mesh.mode() == MESH_OFF) return;
+  
+  // Join the group once the station link is up, and again after an outage
+  if (wifiConnected != meshJoined) {
+    if (wifiConnected) meshUdp.udp.beginMulticast(IPAddress(MESH_GROUP_IP), MESH_PORT);
+    else meshUdp.udp.stop();
+    meshJoined = wifiConnected;
+  }
+  if (!meshJoined) return;
+  
+  uint8_t buf[MESH_PACKET_SIZE];
+  for (uint8_t n = 0; n < MESH_RX_BATCH && meshUdp.udp.parsePacket() > 0; n++) {
+    int len = meshUdp.udp.read(buf, sizeof(buf));
+    if (len <= 0) continue;
+    MeshAddr from = {(uint32_t)meshUdp.udp.remoteIP(), meshUdp.udp.remotePort()};
+    mesh.receive(from, buf, len, millis());
+  }
+  mesh.tick(millis());
+  
+  // Aggregator: one coalesced broadcast for any number of peer updates
+  if (meshDirty && millis() - lastMeshPush >= MESH_PUSH_MS) {
+    meshDirty = false;
+    lastMeshPush = millis();
+    webSocket.broadcastQueued(getHubsJSON(), WS_KIND_HUBS);
+  }
+}
+
+bool MeshEvents::meshCommand(const char* device, bool state, int16_t value) {
+  String id = device;
+  bool known = false;
+  if (id.startsWith("relay")) {
+    int idx = id.substring(5).toInt() - 1;
+    known = idx >= 0 && idx < RELAY_COUNT && config.enableRelays[idx];
+  } else if (id == "led1") {
+    known = config.enableLED;
+  } else if (id == "motor1") {
+    known = config.enableMotor;
+  }
+  if (!known) {
+    Serial.printf("! Mesh command for unknown device %s\n", device);
+    return false;
+  }
+  
+  Serial.printf("[Mesh] Command %s = %s\n", device, state ? "ON" : "OFF");
+  setDeviceState(id, state, value);
+  broadcastState();
+  return true;
+}
+
+void MeshEvents::meshChanged(uint8_t hub) {
+  if (mesh.mode() != MESH_AGGREGATOR || hub == 0) return;
+  meshDirty = true;
+}
+
+void MeshEvents::meshCommandDone(uint8_t hub, const char* device, bool ok) {
+  const MeshHub& h = mesh.hub(hub);
+  Serial.printf("[Mesh] %s/%s %s\n", h.name, device, ok ? "done" : "failed");
+  
+  JsonDocument doc;
+  doc["type"] = "routed";
+  doc["hub"] = h.name;
+  doc["id"] = device;
+  doc["success"] = ok;
+  String output;
+  serializeJson(doc, output);
+  webSocket.broadcastQueued(output, WS_KIND_REPLY);
+}
+
+// Aggregator view of the other hubs, same device fields as "state"
+String getHubsJSON() {
+  JsonDocument doc;
+  doc["type"] = "hubs";
+  doc["aggregator"] = config.deviceName;
+  JsonArray hubs = doc["hubs"].to<JsonArray>();
+  
+  for (uint8_t i = 1; i < mesh.hubCount(); i++) {
+    const MeshHub& h = mesh.hub(i);
+    JsonObject hub = hubs.add<JsonObject>();
+    hub["name"] = h.name;
+    hub["id"] = h.id;
+    hub["online"] = h.online;
+    hub["version"] = h.version;
+    JsonObject sensors = hub["sensors"].to<JsonObject>();
+    JsonArray devices = hub["devices"].to<JsonArray>();
+    for (uint8_t e = 0; e < h.count; e++) {
+      const MeshEntry& entry = h.entries[e];
+      if (!(entry.flags & MESH_ENTRY_DEVICE)) {
+        sensors[entry.key] = entry.value;
+        continue;
+      }
+      JsonObject device = devices.add<JsonObject>();
+      device["id"] = entry.key;
+      device["state"] = (entry.flags & MESH_ENTRY_STATE) != 0;
+      if (entry.value) device["value"] = entry.value;
+    }
+  }
+  
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+// Persist staged samples before a deliberate reboot
+void restartDevice() {
+  if (queueReady) sampleQueue.flush();
+  ESP.restart();
+}
+
+// ============== POWER ==============
+
+// Radio sleep and CPU clocking for config.powerMode; restarts the counters
+void setupPower() {
+  bool light = config.powerMode == POWER_LIGHT;
+  WiFi.setSleep(light ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM);
   
-  String url = String(config.scriptURL);
-  url += "?action=log";
-  url += "&device=" + String(config.deviceName);
-  url += "&temp=" + String(temperature);
-  url += "&humidity=" + String(humidity);
-  url += "&light=" + String(lightLevel);
-  url += "&motion=" + String(motionDetected ? 1 : 0);
+  // Light sleep is entered by the idle task whenever every task is blocked
+  // long enough, so it needs power management and tickless idle in the build
+  lightSleep = false;
+#if CONFIG_PM_ENABLE
+#if CONFIG_IDF_TARGET_ESP32S2
+  esp_pm_config_esp32s2_t pm = {};
+#else
+  esp_pm_config_esp32_t pm = {};
+#endif
+  pm.max_freq_mhz = getCpuFrequencyMhz();
+  pm.min_freq_mhz = light ? 80 : pm.max_freq_mhz;   // 80 MHz keeps WiFi's APB clock
+  pm.light_sleep_enable = light;
+  lightSleep = esp_pm_configure(&pm) == ESP_OK && light;
+#endif
+  if (light && !lightSleep) Serial.println("! Light sleep not supported by this build, using modem sleep");
+  
+  power = PowerStats();
+  power.sinceUs = monoUs();
+  power.readsAtStart = sensorReads();
+  Serial.printf("✓ Power mode: %s\n", POWER_NAMES[config.powerMode]);
+}
+
+uint32_t sensorReads() {
+  uint32_t reads = 0;
+  for (uint8_t i = 0; i < sensorScheduler.size(); i++) reads += sensorScheduler.stats(i).reads;
+  return reads;
+}
+
+// Work the next pass should do right away instead of waiting for a socket
+bool powerBusy() {
+  if (otaActive || inFrame || Serial.available()) return true;
+  if (mqtt.connected() && mqtt.pending()) return true;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (webSocket.depth(num)) return true;
+  }
+  return false;
+}
+
+// ms until the earliest timed job in loop(): sensor steps, automation,
+// logging, timers, fades, streaming, queue retries and the links' ticks.
+// Requests, commands and mesh packets arrive on sockets and end the wait.
+uint32_t nextDeadlineMs() {
+  unsigned long now = millis();
+  uint32_t wait = sensorScheduler.msUntilDue(now, POWER_MAX_IDLE_MS);
+  
+  auto until = [&](unsigned long due) {
+    long left = (long)(due - now);
+    if (left < 0) left = 0;
+    if ((uint32_t)left < wait) wait = left;
+  };
+  until(lastAutomationRun + config.sensorInterval * 1000UL);
+  until(lastDataLog + config.logInterval * 1000UL);
+  until(lastHeartbeat + 30000);
+  if (timers.size()) until(lastTimerTick + TIMER_TICK_MS);
+  for (uint8_t ch = 0; ch < PWM_CHANNEL_COUNT; ch++) {
+    if (pwmFades[ch].pending) until(pwmFades[ch].endTime);
+  }
+  if (streamPeriod) until(lastStreamed + streamPeriod);
+  if (queueReady && sampleQueue.depth() && wifiConnected) until(lastDrainAttempt + drainBackoff);
+  if (queueReady && sampleQueue.msUntilFlush() >= 0) until(now + sampleQueue.msUntilFlush());
+  if (mqtt.enabled()) until(now + POWER_MQTT_IDLE_MS);
+  if (mesh.mode() != MESH_OFF) until(now + POWER_MESH_IDLE_MS);
+  if (meshDirty) until(lastMeshPush + MESH_PUSH_MS);
+  return wait;
+}
+
+// Block in select() on every open lwIP socket (HTTP and WebSocket
+// listeners and clients, DNS, MQTT, mesh) until one is readable or the
+// next deadline. While the loop task is blocked the idle task runs, which
+// lets the radio doze and, in light mode, the chip sleep. Inputs read by
+// sensor drivers bound the wait through their period. The upstream
+// keep-alive sockets are only read during a post, so any the server has
+// closed are dropped first; at EOF they would end every wait at once.
+void idleUntilDeadline() {
+  if (config.powerMode == POWER_PERFORMANCE) return;
   
-  for (int i = 0; i < 4; i++) {
-    url += "&relay" + String(i+1) + "=" + String(relayStates[i] ? 1 : 0);
+  uint32_t waitMs = powerBusy() ? 0 : nextDeadlineMs();
+  if (waitMs < POWER_MIN_IDLE_MS) {
+    power.busy++;
+    return;
   }
   
-  http.begin(url);
-  http.setTimeout(5000);
-  int httpCode = http.GET();
+  upstream.dropClosed();
+  
+  fd_set readable;
+  FD_ZERO(&readable);
+  int maxFd = -1;
+  for (int fd = LWIP_SOCKET_OFFSET; fd < LWIP_SOCKET_OFFSET + CONFIG_LWIP_MAX_SOCKETS; fd++) {
+    if (fcntl(fd, F_GETFL, 0) < 0) continue;   // not open
+    FD_SET(fd, &readable);
+    maxFd = fd;
+  }
   
-  if (httpCode > 0) {
-    Serial.println("[Sheets] Data logged successfully");
+  watchdog.feed();
+  uint64_t start = monoUs();
+  int ready = 0;
+  if (maxFd < 0) {
+    delay(waitMs);
   } else {
-    Serial.printf("[Sheets] Failed: %s\n", http.errorToString(httpCode).c_str());
+    struct timeval timeout = {(time_t)(waitMs / 1000), (suseconds_t)(waitMs % 1000) * 1000};
+    ready = select(maxFd + 1, &readable, nullptr, nullptr, &timeout);
+  }
+  power.idleUs += monoUs() - start;
+  power.waits++;
+  if (ready > 0) power.wakeNetwork++;
+  else power.wakeDeadline++;
+}
+
+// ============== FIRMWARE UPDATE ==============
+
+// Keep a freshly installed image on trial: the Arduino core would
+// otherwise mark it valid at boot, before it has shown it works
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+
+void setupOta() {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  esp_ota_img_states_t state;
+  otaTrial = esp_ota_get_state_partition(running, &state) == ESP_OK &&
+             state == ESP_OTA_IMG_PENDING_VERIFY;
+  Serial.printf("✓ Firmware %s (%s)%s\n", esp_ota_get_app_description()->version, running->label,
+    otaTrial ? ", new image on trial" : "");
+}
+
+// A new image is kept once it has run OTA_CONFIRM_MS with the station
+// link up (if one is configured). A crash or reset before that, or no
+// link by OTA_TRIAL_MS, boots the previous image again.
+void serviceOta() {
+  if (!otaTrial) return;
+  
+  if (millis() >= OTA_CONFIRM_MS && (wifiConnected || !config.wifiSSID[0])) {
+    esp_ota_mark_app_valid_cancel_rollback();
+    otaTrial = false;
+    Serial.println("✓ [OTA] New firmware confirmed");
+  } else if (millis() >= OTA_TRIAL_MS) {
+    Serial.println("! [OTA] New firmware not confirmed, rolling back");
+    if (queueReady) sampleQueue.flush();
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+  }
+}
+
+// Multipart upload to POST /ota[?sha256=HEX]. Each chunk goes through
+// the pipeline straight into the inactive partition.
+void handleOtaUpload() {
+  HTTPUpload& upload = webServer.upload();
+  watchdog.enter(STAGE_OTA);
+  watchdog.feed();
+  
+  if (upload.status == UPLOAD_FILE_START) {
+    otaActive = false;
+    otaInstalled = false;
+    otaError = nullptr;
+    
+    uint8_t sha[OTA_SHA_SIZE];
+    String hex = webServer.arg("sha256");
+    bool hasSha = hex.length() > 0;
+    if (hasSha) {
+      if (hex.length() != OTA_SHA_SIZE * 2) return otaFailed("sha256 must be 64 hex digits");
+      for (int i = 0; i < OTA_SHA_SIZE; i++) {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], 0};
+        char* end;
+        sha[i] = strtoul(byte, &end, 16);
+        if (*end) return otaFailed("sha256 must be 64 hex digits");
+      }
+    }
+    
+    if (!Update.begin(UPDATE_SIZE_UNKNOWN)) return otaFailed(Update.errorString());
+    otaBase.part = esp_ota_get_running_partition();
+    ota.begin(otaImage, &otaBase, hasSha ? sha : nullptr);
+    otaActive = true;
+    otaStarted = millis();
+    Serial.printf("[OTA] Receiving %s\n", upload.filename.c_str());
+  }
+  else if (!otaActive) {
+    return;
+  }
+  else if (upload.status == UPLOAD_FILE_WRITE) {
+    if (!ota.write(upload.buf, upload.currentSize)) otaFailed(ota.error());
+  }
+  else if (upload.status == UPLOAD_FILE_END) {
+    // Nothing is set to boot unless the hash matched
+    if (!ota.finish()) return otaFailed(ota.error());
+    otaActive = false;
+    if (!Update.end(true)) return otaFailed(Update.errorString());
+    otaInstalled = true;
+    otaMs = millis() - otaStarted;
+    Serial.printf("✓ [OTA] %s: %u bytes received, %u byte image, %lu ms\n",
+      ota.format(), ota.received(), ota.imageSize(), otaMs);
   }
+  else if (upload.status == UPLOAD_FILE_ABORTED) {
+    otaFailed("Upload aborted");
+  }
+}
+
+void otaFailed(const char* message) {
+  if (otaActive) Update.abort();
+  ota.end();
+  otaActive = false;
+  otaError = message;
+  Serial.printf("! [OTA] %s\n", message);
+}
+
+String otaStatusJSON() {
+  JsonDocument doc;
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  const esp_app_desc_t* app = esp_ota_get_app_description();
+  doc["running"] = running->label;
+  doc["version"] = app->version;
+  doc["built"] = String(app->date) + " " + app->time;
+  doc["trial"] = otaTrial;
+  doc["canRollBack"] = Update.canRollBack();
   
-  http.end();
+  if (otaInstalled || otaError) {
+    JsonObject last = doc["last"].to<JsonObject>();
+    last["success"] = otaInstalled;
+    if (otaError) last["message"] = otaError;
+    last["format"] = ota.format();
+    last["received"] = ota.received();
+    last["image"] = ota.imageSize();
+    if (otaInstalled) {
+      char hex[OTA_SHA_SIZE * 2 + 1];
+      for (int i = 0; i < OTA_SHA_SIZE; i++) sprintf(hex + 2 * i, "%02x", ota.sha()[i]);
+      last["sha256"] = hex;
+      last["ms"] = otaMs;
+    }
+  }
+  
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+// Boot the other app partition; false if it holds no valid image
+bool otaRollback() {
+  if (!Update.canRollBack() || !Update.rollBack()) return false;
+  Serial.println("[OTA] Rolling back to the previous firmware");
+  return true;
 }
 
 // ============== SERIAL CONFIGURATION ==============
 
+// Consumes only the bytes already received, so a half-typed line never
+// stalls the loop. At most one text command runs per call.
 void handleSerial() {
-  if (Serial.available()) {
-    String cmd = Serial.readStringUntil('\n');
-    cmd.trim();
+  if (inFrame && millis() - frameStart > FRAME_TIMEOUT_MS) {
+    inFrame = false;
+    frameErrors++;
+  }
+  
+  while (Serial.available()) {
+    uint8_t c = Serial.read();
     
-    if (cmd == "help") {
-      printHelp();
-    }
-    else if (cmd == "config") {
-      printConfig();
-    }
-    else if (cmd == "status") {
-      Serial.println("\n=== SYSTEM STATUS ===");
-      Serial.printf("Uptime: %lu seconds\n", millis() / 1000);
-      Serial.printf("WiFi: %s\n", wifiConnected ? "Connected" : "Disconnected");
-      Serial.printf("AP Mode: %s\n", apMode ? "Active" : "Inactive");
-      Serial.printf("Temperature: %.1f°C\n", temperature);
-      Serial.printf("Humidity: %.1f%%\n", humidity);
-      Serial.printf("Light: %d%%\n", lightLevel);
-      Serial.printf("Motion: %s\n", motionDetected ? "Detected" : "None");
-    }
-    else if (cmd == "reset") {
-      Serial.println("Resetting configuration...");
-      resetConfig();
-      Serial.println("Done. Restarting...");
-      delay(500);
-      ESP.restart();
+    if (inFrame) {
+      feedFrame(c);
+      continue;
     }
-    else if (cmd == "restart") {
-      Serial.println("Restarting...");
-      delay(500);
-      ESP.restart();
-    }
-    else if (cmd.startsWith("wifi ")) {
-      // Parse: wifi SSID PASSWORD
-      int spaceIdx = cmd.indexOf(' ', 5);
-      if (spaceIdx > 0) {
-        String ssid = cmd.substring(5, spaceIdx);
-        String pass = cmd.substring(spaceIdx + 1);
-        ssid.toCharArray(config.wifiSSID, 64);
-        pass.toCharArray(config.wifiPassword, 64);
+    if (c == FRAME_SYNC && serialLineLen == 0) {
+      inFrame = true;
+      frameLen = 0;
+      frameStart = millis();
+      continue;
+    }
+    if (c == '\r') continue;
+    
+    if (c == '\n') {
+      bool overflow = serialLineOverflow;
+      serialLine[serialLineLen] = '\0';
+      serialLineLen = 0;
+      serialLineOverflow = false;
+      
+      if (overflow) {
+        Serial.println("! Command too long, ignored");
+      } else {
+        String cmd(serialLine);
+        cmd.trim();
+        runSerialCommand(cmd);
+      }
+      break;
+    }
+    
+    if (serialLineLen < SERIAL_LINE_SIZE - 1) serialLine[serialLineLen++] = c;
+    else serialLineOverflow = true;
+  }
+  
+  streamSamples();
+}
+
+// Serial setters share the schema's limits: out-of-range numbers and text
+// that does not fit are refused, never clamped or cut
+bool setField(Config& target, const char* key, const char* value) {
+  const ConfigField* field = configSchema.find(key);
+  if (field && configSchema.parse(target, *field, value)) return true;
+  Serial.printf("Invalid value for %s\n", key);
+  return false;
+}
+
+void runSerialCommand(String cmd) {
+  if (cmd == "help") {
+    printHelp();
+  }
+  else if (cmd == "config") {
+    printConfig();
+  }
+  else if (cmd == "status") {
+    Serial.println("\n=== SYSTEM STATUS ===");
+    Serial.printf("Uptime: %lu seconds\n", millis() / 1000);
+    Serial.printf("WiFi: %s\n", wifiConnected ? "Connected" : "Disconnected");
+    Serial.printf("AP Mode: %s\n", apMode ? "Active" : "Inactive");
+    Serial.printf("Temperature: %.1f°C\n", temperature);
+    Serial.printf("Humidity: %.1f%%\n", humidity);
+    Serial.printf("Light: %d%%\n", lightLevel);
+    Serial.printf("Motion: %s\n", motionDetected ? "Detected" : "None");
+    
+    if (timeSynced()) {
+      time_t now = time(nullptr);
+      struct tm local;
+      localtime_r(&now, &local);
+      Serial.printf("Time: %04d-%02d-%02d %02d:%02d:%02d\n",
+        local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+        local.tm_hour, local.tm_min, local.tm_sec);
+    } else {
+      Serial.println("Time: not synced");
+    }
+    Serial.printf("Pending timers: %u / %u\n", timers.size(), timers.capacity());
+    Serial.printf("Offline queue: %u pending, %u dropped\n",
+      sampleQueue.depth(), sampleQueue.dropped);
+    if (mqtt.enabled()) {
+      Serial.printf("MQTT: %s, %u pending\n",
+        mqtt.connected() ? "Connected" : "Disconnected", mqtt.pending());
+    }
+  }
+  else if (cmd == "metrics") {
+    Serial.println(getMetricsJSON());
+  }
+  else if (cmd == "reset") {
+    Serial.println("Resetting configuration...");
+    resetConfig();
+    Serial.println("Done. Restarting...");
+    delay(500);
+    restartDevice();
+  }
+  else if (cmd == "restart") {
+    Serial.println("Restarting...");
+    delay(500);
+    restartDevice();
+  }
+  else if (cmd.startsWith("wifi ")) {
+    // Parse: wifi SSID PASSWORD
+    int spaceIdx = cmd.indexOf(' ', 5);
+    if (spaceIdx > 0) {
+      Config next = config;
+      if (setField(next, "wifiSSID", cmd.substring(5, spaceIdx).c_str()) &&
+          setField(next, "wifiPassword", cmd.substring(spaceIdx + 1).c_str())) {
+        config = next;
         saveConfig();
         Serial.printf("WiFi credentials saved: %s\n", config.wifiSSID);
         Serial.println("Restart to apply: type 'restart'");
-      } else {
-        Serial.println("Usage: wifi SSID PASSWORD");
       }
+    } else {
+      Serial.println("Usage: wifi SSID PASSWORD");
     }
-    else if (cmd.startsWith("ap ")) {
-      int spaceIdx = cmd.indexOf(' ', 3);
-      if (spaceIdx > 0) {
-        String ssid = cmd.substring(3, spaceIdx);
-        String pass = cmd.substring(spaceIdx + 1);
-        ssid.toCharArray(config.apSSID, 32);
-        pass.toCharArray(config.apPassword, 32);
+  }
+  else if (cmd.startsWith("ap ")) {
+    int spaceIdx = cmd.indexOf(' ', 3);
+    if (spaceIdx > 0) {
+      Config next = config;
+      if (setField(next, "apSSID", cmd.substring(3, spaceIdx).c_str()) &&
+          setField(next, "apPassword", cmd.substring(spaceIdx + 1).c_str())) {
+        config = next;
         saveConfig();
         Serial.printf("AP credentials saved: %s\n", config.apSSID);
       }
+    } else {
+      Serial.println("Usage: ap SSID PASSWORD");
     }
-    else if (cmd.startsWith("name ")) {
-      String name = cmd.substring(5);
-      name.toCharArray(config.deviceName, 64);
+  }
+  else if (cmd.startsWith("name ")) {
+    if (setField(config, "deviceName", cmd.substring(5).c_str())) {
       saveConfig();
       Serial.printf("Device name: %s\n", config.deviceName);
     }
-    else if (cmd.startsWith("board ")) {
-      int type = cmd.substring(6).toInt();
-      if (type >= 0 && type <= 2) {
-        config.boardType = type;
-        applyBoardDefaults();
+  }
+  else if (cmd.startsWith("board ")) {
+    int type = cmd.substring(6).toInt();
+    if (type < 0 || type > BOARD_CUSTOM || !boardFitsChip(type)) {
+      Serial.printf("! Board %d does not fit this chip: %d (%s) or %d (custom)\n",
+        type, ChipBoard::ID, ChipBoard::name(), BOARD_CUSTOM);
+    } else {
+      config.boardType = type;
+      applyBoardDefaults();
+      saveConfig();
+      Serial.printf("Board type: %d (%s)\n", type, boardName(type));
+      Serial.println("Restart to apply new pin config");
+    }
+  }
+  else if (cmd.startsWith("pin ")) {
+    // Parse: pin <name> <gpio>
+    int idx1 = cmd.indexOf(' ');
+    int idx2 = cmd.indexOf(' ', idx1 + 1);
+    if (idx2 > 0) {
+      String pinName = cmd.substring(idx1 + 1, idx2);
+      String gpio = cmd.substring(idx2 + 1);
+      const ConfigField* field = configSchema.findPin(pinName.c_str());
+      
+      if (!field) {
+        Serial.println("Unknown pin name");
+      } else if (!configSchema.parse(config, *field, gpio.c_str())) {
+        Serial.printf("Invalid GPIO (0-%d)\n", CFG_MAX_GPIO);
+      } else {
         saveConfig();
-        Serial.printf("Board type: %d (%s)\n", type, 
-          type == 0 ? "ESP32 DevKit" : 
-          type == 1 ? "Lolin S2 Mini" : "Custom");
-        Serial.println("Restart to apply new pin config");
+        Serial.printf("Pin %s = GPIO %s\n", pinName.c_str(), gpio.c_str());
       }
     }
-    else if (cmd.startsWith("pin ")) {
-      // Parse: pin <name> <gpio>
-      int idx1 = cmd.indexOf(' ');
-      int idx2 = cmd.indexOf(' ', idx1 + 1);
-      if (idx2 > 0) {
-        String pinName = cmd.substring(idx1 + 1, idx2);
-        int gpio = cmd.substring(idx2 + 1).toInt();
-        
-        if (pinName == "led") config.ledPin = gpio;
-        else if (pinName == "motor") config.motorPin = gpio;
-        else if (pinName == "dht") config.dhtPin = gpio;
-        else if (pinName == "light") config.lightPin = gpio;
-        else if (pinName == "motion") config.motionPin = gpio;
-        else if (pinName == "relay1") config.relayPins[0] = gpio;
-        else if (pinName == "relay2") config.relayPins[1] = gpio;
-        else if (pinName == "relay3") config.relayPins[2] = gpio;
-        else if (pinName == "relay4") config.relayPins[3] = gpio;
-        else {
-          Serial.println("Unknown pin name");
-          return;
-        }
-        
+  }
+  else if (cmd.startsWith("set ")) {
+    // Parse: set <key> <value>, any scalar field of POST /config
+    int idx = cmd.indexOf(' ', 4);
+    String key = idx > 0 ? cmd.substring(4, idx) : cmd.substring(4);
+    const ConfigField* field = configSchema.find(key.c_str());
+    
+    Config next = config;
+    
+    if (!field || idx < 0) {
+      Serial.println(field ? "Usage: set KEY VALUE" : "Unknown setting (see 'config')");
+    } else if (!configSchema.parse(next, *field, cmd.substring(idx + 1).c_str()) ||
+               !boardFitsChip(next.boardType)) {
+      Serial.printf("Invalid value for %s\n", field->key);
+    } else {
+      config = next;
+      char value[64];
+      configSchema.format(config, *field, value, sizeof(value));
+      saveConfig();
+      Serial.printf("%s = %s\n", field->key, value);
+      Serial.println("Restart to apply: type 'restart'");
+    }
+  }
+  else if (cmd.startsWith("pwm ")) {
+    // Parse: pwm <freq> <bits>
+    int spaceIdx = cmd.indexOf(' ', 4);
+    if (spaceIdx > 0) {
+      Config next = config;
+      if (setField(next, "pwmFrequency", cmd.substring(4, spaceIdx).c_str()) &&
+          setField(next, "pwmResolution", cmd.substring(spaceIdx + 1).c_str())) {
+        config = next;
         saveConfig();
-        Serial.printf("Pin %s = GPIO %d\n", pinName.c_str(), gpio);
+        Serial.printf("PWM: %u Hz, %u bit\n", config.pwmFrequency, config.pwmResolution);
+        Serial.println("Restart to apply: type 'restart'");
       }
+    } else {
+      Serial.println("Usage: pwm FREQ BITS");
+    }
+  }
+  else if (cmd.startsWith("fade ")) {
+    config.fadeTime = constrain(cmd.substring(5).toInt(), 0, MAX_TRANSITION_MS);
+    saveConfig();
+    Serial.printf("Fade time: %u ms\n", config.fadeTime);
+  }
+  else if (cmd.startsWith("deadband ")) {
+    // Parse: deadband <sensor> <value> [minMs] [maxSilenceSec]
+    char name[16];
+    float deadband;
+    int minMs = -1, maxSec = -1;
+    int n = sscanf(cmd.c_str() + 9, "%15s %f %d %d", name, &deadband, &minMs, &maxSec);
+    int idx = n >= 2 && deadband >= 0 ? sensorIndex(String(name)) : -1;
+    
+    if (idx >= 0 && minMs <= 65535 && maxSec <= 65535) {
+      SensorPublish& sp = config.sensorPublish[sensorChannels[idx].publishAs];
+      sp.deadband = deadband;
+      if (minMs >= 0) sp.minInterval = minMs;
+      if (maxSec > 0) sp.maxSilence = maxSec;
+      saveConfig();
+      Serial.printf("%s: deadband %.2f, min %u ms, heartbeat %u s\n",
+        sensorChannels[idx].id, sp.deadband, sp.minInterval, sp.maxSilence);
+    } else {
+      Serial.println("Usage: deadband temp1|hum1|light1|motion1 VALUE [MIN_MS] [MAX_SILENCE_S]");
+    }
+  }
+  else if (cmd.startsWith("windows ")) {
+    // Parse: windows 1m 15m 1h
+    char w[STAT_WINDOWS][8];
+    int n = sscanf(cmd.c_str() + 8, "%7s %7s %7s", w[0], w[1], w[2]);
+    for (int i = 0; i < n && i < STAT_WINDOWS; i++) {
+      uint32_t sec = parseDuration(w[i]);
+      if (sec > 0 && sec <= 65535) config.statWindows[i] = sec;
+    }
+    saveConfig();
+    setupStats();
+    Serial.printf("Stat windows: %s %s %s\n", windowLabel(config.statWindows[0]).c_str(),
+      windowLabel(config.statWindows[1]).c_str(), windowLabel(config.statWindows[2]).c_str());
+  }
+  else if (cmd.startsWith("ntp ")) {
+    if (setField(config, "ntpServer", cmd.substring(4).c_str())) {
+      saveConfig();
+      setupTime();
+    }
+  }
+  else if (cmd.startsWith("tz ")) {
+    if (setField(config, "timezone", cmd.substring(3).c_str())) {
+      saveConfig();
+      setupTime();
+    }
+  }
+  else if (cmd.startsWith("sensor ")) {
+    // Parse: sensor <driver> <periodMs> [phaseMs]
+    char name[16];
+    int period = 0, phase = -1;
+    int n = sscanf(cmd.c_str() + 7, "%15s %d %d", name, &period, &phase);
+    int d = n >= 2 ? driverIndex(name) : -1;
+    
+    if (d >= 0 && period >= 10 && period <= 65535 && phase <= 65535) {
+      setSensorTiming(d, period, phase >= 0 ? phase : config.sensorTiming[d].phase);
+      saveConfig();
+      Serial.printf("Sensor %s: every %u ms, phase %u ms\n",
+        DRIVER_NAMES[d], config.sensorTiming[d].period, config.sensorTiming[d].phase);
+    } else {
+      Serial.println("Usage: sensor dht|light|motion|dht2|onewire PERIOD_MS [PHASE_MS]");
+    }
+  }
+  else if (cmd == "adapt on" || cmd == "adapt off") {
+    config.adaptiveSampling = cmd == "adapt on";
+    saveConfig();
+    restartRates();
+    Serial.printf("Adaptive sampling %s\n", config.adaptiveSampling ? "on" : "off");
+  }
+  else if (cmd.startsWith("adapt ")) {
+    // Parse: adapt <driver> <floorMs> <ceilingMs>
+    char name[16];
+    int floorMs = 0, ceilingMs = 0;
+    int n = sscanf(cmd.c_str() + 6, "%15s %d %d", name, &floorMs, &ceilingMs);
+    int d = n == 3 ? driverIndex(name) : -1;
+    
+    if (d >= 0 && floorMs >= 10 && ceilingMs >= floorMs && ceilingMs <= 65535) {
+      config.sensorAdaptive[d] = {(uint16_t)floorMs, (uint16_t)ceilingMs};
+      saveConfig();
+      restartRates();
+      Serial.printf("Sensor %s: adaptive %d-%d ms\n", DRIVER_NAMES[d], floorMs, ceilingMs);
+    } else {
+      Serial.println("Usage: adapt on|off | adapt dht|light|motion|dht2|onewire FLOOR_MS CEILING_MS");
     }
-    else if (cmd.startsWith("relay")) {
-      // Parse: relay1 on/off
-      int idx = cmd.charAt(5) - '1';
-      if (idx >= 0 && idx < 4 && cmd.length() > 7) {
-        bool state = cmd.endsWith("on");
-        setDeviceState("relay" + String(idx + 1), state, -1);
+  }
+  else if (cmd == "sensors") {
+    Serial.println("Driver    Period  Phase   Reads  Fail  Read avg/max us   Jitter avg/max ms");
+    for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+      if (driverTask[d] < 0) {
+        Serial.printf("%-8s  (off)\n", DRIVER_NAMES[d]);
+        continue;
       }
+      const SensorTaskStats& st = sensorScheduler.stats(driverTask[d]);
+      Serial.printf("%-8s  %6u  %5u  %6u  %4u  %7u/%-7u  %8.1f/%-6u\n", DRIVER_NAMES[d],
+        sensorScheduler.period(driverTask[d]), sensorScheduler.phase(driverTask[d]),
+        st.reads, st.failures, (unsigned)st.avgReadUs, st.maxReadUs,
+        st.avgJitterMs, st.maxJitterMs);
     }
-    else if (cmd.startsWith("led ")) {
-      if (cmd.endsWith("on")) setDeviceState("led1", true, -1);
-      else if (cmd.endsWith("off")) setDeviceState("led1", false, -1);
-      else {
-        int val = cmd.substring(4).toInt();
-        setDeviceState("led1", true, val);
+  }
+  else if (cmd == "rules") {
+    if (automation.count() == 0) Serial.println("No rules");
+    for (uint8_t i = 0; i < automation.count(); i++) {
+      const AutomationRule& rule = automation.rule(i);
+      Serial.printf("rule%u [%s] %s  (%u instr, fired %lu)\n", rule.id, rule.active ? "ON " : "off",
+        rule.source, rule.program.length, (unsigned long)rule.fired);
+      for (uint8_t a = 0; a < rule.actionCount; a++) {
+        Serial.printf("     %s %s = %s\n", rule.actions[a].onRelease ? "release:" : "then:   ",
+          rule.actions[a].device, rule.actions[a].state ? "ON" : "OFF");
       }
     }
-    else if (cmd.startsWith("motor ")) {
-      if (cmd.endsWith("on")) setDeviceState("motor1", true, -1);
-      else if (cmd.endsWith("off")) setDeviceState("motor1", false, -1);
-      else {
-        int val = cmd.substring(6).toInt();
-        setDeviceState("motor1", true, val);
+  }
+  else if (cmd == "latency") {
+    const char* names[] = {"command", "sensor"};
+    const LatencyHistogram* hists[] = {&commandLatency, &sensorLatency};
+    Serial.println("Path       Count    Mean us   p50 us   p90 us   p99 us   Max us");
+    for (uint8_t i = 0; i < 2; i++) {
+      const LatencyHistogram& h = *hists[i];
+      Serial.printf("%-8s %7lu %10lu %8lu %8lu %8lu %8lu\n", names[i], (unsigned long)h.count(),
+        (unsigned long)h.meanUs(), (unsigned long)h.percentile(50), (unsigned long)h.percentile(90),
+        (unsigned long)h.percentile(99), (unsigned long)h.maxUs());
+    }
+    uint64_t wall = wallMs();
+    if (wall) Serial.printf("Clock offset: %lld us (wall - mono)\n", (long long)(wall * 1000 - monoUs()));
+    else Serial.println("Clock offset: not synced");
+  }
+  else if (cmd == "bench" || cmd.startsWith("bench ")) {
+    long rounds = cmd.length() > 6 ? cmd.substring(6).toInt() : 1000;
+    runRelayBench(constrain(rounds, 1, 100000));
+  }
+  else if (cmd == "mesh") {
+    if (mesh.mode() == MESH_OFF) Serial.println("Mesh off");
+    for (uint8_t i = 0; i < mesh.hubCount(); i++) {
+      const MeshHub& h = mesh.hub(i);
+      Serial.printf("%-16s %10lu %-7s %s v%-6lu %u entries%s\n", h.name, (unsigned long)h.id,
+        h.online ? "online" : "offline", h.aggregator ? "agg " : "peer", (unsigned long)h.version,
+        h.count, i == 0 ? "  (this hub)" : i == mesh.aggregator() ? "  (aggregator)" : "");
+    }
+  }
+  else if (cmd.startsWith("mesh ")) {
+    String mode = cmd.substring(5);
+    if (mode == "off") config.meshMode = MESH_OFF;
+    else if (mode == "peer") config.meshMode = MESH_PEER;
+    else if (mode == "aggregator") config.meshMode = MESH_AGGREGATOR;
+    else {
+      Serial.println("! Usage: mesh off|peer|aggregator");
+      return;
+    }
+    saveConfig();
+    startMesh();
+  }
+  else if (cmd == "power") {
+    uint64_t elapsedUs = monoUs() - power.sinceUs;
+    Serial.printf("Power mode: %s%s\n", POWER_NAMES[config.powerMode],
+      config.powerMode == POWER_LIGHT && !lightSleep ? " (light sleep unavailable)" : "");
+    Serial.printf("Awake: %.1f%% of %lu s, %lu waits, %lu busy passes\n",
+      elapsedUs ? (elapsedUs - power.idleUs) * 100.0f / elapsedUs : 100.0f,
+      (unsigned long)(elapsedUs / 1000000), (unsigned long)power.waits, (unsigned long)power.busy);
+    Serial.printf("Woken by: network %lu, deadline %lu\n",
+      (unsigned long)power.wakeNetwork, (unsigned long)power.wakeDeadline);
+  }
+  else if (cmd.startsWith("power ")) {
+    String mode = cmd.substring(6);
+    uint8_t m = 0;
+    while (m <= POWER_LIGHT && mode != POWER_NAMES[m]) m++;
+    if (m > POWER_LIGHT) {
+      Serial.println("! Usage: power performance|modem|light");
+      return;
+    }
+    config.powerMode = m;
+    saveConfig();
+    setupPower();
+  }
+  else if (cmd == "ota") {
+    Serial.println(otaStatusJSON());
+  }
+  else if (cmd == "ota rollback") {
+    if (otaRollback()) restartDevice();
+    else Serial.println("! No previous firmware");
+  }
+  else if (cmd == "latency reset") {
+    commandLatency.reset();
+    sensorLatency.reset();
+    Serial.println("Latency histograms cleared");
+  }
+  else if (cmd == "watchdog") {
+    Serial.println("Stage       Budget ms   Max ms  Overruns");
+    for (uint8_t i = 0; i < watchdog.stages(); i++) {
+      Serial.printf("%-10s  %9u  %7.1f  %8lu\n", watchdog.stageName(i), watchdog.budget(i),
+        watchdog.stats(i).maxUs / 1000.0f, (unsigned long)watchdog.stats(i).overruns);
+    }
+    if (watchdog.stalls > 0) watchdog.printReport(Serial, watchdog.last());
+    if (config.watchdogPanic) Serial.printf("Panic reset after %u s stuck\n", config.watchdogPanic);
+    else Serial.println("Panic reset: off");
+  }
+  else if (cmd.startsWith("watchdog ")) {
+    String arg = cmd.substring(9);
+    config.watchdogPanic = arg == "off" ? 0 : constrain(arg.toInt(), 0, 60);
+    watchdog.setPanic(config.watchdogPanic);
+    saveConfig();
+    if (config.watchdogPanic) Serial.printf("Watchdog: reset after %u s stuck\n", config.watchdogPanic);
+    else Serial.println("Watchdog: panic reset off");
+  }
+  else if (cmd == "portal") {
+    openPortal("serial");
+  }
+  else if (cmd == "portal auto" || cmd == "portal always") {
+    config.apPolicy = cmd.endsWith("auto") ? AP_POLICY_AUTO : AP_POLICY_ALWAYS;
+    saveConfig();
+    Serial.printf("AP policy: %s\n", config.apPolicy == AP_POLICY_AUTO ? "auto" : "always on");
+  }
+  else if (cmd.startsWith("mqtt ")) {
+    // Parse: mqtt off | mqtt HOST [PORT] [QOS]
+    char host[SERIAL_LINE_SIZE], port[16] = "1883", qos[16] = "0";
+    int n = sscanf(cmd.c_str() + 5, "%255s %15s %15s", host, port, qos);
+    Config next = config;
+    
+    if (n >= 1 && strcmp(host, "off") == 0) {
+      config.mqttEnabled = false;
+      saveConfig();
+      Serial.println("MQTT disabled");
+      Serial.println("Restart to apply: type 'restart'");
+    } else if (n >= 1 && setField(next, "mqttHost", host) && setField(next, "mqttPort", port) &&
+               setField(next, "mqttQos", qos)) {
+      config = next;
+      config.mqttEnabled = true;
+      saveConfig();
+      Serial.printf("MQTT: %s:%u, QoS %u\n", config.mqttHost, config.mqttPort, config.mqttQos);
+      Serial.println("Restart to apply: type 'restart'");
+    }
+  }
+  else if (cmd.startsWith("relay")) {
+    // Parse: relay1 on/off
+    int idx = cmd.charAt(5) - '1';
+    if (idx >= 0 && idx < RELAY_COUNT && cmd.length() > 7) {
+      bool state = cmd.endsWith("on");
+      setDeviceState("relay" + String(idx + 1), state, -1);
+    }
+  }
+  else if (cmd.startsWith("led ")) {
+    if (cmd.endsWith("on")) setDeviceState("led1", true, -1);
+    else if (cmd.endsWith("off")) setDeviceState("led1", false, -1);
+    else {
+      int val = cmd.substring(4).toInt();
+      setDeviceState("led1", true, val);
+    }
+  }
+  else if (cmd.startsWith("motor ")) {
+    if (cmd.endsWith("on")) setDeviceState("motor1", true, -1);
+    else if (cmd.endsWith("off")) setDeviceState("motor1", false, -1);
+    else {
+      int val = cmd.substring(6).toInt();
+      setDeviceState("motor1", true, val);
+    }
+  }
+  else if (cmd.length() > 0) {
+    Serial.println("Unknown command. Type 'help' for available commands.");
+  }
+}
+
+// ============== SERIAL FRAMES ==============
+
+void feedFrame(uint8_t c) {
+  frameBuf[frameLen++] = c;
+  if (frameLen < 3) return;
+  
+  uint16_t length = frameBuf[1] | (frameBuf[2] << 8);
+  if (length > FRAME_MAX_PAYLOAD) {
+    inFrame = false;
+    frameErrors++;
+    return;
+  }
+  if (frameLen < length + 5) return;
+  
+  inFrame = false;
+  uint16_t crc = frameBuf[length + 3] | (frameBuf[length + 4] << 8);
+  if (crc != SampleQueue::crc16(frameBuf, length + 3)) {
+    frameErrors++;
+    sendFrameAck(false, "CRC mismatch");
+    return;
+  }
+  
+  framesIn++;
+  handleFrame(frameBuf[0], frameBuf + 3, length);
+}
+
+void handleFrame(uint8_t type, const uint8_t* payload, uint16_t length) {
+  switch (type) {
+    case FRAME_GET_CONFIG: {
+      String json = getConfigJSON();
+      sendFrame(FRAME_CONFIG, (const uint8_t*)json.c_str(), json.length());
+      break;
+    }
+    case FRAME_SET_CONFIG: {
+      JsonDocument doc;
+      if (deserializeJson(doc, payload, length) || !doc.is<JsonObject>()) {
+        sendFrameAck(false, "Invalid JSON");
+        break;
+      }
+      const char* bad = applyConfigJSON(doc);
+      if (bad) {
+        sendFrameAck(false, (String("Invalid value for ") + bad).c_str());
+        break;
       }
+      saveConfig();
+      sendFrameAck(true, "Configuration saved. Restart to apply.");
+      break;
+    }
+    case FRAME_GET_STATE: {
+      String json = getStateJSON();
+      sendFrame(FRAME_STATE, (const uint8_t*)json.c_str(), json.length());
+      break;
     }
-    else if (cmd.length() > 0) {
-      Serial.println("Unknown command. Type 'help' for available commands.");
+    case FRAME_STREAM: {
+      uint16_t period = length >= 2 ? payload[0] | (payload[1] << 8) : 0;
+      streamPeriod = period == 0 ? 0 : max(period, (uint16_t)FRAME_MIN_STREAM_MS);
+      lastStreamed = 0;
+      sendFrameAck(true, streamPeriod ? "Streaming" : "Stream stopped");
+      break;
     }
+    default:
+      sendFrameAck(false, "Unknown frame type");
+  }
+}
+
+// False if the payload is over FRAME_MAX_PAYLOAD; the host gets a failed
+// ACK in its place, since it would discard the frame
+bool sendFrame(uint8_t type, const uint8_t* payload, size_t length) {
+  if (length > FRAME_MAX_PAYLOAD) {
+    frameErrors++;
+    sendFrameAck(false, "Reply too long");
+    return false;
   }
+  
+  uint8_t header[4] = {FRAME_SYNC, type, (uint8_t)(length & 0xFF), (uint8_t)(length >> 8)};
+  uint16_t crc = SampleQueue::crc16(header + 1, 3);
+  crc = SampleQueue::crc16(payload, length, crc);
+  uint8_t trailer[2] = {(uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8)};
+  
+  Serial.write(header, sizeof(header));
+  Serial.write(payload, length);
+  Serial.write(trailer, sizeof(trailer));
+  framesOut++;
+  return true;
+}
+
+void sendFrameAck(bool success, const char* message) {
+  char json[96];
+  int n = snprintf(json, sizeof(json), "{\"success\":%s,\"message\":\"%s\"}",
+    success ? "true" : "false", message);
+  sendFrame(FRAME_ACK, (const uint8_t*)json, n);
+}
+
+// Latest sensor values as fixed binary records, no text formatting
+void streamSamples() {
+  if (streamPeriod == 0) return;
+  
+  unsigned long now = millis();
+  if (now - lastStreamed < streamPeriod) return;
+  lastStreamed = now;
+  
+  uint8_t payload[4 + sizeof(SampleRecord)];
+  SampleRecord sample = captureSample();
+  sample.seq = streamSeq++;
+  sample.crc = SampleQueue::crc16((const uint8_t*)&sample, sizeof(sample) - 2);
+  
+  uint32_t uptime = now;
+  memcpy(payload, &uptime, 4);
+  memcpy(payload + 4, &sample, sizeof(sample));
+  sendFrame(FRAME_SAMPLE, payload, sizeof(payload));
 }
 
 void printHelp() {
@@ -1289,6 +4424,7 @@ void printHelp() {
   Serial.println("║   help      - Show this help                              ║");
   Serial.println("║   config    - Show current configuration                  ║");
   Serial.println("║   status    - Show system status                          ║");
+  Serial.println("║   metrics   - Show runtime metrics (JSON)                 ║");
   Serial.println("║   restart   - Restart device                              ║");
   Serial.println("║   reset     - Factory reset                               ║");
   Serial.println("║                                                           ║");
@@ -1298,6 +4434,25 @@ void printHelp() {
   Serial.println("║   name DEVICE_NAME   - Set device name                    ║");
   Serial.println("║   board 0|1|2        - 0=DevKit, 1=S2Mini, 2=Custom       ║");
   Serial.println("║   pin <name> <gpio>  - Set pin (led/motor/dht/etc)        ║");
+  Serial.println("║   set KEY VALUE      - Set any config field by JSON key   ║");
+  Serial.println("║   pwm FREQ BITS      - Set PWM frequency and resolution   ║");
+  Serial.println("║   fade MS            - Set default LED/motor fade time    ║");
+  Serial.println("║   deadband ID V [MIN_MS] [MAX_S] - Sensor publish filter  ║");
+  Serial.println("║   windows W1 W2 W3   - Stat windows, e.g. 1m 15m 1h       ║");
+  Serial.println("║   sensor NAME MS [PHASE] - Sensor read period/offset      ║");
+  Serial.println("║   sensors            - Show acquisition timing stats      ║");
+  Serial.println("║   adapt on|off | adapt NAME FLOOR CEIL - Adaptive rates   ║");
+  Serial.println("║   ntp SERVER         - Set NTP server (host or IP)        ║");
+  Serial.println("║   tz POSIX_TZ        - Set timezone, e.g. WIB-7           ║");
+  Serial.println("║   mqtt HOST [PORT] [QOS] | mqtt off - MQTT broker         ║");
+  Serial.println("║   portal [auto|always] - Reopen AP / set AP policy        ║");
+  Serial.println("║   watchdog [SEC|off] - Stall stats / panic reset timeout  ║");
+  Serial.println("║   latency [reset]    - Command/sensor latency histograms  ║");
+  Serial.println("║   rules              - List automation rules              ║");
+  Serial.println("║   bench [ROUNDS]     - Relay switching: pins vs registers ║");
+  Serial.println("║   ota [rollback]     - Firmware status / boot previous    ║");
+  Serial.println("║   mesh [off|peer|aggregator] - Hubs / multi-hub mode      ║");
+  Serial.println("║   power [performance|modem|light] - Sleep between ticks   ║");
   Serial.println("║                                                           ║");
   Serial.println("║ CONTROL:                                                  ║");
   Serial.println("║   relay1 on|off      - Control relay 1-4                  ║");
@@ -1308,47 +4463,42 @@ void printHelp() {
 
 void printConfig() {
   Serial.println("\n═══════════ CURRENT CONFIGURATION ═══════════");
-  Serial.printf("Device Name: %s\n", config.deviceName);
-  Serial.printf("Board Type:  %s\n", 
-    config.boardType == 0 ? "ESP32 DevKit" : 
-    config.boardType == 1 ? "Lolin S2 Mini" : "Custom");
-  
-  Serial.println("\n--- WiFi ---");
-  Serial.printf("SSID: %s\n", strlen(config.wifiSSID) > 0 ? config.wifiSSID : "(not set)");
-  Serial.printf("AP SSID: %s\n", config.apSSID);
-  
-  Serial.println("\n--- Pins ---");
-  Serial.printf("Relays: %d, %d, %d, %d\n", 
-    config.relayPins[0], config.relayPins[1], 
-    config.relayPins[2], config.relayPins[3]);
-  Serial.printf("LED: %d, Motor: %d\n", config.ledPin, config.motorPin);
-  Serial.printf("DHT: %d (type %d)\n", config.dhtPin, config.dhtType);
-  Serial.printf("Light: %d, Motion: %d\n", config.lightPin, config.motionPin);
-  
-  Serial.println("\n--- Features ---");
-  Serial.printf("DHT: %s, Light: %s, Motion: %s\n",
-    config.enableDHT ? "ON" : "OFF",
-    config.enableLight ? "ON" : "OFF", 
-    config.enableMotion ? "ON" : "OFF");
-  Serial.printf("Relays: %s %s %s %s\n",
-    config.enableRelays[0] ? "ON" : "OFF",
-    config.enableRelays[1] ? "ON" : "OFF",
-    config.enableRelays[2] ? "ON" : "OFF",
-    config.enableRelays[3] ? "ON" : "OFF");
-  Serial.printf("LED: %s, Motor: %s\n",
-    config.enableLED ? "ON" : "OFF",
-    config.enableMotor ? "ON" : "OFF");
-  Serial.printf("Logging: %s\n", config.enableLogging ? "ON" : "OFF");
-  
-  Serial.println("\n--- Intervals ---");
-  Serial.printf("Sensor: %d sec, Logging: %d sec\n", 
-    config.sensorInterval, config.logInterval);
+  
+  const char* group = nullptr;
+  char value[96];
+  for (size_t i = 0; i < configSchema.size(); i++) {
+    const ConfigField& field = configSchema[i];
+    if (!group || strcmp(group, field.group) != 0) {
+      group = field.group;
+      Serial.printf("\n--- %s ---\n", group);
+    }
+    configSchema.format(config, field, value, sizeof(value));
+    Serial.printf("%-16s %s\n", field.key, value);
+  }
+  
+  Serial.println("\n--- Sensors ---");
+  for (uint8_t d = 0; d < DRIVER_COUNT; d++) {
+    Serial.printf("  %-8s every %u ms, phase %u ms", DRIVER_NAMES[d],
+      config.sensorTiming[d].period, config.sensorTiming[d].phase);
+    if (config.adaptiveSampling) {
+      Serial.printf(", adaptive %u-%u ms", config.sensorAdaptive[d].floor, config.sensorAdaptive[d].ceiling);
+    }
+    Serial.println();
+  }
+  Serial.printf("Stat windows: %s, %s, %s\n", windowLabel(config.statWindows[0]).c_str(),
+    windowLabel(config.statWindows[1]).c_str(), windowLabel(config.statWindows[2]).c_str());
+  for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+    Serial.printf("  %-8s deadband %.2f, min %u ms, heartbeat %u s\n", sensorChannels[i].id,
+      config.sensorPublish[i].deadband, config.sensorPublish[i].minInterval,
+      config.sensorPublish[i].maxSilence);
+  }
   
   if (wifiConnected) {
     Serial.printf("\n--- Network ---");
     Serial.printf("\nStation IP: %s\n", WiFi.localIP().toString().c_str());
   }
-  Serial.printf("AP IP: %s\n", WiFi.softAPIP().toString().c_str());
-  Serial.printf("WebSocket: ws://%s:81\n", WiFi.softAPIP().toString().c_str());
+  if (apMode) Serial.printf("AP IP: %s\n", WiFi.softAPIP().toString().c_str());
+  Serial.printf("WebSocket: ws://%s:81 (max %u clients)\n",
+    (apMode ? WiFi.softAPIP() : WiFi.localIP()).toString().c_str(), config.wsMaxClients);
   Serial.println("═════════════════════════════════════════════\n");
 }
\ No newline at end of file
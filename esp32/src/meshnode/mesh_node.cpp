@@ -0,0 +1,276 @@
+/*
+ * Mesh node - a hub's HubMesh on the host, for multi-hub tests
+ *
+ * Built by the [env:mesh] PlatformIO environment. Each instance is one
+ * hub with a temperature sensor and two relays, speaking the firmware's
+ * own HubMesh protocol over UDP. Run several on one machine; they find
+ * each other on the multicast group over loopback:
+ *
+ *   program --name hall --aggregator
+ *   program --name attic --drift
+ *   program --name shed
+ *
+ * Commands on stdin:
+ *   hubs                         table of known hubs and their entries
+ *   set HUB DEVICE on|off [N]    route a command (HUB may be this hub)
+ *   temp VALUE                   set this hub's temperature
+ *   stats                        packet and replication counters
+ *   quit
+ *
+ * Options:
+ *   --name NAME      hub name (default node<pid>)
+ *   --id N           hub id (default pid)
+ *   --aggregator     aggregate the other hubs' state
+ *   --drift          move the temperature by 0.1 every second
+ *   --iface ADDR     interface for multicast (default 127.0.0.1)
+ *   --loss PCT       drop this share of outgoing packets (retry paths)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "HubMesh.h"
+
+#define NODE_RELAYS 2
+
+static uint32_t nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// Multicast arrives on a socket bound to the group port (shared by every
+// node); replies come to each node's own unicast port, which is what the
+// header advertises and what everything is sent from
+class UdpTransport : public MeshTransport {
+ public:
+  bool open(const char* iface) {
+    struct in_addr ifaddr;
+    inet_pton(AF_INET, iface, &ifaddr);
+    int one = 1;
+
+    group_ = socket(AF_INET, SOCK_DGRAM, 0);
+    setsockopt(group_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(group_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(MESH_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(group_, (struct sockaddr*)&addr, sizeof(addr)) < 0) return fail("bind group port");
+
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = groupIp();
+    mreq.imr_interface = ifaddr;
+    if (setsockopt(group_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) return fail("join group");
+
+    unicast_ = socket(AF_INET, SOCK_DGRAM, 0);
+    addr.sin_port = 0;
+    if (bind(unicast_, (struct sockaddr*)&addr, sizeof(addr)) < 0) return fail("bind unicast port");
+    socklen_t len = sizeof(addr);
+    getsockname(unicast_, (struct sockaddr*)&addr, &len);
+    port_ = ntohs(addr.sin_port);
+    setsockopt(unicast_, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr));
+    setsockopt(unicast_, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+    return true;
+  }
+
+  void send(const MeshAddr& to, const uint8_t* data, size_t len) override {
+    if (lossPct && rand() % 100 < lossPct) return;
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = to.ip ? to.ip : groupIp();
+    addr.sin_port = htons(to.ip ? to.port : MESH_PORT);
+    sendto(unicast_, data, len, 0, (struct sockaddr*)&addr, sizeof(addr));
+  }
+
+  // One datagram from either socket into mesh
+  void receive(int fd, HubMesh& mesh) {
+    uint8_t buf[MESH_PACKET_SIZE];
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr*)&addr, &len);
+    if (n <= 0) return;
+    MeshAddr from = {addr.sin_addr.s_addr, ntohs(addr.sin_port)};
+    mesh.receive(from, buf, n, nowMs());
+  }
+
+  int group() const { return group_; }
+  int unicast() const { return unicast_; }
+  uint16_t port() const { return port_; }
+  int lossPct = 0;
+
+ private:
+  static uint32_t groupIp() {
+    uint8_t ip[] = {MESH_GROUP_IP};
+    uint32_t v;
+    memcpy(&v, ip, sizeof(v));
+    return v;
+  }
+
+  bool fail(const char* what) {
+    perror(what);
+    return false;
+  }
+
+  int group_ = -1;
+  int unicast_ = -1;
+  uint16_t port_ = 0;
+};
+
+class Node : public MeshHandler {
+ public:
+  HubMesh mesh;
+  float temperature = 22.0f;
+  bool relays[NODE_RELAYS] = {};
+
+  void publish() {
+    mesh.setSensor("temp1", temperature);
+    char key[MESH_KEY_SIZE];
+    for (uint8_t i = 0; i < NODE_RELAYS; i++) {
+      snprintf(key, sizeof(key), "relay%u", i + 1);
+      mesh.setDevice(key, relays[i], 0);
+    }
+  }
+
+  bool meshCommand(const char* device, bool state, int16_t value) override {
+    (void)value;
+    unsigned idx;
+    if (sscanf(device, "relay%u", &idx) != 1 || idx < 1 || idx > NODE_RELAYS) {
+      printf("[Mesh] Unknown device %s\n", device);
+      return false;
+    }
+    relays[idx - 1] = state;
+    printf("[Control] %s = %s\n", device, state ? "ON" : "OFF");
+    publish();
+    return true;
+  }
+
+  void meshChanged(uint8_t hub) override {
+    const MeshHub& h = mesh.hub(hub);
+    if (mesh.mode() != MESH_AGGREGATOR) return;
+    printf("[Mesh] %s (%u) %s v%u:", h.name[0] ? h.name : "?", (unsigned)h.id,
+           h.online ? "online" : "offline", (unsigned)h.version);
+    for (uint8_t i = 0; i < h.count; i++) printEntry(h.entries[i]);
+    printf("\n");
+  }
+
+  void meshCommandDone(uint8_t hub, const char* device, bool ok) override {
+    printf("%s %s/%s\n", ok ? "✓ Done" : "! Failed", mesh.hub(hub).name, device);
+  }
+
+  void printEntry(const MeshEntry& e) {
+    if (e.flags & MESH_ENTRY_DEVICE) printf(" %s=%s", e.key, e.flags & MESH_ENTRY_STATE ? "ON" : "OFF");
+    else printf(" %s=%.2f", e.key, e.value);
+  }
+
+  void printHubs() {
+    for (uint8_t i = 0; i < mesh.hubCount(); i++) {
+      const MeshHub& h = mesh.hub(i);
+      printf("%-12s %10u %-7s %s v%-5u", h.name[0] ? h.name : "?", (unsigned)h.id,
+             h.online ? "online" : "offline", h.aggregator ? "agg " : "peer", (unsigned)h.version);
+      for (uint8_t e = 0; e < h.count; e++) printEntry(h.entries[e]);
+      printf("%s\n", i == 0 ? "  (this hub)" : i == mesh.aggregator() ? "  (aggregator)" : "");
+    }
+  }
+
+  void printStats() {
+    const MeshStats& s = mesh.stats();
+    printf("sent %u received %u rejected %u\n", (unsigned)s.sent, (unsigned)s.received, (unsigned)s.rejected);
+    printf("deltas sent %u applied %u resyncs %u acked v%u of v%u\n", (unsigned)s.deltasSent,
+           (unsigned)s.deltasApplied, (unsigned)s.resyncs, (unsigned)mesh.acked(),
+           (unsigned)mesh.hub(0).version);
+    printf("commands routed %u failed %u\n", (unsigned)s.commandsRouted, (unsigned)s.commandsFailed);
+  }
+
+  // False on quit
+  bool line(char* text) {
+    char cmd[16] = "", a[MESH_NAME_SIZE] = "", b[MESH_KEY_SIZE] = "", c[8] = "";
+    int value = 0;
+    int n = sscanf(text, "%15s %23s %11s %7s %d", cmd, a, b, c, &value);
+    if (n <= 0) return true;
+    if (!strcmp(cmd, "quit")) return false;
+    if (!strcmp(cmd, "hubs")) printHubs();
+    else if (!strcmp(cmd, "stats")) printStats();
+    else if (!strcmp(cmd, "temp") && n >= 2) {
+      temperature = atof(a);
+      publish();
+    } else if (!strcmp(cmd, "set") && n >= 4) {
+      bool state = !strcmp(c, "on");
+      if (!mesh.command(a, b, state, n >= 5 ? value : -1, nowMs())) printf("! Unknown or offline hub: %s\n", a);
+    } else {
+      printf("! Unknown command: %s\n", cmd);
+    }
+    fflush(stdout);
+    return true;
+  }
+};
+
+int main(int argc, char** argv) {
+  char name[MESH_NAME_SIZE];
+  snprintf(name, sizeof(name), "node%d", (int)getpid());
+  uint32_t id = getpid();
+  uint8_t mode = MESH_PEER;
+  bool drift = false;
+  const char* iface = "127.0.0.1";
+  int loss = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    bool more = i + 1 < argc;
+    if (!strcmp(arg, "--name") && more) snprintf(name, sizeof(name), "%s", argv[++i]);
+    else if (!strcmp(arg, "--id") && more) id = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(arg, "--aggregator")) mode = MESH_AGGREGATOR;
+    else if (!strcmp(arg, "--drift")) drift = true;
+    else if (!strcmp(arg, "--iface") && more) iface = argv[++i];
+    else if (!strcmp(arg, "--loss") && more) loss = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 2;
+    }
+  }
+
+  UdpTransport udp;
+  if (!udp.open(iface)) return 1;
+  // Unbuffered, so lines not read yet stay in the pipe where poll() sees them
+  setvbuf(stdin, nullptr, _IONBF, 0);
+  udp.lossPct = loss;
+  srand(id ^ nowMs());
+
+  Node node;
+  node.mesh.begin(mode, id, (uint32_t)rand(), name, udp.port(), udp, node);
+  node.publish();
+  printf("✓ %s (%u) %s on port %u\n", name, (unsigned)id,
+         mode == MESH_AGGREGATOR ? "aggregator" : "peer", udp.port());
+  fflush(stdout);
+
+  struct pollfd fds[3] = {
+    {udp.group(), POLLIN, 0}, {udp.unicast(), POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}
+  };
+  uint32_t lastDrift = nowMs();
+  char text[128];
+  for (;;) {
+    poll(fds, 3, 20);
+    if (fds[0].revents & POLLIN) udp.receive(udp.group(), node.mesh);
+    if (fds[1].revents & POLLIN) udp.receive(udp.unicast(), node.mesh);
+    if (fds[2].revents & (POLLIN | POLLHUP)) {
+      if (!fgets(text, sizeof(text), stdin)) fds[2].fd = -1;   // keep running without input
+      else if (!node.line(text)) break;
+    }
+
+    uint32_t now = nowMs();
+    if (drift && now - lastDrift >= 1000) {
+      lastDrift = now;
+      node.temperature += 0.1f;
+      node.publish();
+    }
+    node.mesh.tick(now);
+    fflush(stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,545 @@
+/*
+ * Automation simulator - replays sensor traces through the rule engine
+ *
+ * Built for the host by the [env:native] PlatformIO environment. It links
+ * the firmware's own Automation, RuleVM and RollingStats code and feeds it
+ * from a virtual clock instead of millis(): sensor readings come from a
+ * trace, the automation tick runs every --tick ms of trace time, and every
+ * actuator change the rules make is written to an output trace. Nothing
+ * waits on wall time, so a month of data replays in seconds, and two
+ * firmware versions can be compared by diffing their output traces.
+ *
+ * Trace time is 64-bit ms. The firmware code sees it truncated to 32 bits,
+ * so a trace longer than 49.7 days wraps its clock exactly like millis()
+ * on the hub; the output trace keeps the full trace time.
+ *
+ *   program --rules site.rules --trace site.csv --out actions.csv
+ *
+ * Inputs (see the README for details):
+ *   --trace FILE.csv   header "ms,temp1,hum1,..." then one row per reading
+ *                      time; an empty cell means no reading of that channel
+ *   --trace FILE.bin   SampleQueue segment records (16 bytes each), e.g.
+ *                      segment files copied from /queue on the hub
+ *   --synth DAYS       synthetic day/night temperature, humidity, light and
+ *                      motion, reproducible with --seed
+ *   --rules FILE       one rule per line: CONDITION => ACTIONS [; RELEASE]
+ *                      with actions as device=on|off[:value]
+ */
+
+// pio test links src/ into each test, which brings its own main()
+#ifndef PIO_UNIT_TESTING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "Automation.h"
+
+#define SIM_MAX_CHANNELS   16
+#define SIM_MAX_DEVICES    16
+#define SIM_STAT_WINDOWS   3
+#define SIM_STAT_BUCKETS   12     // same as the firmware's STAT_BUCKETS
+
+// SampleQueue record layout (SampleQueue.h pulls in Arduino, so mirrored)
+#define SAMPLE_FLAG_MOTION 0x01
+
+struct __attribute__((packed)) SampleRecord {
+  uint32_t seq;
+  uint32_t time;
+  int16_t temperature;
+  uint16_t humidity;
+  uint8_t light;
+  uint8_t flags;
+  uint16_t crc;
+};
+
+static_assert(sizeof(SampleRecord) == 16, "SampleRecord must stay 16 bytes");
+
+struct Channel {
+  std::string id;
+  float value = 0;            // 0 until the first reading, as on the hub
+  RollingWindow<SIM_STAT_BUCKETS> stats[SIM_STAT_WINDOWS];
+};
+
+struct Device {
+  char id[16];
+  bool state;
+  int value;
+};
+
+// One row of input: a time and the channels read at it
+struct Reading {
+  uint64_t ms;
+  float values[SIM_MAX_CHANNELS];
+  uint32_t present;           // bit per channel
+};
+
+static Channel channels[SIM_MAX_CHANNELS];
+static uint8_t channelCount = 0;
+static uint32_t statWindows[SIM_STAT_WINDOWS] = {60, 900, 3600};
+static uint64_t traceMs = 0;
+static uint32_t virtualMs = 0;    // traceMs as the firmware's millis() would read it
+
+// ============== SYMBOLS & OUTPUTS ==============
+
+class TraceSymbols : public RuleSymbols {
+ public:
+  int sensor(const char* name, uint8_t length) override {
+    for (uint8_t i = 0; i < channelCount; i++) {
+      if (channels[i].id.size() == length && strncmp(channels[i].id.c_str(), name, length) == 0) return i;
+    }
+    return -1;
+  }
+
+  int stat(const char* name, uint8_t length) override {
+    return statIndex(name, length);
+  }
+
+  int window(uint32_t seconds) override {
+    for (int w = 0; w < SIM_STAT_WINDOWS; w++) {
+      if (statWindows[w] == seconds) return w;
+    }
+    return -1;
+  }
+
+  float read(uint8_t sensor, uint8_t stat, uint8_t window) override {
+    if (stat == STAT_VALUE) return channels[sensor].value;
+    return summaryStat(channels[sensor].stats[window].summary(virtualMs), stat);
+  }
+};
+
+// Mirrors setDeviceState(): value -1 keeps the previous level. Only real
+// changes reach the output trace; repeated commands are just counted.
+class TraceSink : public ActionSink {
+ public:
+  FILE* out = nullptr;
+  uint32_t transitions = 0;
+  uint32_t repeats = 0;
+
+  void ruleAction(uint8_t rule, const RuleAction& action, uint32_t nowMs) override {
+    Device* d = find(action.device);
+    if (!d) return;
+
+    int value = action.value >= 0 ? action.value : d->value;
+    if (d->state == action.state && d->value == value) {
+      repeats++;
+      return;
+    }
+    d->state = action.state;
+    d->value = value;
+    transitions++;
+    fprintf(out, "%llu,%s,%s,%d,%u\n", (unsigned long long)traceMs, d->id, d->state ? "on" : "off",
+            d->value, rule + 1);
+  }
+
+ private:
+  Device* find(const char* id) {
+    for (uint8_t i = 0; i < deviceCount_; i++) {
+      if (strcmp(devices_[i].id, id) == 0) return &devices_[i];
+    }
+    if (deviceCount_ >= SIM_MAX_DEVICES) return nullptr;
+    Device& d = devices_[deviceCount_++];
+    snprintf(d.id, sizeof(d.id), "%s", id);
+    d.state = false;
+    d.value = -1;
+    return &d;
+  }
+
+  Device devices_[SIM_MAX_DEVICES];
+  uint8_t deviceCount_ = 0;
+};
+
+static TraceSymbols symbols;
+static TraceSink sink;
+static Automation automation(symbols);
+
+// ============== TRACE INPUT ==============
+
+static int addChannel(const char* id) {
+  for (uint8_t i = 0; i < channelCount; i++) {
+    if (channels[i].id == id) return i;
+  }
+  if (channelCount >= SIM_MAX_CHANNELS) return -1;
+  channels[channelCount].id = id;
+  return channelCount++;
+}
+
+static bool fail(const char* format, const char* detail) {
+  fprintf(stderr, format, detail);
+  fputc('\n', stderr);
+  return false;
+}
+
+// Yields readings in time order; channels are registered on open
+class TraceSource {
+ public:
+  virtual ~TraceSource() {}
+  virtual bool next(Reading& r) = 0;
+  uint32_t corrupt = 0;
+};
+
+// Header "ms,<channel>,..." (or "s,..." for seconds); times are rebased so
+// the first row is at 0 ms
+class CsvTrace : public TraceSource {
+ public:
+  ~CsvTrace() override { if (f_) fclose(f_); }
+
+  bool open(const char* path) {
+    f_ = fopen(path, "r");
+    if (!f_) return fail("Cannot open %s", path);
+    if (!fgets(line_, sizeof(line_), f_)) return fail("%s is empty", path);
+
+    char* save = nullptr;
+    char* tok = strtok_r(line_, ",\r\n", &save);
+    if (tok && strcmp(tok, "s") == 0) scale_ = 1000;
+    else if (!tok || strcmp(tok, "ms") != 0) return fail("%s: first column must be ms or s", path);
+    while ((tok = strtok_r(nullptr, ",\r\n", &save))) {
+      int idx = addChannel(tok);
+      if (idx < 0) return fail("Too many channels in %s", path);
+      columns_.push_back(idx);
+    }
+    return true;
+  }
+
+  bool next(Reading& r) override {
+    while (fgets(line_, sizeof(line_), f_)) {
+      char* p = line_;
+      char* end;
+      double t = strtod(p, &end);
+      if (end == p || line_[0] == '#') continue;
+      if (first_) {
+        origin_ = t;
+        first_ = false;
+      }
+
+      r.ms = (uint64_t)((t - origin_) * scale_);
+      r.present = 0;
+      p = end;
+      for (size_t c = 0; c < columns_.size() && *p == ','; c++) {
+        p++;
+        float v = strtof(p, &end);
+        if (end != p) {
+          r.values[columns_[c]] = v;
+          r.present |= 1UL << columns_[c];
+          p = end;
+        }
+      }
+      return true;
+    }
+    return false;
+  }
+
+ private:
+  FILE* f_ = nullptr;
+  char line_[1024];
+  std::vector<int> columns_;
+  uint32_t scale_ = 1;
+  bool first_ = true;
+  double origin_ = 0;
+};
+
+static uint16_t crc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// The four SampleRecord channels, for the binary and synthetic traces
+struct SampleChannels {
+  int temp, hum, light, motion;
+
+  void add() {
+    temp = addChannel("temp1");
+    hum = addChannel("hum1");
+    light = addChannel("light1");
+    motion = addChannel("motion1");
+  }
+
+  void fill(Reading& r, float t, float h, float l, bool m) const {
+    r.values[temp] = t;
+    r.values[hum] = h;
+    r.values[light] = l;
+    r.values[motion] = m ? 1 : 0;
+    r.present = 1UL << temp | 1UL << hum | 1UL << light | 1UL << motion;
+  }
+};
+
+// Records with a bad CRC (torn tail of a segment) are skipped
+class SampleTrace : public TraceSource {
+ public:
+  ~SampleTrace() override { if (f_) fclose(f_); }
+
+  bool open(const char* path) {
+    f_ = fopen(path, "rb");
+    if (!f_) return fail("Cannot open %s", path);
+    ch_.add();
+    return true;
+  }
+
+  bool next(Reading& r) override {
+    SampleRecord rec;
+    while (fread(&rec, sizeof(rec), 1, f_) == 1) {
+      if (crc16((const uint8_t*)&rec, sizeof(rec) - 2) != rec.crc) {
+        corrupt++;
+        continue;
+      }
+      if (first_) {
+        origin_ = rec.time;
+        first_ = false;
+      }
+      r.ms = (uint64_t)(rec.time - origin_) * 1000;
+      ch_.fill(r, rec.temperature / 100.0f, rec.humidity / 100.0f, rec.light, rec.flags & SAMPLE_FLAG_MOTION);
+      return true;
+    }
+    return false;
+  }
+
+ private:
+  FILE* f_ = nullptr;
+  SampleChannels ch_;
+  bool first_ = true;
+  uint32_t origin_ = 0;
+};
+
+// Day/night cycle with noise and motion bursts; deterministic for a given
+// seed (own LCG, not rand())
+class SynthTrace : public TraceSource {
+ public:
+  SynthTrace(float days, uint32_t stepMs, uint32_t seed)
+    : totalMs_((uint64_t)(days * 86400000.0)), stepMs_(stepMs), seed_(seed) {
+    ch_.add();
+  }
+
+  bool next(Reading& r) override {
+    if (done_) return false;
+    uint64_t ms = ms_;
+    float day = (ms % 86400000ULL) / 86400000.0f;
+    float noise = (random() % 1000) / 1000.0f - 0.5f;
+    float sun = sinf((day - 0.25f) * 2 * (float)M_PI);
+    if (random() % 1000 < (sun > 0 ? 20u : 2u)) motionUntil_ = ms + 30000;
+
+    r.ms = ms;
+    ch_.fill(r, 22 + 6 * sun + noise, 55 - 15 * sun + 2 * noise, sun > 0 ? roundf(90 * sun) : 0,
+             ms < motionUntil_);
+    if (totalMs_ - ms < stepMs_) done_ = true;
+    ms_ += stepMs_;
+    return true;
+  }
+
+ private:
+  uint32_t random() {
+    seed_ = seed_ * 1664525UL + 1013904223UL;
+    return seed_ >> 8;
+  }
+
+  SampleChannels ch_;
+  uint64_t totalMs_;
+  uint32_t stepMs_, seed_;
+  uint64_t ms_ = 0;
+  uint64_t motionUntil_ = 0;
+  bool done_ = false;
+};
+
+// ============== RULES ==============
+
+static char* trim(char* s) {
+  while (*s == ' ' || *s == '\t') s++;
+  char* end = s + strlen(s);
+  while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) end--;
+  *end = '\0';
+  return s;
+}
+
+// "relay1=on motor1=on:40"
+static bool parseActions(AutomationRule& rule, char* text, bool onRelease) {
+  char* save = nullptr;
+  for (char* tok = strtok_r(text, " \t", &save); tok; tok = strtok_r(nullptr, " \t", &save)) {
+    char* eq = strchr(tok, '=');
+    if (!eq) return false;
+    *eq = '\0';
+    char* level = strchr(eq + 1, ':');
+    if (level) *level++ = '\0';
+
+    bool state;
+    if (strcmp(eq + 1, "on") == 0) state = true;
+    else if (strcmp(eq + 1, "off") == 0) state = false;
+    else return false;
+    if (!Automation::addAction(rule, tok, state, level ? atoi(level) : -1, onRelease)) return false;
+  }
+  return true;
+}
+
+static bool loadRules(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) return fail("Cannot open %s", path);
+
+  char line[512];
+  int number = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f)) {
+    number++;
+    char* text = trim(line);
+    if (text[0] == '\0' || text[0] == '#') continue;
+
+    char* arrow = strstr(text, "=>");
+    if (!arrow) {
+      fprintf(stderr, "%s:%d: expected CONDITION => ACTIONS\n", path, number);
+      ok = false;
+      break;
+    }
+    *arrow = '\0';
+    char* actions = arrow + 2;
+    char* release = strchr(actions, ';');
+    if (release) *release++ = '\0';
+
+    bool constant = false;
+    AutomationRule* rule = automation.compile(trim(text), constant);
+    if (!rule) {
+      fprintf(stderr, "%s:%d: %s at %u\n", path, number, automation.error(), automation.errorAt());
+      ok = false;
+    } else if (!parseActions(*rule, actions, false) || (release && !parseActions(*rule, release, true))) {
+      fprintf(stderr, "%s:%d: bad action, expected device=on|off[:value]\n", path, number);
+      ok = false;
+    } else if (!automation.commit()) {
+      fprintf(stderr, "%s:%d: %s\n", path, number, automation.error());
+      ok = false;
+    } else if (constant) {
+      fprintf(stderr, "%s:%d: warning: condition is constant\n", path, number);
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+// ============== MAIN ==============
+
+static void usage() {
+  fprintf(stderr,
+    "usage: program --rules FILE (--trace FILE.csv|FILE.bin | --synth DAYS) [options]\n"
+    "  --out FILE         transition trace (default stdout)\n"
+    "  --tick MS          automation period in trace time (default 2000)\n"
+    "  --windows A,B,C    stat windows in seconds (default 60,900,3600)\n"
+    "  --step MS          synthetic sample period (default 2000)\n"
+    "  --seed N           synthetic trace seed (default 1)\n");
+}
+
+int main(int argc, char** argv) {
+  const char* rulesPath = nullptr;
+  const char* tracePath = nullptr;
+  const char* outPath = nullptr;
+  float synthDays = 0;
+  uint32_t tickMs = 2000;
+  uint32_t stepMs = 2000;
+  uint32_t seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!val) {
+      usage();
+      return 2;
+    }
+    if (strcmp(arg, "--rules") == 0) rulesPath = val;
+    else if (strcmp(arg, "--trace") == 0) tracePath = val;
+    else if (strcmp(arg, "--out") == 0) outPath = val;
+    else if (strcmp(arg, "--synth") == 0) synthDays = atof(val);
+    else if (strcmp(arg, "--tick") == 0) tickMs = strtoul(val, nullptr, 10);
+    else if (strcmp(arg, "--step") == 0) stepMs = strtoul(val, nullptr, 10);
+    else if (strcmp(arg, "--seed") == 0) seed = strtoul(val, nullptr, 10);
+    else if (strcmp(arg, "--windows") == 0) {
+      sscanf(val, "%u,%u,%u", &statWindows[0], &statWindows[1], &statWindows[2]);
+    }
+    else {
+      usage();
+      return 2;
+    }
+    i++;
+  }
+  if (!rulesPath || (!tracePath && synthDays <= 0) || tickMs == 0 || stepMs == 0) {
+    usage();
+    return 2;
+  }
+
+  // Channels must exist before rules compile against them
+  TraceSource* trace;
+  if (tracePath) {
+    size_t len = strlen(tracePath);
+    if (len > 4 && strcmp(tracePath + len - 4, ".bin") == 0) {
+      SampleTrace* t = new SampleTrace();
+      if (!t->open(tracePath)) return 1;
+      trace = t;
+    } else {
+      CsvTrace* t = new CsvTrace();
+      if (!t->open(tracePath)) return 1;
+      trace = t;
+    }
+  } else {
+    trace = new SynthTrace(synthDays, stepMs, seed);
+  }
+  for (uint8_t i = 0; i < channelCount; i++) {
+    for (uint8_t w = 0; w < SIM_STAT_WINDOWS; w++) channels[i].stats[w].begin(statWindows[w] * 1000UL);
+  }
+  if (!loadRules(rulesPath)) return 1;
+
+  sink.out = outPath ? fopen(outPath, "w") : stdout;
+  if (!sink.out) {
+    fail("Cannot write %s", outPath);
+    return 1;
+  }
+  fprintf(sink.out, "ms,device,state,value,rule\n");
+
+  // Sensors are serviced before automation in the loop, so a reading at t
+  // is visible to a tick at t
+  clock_t started = clock();
+  uint64_t nextTick = 0;
+  uint32_t ticks = 0;
+  uint32_t readings = 0;
+  Reading r = {};
+  while (trace->next(r)) {
+    while (nextTick < r.ms) {
+      traceMs = nextTick;
+      virtualMs = (uint32_t)traceMs;
+      automation.tick(virtualMs, sink);
+      nextTick += tickMs;
+      ticks++;
+    }
+    traceMs = r.ms;
+    virtualMs = (uint32_t)traceMs;
+    readings++;
+    for (uint8_t c = 0; c < channelCount; c++) {
+      if (!(r.present & (1UL << c))) continue;
+      channels[c].value = r.values[c];
+      for (uint8_t w = 0; w < SIM_STAT_WINDOWS; w++) channels[c].stats[w].add(r.values[c], virtualMs);
+    }
+  }
+  if (readings) {
+    traceMs = nextTick;
+    virtualMs = (uint32_t)traceMs;
+    automation.tick(virtualMs, sink);
+    ticks++;
+  }
+  if (sink.out != stdout) fclose(sink.out);
+
+  double seconds = (double)(clock() - started) / CLOCKS_PER_SEC;
+  double span = readings ? r.ms / 1000.0 : 0;
+  fprintf(stderr, "[Sim] %lu readings over %.1f h, %lu ticks in %.2f s (%.0fx real time)\n",
+          (unsigned long)readings, span / 3600, (unsigned long)ticks, seconds, seconds > 0 ? span / seconds : 0);
+  if (trace->corrupt) fprintf(stderr, "[Sim] Skipped %lu corrupt records\n", (unsigned long)trace->corrupt);
+  fprintf(stderr, "[Sim] %lu transitions, %lu repeated commands, %lu VM instructions, %lu budget hits\n",
+          (unsigned long)sink.transitions, (unsigned long)sink.repeats,
+          (unsigned long)automation.instructions, (unsigned long)automation.budgetHits);
+  for (uint8_t i = 0; i < automation.count(); i++) {
+    const AutomationRule& rule = automation.rule(i);
+    fprintf(stderr, "  %u. fired %lu  %s\n", i + 1, (unsigned long)rule.fired, rule.source);
+  }
+  return 0;
+}
+#endif
@@ -0,0 +1,78 @@
+// AdaptiveRate: speed-up, back-off and the floor/ceiling bounds
+#include <unity.h>
+#include "AdaptiveRate.h"
+
+static AdaptiveRate rate;
+
+void setUp() { rate = AdaptiveRate(); }
+void tearDown() {}
+
+void test_begin_clamps() {
+  rate.begin(50, 100, 1000);
+  TEST_ASSERT_EQUAL(100, rate.period());
+  rate.begin(5000, 100, 1000);
+  TEST_ASSERT_EQUAL(1000, rate.period());
+
+  // No zero floor, and the ceiling is never below the floor
+  rate.begin(0, 0, 0);
+  TEST_ASSERT_EQUAL(1, rate.floor());
+  TEST_ASSERT_EQUAL(1, rate.ceiling());
+  TEST_ASSERT_EQUAL(1, rate.period());
+  rate.begin(500, 400, 300);
+  TEST_ASSERT_EQUAL(400, rate.ceiling());
+  TEST_ASSERT_EQUAL(400, rate.period());
+}
+
+void test_change_halves_down_to_floor() {
+  rate.begin(1000, 100, 10000);
+  TEST_ASSERT_EQUAL(500, rate.update(1.0f));
+  TEST_ASSERT_EQUAL(250, rate.update(3.0f));
+  TEST_ASSERT_EQUAL(125, rate.update(1.5f));
+  TEST_ASSERT_EQUAL(100, rate.update(2.0f));
+  TEST_ASSERT_EQUAL(100, rate.update(2.0f));
+  TEST_ASSERT_EQUAL(4, rate.speedUps);
+}
+
+void test_quiet_backs_off_up_to_ceiling() {
+  rate.begin(100, 100, 300);
+  TEST_ASSERT_EQUAL(126, rate.update(0));
+  TEST_ASSERT_EQUAL(158, rate.update(0));
+  for (int i = 0; i < 20; i++) {
+    uint32_t period = rate.update(0);
+    TEST_ASSERT_LESS_OR_EQUAL(300, period);
+  }
+  TEST_ASSERT_EQUAL(300, rate.period());
+  TEST_ASSERT_EQUAL(5, rate.backOffs);
+}
+
+void test_moderate_activity_holds() {
+  rate.begin(1000, 100, 10000);
+  // Smoothed activity above ADAPT_QUIET but each change below one step
+  for (int i = 0; i < 10; i++) rate.update(0.6f);
+  uint32_t held = rate.period();
+  for (int i = 0; i < 10; i++) TEST_ASSERT_EQUAL(held, rate.update(0.6f));
+  TEST_ASSERT_TRUE(rate.activity() > ADAPT_QUIET);
+  TEST_ASSERT_EQUAL(0, rate.speedUps);
+}
+
+void test_burst_then_quiet_stays_in_bounds() {
+  rate.begin(2000, 250, 8000);
+  uint32_t x = 1;
+  for (int i = 0; i < 1000; i++) {
+    x = x * 1103515245u + 12345u;
+    float change = (x >> 16) % 8 == 0 ? 2.0f : 0.0f;
+    uint32_t period = rate.update(change);
+    TEST_ASSERT_GREATER_OR_EQUAL(250, period);
+    TEST_ASSERT_LESS_OR_EQUAL(8000, period);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_begin_clamps);
+  RUN_TEST(test_change_halves_down_to_floor);
+  RUN_TEST(test_quiet_backs_off_up_to_ceiling);
+  RUN_TEST(test_moderate_activity_holds);
+  RUN_TEST(test_burst_then_quiet_stays_in_bounds);
+  return UNITY_END();
+}
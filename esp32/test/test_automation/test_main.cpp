@@ -0,0 +1,115 @@
+// Automation: rule ids, removal, id wrap and the table limit
+#include <unity.h>
+#include <string.h>
+#include "Automation.h"
+
+class TestSymbols : public RuleSymbols {
+ public:
+  float temp = 0;
+  int sensor(const char* name, uint8_t length) override {
+    return length == 5 && strncmp(name, "temp1", 5) == 0 ? 0 : -1;
+  }
+  int stat(const char* name, uint8_t length) override { return statIndex(name, length); }
+  int window(uint32_t seconds) override { return -1; }
+  float read(uint8_t sensor, uint8_t stat, uint8_t window) override { return temp; }
+};
+
+class TestSink : public ActionSink {
+ public:
+  char last[16] = "";
+  uint8_t calls = 0;
+  void ruleAction(uint8_t rule, const RuleAction& action, uint32_t nowMs) override {
+    strcpy(last, action.device);
+    calls++;
+  }
+};
+
+static TestSymbols symbols;
+
+void setUp() { symbols = TestSymbols(); }
+void tearDown() {}
+
+static uint16_t add(Automation& a, const char* when, const char* device) {
+  bool constant;
+  AutomationRule* rule = a.compile(when, constant);
+  if (!rule) return 0;
+  Automation::addAction(*rule, device, true, -1, false);
+  return a.commit() ? rule->id : 0;
+}
+
+void test_ids_survive_removal() {
+  static Automation automation(symbols);
+  uint16_t a = add(automation, "temp1 > 10", "relay1");
+  uint16_t b = add(automation, "temp1 > 20", "relay2");
+  uint16_t c = add(automation, "temp1 > 30", "relay3");
+  TEST_ASSERT_EQUAL(1, a);
+  TEST_ASSERT_EQUAL(2, b);
+  TEST_ASSERT_EQUAL(3, c);
+
+  TEST_ASSERT_TRUE(automation.remove(b));
+  TEST_ASSERT_FALSE(automation.remove(b));
+  TEST_ASSERT_FALSE(automation.remove(0));
+  TEST_ASSERT_EQUAL(2, automation.count());
+  TEST_ASSERT_EQUAL(a, automation.rule(0).id);
+  TEST_ASSERT_EQUAL(c, automation.rule(1).id);
+
+  // Removed ids are not handed out again
+  TEST_ASSERT_EQUAL(4, add(automation, "temp1 > 40", "relay4"));
+
+  // The remaining rules still drive their own actions
+  TestSink sink;
+  symbols.temp = 35;
+  TEST_ASSERT_TRUE(automation.tick(0, sink));
+  TEST_ASSERT_EQUAL(2, sink.calls);
+  TEST_ASSERT_EQUAL_STRING("relay3", sink.last);
+}
+
+void test_removal_frees_a_slot() {
+  static Automation automation(symbols);
+  uint16_t first = 0;
+  for (uint8_t i = 0; i < MAX_RULES; i++) {
+    uint16_t id = add(automation, "temp1 > 1", "relay1");
+    TEST_ASSERT_NOT_EQUAL(0, id);
+    if (i == 0) first = id;
+  }
+  TEST_ASSERT_EQUAL(0, add(automation, "temp1 > 1", "relay1"));
+  TEST_ASSERT_EQUAL_STRING("Rule table full", automation.error());
+
+  TEST_ASSERT_TRUE(automation.remove(first));
+  TEST_ASSERT_NOT_EQUAL(0, add(automation, "temp1 > 1", "relay1"));
+  TEST_ASSERT_EQUAL(MAX_RULES, automation.count());
+}
+
+void test_id_wrap_skips_ids_in_use() {
+  static Automation automation(symbols);
+  uint16_t kept = add(automation, "temp1 > 1", "relay1");
+  TEST_ASSERT_EQUAL(1, kept);
+
+  // Cycle through every other id until the counter wraps past 0
+  for (uint32_t i = 2; i <= 0xFFFF; i++) {
+    uint16_t id = add(automation, "temp1 > 2", "relay2");
+    TEST_ASSERT_EQUAL(i, id);
+    automation.remove(id);
+  }
+
+  TEST_ASSERT_EQUAL(2, add(automation, "temp1 > 3", "relay3"));
+  TEST_ASSERT_EQUAL(kept, automation.rule(0).id);
+}
+
+void test_sensors_follow_the_table() {
+  static Automation automation(symbols);
+  TEST_ASSERT_EQUAL(0, automation.sensors());
+  uint16_t id = add(automation, "temp1 > 1", "relay1");
+  TEST_ASSERT_EQUAL(1, automation.sensors());
+  automation.remove(id);
+  TEST_ASSERT_EQUAL(0, automation.sensors());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ids_survive_removal);
+  RUN_TEST(test_removal_frees_a_slot);
+  RUN_TEST(test_id_wrap_skips_ids_in_use);
+  RUN_TEST(test_sensors_follow_the_table);
+  return UNITY_END();
+}
@@ -0,0 +1,106 @@
+// EventBus: filtered delivery, cursor overrun and independent cursors
+#include <unity.h>
+#include "EventBus.h"
+
+static EventBus<8> bus;
+
+void setUp() { bus = EventBus<8>(); }
+void tearDown() {}
+
+void test_subscribe_starts_at_next_event() {
+  bus.publish(EVENT_SENSOR, 0, 1.0f, EVENT_CHANGED, 10);
+  EventCursor c;
+  bus.subscribe(c, EVENT_TYPE(EVENT_SENSOR), EVENT_ALL_SOURCES, false);
+  TEST_ASSERT_NULL(bus.next(c));
+
+  bus.publish(EVENT_SENSOR, 0, 2.0f, EVENT_CHANGED, 20);
+  const Event* e = bus.next(c);
+  TEST_ASSERT_NOT_NULL(e);
+  TEST_ASSERT_EQUAL(1, e->seq);
+  TEST_ASSERT_EQUAL(20, e->timeMs);
+  TEST_ASSERT_EQUAL_FLOAT(2.0f, e->value);
+  TEST_ASSERT_NULL(bus.next(c));
+  TEST_ASSERT_EQUAL(1, c.delivered);
+}
+
+void test_filters() {
+  EventCursor sensors, device3, changed;
+  bus.subscribe(sensors, EVENT_TYPE(EVENT_SENSOR), EVENT_ALL_SOURCES, false);
+  bus.subscribe(device3, EVENT_TYPE(EVENT_DEVICE), 1UL << 3, false);
+  bus.subscribe(changed, EVENT_TYPE(EVENT_SENSOR) | EVENT_TYPE(EVENT_DEVICE), EVENT_ALL_SOURCES, true);
+
+  bus.publish(EVENT_SENSOR, 1, 20.0f, 0, 0);
+  bus.publish(EVENT_DEVICE, 3, 100.0f, EVENT_CHANGED | EVENT_STATE, 0);
+  bus.publish(EVENT_DEVICE, 2, 0.0f, EVENT_CHANGED, 0);
+  bus.publish(EVENT_SENSOR, 31, 21.0f, EVENT_CHANGED, 0);
+
+  TEST_ASSERT_EQUAL(0, bus.next(sensors)->seq);
+  TEST_ASSERT_EQUAL(3, bus.next(sensors)->seq);
+  TEST_ASSERT_NULL(bus.next(sensors));
+
+  const Event* e = bus.next(device3);
+  TEST_ASSERT_EQUAL(1, e->seq);
+  TEST_ASSERT_TRUE(e->flags & EVENT_STATE);
+  TEST_ASSERT_NULL(bus.next(device3));
+
+  TEST_ASSERT_EQUAL(1, bus.next(changed)->seq);
+  TEST_ASSERT_EQUAL(2, bus.next(changed)->seq);
+  TEST_ASSERT_EQUAL(3, bus.next(changed)->seq);
+  TEST_ASSERT_NULL(bus.next(changed));
+  TEST_ASSERT_EQUAL(0, bus.behind(changed));
+}
+
+void test_overrun_skips_to_oldest_held() {
+  EventCursor c;
+  bus.subscribe(c, EVENT_TYPE(EVENT_SENSOR), EVENT_ALL_SOURCES, false);
+  for (int i = 0; i < 20; i++) bus.publish(EVENT_SENSOR, 0, (float)i, 0, i);
+  TEST_ASSERT_EQUAL(20, bus.behind(c));
+
+  // 12 were overwritten; the 8 still in the ring come out in order
+  for (int i = 12; i < 20; i++) {
+    const Event* e = bus.next(c);
+    TEST_ASSERT_NOT_NULL(e);
+    TEST_ASSERT_EQUAL(i, e->seq);
+    TEST_ASSERT_EQUAL_FLOAT((float)i, e->value);
+  }
+  TEST_ASSERT_NULL(bus.next(c));
+  TEST_ASSERT_EQUAL(12, c.missed);
+  TEST_ASSERT_EQUAL(8, c.delivered);
+}
+
+void test_exactly_full_is_not_overrun() {
+  EventCursor c;
+  bus.subscribe(c, EVENT_TYPE(EVENT_SENSOR), EVENT_ALL_SOURCES, false);
+  for (int i = 0; i < 8; i++) bus.publish(EVENT_SENSOR, 0, (float)i, 0, i);
+  TEST_ASSERT_EQUAL(0, bus.next(c)->seq);
+  TEST_ASSERT_EQUAL(0, c.missed);
+}
+
+void test_cursors_are_independent() {
+  EventCursor fast, slow;
+  bus.subscribe(fast, EVENT_TYPE(EVENT_SENSOR), EVENT_ALL_SOURCES, false);
+  bus.subscribe(slow, EVENT_TYPE(EVENT_SENSOR), EVENT_ALL_SOURCES, false);
+  for (int i = 0; i < 6; i++) {
+    bus.publish(EVENT_SENSOR, 0, (float)i, 0, i);
+    TEST_ASSERT_NOT_NULL(bus.next(fast));
+  }
+  TEST_ASSERT_EQUAL(0, bus.behind(fast));
+  TEST_ASSERT_EQUAL(6, bus.behind(slow));
+
+  // Overrunning the slow cursor does not touch the fast one
+  for (int i = 6; i < 14; i++) bus.publish(EVENT_SENSOR, 0, (float)i, 0, i);
+  TEST_ASSERT_EQUAL(6, bus.next(fast)->seq);
+  TEST_ASSERT_EQUAL(0, fast.missed);
+  TEST_ASSERT_EQUAL(6, bus.next(slow)->seq);
+  TEST_ASSERT_EQUAL(6, slow.missed);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_subscribe_starts_at_next_event);
+  RUN_TEST(test_filters);
+  RUN_TEST(test_overrun_skips_to_oldest_held);
+  RUN_TEST(test_exactly_full_is_not_overrun);
+  RUN_TEST(test_cursors_are_independent);
+  return UNITY_END();
+}
@@ -0,0 +1,182 @@
+// HubMesh: routed commands over a loopback transport with lost and reordered packets
+#include <unity.h>
+#include <vector>
+#include "HubMesh.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// Captures packets; the test decides which ones arrive, and in what order
+class Wire : public MeshTransport {
+ public:
+  std::vector<Bytes> sent;
+  void send(const MeshAddr& to, const uint8_t* data, size_t len) override {
+    sent.push_back(Bytes(data, data + len));
+  }
+  // Takes the packets of one type out of the capture
+  std::vector<Bytes> take(uint8_t type) {
+    std::vector<Bytes> out, rest;
+    for (Bytes& p : sent) (p[3] == type ? out : rest).push_back(p);
+    sent = rest;
+    return out;
+  }
+};
+
+class Owner : public MeshHandler {
+ public:
+  int applied = 0;
+  bool state = false;
+  bool meshCommand(const char* device, bool s, int16_t value) override {
+    applied++;
+    state = s;
+    return true;
+  }
+};
+
+class Router : public MeshHandler {
+ public:
+  int done = 0;
+  int failed = 0;
+  bool meshCommand(const char* device, bool s, int16_t value) override { return false; }
+  void meshCommandDone(uint8_t hub, const char* device, bool ok) override {
+    done++;
+    if (!ok) failed++;
+  }
+};
+
+static Wire aggWire, peerWire;
+static Owner owner;
+static Router router;
+static HubMesh agg, peer;
+static uint32_t now;
+
+static const MeshAddr FROM = {0x0100007f, 0};
+
+static void deliver(HubMesh& to, const Bytes& p) { to.receive(FROM, p.data(), p.size(), now); }
+
+static void deliverAll(HubMesh& to, const std::vector<Bytes>& packets) {
+  for (const Bytes& p : packets) deliver(to, p);
+}
+
+static uint16_t seqOf(const Bytes& command) { return command[18] | command[19] << 8; }
+
+void setUp() {
+  aggWire = Wire();
+  peerWire = Wire();
+  owner = Owner();
+  router = Router();
+  now = 1000;
+  agg.begin(MESH_AGGREGATOR, 1, 11, "hall", MESH_PORT, aggWire, router);
+  peer.begin(MESH_PEER, 2, 22, "attic", MESH_PORT, peerWire, owner);
+
+  // Each hub learns the other from its announce
+  agg.tick(now);
+  peer.tick(now);
+  deliverAll(peer, aggWire.take(MESH_ANNOUNCE));
+  deliverAll(agg, peerWire.take(MESH_ANNOUNCE));
+  aggWire.sent.clear();
+  peerWire.sent.clear();
+}
+
+void tearDown() {}
+
+void test_command_is_applied_once() {
+  TEST_ASSERT_TRUE(agg.command("attic", "relay1", true, -1, now));
+  std::vector<Bytes> cmd = aggWire.take(MESH_COMMAND);
+  TEST_ASSERT_EQUAL(1, cmd.size());
+
+  // The ACK is lost, so the retry arrives too: applied once, ACKed twice
+  deliver(peer, cmd[0]);
+  peerWire.take(MESH_COMMAND_ACK);
+  now += MESH_COMMAND_MS;
+  agg.tick(now);
+  std::vector<Bytes> retry = aggWire.take(MESH_COMMAND);
+  TEST_ASSERT_EQUAL(1, retry.size());
+  deliver(peer, retry[0]);
+
+  TEST_ASSERT_EQUAL(1, owner.applied);
+  deliverAll(agg, peerWire.take(MESH_COMMAND_ACK));
+  TEST_ASSERT_EQUAL(1, router.done);
+  TEST_ASSERT_EQUAL(0, router.failed);
+}
+
+void test_commands_to_one_hub_go_one_at_a_time() {
+  TEST_ASSERT_TRUE(agg.command("attic", "relay1", true, -1, now));
+  TEST_ASSERT_TRUE(agg.command("attic", "relay1", false, -1, now));
+  std::vector<Bytes> first = aggWire.take(MESH_COMMAND);
+  TEST_ASSERT_EQUAL(1, first.size());
+
+  deliver(peer, first[0]);
+  deliverAll(agg, peerWire.take(MESH_COMMAND_ACK));
+  std::vector<Bytes> second = aggWire.take(MESH_COMMAND);
+  TEST_ASSERT_EQUAL(1, second.size());
+  TEST_ASSERT_EQUAL(seqOf(first[0]) + 1, seqOf(second[0]));
+
+  deliver(peer, second[0]);
+  deliverAll(agg, peerWire.take(MESH_COMMAND_ACK));
+  TEST_ASSERT_EQUAL(2, owner.applied);
+  TEST_ASSERT_FALSE(owner.state);
+  TEST_ASSERT_EQUAL(2, router.done);
+}
+
+void test_late_retry_does_not_undo_a_newer_command() {
+  TEST_ASSERT_TRUE(agg.command("attic", "relay1", true, -1, now));
+  TEST_ASSERT_TRUE(agg.command("attic", "relay1", false, -1, now));
+
+  // Every try of "on" is held back until the sender gives up on it
+  std::vector<Bytes> held = aggWire.take(MESH_COMMAND);
+  for (int i = 0; i < MESH_COMMAND_TRIES; i++) {
+    now += MESH_COMMAND_MS;
+    agg.tick(now);
+  }
+  TEST_ASSERT_EQUAL(1, router.failed);
+  std::vector<Bytes> tries = aggWire.take(MESH_COMMAND);
+  TEST_ASSERT_TRUE(tries.size() > 1);
+  Bytes off = tries.back();
+  TEST_ASSERT_NOT_EQUAL(seqOf(held[0]), seqOf(off));
+
+  // "off" lands first, then the held copies of "on"
+  deliver(peer, off);
+  deliverAll(peer, held);
+  deliver(peer, tries.front());
+
+  TEST_ASSERT_EQUAL(1, owner.applied);
+  TEST_ASSERT_FALSE(owner.state);
+
+  deliverAll(agg, peerWire.take(MESH_COMMAND_ACK));
+  TEST_ASSERT_EQUAL(2, router.done);
+  TEST_ASSERT_EQUAL(1, router.failed);
+}
+
+void test_seq_wrap_and_reboot() {
+  // Past the 16-bit wrap every command is still newer than the last
+  for (int i = 0; i < 70000; i++) {
+    TEST_ASSERT_TRUE(agg.command("attic", "relay1", i & 1, -1, now));
+    deliverAll(peer, aggWire.take(MESH_COMMAND));
+    deliverAll(agg, peerWire.take(MESH_COMMAND_ACK));
+  }
+  TEST_ASSERT_EQUAL(70000, owner.applied);
+  TEST_ASSERT_EQUAL(70000, router.done);
+  TEST_ASSERT_EQUAL(0, router.failed);
+
+  // A rebooted sender starts its seqs over, below the last one applied,
+  // and is applied again under its new epoch
+  agg.begin(MESH_AGGREGATOR, 1, 12, "hall", MESH_PORT, aggWire, router);
+  now += MESH_ANNOUNCE_MS;
+  agg.tick(now);
+  peer.tick(now);
+  deliverAll(peer, aggWire.take(MESH_ANNOUNCE));
+  deliverAll(agg, peerWire.take(MESH_ANNOUNCE));
+  TEST_ASSERT_TRUE(agg.command("attic", "relay1", true, -1, now));
+  deliverAll(peer, aggWire.take(MESH_COMMAND));
+  TEST_ASSERT_EQUAL(70001, owner.applied);
+  TEST_ASSERT_TRUE(owner.state);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_command_is_applied_once);
+  RUN_TEST(test_commands_to_one_hub_go_one_at_a_time);
+  RUN_TEST(test_late_retry_does_not_undo_a_newer_command);
+  RUN_TEST(test_seq_wrap_and_reboot);
+  return UNITY_END();
+}
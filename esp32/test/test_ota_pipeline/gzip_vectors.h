@@ -0,0 +1,191 @@
+// gzip streams of makeImage(3000) (fixed Huffman blocks) and makeImage(32000)
+// (dynamic blocks, with a match close to the 32 KB window limit), made with
+// Python's zlib.compressobj(9, DEFLATED, 31, 9, Z_FIXED / Z_DEFAULT_STRATEGY)
+
+#pragma once
+
+#include <stdint.h>
+
+static const uint8_t GZIP_FIXED[1145] = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x7b, 0xb9, 0xfc, 0x1a, 0xef, 0x21,
+  0xbb, 0xb3, 0xeb, 0x15, 0xd6, 0x67, 0x4e, 0x53, 0x0b, 0x4a, 0xad, 0x7b, 0xb6, 0xdb, 0xe5, 0xc2,
+  0xfc, 0xa8, 0xe8, 0xda, 0x55, 0x3b, 0x6f, 0xc5, 0x4d, 0x63, 0x4a, 0x61, 0x3d, 0x23, 0xef, 0x7e,
+  0x70, 0xd3, 0xf4, 0xa0, 0x68, 0xf5, 0x3f, 0xaf, 0x36, 0xde, 0x9a, 0x70, 0xd6, 0xed, 0x66, 0xf1,
+  0xa6, 0x2c, 0xff, 0xa6, 0xf5, 0x7d, 0xee, 0xeb, 0x85, 0x9f, 0x71, 0x76, 0x49, 0x16, 0xb9, 0xd9,
+  0x6d, 0xe0, 0xb1, 0x52, 0x37, 0xe0, 0xaf, 0x7c, 0xba, 0xfd, 0x04, 0x53, 0xd5, 0x94, 0x35, 0xf7,
+  0xef, 0xbc, 0x12, 0x8f, 0x64, 0xab, 0x63, 0x9e, 0x52, 0x1f, 0xc6, 0x2a, 0x77, 0x71, 0x4a, 0xc9,
+  0x8e, 0xbc, 0xfd, 0x53, 0x92, 0x19, 0x52, 0x55, 0x27, 0x48, 0xef, 0x9c, 0x7f, 0xef, 0xf6, 0x12,
+  0xa9, 0x6b, 0x67, 0x0a, 0x66, 0x4f, 0x74, 0xff, 0x67, 0x6e, 0xc0, 0xae, 0x12, 0x33, 0x67, 0xed,
+  0x36, 0x83, 0x27, 0x25, 0x01, 0x7b, 0x3d, 0xfc, 0xef, 0x17, 0x6f, 0xd6, 0x69, 0x33, 0xb7, 0x12,
+  0x0d, 0xfe, 0xfa, 0xb4, 0xf2, 0x6b, 0xf9, 0x95, 0xfd, 0x01, 0x7f, 0xda, 0x99, 0x57, 0x9c, 0xbb,
+  0xdc, 0x7f, 0xe6, 0xd4, 0xed, 0xe2, 0xcc, 0xc5, 0xbc, 0x71, 0x65, 0xde, 0x5f, 0x1a, 0xe3, 0x2f,
+  0x64, 0x6b, 0xa7, 0xcd, 0x6f, 0x2c, 0x0a, 0x7b, 0xce, 0xc7, 0xde, 0xbc, 0xf8, 0x02, 0xd7, 0xae,
+  0x92, 0x05, 0x6d, 0xfd, 0x49, 0xdf, 0x5e, 0xda, 0xa8, 0x3c, 0x9c, 0xfc, 0xa6, 0x46, 0x3f, 0xce,
+  0xe8, 0x51, 0xf8, 0x76, 0x9e, 0x92, 0xdc, 0xc5, 0x73, 0x9e, 0x9a, 0x5c, 0x98, 0xf8, 0x43, 0xa0,
+  0xf7, 0xee, 0xf2, 0x5c, 0x5b, 0x55, 0xa1, 0xbb, 0xeb, 0x35, 0xaf, 0x30, 0xe5, 0x7d, 0xf6, 0x17,
+  0x78, 0x32, 0x53, 0x39, 0xfb, 0xd3, 0xbd, 0xb3, 0x9b, 0x43, 0x7e, 0xa9, 0x7a, 0xbc, 0x49, 0x74,
+  0x16, 0xbf, 0xeb, 0xf8, 0xdb, 0xe0, 0x97, 0xdc, 0xa7, 0xc6, 0x3f, 0x3b, 0xd9, 0xb7, 0xf5, 0xa9,
+  0x77, 0x73, 0x0b, 0xde, 0x6c, 0x5b, 0xb2, 0xe9, 0x29, 0xc3, 0x3a, 0xcd, 0x8b, 0xe2, 0x51, 0x6e,
+  0x87, 0x3d, 0x1b, 0x54, 0x0f, 0xda, 0x67, 0x2e, 0xa8, 0x10, 0x55, 0x4e, 0x5c, 0x7c, 0x26, 0x64,
+  0x35, 0x7f, 0x71, 0xca, 0xde, 0x27, 0xe6, 0x9d, 0x69, 0x53, 0xe2, 0x99, 0x14, 0xd7, 0xbf, 0x6c,
+  0x79, 0x52, 0xe6, 0xb9, 0x39, 0xfb, 0x59, 0xbd, 0xda, 0xba, 0x39, 0x5d, 0xbe, 0x67, 0x4e, 0xbd,
+  0xb3, 0x9e, 0xad, 0x70, 0x44, 0x6d, 0x5e, 0xf8, 0x02, 0x5d, 0xe9, 0x93, 0xa6, 0xf3, 0x67, 0x79,
+  0xb7, 0xbc, 0x7e, 0xad, 0xca, 0xf8, 0x64, 0xd2, 0x23, 0x66, 0x46, 0x9b, 0xb8, 0xd8, 0x6b, 0x1d,
+  0xb6, 0x9f, 0xae, 0x07, 0xec, 0xda, 0xa1, 0xeb, 0x5c, 0x93, 0xae, 0x5f, 0x79, 0xe1, 0xdc, 0x11,
+  0xef, 0xee, 0xee, 0xc3, 0x33, 0x53, 0x57, 0x08, 0x45, 0x4d, 0xf5, 0x93, 0x63, 0x66, 0x98, 0xf2,
+  0xc0, 0xda, 0x54, 0x66, 0xe1, 0x75, 0x4d, 0x36, 0x79, 0x69, 0xcf, 0xbc, 0xdd, 0x47, 0x13, 0x72,
+  0x7f, 0xb8, 0xd7, 0xc5, 0x7b, 0x7a, 0xef, 0xfc, 0xc4, 0x1d, 0xd3, 0xa3, 0xa8, 0x1f, 0xaa, 0x67,
+  0x7c, 0xfb, 0x99, 0x54, 0x96, 0x5c, 0xe4, 0xd2, 0x87, 0x39, 0x79, 0xf1, 0x97, 0x3b, 0x1e, 0xcc,
+  0x09, 0x16, 0x60, 0x48, 0x92, 0x3b, 0x5e, 0xd1, 0x27, 0x90, 0x2a, 0xf8, 0xa7, 0xac, 0x50, 0x9e,
+  0xd9, 0xb2, 0xf1, 0x79, 0xfd, 0x8c, 0xbb, 0xb2, 0x41, 0x5f, 0x43, 0x92, 0xb8, 0xdf, 0xdf, 0x72,
+  0x15, 0xde, 0xaf, 0xe7, 0x30, 0x7f, 0xc1, 0xd4, 0xcd, 0xf6, 0xeb, 0x5a, 0x4e, 0x9f, 0x6e, 0x5b,
+  0xf7, 0x96, 0x79, 0xe1, 0xad, 0x1f, 0x8a, 0xd2, 0x55, 0xcd, 0x8e, 0x79, 0xf7, 0xbf, 0x79, 0x44,
+  0x34, 0xf0, 0x1d, 0x78, 0xb5, 0xcf, 0xe0, 0x64, 0x95, 0xe8, 0x6a, 0xa1, 0xcf, 0x33, 0x77, 0x76,
+  0x1c, 0xb1, 0x7e, 0x26, 0x9f, 0x6c, 0x6e, 0xf0, 0x46, 0x63, 0x3e, 0x67, 0xce, 0xa7, 0xc7, 0x9c,
+  0xbb, 0xef, 0x5f, 0x79, 0xc7, 0xcd, 0x51, 0x11, 0xb2, 0xe8, 0xcf, 0x56, 0x5d, 0xcb, 0xd6, 0x79,
+  0xcf, 0x73, 0x1f, 0xfe, 0x3c, 0xb5, 0xa5, 0xc8, 0xe2, 0xff, 0xd7, 0xd5, 0x0c, 0x9e, 0x7b, 0x17,
+  0xb1, 0x04, 0x6f, 0x9d, 0x7c, 0xc0, 0xec, 0xa8, 0x77, 0x72, 0xb7, 0xa8, 0xc9, 0x3b, 0x85, 0x8b,
+  0x2d, 0x31, 0x56, 0x29, 0xc7, 0xc3, 0x7e, 0xf6, 0xec, 0x39, 0x61, 0xda, 0x18, 0x18, 0xfb, 0x9d,
+  0x43, 0x6e, 0x6d, 0x86, 0xe9, 0xde, 0xad, 0x97, 0xf5, 0x1f, 0x9c, 0x13, 0xb2, 0x79, 0xe9, 0xd9,
+  0xf6, 0xac, 0x3b, 0xbd, 0xfc, 0xff, 0x3c, 0xef, 0xbc, 0xdb, 0x7a, 0x72, 0x7f, 0xfe, 0xd4, 0x37,
+  0x3e, 0xe3, 0xa9, 0x97, 0xda, 0xfd, 0xf8, 0xf1, 0x66, 0xbf, 0x2f, 0x1f, 0xc2, 0x1b, 0xa3, 0x17,
+  0x86, 0x35, 0xe6, 0x6e, 0x96, 0xb7, 0xae, 0x3b, 0x1d, 0xb7, 0xdf, 0x79, 0xdd, 0x9e, 0x1b, 0x4c,
+  0x91, 0xee, 0xcc, 0x65, 0xd1, 0xfe, 0x33, 0x44, 0x8f, 0xbb, 0x9d, 0xd4, 0x5a, 0xf8, 0xf4, 0xf4,
+  0xa3, 0xb9, 0x5b, 0xbc, 0x3c, 0x26, 0xae, 0x67, 0x3a, 0xf3, 0x66, 0xbe, 0xdc, 0x05, 0x85, 0xc2,
+  0x35, 0x51, 0x7b, 0x27, 0x86, 0xdf, 0x3b, 0xa6, 0xa0, 0x71, 0x2e, 0xb5, 0x95, 0x3d, 0x54, 0x78,
+  0x83, 0x63, 0xfe, 0x0d, 0x7e, 0x2b, 0x57, 0x13, 0x7e, 0x95, 0xa6, 0xfb, 0x6b, 0xa3, 0xfe, 0x26,
+  0x45, 0x6c, 0xff, 0xe6, 0x16, 0xc0, 0x71, 0xc2, 0x47, 0xb3, 0x60, 0xd7, 0x4f, 0xe1, 0x94, 0x94,
+  0x54, 0xb3, 0xfe, 0x93, 0x3c, 0xd2, 0x47, 0xe4, 0x35, 0x58, 0x2e, 0x3d, 0xda, 0xb9, 0xfe, 0xee,
+  0xda, 0xc0, 0x1b, 0x13, 0xbf, 0x78, 0x37, 0x85, 0x2f, 0xfe, 0x79, 0x35, 0xc0, 0xf8, 0x87, 0xc2,
+  0xf5, 0x8d, 0xeb, 0x5c, 0xf7, 0x3c, 0x5b, 0x37, 0xbb, 0xa2, 0xba, 0x4c, 0x46, 0xe6, 0xee, 0x85,
+  0xd8, 0x75, 0x86, 0x87, 0x97, 0x18, 0xcd, 0xbf, 0xa7, 0xbb, 0xf0, 0x6c, 0x50, 0x64, 0xbb, 0xbd,
+  0x50, 0xda, 0x37, 0x56, 0xd6, 0xaf, 0xba, 0x4f, 0xdf, 0xc5, 0x31, 0xbc, 0x59, 0xbc, 0xe5, 0x2d,
+  0xdf, 0xa6, 0x6f, 0xf9, 0x1e, 0xdd, 0xbb, 0x5f, 0xe7, 0x9d, 0x4b, 0x4b, 0xec, 0x8d, 0xdc, 0xbe,
+  0xa6, 0xdf, 0x5c, 0xef, 0xe3, 0xc4, 0xaa, 0x35, 0x0b, 0x45, 0x76, 0xda, 0xa9, 0x7e, 0x58, 0xfb,
+  0x85, 0x67, 0xaf, 0x8e, 0x67, 0x9c, 0x54, 0x65, 0x7a, 0x26, 0xcb, 0x32, 0x3f, 0x1d, 0xf1, 0xbe,
+  0xbd, 0xa6, 0x0d, 0x13, 0xbc, 0xa7, 0x7c, 0x93, 0x91, 0x36, 0x79, 0xb3, 0x43, 0xf1, 0xd4, 0x47,
+  0xa1, 0xf3, 0x32, 0x77, 0xdc, 0xd6, 0x87, 0xdb, 0x46, 0xd8, 0x6f, 0xd7, 0x5b, 0x23, 0xb4, 0xb9,
+  0xe7, 0x25, 0x6b, 0xb1, 0x5c, 0xb3, 0xb4, 0x87, 0xdd, 0x27, 0xbb, 0x78, 0x01, 0xff, 0x5f, 0xef,
+  0x5c, 0x4e, 0xb1, 0xcd, 0xe1, 0x75, 0xe2, 0x3d, 0xbf, 0xe1, 0xbd, 0xba, 0xcd, 0x8b, 0x27, 0x2f,
+  0x0e, 0x7f, 0x7f, 0xf4, 0x75, 0xb2, 0xcc, 0x86, 0x6e, 0xc1, 0x07, 0x4c, 0x71, 0x5f, 0x03, 0xe7,
+  0x9f, 0x58, 0xab, 0xeb, 0xa9, 0xfc, 0x6c, 0xd6, 0xc2, 0xab, 0xb7, 0x1e, 0x31, 0xfa, 0xec, 0x88,
+  0xe0, 0x11, 0x73, 0x0b, 0xc8, 0xde, 0x37, 0xf7, 0xee, 0x77, 0xa1, 0x09, 0x07, 0xfc, 0x04, 0xd4,
+  0xd7, 0xb6, 0x4e, 0xb6, 0xbb, 0x51, 0xd7, 0x60, 0x54, 0x25, 0xc7, 0xac, 0xba, 0xc6, 0x4f, 0xcb,
+  0xeb, 0xe2, 0xbc, 0xb7, 0x4e, 0x35, 0x1f, 0xe3, 0x2b, 0xf2, 0x0b, 0x37, 0x31, 0xe9, 0x5e, 0x36,
+  0x69, 0xf0, 0x9e, 0x59, 0xfc, 0x35, 0xf1, 0x86, 0xc3, 0xa4, 0xe0, 0x8d, 0x8a, 0xbf, 0x83, 0x26,
+  0x74, 0xe4, 0x5c, 0xbc, 0x74, 0xfc, 0x86, 0x77, 0xfc, 0xc2, 0x47, 0x5d, 0xc5, 0x7f, 0xec, 0x1e,
+  0x76, 0xfe, 0x78, 0xd1, 0x60, 0xd8, 0xe5, 0x78, 0xd6, 0x26, 0xe8, 0x5b, 0x51, 0x9f, 0xab, 0x73,
+  0x6b, 0x83, 0x91, 0x69, 0xba, 0x79, 0xa2, 0x61, 0xb2, 0xb1, 0x55, 0x8a, 0x49, 0x9a, 0x59, 0x82,
+  0x81, 0xf5, 0x28, 0x7f, 0x64, 0xf1, 0x8d, 0xc1, 0x54, 0x92, 0x91, 0x75, 0x2a, 0x58, 0xc2, 0x6a,
+  0x94, 0x3f, 0xb4, 0xf9, 0xa3, 0xd5, 0xf9, 0x68, 0x75, 0x3e, 0x5a, 0x9d, 0x0f, 0xff, 0xea, 0x1c,
+  0x00, 0x2c, 0xd2, 0x9c, 0xec, 0xb8, 0x0b, 0x00, 0x00,
+};
+
+static const uint8_t GZIP_DYNAMIC[1689] = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xed, 0xdd, 0xf9, 0x3f, 0xd4, 0x79,
+  0x1c, 0x07, 0x70, 0x91, 0xd4, 0x22, 0xd2, 0x5a, 0x8f, 0x8d, 0x1d, 0x33, 0xcc, 0x61, 0x98, 0xcb,
+  0x98, 0x31, 0xcc, 0x8c, 0x99, 0x2e, 0x57, 0xd3, 0x22, 0x1d, 0x8e, 0xca, 0x3d, 0x24, 0x8c, 0x63,
+  0x34, 0xce, 0x06, 0x85, 0x8a, 0x12, 0xa5, 0xb6, 0x43, 0x4d, 0xd2, 0x6e, 0x3d, 0x36, 0x4c, 0x51,
+  0x21, 0xe9, 0x58, 0xda, 0x4a, 0x88, 0x74, 0x88, 0x10, 0x31, 0xa5, 0xa4, 0x12, 0x52, 0xd9, 0xc3,
+  0x7c, 0xff, 0x8b, 0xdd, 0xef, 0xfb, 0xa7, 0xd7, 0xe3, 0xf9, 0x78, 0xfd, 0xfe, 0xfe, 0xfc, 0xf4,
+  0x7a, 0x7c, 0x46, 0xce, 0x3e, 0xd1, 0xff, 0x43, 0xd0, 0xaa, 0xc4, 0x2a, 0x23, 0x0f, 0x13, 0xbd,
+  0xc5, 0x72, 0x55, 0xfd, 0xca, 0x76, 0x85, 0xff, 0xc6, 0xed, 0xbf, 0xd7, 0x75, 0x07, 0x1c, 0xd6,
+  0x0c, 0xd3, 0x6e, 0x31, 0x77, 0xbd, 0x55, 0xf5, 0x8b, 0xf7, 0x46, 0xd2, 0xcc, 0x9b, 0x8b, 0xdd,
+  0x85, 0xad, 0x2e, 0xcf, 0xa4, 0x55, 0x5b, 0x3d, 0x77, 0x28, 0x0b, 0x5c, 0x95, 0x8b, 0x55, 0x0b,
+  0xf2, 0x7e, 0x4c, 0x70, 0x11, 0x5c, 0xd0, 0xe3, 0x92, 0x18, 0x06, 0x29, 0xc3, 0x35, 0x77, 0x35,
+  0x53, 0x8b, 0xcb, 0xfb, 0x9f, 0xbf, 0x31, 0xf1, 0x9b, 0x27, 0xd7, 0x2a, 0xce, 0xd8, 0xa0, 0x8d,
+  0xe9, 0x28, 0x4e, 0xac, 0x95, 0xdc, 0x28, 0x0e, 0xd5, 0x10, 0x13, 0x0a, 0x4d, 0xeb, 0x14, 0x7d,
+  0x3d, 0x67, 0x96, 0x3c, 0x69, 0x89, 0x3b, 0x5e, 0xe4, 0xfa, 0x37, 0x87, 0xa1, 0x83, 0xdf, 0x54,
+  0x52, 0x71, 0x85, 0x31, 0x94, 0xe8, 0xd5, 0xe0, 0xe6, 0xd9, 0x2f, 0xad, 0xa6, 0xe4, 0x72, 0xb8,
+  0xc6, 0x6b, 0x27, 0x87, 0x53, 0x26, 0x93, 0x1e, 0xdd, 0xf0, 0x9a, 0xd9, 0xa5, 0x75, 0xae, 0xad,
+  0x73, 0x7f, 0x4b, 0x73, 0x8f, 0x34, 0xb2, 0x4c, 0x3f, 0x40, 0x26, 0x9a, 0xc8, 0x0a, 0x6c, 0x8f,
+  0xb2, 0x09, 0x57, 0x64, 0x25, 0x6c, 0x78, 0xb5, 0x50, 0x67, 0x67, 0x59, 0xfb, 0x77, 0x57, 0x13,
+  0x4f, 0xe5, 0xee, 0x0f, 0x99, 0x1a, 0xe1, 0xe3, 0x07, 0x0e, 0x8e, 0xa6, 0xd3, 0x03, 0x98, 0x83,
+  0x3e, 0x35, 0x7a, 0x89, 0x31, 0x65, 0x25, 0xc3, 0xac, 0xf6, 0xa2, 0x69, 0xc3, 0x7d, 0xbd, 0x67,
+  0x63, 0x9c, 0x08, 0x46, 0xbd, 0x4a, 0xf2, 0x23, 0x4d, 0xc9, 0x27, 0x4f, 0xc3, 0xa1, 0xa3, 0x96,
+  0x51, 0xe3, 0x7d, 0xad, 0xd5, 0xeb, 0xbe, 0x12, 0xdc, 0x46, 0x83, 0x57, 0x98, 0xf4, 0x2e, 0xfb,
+  0xc6, 0xf8, 0x8a, 0x19, 0xcf, 0x9a, 0xa9, 0xd3, 0xb9, 0x52, 0x40, 0xca, 0xd7, 0x5d, 0xf4, 0x2c,
+  0xf7, 0x4c, 0xd5, 0xb0, 0x46, 0x25, 0xb9, 0xc3, 0xc4, 0xdf, 0xa5, 0xd1, 0x3d, 0x93, 0x70, 0x4b,
+  0x18, 0x79, 0x2a, 0xd9, 0xd8, 0x32, 0xb8, 0xac, 0x65, 0xdd, 0x79, 0x03, 0x69, 0x58, 0xc3, 0x10,
+  0x67, 0x4f, 0x78, 0x71, 0xa0, 0x26, 0x4e, 0x39, 0x92, 0x3d, 0x24, 0x73, 0xaf, 0x8e, 0x52, 0x65,
+  0x10, 0x2b, 0x4b, 0xf2, 0x7e, 0x6e, 0x69, 0x1e, 0xe3, 0x1d, 0xc7, 0x36, 0x11, 0x4f, 0xfa, 0x9c,
+  0xa2, 0x9a, 0xde, 0x63, 0x2b, 0x8e, 0x89, 0xb2, 0xdf, 0xbe, 0x25, 0xcc, 0x19, 0x3a, 0x30, 0xa8,
+  0x35, 0x87, 0x1f, 0xb0, 0xf9, 0xc9, 0x6e, 0xa7, 0xf1, 0xa7, 0x5e, 0x57, 0x6b, 0xa9, 0x2b, 0xd2,
+  0x23, 0xe8, 0x29, 0xed, 0x6d, 0x4d, 0xa2, 0xfc, 0xfc, 0xc6, 0xa3, 0xe2, 0x73, 0x46, 0xfe, 0x87,
+  0x3c, 0x30, 0x5a, 0x1a, 0xc5, 0x2f, 0x78, 0x6c, 0xb3, 0xd2, 0xa7, 0xe4, 0x79, 0xe6, 0xa6, 0xee,
+  0x92, 0xfa, 0xdb, 0x41, 0x31, 0xd3, 0xae, 0xf2, 0x40, 0x77, 0x51, 0xdd, 0xb8, 0xee, 0xa6, 0xbd,
+  0x38, 0xfa, 0x7a, 0x9a, 0x5d, 0x8f, 0x6a, 0xc9, 0x56, 0x8c, 0xdf, 0xaf, 0x03, 0xd1, 0x92, 0xc0,
+  0xce, 0xdd, 0x2f, 0x4a, 0xd6, 0x1a, 0x6a, 0x84, 0x60, 0xee, 0x24, 0x17, 0x18, 0x8a, 0x17, 0xcd,
+  0xc8, 0xe2, 0xcd, 0xb5, 0x1c, 0xb3, 0x5e, 0x65, 0x1c, 0xe9, 0xfd, 0xc9, 0x7b, 0x72, 0x5d, 0x88,
+  0xee, 0xfb, 0x6e, 0xe7, 0xc5, 0x37, 0x68, 0x4b, 0x15, 0xa7, 0x0e, 0x55, 0x0b, 0x2b, 0xb3, 0xef,
+  0xdf, 0xcf, 0xad, 0x7c, 0xa7, 0x55, 0xda, 0x3d, 0x8d, 0x33, 0x4d, 0xdd, 0xb9, 0x4c, 0xd2, 0x3f,
+  0xe5, 0xe6, 0x9b, 0xb9, 0xf0, 0xe6, 0x9b, 0xeb, 0x8c, 0x7b, 0xa9, 0xc6, 0xe7, 0x8d, 0x3e, 0x1d,
+  0xad, 0xdb, 0xdd, 0xc4, 0x53, 0x99, 0x87, 0x72, 0x18, 0xa3, 0x56, 0x8a, 0x05, 0xd1, 0xe3, 0x2f,
+  0x17, 0xd4, 0xf7, 0x3f, 0x1a, 0xd3, 0x9d, 0x9f, 0xbc, 0xee, 0xf4, 0xcc, 0x65, 0xaa, 0x63, 0xce,
+  0xc9, 0x57, 0x31, 0x03, 0x5f, 0x9a, 0x2f, 0x25, 0x38, 0xfc, 0x33, 0x79, 0x5e, 0xc3, 0xbd, 0xe1,
+  0xf4, 0xdc, 0xb5, 0x97, 0x0f, 0xde, 0xb4, 0xbf, 0x2d, 0x0a, 0xcd, 0x37, 0x66, 0x8d, 0x61, 0x3b,
+  0xb2, 0x37, 0x71, 0xc3, 0xee, 0x6c, 0xf8, 0xb2, 0xf7, 0xda, 0x5d, 0x76, 0xd6, 0x9a, 0xcd, 0x9f,
+  0xe7, 0x63, 0x2a, 0xb6, 0xb0, 0x1b, 0x2e, 0x77, 0xd2, 0x5f, 0xb4, 0x19, 0xf1, 0x47, 0xdc, 0x73,
+  0x55, 0xf9, 0x11, 0x49, 0xff, 0x9c, 0x14, 0x49, 0x7a, 0x68, 0x98, 0x99, 0x99, 0x8c, 0x2c, 0x95,
+  0x5e, 0xc6, 0x92, 0xfa, 0x97, 0x2f, 0xab, 0x3d, 0x26, 0x3e, 0xf8, 0x64, 0x6d, 0x2c, 0xdd, 0x90,
+  0x15, 0x53, 0x6d, 0xce, 0x93, 0xdf, 0x0f, 0xb8, 0xb1, 0xa2, 0xf2, 0x5a, 0x97, 0xa6, 0x9f, 0xab,
+  0x96, 0x6c, 0xa3, 0xe7, 0x11, 0xe3, 0x3b, 0x2e, 0xf7, 0xac, 0x4b, 0x87, 0xef, 0x0f, 0x9e, 0xb8,
+  0xb4, 0xca, 0xad, 0x48, 0xa9, 0xd9, 0x32, 0xaa, 0xc0, 0xb4, 0x63, 0xe3, 0xcb, 0xfd, 0x1b, 0x8a,
+  0x7c, 0xfa, 0xfe, 0xc4, 0x5a, 0xb5, 0x89, 0x73, 0x74, 0xd6, 0x2f, 0xbe, 0xb0, 0x2c, 0xb6, 0xcb,
+  0x80, 0xeb, 0xcc, 0x32, 0xc0, 0xef, 0xe8, 0xaf, 0xf0, 0xff, 0x2b, 0xc4, 0xb7, 0x66, 0xca, 0xc5,
+  0x6b, 0xfe, 0xdd, 0xd5, 0xe4, 0xb8, 0xab, 0x5f, 0x16, 0x87, 0x85, 0x89, 0xed, 0xf7, 0xdf, 0xd3,
+  0x33, 0x6d, 0x32, 0xb7, 0x9a, 0xfb, 0x70, 0xb0, 0x4e, 0xd9, 0x5b, 0xb1, 0xa6, 0xab, 0x68, 0x42,
+  0xb4, 0xc3, 0xa7, 0xec, 0xcb, 0x63, 0x2f, 0xbb, 0x69, 0xec, 0xd3, 0x8b, 0x95, 0xce, 0xd7, 0x54,
+  0x95, 0xc7, 0x93, 0xd3, 0x64, 0x66, 0x66, 0xbd, 0xed, 0x9b, 0x2b, 0x6d, 0x1b, 0xcf, 0x30, 0x15,
+  0x7d, 0xd4, 0xd2, 0x56, 0x6f, 0xbf, 0x5d, 0x42, 0xa3, 0xf0, 0x29, 0x6d, 0xed, 0x49, 0xea, 0xf0,
+  0x58, 0x80, 0xc6, 0x68, 0xd9, 0xa5, 0x77, 0x0b, 0xab, 0xa6, 0x62, 0xdd, 0xf2, 0xeb, 0xdf, 0x4a,
+  0xda, 0xc2, 0x83, 0xf7, 0xf9, 0xd5, 0x94, 0xef, 0xe7, 0xd0, 0x3e, 0x16, 0xa5, 0x96, 0x97, 0x7e,
+  0x5f, 0x27, 0x20, 0x7c, 0xa8, 0x98, 0xd0, 0x6b, 0xa0, 0xb8, 0x07, 0x2c, 0x49, 0x89, 0x88, 0x9c,
+  0xfb, 0x9b, 0x07, 0xc5, 0xa4, 0xa0, 0x81, 0x9d, 0x59, 0x28, 0x2a, 0x9e, 0x32, 0x33, 0x65, 0x8d,
+  0xd6, 0xe2, 0x9a, 0x3f, 0x1a, 0x3d, 0x30, 0x7b, 0xee, 0xa2, 0xf4, 0x71, 0xf2, 0x15, 0xd6, 0xd0,
+  0xca, 0x8d, 0xaa, 0xf7, 0x8e, 0x68, 0x4b, 0x31, 0x3b, 0x4d, 0xdd, 0x04, 0xe3, 0x82, 0x40, 0x43,
+  0xcf, 0xaf, 0x63, 0x2b, 0x9b, 0xe7, 0x95, 0xe8, 0x2f, 0xd7, 0x7f, 0x70, 0xe1, 0x3d, 0x89, 0xff,
+  0x7a, 0xe8, 0x75, 0xe3, 0xe7, 0xc1, 0xc9, 0x83, 0x66, 0x17, 0xf2, 0x17, 0xbd, 0xd0, 0x0c, 0x98,
+  0x5c, 0xa3, 0xb8, 0x5b, 0x41, 0x75, 0xb7, 0x54, 0x1d, 0x2b, 0x7d, 0xdc, 0x3d, 0x38, 0x67, 0x75,
+  0xad, 0xaf, 0xde, 0x0f, 0x2e, 0x5e, 0x51, 0xd7, 0x4f, 0xf4, 0x7e, 0x36, 0x2a, 0xbc, 0xe9, 0x61,
+  0x48, 0xaa, 0xc8, 0x39, 0x28, 0xe8, 0x92, 0x67, 0x32, 0x53, 0x31, 0x5a, 0x84, 0x72, 0x0f, 0xeb,
+  0x55, 0x1d, 0x27, 0xdf, 0x2d, 0x4f, 0xff, 0x18, 0x98, 0x1c, 0x1b, 0x5f, 0xa5, 0x49, 0xed, 0x64,
+  0x65, 0x8a, 0x8e, 0x4a, 0x27, 0x83, 0xbb, 0x96, 0x1e, 0x58, 0x7b, 0x11, 0xf7, 0xcd, 0xbb, 0x70,
+  0x77, 0x74, 0xc7, 0xc3, 0x3b, 0x5d, 0xa2, 0xc0, 0xd2, 0xc1, 0x3c, 0xe9, 0x8c, 0x60, 0x60, 0xcf,
+  0xf4, 0xeb, 0x4c, 0xdb, 0xbc, 0x65, 0xad, 0x7c, 0xef, 0xa9, 0x84, 0x02, 0xe7, 0x15, 0x39, 0x99,
+  0x4c, 0x76, 0x04, 0x27, 0xd8, 0x36, 0xd4, 0x8e, 0x1b, 0xc6, 0x0a, 0xb7, 0x0f, 0x62, 0xf0, 0xc0,
+  0xe8, 0xb2, 0x1d, 0x12, 0x21, 0x4c, 0x9e, 0x18, 0x29, 0xb8, 0x60, 0x74, 0x99, 0x65, 0x17, 0x6c,
+  0x1b, 0xc1, 0x11, 0xb3, 0xf9, 0x21, 0xcc, 0x20, 0x46, 0xb8, 0xbd, 0x13, 0x18, 0x5d, 0x66, 0x23,
+  0x11, 0xc6, 0x72, 0x0a, 0x45, 0x0a, 0x3e, 0x18, 0x5d, 0xb6, 0x9f, 0x7d, 0x0b, 0xd4, 0xa7, 0x40,
+  0xa0, 0x3e, 0x0a, 0x61, 0x2c, 0x21, 0x18, 0x5d, 0xe6, 0x20, 0x11, 0x6e, 0x2f, 0x0c, 0x46, 0x0a,
+  0x01, 0x18, 0x5d, 0x76, 0x10, 0xc6, 0x38, 0x45, 0xf1, 0x22, 0x1d, 0x19, 0x12, 0x41, 0x34, 0x7f,
+  0x2b, 0xd7, 0x16, 0x8c, 0x2e, 0x3b, 0x22, 0xb1, 0xc5, 0xc1, 0x36, 0x16, 0x29, 0x18, 0x60, 0x74,
+  0x99, 0xeb, 0x14, 0x2b, 0x8c, 0x74, 0x8c, 0xe2, 0x31, 0xa3, 0xf9, 0x12, 0xc1, 0x16, 0x07, 0x3b,
+  0x30, 0xba, 0xcc, 0x43, 0x62, 0x2b, 0xd7, 0x2e, 0x06, 0x29, 0x98, 0x60, 0x74, 0x99, 0x3f, 0xfb,
+  0x16, 0xa8, 0x4f, 0x01, 0x4b, 0x7d, 0x14, 0x24, 0x02, 0x36, 0x18, 0x5d, 0x76, 0x42, 0x22, 0x9a,
+  0xcf, 0x8e, 0x42, 0x0a, 0x16, 0x18, 0x5d, 0x16, 0xcc, 0xbe, 0x05, 0xea, 0x53, 0x60, 0xaf, 0x3e,
+  0x0a, 0xd1, 0x7c, 0x0e, 0x18, 0x5d, 0x16, 0x22, 0x21, 0x11, 0x70, 0x22, 0x91, 0xc2, 0x1e, 0x8c,
+  0x2e, 0x63, 0x49, 0xdb, 0x08, 0x52, 0xcb, 0x78, 0x9c, 0x95, 0x8c, 0x98, 0x88, 0x4f, 0xb0, 0x20,
+  0x83, 0xd1, 0x65, 0x1c, 0x12, 0x71, 0x58, 0x72, 0x12, 0x52, 0x58, 0x81, 0xd1, 0x65, 0x0b, 0x42,
+  0x12, 0x29, 0x1e, 0x27, 0xb5, 0xb4, 0x4e, 0xc4, 0xcb, 0x88, 0x71, 0x58, 0x1b, 0x30, 0xba, 0x6c,
+  0x89, 0x44, 0x82, 0x85, 0xcd, 0x36, 0xa4, 0xb0, 0x06, 0xa3, 0xcb, 0xf8, 0xd9, 0xb7, 0x40, 0x7d,
+  0x0a, 0x28, 0xea, 0xa3, 0x20, 0x23, 0x52, 0xc1, 0xe8, 0x32, 0x01, 0x89, 0x44, 0x3c, 0x55, 0x8a,
+  0x14, 0x14, 0x30, 0xba, 0x4c, 0x9c, 0x7d, 0x0b, 0xd4, 0xa7, 0x80, 0xa6, 0x3e, 0x0a, 0x89, 0x78,
+  0x3a, 0x18, 0x5d, 0x26, 0x21, 0x21, 0x23, 0xd2, 0xe3, 0x91, 0x82, 0x06, 0x46, 0x97, 0xad, 0xe8,
+  0xdb, 0xa9, 0x69, 0x36, 0x29, 0x64, 0xac, 0x9c, 0x96, 0x4e, 0x49, 0xb5, 0xc6, 0x81, 0xd1, 0x65,
+  0x32, 0x12, 0xc9, 0x56, 0xb8, 0x0c, 0xa4, 0xc0, 0x82, 0xd1, 0x65, 0x6b, 0x6a, 0x06, 0x3d, 0x85,
+  0x9c, 0x66, 0x63, 0x91, 0x4e, 0x91, 0xd3, 0x92, 0xad, 0x2c, 0xc1, 0xe8, 0xb2, 0x0d, 0x12, 0xa9,
+  0xd6, 0x96, 0xdb, 0x91, 0xc2, 0x02, 0x8c, 0x2e, 0x53, 0x66, 0xdf, 0x02, 0xf5, 0x29, 0xc0, 0xab,
+  0x8f, 0x82, 0x9c, 0x46, 0x00, 0xa3, 0xcb, 0x54, 0x24, 0xd2, 0x29, 0x84, 0x34, 0xa4, 0xc0, 0x83,
+  0xd1, 0x65, 0xda, 0xec, 0x5b, 0xa0, 0x3e, 0x05, 0x44, 0xf5, 0x51, 0x48, 0xa7, 0x90, 0xc0, 0xe8,
+  0x32, 0x1d, 0x09, 0x39, 0x8d, 0x94, 0x82, 0x14, 0x44, 0x30, 0xba, 0xcc, 0xe0, 0x88, 0xd9, 0xea,
+  0x29, 0x90, 0x83, 0x7a, 0x14, 0x14, 0xc2, 0x74, 0x04, 0xa3, 0xcb, 0xb6, 0x48, 0x04, 0x31, 0x1c,
+  0x23, 0x90, 0xc2, 0x01, 0x8c, 0x2e, 0xc3, 0x1e, 0x1e, 0xf6, 0xff, 0xb0, 0x87, 0x87, 0xfd, 0x3f,
+  0xec, 0xe1, 0x61, 0xff, 0x0f, 0x7b, 0x78, 0xd8, 0xff, 0x83, 0x61, 0xff, 0x0f, 0x86, 0xfd, 0x3f,
+  0x18, 0xf6, 0xff, 0x60, 0xd8, 0xff, 0x83, 0x61, 0xff, 0x0f, 0x86, 0xfd, 0x3f, 0x18, 0xf6, 0xff,
+  0x60, 0xd8, 0xff, 0x83, 0x61, 0xff, 0x0f, 0x86, 0xfd, 0x3f, 0x18, 0xf6, 0xff, 0x60, 0xd8, 0xff,
+  0x83, 0x61, 0xff, 0x0f, 0x86, 0xfd, 0x3f, 0x18, 0xf6, 0xff, 0x60, 0xd8, 0xff, 0x83, 0x61, 0xff,
+  0x0f, 0x86, 0xfd, 0x3f, 0x18, 0xf6, 0xff, 0x60, 0xd8, 0xff, 0x83, 0x61, 0xff, 0x0f, 0x86, 0xfd,
+  0xff, 0x7f, 0xcd, 0xf0, 0x2d, 0x32, 0x7c, 0x8b, 0x0c, 0xdf, 0x22, 0xff, 0xff, 0xbf, 0x45, 0xfe,
+  0x17, 0x65, 0x13, 0xa8, 0x03, 0x00, 0x7d, 0x00, 0x00,
+};
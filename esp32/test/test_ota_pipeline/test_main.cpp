@@ -0,0 +1,307 @@
+// OtaPipeline: plain, gzip (stored, fixed, dynamic) and delta uploads in random chunks
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "OtaPipeline.h"
+#include "gzip_vectors.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+class VecSink : public ByteSink {
+ public:
+  Bytes data;
+  bool put(const uint8_t* p, size_t len) override {
+    data.insert(data.end(), p, p + len);
+    return true;
+  }
+};
+
+class MemBase : public BaseImage {
+ public:
+  Bytes data;
+  uint32_t size() const override { return data.size(); }
+  bool read(uint32_t offset, uint8_t* buf, size_t len) override {
+    if (offset + len > data.size()) return false;
+    memcpy(buf, data.data() + offset, len);
+    return true;
+  }
+};
+
+static OtaPipeline ota;
+static VecSink sink;
+static MemBase base;
+
+void setUp() {
+  sink.data.clear();
+  base.data.clear();
+}
+
+void tearDown() { ota.end(); }
+
+// Same generator as the one gzip_vectors.h was made from
+static Bytes makeImage(size_t size) {
+  Bytes img(size);
+  uint32_t x = 12345;
+  for (size_t i = 0; i < size; i++) {
+    x = x * 1103515245u + 12345u;
+    img[i] = i < 1024 ? x >> 24 : "0123456789abcdef"[(i * 7) % 16] ^ ((i >> 9) & 0x1f);
+  }
+  img[0] = OTA_IMAGE_MAGIC;
+  if (size > 2048) memcpy(&img[size - 1000], &img[1], 1000);
+  return img;
+}
+
+static void sha256(const Bytes& data, uint8_t out[OTA_SHA_SIZE]) {
+  Sha256 sha;
+  sha.update(data.data(), data.size());
+  sha.final(out);
+}
+
+static uint32_t crc32(const Bytes& data) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint8_t b : data) {
+    crc ^= b;
+    for (int k = 0; k < 8; k++) crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+  }
+  return ~crc;
+}
+
+static void put32(Bytes& out, uint32_t v) {
+  for (int i = 0; i < 4; i++) out.push_back(v >> (8 * i));
+}
+
+// gzip member of stored blocks, blockSize bytes each
+static Bytes gzipStored(const Bytes& data, size_t blockSize) {
+  Bytes out = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3};
+  size_t off = 0;
+  do {
+    size_t n = data.size() - off < blockSize ? data.size() - off : blockSize;
+    out.push_back(off + n == data.size() ? 1 : 0);
+    out.push_back(n);
+    out.push_back(n >> 8);
+    out.push_back(~n);
+    out.push_back(~n >> 8);
+    out.insert(out.end(), data.begin() + off, data.begin() + off + n);
+    off += n;
+  } while (off < data.size());
+  put32(out, crc32(data));
+  put32(out, data.size());
+  return out;
+}
+
+static Bytes deltaHeader(const Bytes& from, const Bytes& to) {
+  Bytes out = {'O', 'D', 'L', 'T', OTA_DELTA_VERSION, 0, 0, 0};
+  uint8_t digest[OTA_SHA_SIZE];
+  put32(out, from.size());
+  sha256(from, digest);
+  out.insert(out.end(), digest, digest + OTA_SHA_SIZE);
+  put32(out, to.size());
+  sha256(to, digest);
+  out.insert(out.end(), digest, digest + OTA_SHA_SIZE);
+  return out;
+}
+
+// Target: base[0..1000) copied, base[1000..3000) with small changes (ADD),
+// then 500 new bytes (DATA), then the tail of the base copied again
+static void makeDelta(Bytes& target, Bytes& delta) {
+  base.data = makeImage(6000);
+  target.assign(base.data.begin(), base.data.begin() + 3000);
+  for (size_t i = 1000; i < 3000; i += 37) target[i] += 4;
+  for (int i = 0; i < 500; i++) target.push_back(i * 3);
+  target.insert(target.end(), base.data.begin() + 4000, base.data.end());
+
+  delta = deltaHeader(base.data, target);
+  delta.push_back(OTA_DELTA_COPY);
+  put32(delta, 0);
+  put32(delta, 1000);
+  delta.push_back(OTA_DELTA_ADD);
+  put32(delta, 1000);
+  put32(delta, 2000);
+  for (size_t i = 1000; i < 3000; i++) delta.push_back(target[i] - base.data[i]);
+  delta.push_back(OTA_DELTA_DATA);
+  put32(delta, 500);
+  delta.insert(delta.end(), target.begin() + 3000, target.begin() + 3500);
+  delta.push_back(OTA_DELTA_COPY);
+  put32(delta, 4000);
+  put32(delta, 2000);
+  delta.push_back(OTA_DELTA_END);
+}
+
+// Feed the upload in chunks of 1..maxChunk bytes; false if a write failed
+static bool feed(const Bytes& upload, const uint8_t* expected, uint32_t seed, size_t maxChunk) {
+  sink.data.clear();
+  ota.begin(sink, base.data.empty() ? nullptr : &base, expected);
+  uint32_t x = seed;
+  size_t off = 0;
+  while (off < upload.size()) {
+    x = x * 1103515245u + 12345u;
+    size_t n = 1 + (x >> 8) % maxChunk;
+    if (n > upload.size() - off) n = upload.size() - off;
+    if (!ota.write(upload.data() + off, n)) return false;
+    off += n;
+  }
+  return true;
+}
+
+// Upload in many chunkings, each must produce image with its hash
+static void expectImage(const Bytes& upload, const Bytes& image, bool giveSha, const char* format) {
+  uint8_t digest[OTA_SHA_SIZE];
+  sha256(image, digest);
+  static const size_t chunks[] = {1, 3, 64, 1500, 100000};
+  for (size_t c : chunks) {
+    for (uint32_t seed = 1; seed <= 4; seed++) {
+      TEST_ASSERT_TRUE_MESSAGE(feed(upload, giveSha ? digest : nullptr, seed, c), ota.error());
+      TEST_ASSERT_TRUE_MESSAGE(ota.finish(), ota.error());
+      TEST_ASSERT_EQUAL_STRING(format, ota.format());
+      TEST_ASSERT_EQUAL(image.size(), ota.imageSize());
+      TEST_ASSERT_EQUAL(image.size(), sink.data.size());
+      TEST_ASSERT_TRUE(sink.data == image);
+      TEST_ASSERT_EQUAL_MEMORY(digest, ota.sha(), OTA_SHA_SIZE);
+    }
+  }
+}
+
+static void expectError(const Bytes& upload, const uint8_t* expected, const char* error) {
+  bool ok = feed(upload, expected, 7, 200) && ota.finish();
+  TEST_ASSERT_FALSE(ok);
+  TEST_ASSERT_EQUAL_STRING(error, ota.error());
+}
+
+void test_sha256_known_answer() {
+  static const uint8_t abc[32] = {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad};
+  uint8_t digest[OTA_SHA_SIZE];
+  sha256(Bytes{'a', 'b', 'c'}, digest);
+  TEST_ASSERT_EQUAL_MEMORY(abc, digest, OTA_SHA_SIZE);
+}
+
+void test_plain_image() {
+  Bytes image = makeImage(5000);
+  expectImage(image, image, true, "bin");
+}
+
+void test_plain_needs_hash_and_magic() {
+  Bytes image = makeImage(5000);
+  expectError(image, nullptr, "SHA-256 of the image required");
+
+  uint8_t digest[OTA_SHA_SIZE];
+  sha256(image, digest);
+  image[0] = 0;
+  expectError(image, digest, "Not an ESP32 image");
+}
+
+void test_wrong_expected_hash() {
+  Bytes image = makeImage(5000);
+  uint8_t digest[OTA_SHA_SIZE];
+  sha256(image, digest);
+  digest[5] ^= 1;
+  expectError(image, digest, "SHA-256 mismatch");
+}
+
+void test_gzip_stored_blocks() {
+  Bytes image = makeImage(5000);
+  expectImage(gzipStored(image, 1200), image, true, "gzip");
+}
+
+void test_gzip_fixed_blocks() {
+  Bytes upload(GZIP_FIXED, GZIP_FIXED + sizeof(GZIP_FIXED));
+  TEST_ASSERT_EQUAL(1, (upload[10] >> 1) & 3);
+  expectImage(upload, makeImage(3000), true, "gzip");
+}
+
+void test_gzip_dynamic_blocks() {
+  Bytes upload(GZIP_DYNAMIC, GZIP_DYNAMIC + sizeof(GZIP_DYNAMIC));
+  TEST_ASSERT_EQUAL(2, (upload[10] >> 1) & 3);
+  expectImage(upload, makeImage(32000), true, "gzip");
+}
+
+void test_gzip_truncated_and_corrupt() {
+  Bytes image = makeImage(32000);
+  uint8_t digest[OTA_SHA_SIZE];
+  sha256(image, digest);
+
+  Bytes upload(GZIP_DYNAMIC, GZIP_DYNAMIC + sizeof(GZIP_DYNAMIC));
+  upload.resize(upload.size() - 6);
+  expectError(upload, digest, "gzip stream truncated");
+
+  upload.assign(GZIP_DYNAMIC, GZIP_DYNAMIC + sizeof(GZIP_DYNAMIC));
+  upload[upload.size() - 8] ^= 0xFF;
+  expectError(upload, digest, "gzip CRC mismatch");
+
+  upload = gzipStored(image, 1200);
+  upload.resize(upload.size() / 2);
+  expectError(upload, digest, "gzip stream truncated");
+}
+
+void test_delta() {
+  Bytes target, delta;
+  makeDelta(target, delta);
+  expectImage(delta, target, false, "delta");
+  expectImage(delta, target, true, "delta");
+}
+
+void test_gzip_delta() {
+  Bytes target, delta;
+  makeDelta(target, delta);
+  expectImage(gzipStored(delta, 700), target, false, "gzip+delta");
+}
+
+void test_delta_wrong_base() {
+  Bytes target, delta;
+  makeDelta(target, delta);
+
+  base.data[100] ^= 1;
+  expectError(delta, nullptr, "Delta is for a different firmware");
+
+  base.data.resize(5000);
+  expectError(delta, nullptr, "Delta is for a different firmware");
+
+  base.data.clear();
+  expectError(delta, nullptr, "Delta updates need the running image");
+}
+
+void test_delta_truncated_and_bad_ops() {
+  Bytes target, delta;
+  makeDelta(target, delta);
+
+  Bytes cut(delta.begin(), delta.end() - 1);
+  expectError(cut, nullptr, "Delta truncated");
+  cut.assign(delta.begin(), delta.begin() + OTA_DELTA_HEADER + 200);
+  expectError(cut, nullptr, "Delta truncated");
+
+  Bytes bad = delta;
+  bad[OTA_DELTA_HEADER] = 9;
+  expectError(bad, nullptr, "Bad delta op");
+
+  bad = delta;
+  bad[OTA_DELTA_HEADER + 5] = 0xFF;      // COPY length past the base
+  bad[OTA_DELTA_HEADER + 6] = 0xFF;
+  expectError(bad, nullptr, "Delta op outside the base image");
+
+  bad = delta;
+  bad.push_back(0);
+  expectError(bad, nullptr, "Data after end of delta");
+
+  // Right ops, but the header names another target
+  bad = delta;
+  bad[48] ^= 1;
+  expectError(bad, nullptr, "SHA-256 mismatch");
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sha256_known_answer);
+  RUN_TEST(test_plain_image);
+  RUN_TEST(test_plain_needs_hash_and_magic);
+  RUN_TEST(test_wrong_expected_hash);
+  RUN_TEST(test_gzip_stored_blocks);
+  RUN_TEST(test_gzip_fixed_blocks);
+  RUN_TEST(test_gzip_dynamic_blocks);
+  RUN_TEST(test_gzip_truncated_and_corrupt);
+  RUN_TEST(test_delta);
+  RUN_TEST(test_gzip_delta);
+  RUN_TEST(test_delta_wrong_base);
+  RUN_TEST(test_delta_truncated_and_bad_ops);
+  return UNITY_END();
+}
@@ -0,0 +1,311 @@
+// RuleVM: hysteresis, hold timers, constant folding, compile errors, and
+// a benchmark of the VM against a tree of typical rules
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "RuleVM.h"
+
+// temp1, hum1, motion1; stat 1 = mean over a 60 s or 15 min window
+class TestSymbols : public RuleSymbols {
+ public:
+  float values[3] = {0, 0, 0};
+  float means[3][2] = {};
+  uint32_t reads = 0;
+
+  int sensor(const char* name, uint8_t length) override {
+    static const char* const names[] = {"temp1", "hum1", "motion1"};
+    for (int i = 0; i < 3; i++) {
+      if (strlen(names[i]) == length && strncmp(names[i], name, length) == 0) return i;
+    }
+    return -1;
+  }
+  int stat(const char* name, uint8_t length) override {
+    return length == 4 && strncmp(name, "mean", 4) == 0 ? 1 : -1;
+  }
+  int window(uint32_t seconds) override {
+    return seconds == 60 ? 0 : seconds == 900 ? 1 : -1;
+  }
+  float read(uint8_t sensor, uint8_t stat, uint8_t window) override {
+    reads++;
+    return stat == 0 ? values[sensor] : means[sensor][window];
+  }
+};
+
+static TestSymbols symbols;
+static RuleProgram program;
+static RuleState state;
+
+void setUp() {
+  symbols = TestSymbols();
+  memset(&program, 0, sizeof(program));
+  memset(&state, 0, sizeof(state));
+}
+
+void tearDown() {}
+
+static bool compile(const char* text) {
+  RuleCompiler compiler(symbols);
+  bool ok = compiler.compile(text, program);
+  if (!ok) printf("  compile \"%s\": %s at %u\n", text, compiler.error(), compiler.errorAt());
+  return ok;
+}
+
+static bool eval(uint32_t nowMs = 0) {
+  bool result = false;
+  RuleVM::run(program, state, nowMs, symbols, result);
+  return result;
+}
+
+// Error message and position of a rule that must not compile
+static void expectError(const char* text, const char* message, uint16_t at) {
+  RuleCompiler compiler(symbols);
+  TEST_ASSERT_FALSE(compiler.compile(text, program));
+  TEST_ASSERT_EQUAL_STRING(message, compiler.error());
+  TEST_ASSERT_EQUAL(at, compiler.errorAt());
+}
+
+void test_compare_and_logic() {
+  TEST_ASSERT_TRUE(compile("temp1 > 30 and not (hum1 < 40) or motion1"));
+  symbols.values[0] = 31;
+  symbols.values[1] = 50;
+  TEST_ASSERT_TRUE(eval());
+  symbols.values[1] = 30;
+  TEST_ASSERT_FALSE(eval());
+  symbols.values[2] = 1;
+  TEST_ASSERT_TRUE(eval());
+}
+
+void test_missing_reading_never_matches() {
+  TEST_ASSERT_TRUE(compile("temp1 > 30 or temp1 <= 30"));
+  symbols.values[0] = NAN;
+  TEST_ASSERT_FALSE(eval());
+  TEST_ASSERT_TRUE(compile("temp1"));
+  TEST_ASSERT_FALSE(eval());
+}
+
+void test_hysteresis_above() {
+  TEST_ASSERT_TRUE(compile("temp1 > 30 hyst 2"));
+  const float trace[] = {29, 30, 31, 29, 28.5f, 28, 29, 30.5f};
+  const bool expect[] = {false, false, true, true, true, false, false, true};
+  for (uint8_t i = 0; i < sizeof(trace) / sizeof(trace[0]); i++) {
+    symbols.values[0] = trace[i];
+    TEST_ASSERT_EQUAL(expect[i], eval());
+  }
+}
+
+void test_hysteresis_below() {
+  TEST_ASSERT_TRUE(compile("temp1 < 10 hyst 2"));
+  const float trace[] = {11, 9.5f, 11, 11.9f, 12, 11};
+  const bool expect[] = {false, true, true, true, false, false};
+  for (uint8_t i = 0; i < sizeof(trace) / sizeof(trace[0]); i++) {
+    symbols.values[0] = trace[i];
+    TEST_ASSERT_EQUAL(expect[i], eval());
+  }
+}
+
+void test_hysteresis_holds_latch_on_missing_reading() {
+  TEST_ASSERT_TRUE(compile("temp1 > 30 hyst 2"));
+  symbols.values[0] = 31;
+  TEST_ASSERT_TRUE(eval());
+  symbols.values[0] = NAN;
+  TEST_ASSERT_TRUE(eval());
+  symbols.values[0] = 27;
+  TEST_ASSERT_FALSE(eval());
+  symbols.values[0] = NAN;
+  TEST_ASSERT_FALSE(eval());
+}
+
+void test_hysteresis_slots_are_independent() {
+  TEST_ASSERT_TRUE(compile("temp1 > 30 hyst 2 or hum1 > 80 hyst 5"));
+  TEST_ASSERT_EQUAL(2, program.slots);
+  symbols.values[1] = 81;
+  TEST_ASSERT_TRUE(eval());
+  symbols.values[1] = 76;
+  TEST_ASSERT_TRUE(eval());
+  symbols.values[1] = 75;
+  TEST_ASSERT_FALSE(eval());
+  TEST_ASSERT_EQUAL(0, state.latched);
+}
+
+void test_hold() {
+  TEST_ASSERT_TRUE(compile("motion1 for 60s"));
+  symbols.values[2] = 1;
+  TEST_ASSERT_FALSE(eval(1000));
+  TEST_ASSERT_FALSE(eval(60999));
+  TEST_ASSERT_TRUE(eval(61000));
+  TEST_ASSERT_TRUE(eval(90000));
+
+  // A break restarts the timer
+  symbols.values[2] = 0;
+  TEST_ASSERT_FALSE(eval(91000));
+  symbols.values[2] = 1;
+  TEST_ASSERT_FALSE(eval(92000));
+  TEST_ASSERT_FALSE(eval(151999));
+  TEST_ASSERT_TRUE(eval(152000));
+}
+
+void test_hold_units_and_clock_wrap() {
+  TEST_ASSERT_TRUE(compile("temp1 > 20 for 500ms"));
+  TEST_ASSERT_EQUAL(500, (uint32_t)program.code[program.length - 1].f);
+  symbols.values[0] = 25;
+  TEST_ASSERT_FALSE(eval(0xFFFFFF00UL));
+  TEST_ASSERT_FALSE(eval(0x000000E0UL));     // 480 ms across the wrap
+  TEST_ASSERT_TRUE(eval(0x000000F4UL));      // 500 ms
+
+  TEST_ASSERT_TRUE(compile("motion1 for 2m"));
+  TEST_ASSERT_EQUAL(120000, (uint32_t)program.code[program.length - 1].f);
+  TEST_ASSERT_TRUE(compile("motion1 for 1h"));
+  TEST_ASSERT_EQUAL(3600000, (uint32_t)program.code[program.length - 1].f);
+}
+
+void test_constant_folding() {
+  RuleCompiler compiler(symbols);
+
+  // Whole condition folds to one constant
+  TEST_ASSERT_TRUE(compiler.compile("2 + 3 * 4 > 13", program));
+  TEST_ASSERT_TRUE(compiler.constant());
+  TEST_ASSERT_EQUAL(1, program.length);
+  TEST_ASSERT_EQUAL(RULE_CONST, program.code[0].op);
+  TEST_ASSERT_EQUAL_FLOAT(1, program.code[0].f);
+
+  // Constant operand of a comparison
+  TEST_ASSERT_TRUE(compiler.compile("temp1 > 10 * 3 - -2", program));
+  TEST_ASSERT_FALSE(compiler.constant());
+  TEST_ASSERT_EQUAL(3, program.length);
+  TEST_ASSERT_EQUAL(RULE_READ, program.code[0].op);
+  TEST_ASSERT_EQUAL(RULE_CONST, program.code[1].op);
+  TEST_ASSERT_EQUAL_FLOAT(32, program.code[1].f);
+  TEST_ASSERT_EQUAL(RULE_GT, program.code[2].op);
+
+  // Identity operands drop out, deciding ones replace the expression
+  TEST_ASSERT_TRUE(compiler.compile("true and temp1 > 30 and true", program));
+  TEST_ASSERT_EQUAL(3, program.length);
+  TEST_ASSERT_TRUE(compiler.compile("temp1 > 30 or false", program));
+  TEST_ASSERT_EQUAL(3, program.length);
+  TEST_ASSERT_TRUE(compiler.compile("temp1 > 30 or true", program));
+  TEST_ASSERT_TRUE(compiler.constant());
+  TEST_ASSERT_EQUAL(1, program.length);
+  TEST_ASSERT_TRUE(compiler.compile("false and (temp1 > 30 or hum1 > 50)", program));
+  TEST_ASSERT_TRUE(compiler.constant());
+  TEST_ASSERT_EQUAL(1, program.length);
+  TEST_ASSERT_EQUAL_FLOAT(0, program.code[0].f);
+  TEST_ASSERT_TRUE(compiler.compile("not not 0", program));
+  TEST_ASSERT_TRUE(compiler.constant());
+  TEST_ASSERT_EQUAL_FLOAT(0, program.code[0].f);
+
+  // A constant comparison under hyst needs no slot
+  TEST_ASSERT_TRUE(compiler.compile("5 > 3 hyst 1", program));
+  TEST_ASSERT_EQUAL(0, program.slots);
+  TEST_ASSERT_EQUAL(1, program.length);
+}
+
+void test_stat_operand() {
+  TEST_ASSERT_TRUE(compile("mean(temp1, 15m) >= 28"));
+  TEST_ASSERT_EQUAL(RULE_READ, program.code[0].op);
+  TEST_ASSERT_EQUAL(0, program.code[0].a);
+  TEST_ASSERT_EQUAL(1, program.code[0].b);
+  TEST_ASSERT_EQUAL(1, program.code[0].c);
+  symbols.means[0][1] = 28;
+  TEST_ASSERT_TRUE(eval());
+  symbols.means[0][1] = 27.9f;
+  TEST_ASSERT_FALSE(eval());
+}
+
+void test_compile_errors() {
+  expectError("temp9 > 3", "Unknown sensor", 0);
+  expectError("temp1 >", "Expected a value", 7);
+  expectError("temp1 > 3 )", "Unexpected text", 10);
+  expectError("(temp1 > 3", "Expected )", 10);
+  expectError("temp1 > 30 hyst", "hyst needs a number", 15);
+  expectError("temp1 > 30 hyst 2s", "hyst needs a number", 16);
+  expectError("temp1 == 30 hyst 2", "hyst needs > >= < <=", 17);
+  expectError("motion1 for 5x", "Unknown unit", 12);
+  expectError("motion1 for", "Expected a duration", 11);
+  expectError("temp1 > 3s", "Duration not allowed here", 8);
+  expectError("temp1 # 3", "Unexpected character", 6);
+  expectError("median(temp1, 60s) > 3", "Unknown stat", 6);
+  expectError("mean(temp1, 5m) > 3", "Window not configured (see statWindows)", 14);
+  expectError("mean(temp1 60s) > 3", "Expected ,", 11);
+}
+
+void test_compile_limits() {
+  // Nine modifiers for eight slots; reported after the last duration
+  expectError("motion1 for 1s for 1s for 1s for 1s for 1s for 1s for 1s for 1s for 1s",
+              "Too many hyst/for modifiers", 70);
+
+  // 17 operands and 16 additions do not fit in RULE_MAX_CODE
+  char text[160] = "temp1";
+  for (uint8_t i = 0; i < 16; i++) strcat(text, " + temp1");
+  RuleCompiler compiler(symbols);
+  TEST_ASSERT_FALSE(compiler.compile(text, program));
+  TEST_ASSERT_EQUAL_STRING("Rule too long", compiler.error());
+
+  // Right-nested sums keep every operand on the stack; the depth is
+  // checked once the whole rule has parsed
+  const char* deep = "temp1 + (temp1 + (temp1 + (temp1 + (temp1 + (temp1 + (temp1 + (temp1 + temp1)))))))";
+  expectError(deep, "Expression too deep", strlen(deep));
+  TEST_ASSERT_TRUE(compile("temp1 + (temp1 + (temp1 + (temp1 + (temp1 + (temp1 + (temp1 + temp1))))))"));
+  TEST_ASSERT_EQUAL(RULE_STACK, program.stackDepth);
+}
+
+// Evaluations per second over rules shaped like the ones in the README;
+// prints the cost per evaluation and per instruction
+void test_benchmark() {
+  static const char* const rules[] = {
+    "temp1 > 30 hyst 2 and motion1 for 60s",
+    "mean(temp1, 15m) >= 28 or not (hum1 < 20)",
+    "temp1 - mean(temp1, 60s) > 1.5 and hum1 > 60 hyst 5",
+    "motion1 or temp1 * 1.8 + 32 > 86 for 5m",
+  };
+  const uint8_t count = sizeof(rules) / sizeof(rules[0]);
+  static RuleProgram programs[4];
+  static RuleState states[4];
+  for (uint8_t i = 0; i < count; i++) {
+    RuleCompiler compiler(symbols);
+    TEST_ASSERT_TRUE(compiler.compile(rules[i], programs[i]));
+  }
+
+  const uint32_t rounds = 200000;
+  uint32_t instructions = 0;
+  uint32_t trueCount = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t n = 0; n < rounds; n++) {
+    symbols.values[0] = 25 + (n % 100) * 0.1f;
+    symbols.values[1] = 50 + (n % 37);
+    symbols.values[2] = (n / 50) & 1;
+    symbols.means[0][0] = symbols.means[0][1] = 27 + (n % 20) * 0.1f;
+    for (uint8_t i = 0; i < count; i++) {
+      bool result;
+      instructions += RuleVM::run(programs[i], states[i], n * 100, symbols, result);
+      trueCount += result;
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  char line[128];
+  snprintf(line, sizeof(line), "%.1f ns/evaluation, %.2f ns/instruction, %u of %u true",
+           ns / (rounds * count), ns / instructions, trueCount, rounds * count);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_GREATER_THAN(0, trueCount);
+  TEST_ASSERT_LESS_THAN(rounds * count, trueCount);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_compare_and_logic);
+  RUN_TEST(test_missing_reading_never_matches);
+  RUN_TEST(test_hysteresis_above);
+  RUN_TEST(test_hysteresis_below);
+  RUN_TEST(test_hysteresis_holds_latch_on_missing_reading);
+  RUN_TEST(test_hysteresis_slots_are_independent);
+  RUN_TEST(test_hold);
+  RUN_TEST(test_hold_units_and_clock_wrap);
+  RUN_TEST(test_constant_folding);
+  RUN_TEST(test_stat_operand);
+  RUN_TEST(test_compile_errors);
+  RUN_TEST(test_compile_limits);
+  RUN_TEST(test_benchmark);
+  return UNITY_END();
+}
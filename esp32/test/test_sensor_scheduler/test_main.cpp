@@ -0,0 +1,146 @@
+// SensorScheduler: phase grid, one step per poll, two-step reads and setPeriod
+#include <unity.h>
+#include "SensorScheduler.h"
+
+class FakeDriver : public SensorDriver {
+ public:
+  uint32_t waitMs = 0;
+  bool ok = true;
+  uint32_t starts = 0;
+  uint32_t collects = 0;
+  const char* name() const override { return "fake"; }
+  bool begin() override { return true; }
+  uint8_t channels() const override { return 1; }
+  uint32_t start() override {
+    starts++;
+    return waitMs;
+  }
+  bool collect(float* values) override {
+    values[0] = ++collects;
+    return ok;
+  }
+};
+
+static uint32_t fakeMicros() { return 0; }
+
+static SensorScheduler<4> scheduler(fakeMicros);
+static FakeDriver a, b;
+static float values[1];
+
+void setUp() {
+  scheduler = SensorScheduler<4>(fakeMicros);
+  a = FakeDriver();
+  b = FakeDriver();
+}
+
+void tearDown() {}
+
+void test_phase_offsets() {
+  scheduler.add(&a, 1000, 0);
+  scheduler.add(&b, 1000, 500);
+  scheduler.begin(10000);
+
+  TEST_ASSERT_EQUAL(0, scheduler.poll(10000, values));
+  TEST_ASSERT_EQUAL(-1, scheduler.poll(10000, values));
+  TEST_ASSERT_EQUAL(500, scheduler.msUntilDue(10000, 5000));
+  TEST_ASSERT_EQUAL(-1, scheduler.poll(10499, values));
+  TEST_ASSERT_EQUAL(1, scheduler.poll(10500, values));
+  TEST_ASSERT_EQUAL(500, scheduler.msUntilDue(10500, 5000));
+  TEST_ASSERT_EQUAL(0, scheduler.poll(11000, values));
+  TEST_ASSERT_EQUAL(1, scheduler.poll(11500, values));
+}
+
+void test_one_step_per_poll() {
+  scheduler.add(&a, 1000, 0);
+  scheduler.add(&b, 1000, 0);
+  scheduler.begin(0);
+
+  // Both due together: served on consecutive polls, the second one late
+  TEST_ASSERT_EQUAL(0, scheduler.poll(0, values));
+  TEST_ASSERT_EQUAL(1, a.starts);
+  TEST_ASSERT_EQUAL(0, b.starts);
+  TEST_ASSERT_EQUAL(1, scheduler.poll(30, values));
+  TEST_ASSERT_EQUAL(30, scheduler.stats(1).maxJitterMs);
+  TEST_ASSERT_EQUAL(-1, scheduler.poll(30, values));
+}
+
+void test_two_step_read_is_collected_first() {
+  a.waitMs = 750;
+  scheduler.add(&a, 1000, 0);
+  scheduler.add(&b, 1000, 750);
+  scheduler.begin(0);
+
+  TEST_ASSERT_EQUAL(-1, scheduler.poll(0, values));
+  TEST_ASSERT_EQUAL(1, a.starts);
+  TEST_ASSERT_EQUAL(0, a.collects);
+  TEST_ASSERT_EQUAL(750, scheduler.msUntilDue(0, 5000));
+
+  // The finished conversion goes before b, which falls due at the same time
+  TEST_ASSERT_EQUAL(0, scheduler.poll(750, values));
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, values[0]);
+  TEST_ASSERT_EQUAL(1, scheduler.poll(750, values));
+}
+
+void test_missed_periods_keep_the_grid() {
+  scheduler.add(&a, 1000, 200);
+  scheduler.begin(0);
+
+  TEST_ASSERT_EQUAL(0, scheduler.poll(3500, values));
+  TEST_ASSERT_EQUAL(1, a.starts);
+  // Next slot is 4200, not 4500 and not a burst of catch-up reads
+  TEST_ASSERT_EQUAL(-1, scheduler.poll(3600, values));
+  TEST_ASSERT_EQUAL(700, scheduler.msUntilDue(3500, 5000));
+  TEST_ASSERT_EQUAL(0, scheduler.poll(4200, values));
+  TEST_ASSERT_EQUAL(3300, scheduler.stats(0).maxJitterMs);
+}
+
+void test_set_period_moves_the_grid() {
+  scheduler.add(&a, 1000, 0);
+  scheduler.begin(0);
+  TEST_ASSERT_EQUAL(0, scheduler.poll(0, values));
+
+  // Faster: counted from the last slot (0), not from now
+  scheduler.setPeriod(0, 400, 100);
+  TEST_ASSERT_EQUAL(400, scheduler.period(0));
+  TEST_ASSERT_EQUAL(300, scheduler.msUntilDue(100, 5000));
+  TEST_ASSERT_EQUAL(0, scheduler.poll(400, values));
+
+  // A slot already in the past becomes now
+  scheduler.setPeriod(0, 100, 700);
+  TEST_ASSERT_EQUAL(0, scheduler.msUntilDue(700, 5000));
+  TEST_ASSERT_EQUAL(0, scheduler.poll(700, values));
+
+  // Slower: next read one new period after the last slot
+  scheduler.setPeriod(0, 3000, 750);
+  TEST_ASSERT_EQUAL(2950, scheduler.msUntilDue(750, 5000));
+
+  // Zero is taken as 1 ms
+  scheduler.setPeriod(0, 0, 800);
+  TEST_ASSERT_EQUAL(1, scheduler.period(0));
+}
+
+void test_failures_and_capacity() {
+  a.ok = false;
+  TEST_ASSERT_EQUAL(0, scheduler.add(&a, 1000, 0));
+  TEST_ASSERT_EQUAL(1, scheduler.add(&b, 1000, 0));
+  TEST_ASSERT_EQUAL(2, scheduler.add(&b, 1000, 0));
+  TEST_ASSERT_EQUAL(3, scheduler.add(&b, 1000, 0));
+  TEST_ASSERT_EQUAL(-1, scheduler.add(&b, 1000, 0));
+  TEST_ASSERT_EQUAL(-1, scheduler.add(nullptr, 1000, 0));
+  scheduler.begin(0);
+
+  TEST_ASSERT_EQUAL(-1, scheduler.poll(0, values));
+  TEST_ASSERT_EQUAL(1, scheduler.stats(0).reads);
+  TEST_ASSERT_EQUAL(1, scheduler.stats(0).failures);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_phase_offsets);
+  RUN_TEST(test_one_step_per_poll);
+  RUN_TEST(test_two_step_read_is_collected_first);
+  RUN_TEST(test_missed_periods_keep_the_grid);
+  RUN_TEST(test_set_period_moves_the_grid);
+  RUN_TEST(test_failures_and_capacity);
+  return UNITY_END();
+}
@@ -0,0 +1,151 @@
+// TimerWheel: firing ticks, cancel, cascades across levels and tick wrap
+#include <unity.h>
+#include "TimerWheel.h"
+
+typedef TimerWheel<uint32_t, 64> Wheel;
+
+static Wheel wheel;
+static uint32_t firedAt[16];
+static uint32_t firedPayload[16];
+static uint8_t fired;
+
+void setUp() {
+  wheel.clear(0);
+  fired = 0;
+}
+
+void tearDown() {}
+
+// Advance one tick at a time, recording the tick each payload fired on
+static void runTo(uint32_t tick) {
+  while (wheel.now() != tick) {
+    uint32_t next = wheel.now() + 1;
+    wheel.advance(next, [&](Wheel::Handle, uint32_t& p) {
+      if (fired < 16) {
+        firedAt[fired] = next;
+        firedPayload[fired] = p;
+      }
+      fired++;
+    });
+  }
+}
+
+void test_fires_on_its_tick() {
+  wheel.schedule(10, 1);
+  runTo(9);
+  TEST_ASSERT_EQUAL(0, fired);
+  runTo(10);
+  TEST_ASSERT_EQUAL(1, fired);
+  TEST_ASSERT_EQUAL(10, firedAt[0]);
+  TEST_ASSERT_EQUAL(0, wheel.size());
+}
+
+void test_zero_delay_fires_next_tick() {
+  wheel.schedule(0, 7);
+  runTo(1);
+  TEST_ASSERT_EQUAL(1, fired);
+  TEST_ASSERT_EQUAL(7, firedPayload[0]);
+}
+
+void test_cancel() {
+  Wheel::Handle a = wheel.schedule(5, 1);
+  Wheel::Handle b = wheel.schedule(5, 2);
+  TEST_ASSERT_EQUAL(5, wheel.remaining(a));
+  TEST_ASSERT_TRUE(wheel.cancel(a));
+  TEST_ASSERT_FALSE(wheel.cancel(a));
+  TEST_ASSERT_NULL(wheel.find(a));
+  TEST_ASSERT_EQUAL(-1, wheel.remaining(a));
+  runTo(5);
+  TEST_ASSERT_EQUAL(1, fired);
+  TEST_ASSERT_EQUAL(2, firedPayload[0]);
+  // A fired handle is stale, even once its slot is reused
+  TEST_ASSERT_FALSE(wheel.cancel(b));
+  Wheel::Handle c = wheel.schedule(3, 3);
+  TEST_ASSERT_EQUAL(b & 0xFFFF, c & 0xFFFF);
+  TEST_ASSERT_NULL(wheel.find(b));
+  TEST_ASSERT_NOT_NULL(wheel.find(c));
+}
+
+void test_cascades_across_levels() {
+  // One delay per level, plus level boundaries
+  const uint32_t delays[] = {63, 64, 65, 4095, 4096, 4097, 262143, 262144, 300001};
+  const uint8_t n = sizeof(delays) / sizeof(delays[0]);
+  for (uint8_t i = 0; i < n; i++) wheel.schedule(delays[i], i);
+  runTo(300001);
+  TEST_ASSERT_EQUAL(n, fired);
+  for (uint8_t i = 0; i < n; i++) {
+    TEST_ASSERT_EQUAL(i, firedPayload[i]);
+    TEST_ASSERT_EQUAL(delays[i], firedAt[i]);
+  }
+}
+
+void test_cascade_from_unaligned_start() {
+  wheel.clear(4000);
+  wheel.schedule(100, 1);     // crosses the level-1 boundary at 4096
+  wheel.schedule(5000, 2);
+  runTo(4100);
+  TEST_ASSERT_EQUAL(1, fired);
+  TEST_ASSERT_EQUAL(4100, firedAt[0]);
+  runTo(9000);
+  TEST_ASSERT_EQUAL(2, fired);
+  TEST_ASSERT_EQUAL(9000, firedAt[1]);
+}
+
+void test_tick_wrap() {
+  wheel.clear(0xFFFFFFF0UL);
+  wheel.schedule(0x10, 1);    // lands exactly on 0
+  wheel.schedule(0x20, 2);
+  wheel.schedule(5000, 3);
+  runTo(0);
+  TEST_ASSERT_EQUAL(1, fired);
+  TEST_ASSERT_EQUAL(0, firedAt[0]);
+  runTo(0x10);
+  TEST_ASSERT_EQUAL(2, fired);
+  runTo(5000 - 0x10);
+  TEST_ASSERT_EQUAL(3, fired);
+  TEST_ASSERT_EQUAL(5000 - 0x10, firedAt[2]);
+}
+
+void test_large_step_fires_everything_due() {
+  wheel.schedule(10, 1);
+  wheel.schedule(1000, 2);
+  wheel.schedule(100000, 3);
+  uint8_t count = 0;
+  wheel.advance(100000, [&](Wheel::Handle, uint32_t&) { count++; });
+  TEST_ASSERT_EQUAL(3, count);
+  TEST_ASSERT_EQUAL(0, wheel.size());
+}
+
+void test_reschedule_from_callback() {
+  wheel.schedule(10, 1);
+  uint8_t count = 0;
+  for (uint32_t t = 1; t <= 35; t++) {
+    wheel.advance(t, [&](Wheel::Handle, uint32_t& p) {
+      count++;
+      wheel.schedule(10, p);
+    });
+  }
+  TEST_ASSERT_EQUAL(3, count);
+  TEST_ASSERT_EQUAL(1, wheel.size());
+}
+
+void test_full_pool() {
+  for (uint8_t i = 0; i < 64; i++) TEST_ASSERT_NOT_EQUAL(0, wheel.schedule(i + 1, i));
+  TEST_ASSERT_EQUAL(0, wheel.schedule(1, 99));
+  runTo(1);
+  TEST_ASSERT_NOT_EQUAL(0, wheel.schedule(1, 99));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fires_on_its_tick);
+  RUN_TEST(test_zero_delay_fires_next_tick);
+  RUN_TEST(test_cancel);
+  RUN_TEST(test_cascades_across_levels);
+  RUN_TEST(test_cascade_from_unaligned_start);
+  RUN_TEST(test_tick_wrap);
+  RUN_TEST(test_large_step_fires_everything_due);
+  RUN_TEST(test_reschedule_from_callback);
+  RUN_TEST(test_full_pool);
+  return UNITY_END();
+}
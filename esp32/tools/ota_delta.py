@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Build an ODLT delta between two firmware images for POST /ota.
+
+The delta turns the image the hub is running (OLD) into NEW using three
+ops: COPY a range of OLD, ADD a range of OLD plus per-byte differences,
+and DATA for literal bytes. ADD covers code that moved: most bytes
+are equal and the rest are small address changes, which leave mostly
+zero differences. Those compress well, so the delta is written gzip
+compressed unless OUT ends in .odlt. The hub checks the OLD size and
+SHA-256 in the header before applying anything. It checks the NEW SHA-256
+before it switches partitions.
+
+  ota_delta.py old/firmware.bin .pio/build/esp32dev/firmware.bin fw.odlt.gz
+  curl -F image=@fw.odlt.gz http://HUB/ota
+
+The delta is applied once here and compared with NEW before it is written.
+Only the Python standard library is used.
+"""
+
+import argparse
+import gzip
+import hashlib
+import struct
+import sys
+
+MAGIC = b"ODLT"
+VERSION = 1
+OP_END, OP_COPY, OP_ADD, OP_DATA = 0, 1, 2, 3
+
+BLOCK = 16        # bytes hashed per index entry
+STRIDE = 4        # OLD is indexed every STRIDE bytes
+MIN_MATCH = 24    # shorter exact matches are not worth an op
+
+
+def build_index(old):
+    index = {}
+    for i in range(0, len(old) - BLOCK + 1, STRIDE):
+        index.setdefault(old[i:i + BLOCK], i)
+    return index
+
+
+def extend(old, new, i, j):
+    """Length of the exact match old[i:], new[j:]."""
+    n = 0
+    limit = min(len(old) - i, len(new) - j)
+    while n < limit and old[i + n] == new[j + n]:
+        n += 1
+    return n
+
+
+def fuzzy(old, new, i, j, limit):
+    """bsdiff-style approximate extension: the length that maximises
+    2 * equal bytes - length, starting at old[i], new[j]."""
+    limit = min(limit, len(old) - i, len(new) - j)
+    best, best_len, score = 0, 0, 0
+    for n in range(limit):
+        score += 1 if old[i + n] == new[j + n] else -1
+        if score > best:
+            best, best_len = score, n + 1
+        elif score < best - 64:
+            break
+    return best_len
+
+
+def diff(old, new):
+    ops = []
+    literal = bytearray()
+    index = build_index(old)
+
+    def flush():
+        if literal:
+            ops.append((OP_DATA, bytes(literal)))
+            literal.clear()
+
+    j = 0
+    while j < len(new):
+        i = index.get(new[j:j + BLOCK]) if j + BLOCK <= len(new) else None
+        n = extend(old, new, i, j) if i is not None else 0
+        if n < MIN_MATCH:
+            literal.append(new[j])
+            j += 1
+            continue
+
+        # Grow backwards into the literal run
+        back = 0
+        while back < len(literal) and i - back > 0 and old[i - back - 1] == literal[-back - 1]:
+            back += 1
+        if back:
+            del literal[-back:]
+        flush()
+        ops.append((OP_COPY, i - back, n + back))
+        i, j = i + n, j + n
+
+        f = fuzzy(old, new, i, j, 1 << 16)
+        if f:
+            delta = bytes((new[j + k] - old[i + k]) & 0xFF for k in range(f))
+            ops.append((OP_ADD, i, delta))
+            j += f
+    flush()
+    return ops
+
+
+def encode(old, new, ops):
+    out = bytearray(MAGIC + bytes([VERSION, 0, 0, 0]))
+    out += struct.pack("<I", len(old)) + hashlib.sha256(old).digest()
+    out += struct.pack("<I", len(new)) + hashlib.sha256(new).digest()
+    for op in ops:
+        if op[0] == OP_COPY:
+            out += struct.pack("<BII", OP_COPY, op[1], op[2])
+        elif op[0] == OP_ADD:
+            out += struct.pack("<BII", OP_ADD, op[1], len(op[2])) + op[2]
+        else:
+            out += struct.pack("<BI", OP_DATA, len(op[1])) + op[1]
+    out.append(OP_END)
+    return bytes(out)
+
+
+def apply(old, delta):
+    if delta[:4] != MAGIC:
+        raise ValueError("not a delta")
+    pos, out = 80, bytearray()
+    while True:
+        op = delta[pos]
+        if op == OP_END:
+            return bytes(out)
+        if op == OP_DATA:
+            (n,) = struct.unpack_from("<I", delta, pos + 1)
+            out += delta[pos + 5:pos + 5 + n]
+            pos += 5 + n
+        else:
+            off, n = struct.unpack_from("<II", delta, pos + 1)
+            if op == OP_COPY:
+                out += old[off:off + n]
+                pos += 9
+            else:
+                out += bytes((a + b) & 0xFF for a, b in zip(old[off:off + n], delta[pos + 9:pos + 9 + n]))
+                pos += 9 + n
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("old", help="image the hub is running")
+    parser.add_argument("new", help="image to install")
+    parser.add_argument("out", help="delta file (.odlt raw, anything else gzip)")
+    args = parser.parse_args()
+
+    old = open(args.old, "rb").read()
+    new = open(args.new, "rb").read()
+    if not new or new[0] != 0xE9:
+        sys.exit("%s is not an ESP32 image" % args.new)
+
+    ops = diff(old, new)
+    delta = encode(old, new, ops)
+    if apply(old, delta) != new:
+        sys.exit("internal error: delta does not reproduce the new image")
+
+    data = delta if args.out.endswith(".odlt") else gzip.compress(delta, 9)
+    with open(args.out, "wb") as f:
+        f.write(data)
+
+    counts = {}
+    for op in ops:
+        counts[op[0]] = counts.get(op[0], 0) + 1
+    print("%s: %d bytes (new image %d, gzip of new image %d)" %
+          (args.out, len(data), len(new), len(gzip.compress(new, 9))))
+    print("ops: %d copy, %d add, %d data" %
+          (counts.get(OP_COPY, 0), counts.get(OP_ADD, 0), counts.get(OP_DATA, 0)))
+    print("sha256 %s" % hashlib.sha256(new).hexdigest())
+
+
+if __name__ == "__main__":
+    main()
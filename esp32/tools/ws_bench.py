@@ -0,0 +1,564 @@
+#!/usr/bin/env python3
+"""WebSocket load generator and throughput benchmark for the hub.
+
+Opens N command clients plus optional observer-only "dashboards" against
+the port-81 WebSocket server and drives a weighted mix of control,
+get_state, get_config, add_rule and ping commands. Every rule a client adds
+is deleted again right away (delete_rule), so the hub's rule table never
+fills. It reports per-command round trip percentiles, replies that
+reported success:false, command-to-broadcast latency (control sent ->
+state frame showing the new device state, as seen by every client),
+frames/s and bytes/s in both directions, and the hub's own /metrics
+before and after the run.
+
+--fuzz replays a corpus of command frames (one per line) with random
+mutations as fast as the hub accepts them. It measures handleCommand()
+throughput and checks that the hub keeps answering pings.
+
+Results go to stdout and, with --json, to a machine-readable file for
+regression tracking. Only the Python standard library is used.
+
+  ws_bench.py 192.168.4.1 --clients 4 --observers 2 --duration 30
+  ws_bench.py 192.168.4.1 --mix control=1,ping=1 --rate 50 --json run.json
+  ws_bench.py 192.168.4.1 --fuzz corpus.txt --duration 60
+
+Control commands switch real outputs; run this on a bench setup.
+"""
+
+import argparse
+import asyncio
+import base64
+import json
+import os
+import random
+import struct
+import sys
+import time
+import urllib.request
+
+DEVICES = ["relay1", "relay2", "relay3", "relay4", "led1", "motor1"]
+OPS = ["control", "get_state", "get_config", "add_rule", "ping"]
+# Sent only as the follow-up of a successful add_rule
+FOLLOW_UPS = ["delete_rule"]
+DEFAULT_MIX = "control=5,get_state=2,get_config=1,add_rule=1,ping=2"
+
+# Constant-false rule: exercises the compiler and the rule table without
+# ever switching anything. It is deleted after each add, so the table
+# (10 rules) has room as long as no more than 10 clients add at once.
+IDLE_RULE = {"type": "add_rule", "when": "0 > 1",
+             "actions": [{"id": "relay4", "state": False}]}
+
+BUILTIN_CORPUS = [
+    '{"type":"control","id":"relay1","state":true}',
+    '{"type":"control","id":"led1","state":true,"brightness":75}',
+    '{"type":"control","id":"motor1","state":true,"value":80,"transition":2000}',
+    '{"type":"control","id":"relay2","state":false,"delay":600000}',
+    '{"type":"schedule","id":"motor1","state":true,"value":60,"at":"06:00","daily":true}',
+    '{"type":"cancel","timerId":65537}',
+    '{"type":"get_state"}',
+    '{"type":"get_config"}',
+    '{"type":"add_rule","trigger":"temp1","condition":">","value":28,"action":"relay3","actionState":true}',
+    '{"type":"add_rule","when":"temp1 > 30 hyst 2 and motion1 for 60s",'
+    '"actions":[{"id":"relay3","state":true}],"release":[{"id":"relay3","state":false}]}',
+    '{"type":"delete_rule","id":"rule1"}',
+    '{"type":"ping"}',
+]
+
+
+# ============== WEBSOCKET CLIENT ==============
+
+class WsClosed(Exception):
+    pass
+
+
+class WsClient:
+    """Minimal RFC 6455 client: masked text frames out, text frames in."""
+
+    def __init__(self, stats):
+        self.stats = stats
+        self.reader = None
+        self.writer = None
+
+    async def connect(self, host, port, timeout):
+        self.reader, self.writer = await asyncio.wait_for(
+            asyncio.open_connection(host, port), timeout)
+        key = base64.b64encode(os.urandom(16)).decode()
+        self.writer.write((
+            "GET / HTTP/1.1\r\n"
+            f"Host: {host}:{port}\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            f"Sec-WebSocket-Key: {key}\r\n"
+            "Sec-WebSocket-Version: 13\r\n\r\n").encode())
+        await self.writer.drain()
+        head = await asyncio.wait_for(self.reader.readuntil(b"\r\n\r\n"), timeout)
+        if b" 101 " not in head.split(b"\r\n", 1)[0]:
+            raise WsClosed("handshake refused")
+
+    async def send(self, text):
+        if self.writer.is_closing() or self.reader.at_eof():
+            raise WsClosed("connection lost")
+        payload = text.encode() if isinstance(text, str) else text
+        header = bytearray([0x81])
+        n = len(payload)
+        if n < 126:
+            header.append(0x80 | n)
+        elif n < 65536:
+            header.append(0x80 | 126)
+            header += struct.pack(">H", n)
+        else:
+            header.append(0x80 | 127)
+            header += struct.pack(">Q", n)
+        mask = os.urandom(4)
+        masked = bytes(b ^ mask[i & 3] for i, b in enumerate(payload))
+        self.writer.write(bytes(header) + mask + masked)
+        await self.writer.drain()
+        self.stats.tx_frames += 1
+        self.stats.tx_bytes += len(payload)
+
+    async def recv(self):
+        """Next text message; answers pings, raises WsClosed on close."""
+        message = b""
+        while True:
+            try:
+                b0, b1 = await self.reader.readexactly(2)
+                n = b1 & 0x7F
+                if n == 126:
+                    n = struct.unpack(">H", await self.reader.readexactly(2))[0]
+                elif n == 127:
+                    n = struct.unpack(">Q", await self.reader.readexactly(8))[0]
+                mask = await self.reader.readexactly(4) if b1 & 0x80 else None
+                data = await self.reader.readexactly(n)
+            except (asyncio.IncompleteReadError, ConnectionError) as e:
+                raise WsClosed(str(e))
+            if mask:
+                data = bytes(b ^ mask[i & 3] for i, b in enumerate(data))
+
+            opcode = b0 & 0x0F
+            if opcode == 0x8:
+                raise WsClosed("closed by hub")
+            if opcode == 0x9:
+                self.writer.write(bytes([0x8A, 0x80 | len(data)]) + b"\0\0\0\0" + data)
+                continue
+            if opcode in (0x1, 0x0):
+                message += data
+                if b0 & 0x80:
+                    self.stats.rx_frames += 1
+                    self.stats.rx_bytes += len(message)
+                    return message.decode(errors="replace")
+
+    def close(self):
+        if self.writer:
+            self.writer.close()
+
+
+# ============== MEASUREMENT ==============
+
+class Stats:
+    def __init__(self):
+        self.tx_frames = 0
+        self.tx_bytes = 0
+        self.rx_frames = 0
+        self.rx_bytes = 0
+        self.sent = {op: 0 for op in OPS + FOLLOW_UPS}
+        self.replies = {op: 0 for op in OPS + FOLLOW_UPS}
+        self.failed = {op: 0 for op in OPS + FOLLOW_UPS}     # replies with success:false
+        self.timeouts = {op: 0 for op in OPS + FOLLOW_UPS}
+        self.rtt = {op: [] for op in OPS + FOLLOW_UPS}
+        self.broadcast = []        # control sent -> state frame, any client
+        self.disconnects = 0
+        self.refused = 0
+        self.errors = []
+
+
+def percentiles(samples):
+    if not samples:
+        return {"count": 0}
+    s = sorted(samples)
+
+    def pick(p):
+        return round(s[min(len(s) - 1, int(len(s) * p / 100))], 2)
+
+    return {"count": len(s), "mean": round(sum(s) / len(s), 2),
+            "p50": pick(50), "p90": pick(90), "p99": pick(99), "max": round(s[-1], 2)}
+
+
+class Broadcasts:
+    """Expected device states, so any client can time the state broadcast.
+
+    Devices are split between command clients, so each device has one
+    writer and the latest control for it is unambiguous.
+    """
+
+    def __init__(self, stats):
+        self.stats = stats
+        self.pending = {}          # device -> (state, sent at, set of clients still waiting)
+
+    def expect(self, device, state, clients):
+        self.pending[device] = (state, time.perf_counter(), set(clients))
+
+    def seen(self, client, message):
+        if not self.pending or '"type":"state"' not in message:
+            return
+        now = time.perf_counter()
+        try:
+            devices = json.loads(message).get("devices", [])
+        except ValueError:
+            return
+        for d in devices:
+            entry = self.pending.get(d.get("id"))
+            if not entry or client not in entry[2] or bool(d.get("state")) != entry[0]:
+                continue
+            self.stats.broadcast.append((now - entry[1]) * 1000)
+            entry[2].discard(client)
+
+
+def fetch_metrics(host, port, timeout):
+    try:
+        with urllib.request.urlopen(f"http://{host}:{port}/metrics", timeout=timeout) as r:
+            return json.loads(r.read())
+    except (OSError, ValueError) as e:
+        return {"error": str(e)}
+
+
+# ============== LOAD ==============
+
+def parse_mix(text):
+    weights = {}
+    for part in text.split(","):
+        name, _, weight = part.partition("=")
+        if name not in OPS:
+            raise SystemExit(f"unknown command in --mix: {name}")
+        weights[name] = float(weight or 1)
+    return weights
+
+
+def make_command(op, device, rnd, trace):
+    if op == "control":
+        return {"type": "control", "id": device, "state": rnd.random() < 0.5, "trace": trace}
+    if op == "add_rule":
+        return IDLE_RULE
+    return {"type": op}
+
+
+def is_reply(op, message):
+    if op == "control":
+        return '"type":"trace"' in message
+    if op == "get_state":
+        return '"type":"state"' in message
+    if op == "get_config":
+        return '"boardType"' in message
+    if op == "add_rule":
+        return '"type":"rule_added"' in message
+    if op == "delete_rule":
+        return '"type":"rule_deleted"' in message
+    return '"type":"pong"' in message
+
+
+async def exchange(ws, inbox, stats, op, command, timeout):
+    """Send one command and wait for its reply; None on timeout."""
+    sent = time.perf_counter()
+    await ws.send(json.dumps(command, separators=(",", ":")))
+    stats.sent[op] += 1
+
+    wait_until = sent + timeout
+    while True:
+        try:
+            message = await asyncio.wait_for(inbox.get(), wait_until - time.perf_counter())
+        except asyncio.TimeoutError:
+            stats.timeouts[op] += 1
+            return None
+        if message is None:
+            raise WsClosed("closed by hub")
+        if is_reply(op, message):
+            stats.replies[op] += 1
+            stats.rtt[op].append((time.perf_counter() - sent) * 1000)
+            if '"success":false' in message:
+                stats.failed[op] += 1
+            return message
+
+
+async def reader_loop(ws, cid, broadcasts, inbox):
+    try:
+        while True:
+            message = await ws.recv()
+            broadcasts.seen(cid, message)
+            inbox.put_nowait(message)
+    except WsClosed:
+        inbox.put_nowait(None)
+
+
+async def command_client(args, cid, devices, stats, broadcasts, everyone, deadline, rnd):
+    ws = WsClient(stats)
+    try:
+        await ws.connect(args.host, args.port, args.timeout)
+    except (OSError, asyncio.TimeoutError, WsClosed) as e:
+        stats.refused += 1
+        stats.errors.append(f"client {cid}: {e}")
+        return
+    inbox = asyncio.Queue()
+    reader = asyncio.create_task(reader_loop(ws, cid, broadcasts, inbox))
+
+    ops, weights = zip(*args.mix.items())
+    interval = args.clients / args.rate if args.rate > 0 else 0
+    next_at = time.perf_counter()
+    trace = cid * 1000000
+    try:
+        while time.perf_counter() < deadline:
+            op = rnd.choices(ops, weights)[0]
+            if op == "control" and not devices:
+                op = "ping"
+            device = rnd.choice(devices) if devices else None
+            trace += 1
+            command = make_command(op, device, rnd, trace)
+
+            # Drop anything left over from earlier commands
+            while not inbox.empty():
+                if inbox.get_nowait() is None:
+                    raise WsClosed("closed by hub")
+
+            if op == "control":
+                broadcasts.expect(device, command["state"], everyone)
+            reply = await exchange(ws, inbox, stats, op, command, args.timeout)
+
+            # Take the rule out again so the table never fills
+            if op == "add_rule" and reply and '"success":true' in reply:
+                rule_id = json.loads(reply).get("id")
+                if rule_id:
+                    await exchange(ws, inbox, stats, "delete_rule",
+                                   {"type": "delete_rule", "id": rule_id}, args.timeout)
+
+            if interval:
+                next_at += interval
+                await asyncio.sleep(max(0, next_at - time.perf_counter()))
+    except (WsClosed, ConnectionError) as e:
+        stats.disconnects += 1
+        stats.errors.append(f"client {cid}: {e}")
+    finally:
+        reader.cancel()
+        ws.close()
+
+
+async def observer_client(args, cid, stats, broadcasts, deadline):
+    ws = WsClient(stats)
+    try:
+        await ws.connect(args.host, args.port, args.timeout)
+        while True:
+            remaining = deadline - time.perf_counter()
+            if remaining <= 0:
+                break
+            try:
+                message = await asyncio.wait_for(ws.recv(), remaining)
+            except asyncio.TimeoutError:
+                break
+            broadcasts.seen(cid, message)
+    except (OSError, asyncio.TimeoutError) as e:
+        stats.refused += 1
+        stats.errors.append(f"observer {cid}: {e}")
+    except WsClosed as e:
+        stats.disconnects += 1
+        stats.errors.append(f"observer {cid}: {e}")
+    finally:
+        ws.close()
+
+
+# ============== FUZZ ==============
+
+def mutate(text, rnd):
+    data = bytearray(text.encode())
+    kind = rnd.randrange(8)
+    if kind == 0 and data:                       # flip bytes
+        for _ in range(rnd.randint(1, 4)):
+            data[rnd.randrange(len(data))] = rnd.randrange(256)
+    elif kind == 1 and data:                     # truncate
+        del data[rnd.randrange(len(data)):]
+    elif kind == 2:                              # long string value
+        data = data.replace(b'"relay', b'"' + b"x" * rnd.choice([16, 64, 512, 2000]), 1)
+    elif kind == 3:                              # deep nesting
+        depth = rnd.choice([8, 32, 128])
+        data = b'{"type":"control","id":' + b"[" * depth + b"1" + b"]" * depth + b"}"
+    elif kind == 4:                              # extreme numbers
+        data = data.replace(b":true", rnd.choice([b":1e308", b":-1", b":4294967296", b":null"]), 1)
+    elif kind == 5:                              # wrong types
+        data = data.replace(b'"id":', b'"id":{"a":', 1)
+    elif kind == 6 and data:                     # duplicate a slice
+        i = rnd.randrange(len(data))
+        data[i:i] = data[i:i + rnd.randint(1, 32)]
+    return bytes(data)                           # kind 7: unchanged
+
+
+async def fuzz_client(args, cid, corpus, stats, deadline, rnd):
+    """Sends mutated frames back to back; reconnects when the hub drops it."""
+    while time.perf_counter() < deadline:
+        ws = WsClient(stats)
+        reader = None
+        try:
+            await ws.connect(args.host, args.port, args.timeout)
+            reader = asyncio.create_task(reader_loop(ws, cid, Broadcasts(stats), asyncio.Queue()))
+            while time.perf_counter() < deadline:
+                await ws.send(mutate(rnd.choice(corpus), rnd))
+                await asyncio.sleep(0)
+        except (OSError, asyncio.TimeoutError) as e:
+            stats.refused += 1
+            stats.errors.append(f"fuzz {cid}: {e}")
+            await asyncio.sleep(1)
+        except WsClosed as e:
+            stats.disconnects += 1
+            stats.errors.append(f"fuzz {cid}: {e}")
+        finally:
+            if reader:
+                reader.cancel()
+            ws.close()
+
+
+async def liveness(args, stats, deadline, period=1.0):
+    """Pings on a separate connection while the fuzzers run."""
+    ws = WsClient(Stats())
+    try:
+        await ws.connect(args.host, args.port, args.timeout)
+    except (OSError, asyncio.TimeoutError, WsClosed) as e:
+        stats.errors.append(f"liveness: {e}")
+        return
+    try:
+        while time.perf_counter() < deadline:
+            sent = time.perf_counter()
+            await ws.send('{"type":"ping"}')
+            stats.sent["ping"] += 1
+            try:
+                while True:
+                    message = await asyncio.wait_for(ws.recv(), args.timeout)
+                    if '"type":"pong"' in message:
+                        stats.replies["ping"] += 1
+                        stats.rtt["ping"].append((time.perf_counter() - sent) * 1000)
+                        break
+            except asyncio.TimeoutError:
+                stats.timeouts["ping"] += 1
+            await asyncio.sleep(period)
+    except WsClosed as e:
+        stats.disconnects += 1
+        stats.errors.append(f"liveness: {e}")
+    finally:
+        ws.close()
+
+
+# ============== MAIN ==============
+
+async def run(args):
+    stats = Stats()
+    broadcasts = Broadcasts(stats)
+    rnd = random.Random(args.seed)
+    deadline = time.perf_counter() + args.duration
+    tasks = []
+
+    if args.fuzz:
+        if args.fuzz == "-":
+            corpus = BUILTIN_CORPUS
+        else:
+            with open(args.fuzz) as f:
+                corpus = [line.rstrip("\n") for line in f if line.strip()]
+        for cid in range(args.clients):
+            tasks.append(fuzz_client(args, cid, corpus, stats, deadline, random.Random(rnd.random())))
+        tasks.append(liveness(args, stats, deadline))
+    else:
+        everyone = list(range(args.clients + args.observers))
+        for cid in range(args.clients):
+            mine = DEVICES[cid::args.clients] if args.clients <= len(DEVICES) else [DEVICES[cid % len(DEVICES)]]
+            tasks.append(command_client(args, cid, mine, stats, broadcasts, everyone, deadline,
+                                        random.Random(rnd.random())))
+        for oid in range(args.observers):
+            tasks.append(observer_client(args, args.clients + oid, stats, broadcasts, deadline))
+
+    started = time.perf_counter()
+    await asyncio.gather(*tasks)
+    return stats, time.perf_counter() - started
+
+
+def report(args, stats, elapsed, before, after):
+    result = {
+        "host": args.host,
+        "mode": "fuzz" if args.fuzz else "load",
+        "clients": args.clients,
+        "observers": 0 if args.fuzz else args.observers,
+        "mix": args.mix,
+        "rate": args.rate,
+        "seed": args.seed,
+        "duration": round(elapsed, 2),
+        "frames": {
+            "tx": stats.tx_frames, "rx": stats.rx_frames,
+            "txPerSec": round(stats.tx_frames / elapsed, 1),
+            "rxPerSec": round(stats.rx_frames / elapsed, 1),
+            "txBytesPerSec": round(stats.tx_bytes / elapsed),
+            "rxBytesPerSec": round(stats.rx_bytes / elapsed),
+        },
+        "commands": {op: {"sent": stats.sent[op], "replies": stats.replies[op],
+                          "failed": stats.failed[op], "timeouts": stats.timeouts[op],
+                          "rttMs": percentiles(stats.rtt[op])}
+                     for op in OPS + FOLLOW_UPS if stats.sent[op]},
+        "broadcastMs": percentiles(stats.broadcast),
+        "disconnects": stats.disconnects,
+        "refused": stats.refused,
+        "errors": stats.errors[:20],
+        "hub": {"before": before, "after": after},
+    }
+
+    f = result["frames"]
+    print(f"{result['mode']}: {args.clients} clients, {result['observers']} observers, "
+          f"{elapsed:.1f} s")
+    print(f"  tx {f['txPerSec']} frames/s {f['txBytesPerSec']} B/s   "
+          f"rx {f['rxPerSec']} frames/s {f['rxBytesPerSec']} B/s")
+    print("  command       sent  replies  failed  timeouts   p50 ms   p90 ms   p99 ms   max ms")
+    for op, c in result["commands"].items():
+        r = c["rttMs"]
+        print(f"  {op:<12}{c['sent']:>6}{c['replies']:>9}{c['failed']:>8}{c['timeouts']:>10}"
+              + "".join(f"{r.get(k, '-'):>9}" for k in ("p50", "p90", "p99", "max")))
+    b = result["broadcastMs"]
+    if b["count"]:
+        print(f"  control -> state broadcast: {b['count']} seen, p50 {b['p50']} ms, "
+              f"p90 {b['p90']} ms, p99 {b['p99']} ms, max {b['max']} ms")
+    print(f"  disconnects {stats.disconnects}, refused {stats.refused}")
+    for e in stats.errors[:5]:
+        print(f"  ! {e}")
+    if "freeHeap" in before and "freeHeap" in after:
+        print(f"  hub heap {before['freeHeap']} -> {after['freeHeap']} bytes")
+
+    if args.json:
+        with open(args.json, "w") as out:
+            json.dump(result, out, indent=2)
+    return result
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    p.add_argument("host")
+    p.add_argument("--port", type=int, default=81)
+    p.add_argument("--http-port", type=int, default=80, help="for /metrics")
+    p.add_argument("--clients", type=int, default=4, help="command clients")
+    p.add_argument("--observers", type=int, default=0, help="dashboards that only listen")
+    p.add_argument("--duration", type=float, default=30, help="seconds")
+    p.add_argument("--mix", default=DEFAULT_MIX, help="weights, e.g. control=5,ping=1")
+    p.add_argument("--rate", type=float, default=0,
+                   help="total commands/s (default: each client waits for its reply)")
+    p.add_argument("--timeout", type=float, default=5, help="reply timeout in seconds")
+    p.add_argument("--fuzz", metavar="CORPUS", help="mutated command frames; '-' for the built-in corpus")
+    p.add_argument("--seed", type=int, default=1)
+    p.add_argument("--json", metavar="FILE", help="write results as JSON")
+    args = p.parse_args()
+    args.mix = parse_mix(args.mix)
+    if args.clients < 1:
+        p.error("--clients must be at least 1")
+
+    before = fetch_metrics(args.host, args.http_port, args.timeout)
+    stats, elapsed = asyncio.run(run(args))
+    after = fetch_metrics(args.host, args.http_port, args.timeout)
+    result = report(args, stats, elapsed, before, after)
+
+    # Non-zero exit when the hub stopped answering, for CI-style use. The
+    # hub may legitimately drop a fuzz client, so there only pings count.
+    dead = any(c["replies"] == 0 for c in result["commands"].values())
+    if not args.fuzz and result["disconnects"]:
+        dead = True
+    sys.exit(1 if dead else 0)
+
+
+if __name__ == "__main__":
+    main()
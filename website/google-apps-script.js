@@ -39,6 +39,9 @@ function handleRequest(e) {
       case 'log':
         result = logSensorData(e.parameter);
         break;
+      case 'logBatch':
+        result = logBatch(e.parameter);
+        break;
       case 'saveSensorData':
         result = saveSensorData(JSON.parse(e.parameter.deviceId), JSON.parse(e.parameter.value), JSON.parse(e.parameter.timestamp));
         break;
@@ -247,7 +250,8 @@ function logSensorData(params) {
   const deviceId = params.deviceId || 'default';
   const sheet = getDeviceSheet(deviceId);
   
-  const timestamp = new Date().toISOString();
+  // Samples replayed from the hub's offline queue carry their own time
+  const timestamp = params.ts ? new Date(Number(params.ts) * 1000).toISOString() : new Date().toISOString();
   const temp = params.temp || '';
   const humidity = params.humidity || '';
   const light = params.light || '';
@@ -265,6 +269,57 @@ function logSensorData(params) {
   return { success: true, message: 'Data logged successfully to ESP32_' + deviceId };
 }
 
+// Log a batch of buffered samples from ESP32 in a single write.
+// rows: samples joined by '~', fields joined by '_':
+//   time_temp_humidity_light_flags
+// time is unix seconds, or 'u' + seconds since boot (resolved against the
+// batch's 'uptime'; the hub only sends these for its current boot, and a
+// row ahead of 'uptime' cannot be from it and is skipped); temp/humidity
+// are in hundredths; flags bit0 = motion, bits1-4 = relay1-4.
+function logBatch(params) {
+  const deviceId = params.deviceId || 'default';
+  const sheet = getDeviceSheet(deviceId);
+  
+  const receivedAt = Date.now();
+  const uptime = Number(params.uptime) || 0;
+  const rows = [];
+  
+  (params.rows || '').split('~').forEach(function(row) {
+    const f = row.split('_');
+    if (f.length < 5) return;
+    
+    const bootRelative = f[0].charAt(0) === 'u';
+    if (bootRelative && Number(f[0].substring(1)) > uptime) return;
+    
+    const time = bootRelative
+      ? receivedAt - (uptime - Number(f[0].substring(1))) * 1000
+      : Number(f[0]) * 1000;
+    const flags = Number(f[4]);
+    
+    rows.push([
+      new Date(time).toISOString(),
+      Number(f[1]) / 100,
+      Number(f[2]) / 100,
+      Number(f[3]),
+      flags & 1,
+      (flags >> 1) & 1,
+      (flags >> 2) & 1,
+      (flags >> 3) & 1,
+      (flags >> 4) & 1,
+      ''
+    ]);
+  });
+  
+  if (rows.length > 0) {
+    sheet.getRange(sheet.getLastRow() + 1, 1, rows.length, 10).setValues(rows);
+  }
+  
+  // Update device last seen once per batch
+  registerDeviceInList(deviceId);
+  
+  return { success: true, count: rows.length };
+}
+
 // Save sensor data
 function saveSensorData(deviceId, value, timestamp) {
   const sheet = getDeviceSheet(deviceId);
@@ -278,11 +333,14 @@ function saveSensorData(deviceId, value, timestamp) {
   const shouldUpdate = lastTimestamp && (currentTime - new Date(lastTimestamp)) < 60000;
   
   if (shouldUpdate && lastRow > 1) {
-    // Update existing row with new sensor data
-    if (value.temperature !== undefined) sheet.getRange(lastRow, 2).setValue(value.temperature);
-    if (value.humidity !== undefined) sheet.getRange(lastRow, 3).setValue(value.humidity);
-    if (value.light !== undefined) sheet.getRange(lastRow, 4).setValue(value.light);
-    if (value.motion !== undefined) sheet.getRange(lastRow, 5).setValue(value.motion);
+    // Update existing row with new sensor data (one read, one write)
+    const range = sheet.getRange(lastRow, 2, 1, 4);
+    const row = range.getValues()[0];
+    if (value.temperature !== undefined) row[0] = value.temperature;
+    if (value.humidity !== undefined) row[1] = value.humidity;
+    if (value.light !== undefined) row[2] = value.light;
+    if (value.motion !== undefined) row[3] = value.motion;
+    range.setValues([row]);
   } else {
     // Create new row
     sheet.appendRow([
@@ -0,0 +1,67 @@
+import { useDevice } from '../context/DeviceContext';
+
+// Another hub, replicated through the aggregator this dashboard is
+// connected to; its devices are switched by routed commands
+const HubCard = ({ hub }) => {
+  const { controlHubDevice, routed } = useDevice();
+  const sensors = Object.entries(hub.sensors || {});
+  const devices = hub.devices || [];
+
+  const getRoutedStatus = (deviceId) => {
+    const result = routed[`${hub.name}/${deviceId}`];
+    if (!result) return null;
+    if (result.pending) return <span className="text-xs text-slate-400">Sending...</span>;
+    if (!result.success) {
+      return <span className="text-xs text-red-400">{result.message || 'Failed'}</span>;
+    }
+    return null;
+  };
+
+  return (
+    <div className={`glass-card p-5 border ${hub.online ? 'border-cyan-500/30' : 'border-slate-600/30 opacity-60'}`}>
+      <div className="flex items-start justify-between mb-4">
+        <div className="flex items-center gap-3">
+          <span className="text-3xl">📡</span>
+          <div>
+            <h3 className="font-semibold text-white">{hub.name}</h3>
+            <p className="text-xs text-slate-400">
+              {devices.length} devices • {sensors.length} sensors
+            </p>
+          </div>
+        </div>
+        <div className="flex items-center gap-2">
+          <div className={`w-3 h-3 rounded-full ${hub.online ? 'bg-green-400 animate-pulse' : 'bg-slate-500'}`} />
+          <span className="text-xs text-slate-400">{hub.online ? 'Online' : 'Offline'}</span>
+        </div>
+      </div>
+
+      {sensors.length > 0 && (
+        <div className="grid grid-cols-2 gap-2 mb-4">
+          {sensors.map(([key, value]) => (
+            <div key={key} className="p-2 rounded-lg bg-slate-800/50">
+              <p className="text-xs text-slate-400">{key}</p>
+              <p className="font-semibold gradient-text">{Number(value).toFixed(1)}</p>
+            </div>
+          ))}
+        </div>
+      )}
+
+      <div className="space-y-2">
+        {devices.map(device => (
+          <div key={device.id} className="flex items-center justify-between">
+            <div>
+              <p className="text-sm text-white">{device.id}</p>
+              {getRoutedStatus(device.id)}
+            </div>
+            <div
+              className={`toggle-switch ${device.state ? 'active' : ''} ${hub.online ? '' : 'pointer-events-none'}`}
+              onClick={() => controlHubDevice(hub.name, device.id, !device.state)}
+            />
+          </div>
+        ))}
+      </div>
+    </div>
+  );
+};
+
+export default HubCard;
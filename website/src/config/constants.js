@@ -16,6 +16,9 @@ export const DEFAULT_ADMIN = {
 // ESP32 WebSocket Configuration
 export const ESP32_CONFIG = {
   WS_URL: 'ws://192.168.4.1:81', // Default ESP32 AP mode
+  API_URL: 'http://192.168.4.1/api', // Local REST gateway on the hub
+  API_TIMEOUT: 1500,
+  API_RETRY_INTERVAL: 30000, // After a failure the hub is skipped this long
   RECONNECT_INTERVAL: 5000,
   SERIAL_BAUD_RATES: [9600, 19200, 38400, 57600, 115200],
   DEFAULT_BAUD: 115200
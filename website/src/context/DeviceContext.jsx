@@ -17,6 +17,8 @@ export const DeviceProvider = ({ children }) => {
   const [automationRules, setAutomationRules] = useState([]);
   const [connectionStatus, setConnectionStatus] = useState('disconnected');
   const [ws, setWs] = useState(null);
+  const [hubs, setHubs] = useState([]);
+  const [routed, setRouted] = useState({});
 
   // Initialize demo data
   useEffect(() => {
@@ -148,6 +150,29 @@ export const DeviceProvider = ({ children }) => {
       setDevices(prev => prev.map(device =>
         device.id === data.id ? { ...device, state: data.state } : device
       ));
+    } else if (data.type === 'hubs') {
+      // Other hubs, replicated through the hub this socket is connected to
+      setHubs(data.hubs || []);
+    } else if (data.type === 'routed') {
+      // Outcome of a command routed to another hub, keyed 'hub/device'
+      setRouted(prev => ({
+        ...prev,
+        [`${data.hub}/${data.id}`]: { pending: false, success: data.success, message: data.message }
+      }));
+    }
+  };
+
+  // Control a device of another hub; the aggregator routes it
+  const controlHubDevice = (hub, deviceId, state, options = {}) => {
+    if (ws && ws.readyState === WebSocket.OPEN) {
+      setRouted(prev => ({ ...prev, [`${hub}/${deviceId}`]: { pending: true } }));
+      ws.send(JSON.stringify({
+        type: 'control',
+        hub,
+        id: deviceId,
+        state,
+        ...options
+      }));
     }
   };
 
@@ -218,6 +243,9 @@ export const DeviceProvider = ({ children }) => {
     connectionStatus,
     connectToESP32,
     controlDevice,
+    hubs,
+    routed,
+    controlHubDevice,
     addDevice,
     removeDevice,
     updateDevice,
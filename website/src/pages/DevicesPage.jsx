@@ -3,10 +3,11 @@ import { Plus, Grid, List, Search, Filter } from 'lucide-react';
 import { useDevice } from '../context/DeviceContext';
 import { useAuth } from '../context/AuthContext';
 import DeviceCard from '../components/DeviceCard';
+import HubCard from '../components/HubCard';
 import AddDeviceModal from '../components/AddDeviceModal';
 
 const DevicesPage = () => {
-  const { devices, removeDevice } = useDevice();
+  const { devices, removeDevice, hubs } = useDevice();
   const { isTechnician } = useAuth();
   const [viewMode, setViewMode] = useState('grid');
   const [searchTerm, setSearchTerm] = useState('');
@@ -131,6 +132,24 @@ const DevicesPage = () => {
         </div>
       )}
 
+      {/* Other Hubs Section (when connected to a mesh aggregator) */}
+      {hubs.length > 0 && (
+        <div>
+          <h2 className="text-xl font-semibold mb-4 flex items-center gap-2">
+            <span>📡</span> Other Hubs
+            <span className="text-sm font-normal text-slate-400">({hubs.length})</span>
+          </h2>
+          <div className={viewMode === 'grid' 
+            ? 'grid grid-cols-1 md:grid-cols-2 lg:grid-cols-3 gap-4'
+            : 'space-y-4'
+          }>
+            {hubs.map(hub => (
+              <HubCard key={hub.name} hub={hub} />
+            ))}
+          </div>
+        </div>
+      )}
+
       {/* Empty State */}
       {filteredDevices.length === 0 && (
         <div className="glass-card p-12 text-center">
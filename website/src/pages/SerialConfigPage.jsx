@@ -15,9 +15,13 @@ import {
   AlertCircle,
   Loader2,
   ChevronDown,
-  ChevronUp
+  ChevronUp,
+  Activity
 } from 'lucide-react';
 import { ESP32_PINS } from '../config/constants';
+import { FRAME, encodeFrame, decodeSample, SerialDemux } from '../services/serialProtocol';
+
+const STREAM_PERIOD_MS = 100;
 
 const SerialConfigPage = () => {
   const [port, setPort] = useState(null);
@@ -39,12 +43,26 @@ const SerialConfigPage = () => {
     led: 25, motor: 33, dht: 32, light: 34, motion: 35
   });
   
+  const [streaming, setStreaming] = useState(false);
+  const [liveSample, setLiveSample] = useState(null);
+  const [sampleRate, setSampleRate] = useState(0);
+  
   const logContainerRef = useRef(null);
-  const inputBuffer = useRef('');
+  const sampleCount = useRef(0);
 
   // Check if Web Serial is supported
   const isSupported = 'serial' in navigator;
 
+  // Samples per second while streaming
+  useEffect(() => {
+    if (!streaming) return;
+    const interval = setInterval(() => {
+      setSampleRate(sampleCount.current);
+      sampleCount.current = 0;
+    }, 1000);
+    return () => clearInterval(interval);
+  }, [streaming]);
+
   useEffect(() => {
     if (logContainerRef.current) {
       logContainerRef.current.scrollTop = logContainerRef.current.scrollHeight;
@@ -85,14 +103,11 @@ const SerialConfigPage = () => {
       setPort(selectedPort);
       setConnected(true);
       
-      const textDecoder = new TextDecoderStream();
-      selectedPort.readable.pipeTo(textDecoder.writable);
-      const newReader = textDecoder.readable.getReader();
+      // Raw bytes: the stream mixes text lines with binary frames
+      const newReader = selectedPort.readable.getReader();
       setReader(newReader);
       
-      const textEncoder = new TextEncoderStream();
-      textEncoder.readable.pipeTo(selectedPort.writable);
-      const newWriter = textEncoder.writable.getWriter();
+      const newWriter = selectedPort.writable.getWriter();
       setWriter(newWriter);
       
       addLog('Connected to ESP32', 'success');
@@ -102,7 +117,7 @@ const SerialConfigPage = () => {
       
       // Request current config
       setTimeout(() => {
-        sendCommand('config');
+        sendFrame(FRAME.GET_CONFIG, undefined, newWriter);
       }, 1000);
       
     } catch (error) {
@@ -125,39 +140,57 @@ const SerialConfigPage = () => {
         setPort(null);
       }
       setConnected(false);
+      setStreaming(false);
       addLog('Disconnected', 'info');
     } catch (error) {
       addLog(`Disconnect error: ${error.message}`, 'error');
     }
   };
 
+  const handleLine = (line) => {
+    // Detect message type
+    let type = 'info';
+    if (line.includes('✓') || line.includes('success')) type = 'success';
+    else if (line.includes('✗') || line.includes('error') || line.includes('fail')) type = 'error';
+    else if (line.includes('!') || line.includes('warning')) type = 'warning';
+    
+    addLog(line, type);
+    
+    // Try to parse config info
+    parseConfigLine(line);
+  };
+
+  const handleFrame = (type, payload) => {
+    const text = () => new TextDecoder().decode(payload);
+    
+    if (type === FRAME.SAMPLE) {
+      sampleCount.current++;
+      setLiveSample(decodeSample(payload));
+    } else if (type === FRAME.CONFIG) {
+      applyDeviceConfig(JSON.parse(text()));
+      addLog('Configuration read from device', 'success');
+    } else if (type === FRAME.STATE) {
+      const state = JSON.parse(text());
+      const on = (state.devices || []).filter(d => d.state).map(d => d.id);
+      addLog(`State: uptime ${state.uptime}s, WiFi ${state.wifiConnected ? 'connected' : 'disconnected'}, on: ${on.join(', ') || 'none'}`, 'info');
+    } else if (type === FRAME.ACK) {
+      const ack = JSON.parse(text());
+      addLog(ack.message, ack.success ? 'success' : 'error');
+    }
+  };
+
   const readLoop = async (reader) => {
+    const demux = new SerialDemux({
+      onLine: handleLine,
+      onFrame: handleFrame,
+      onError: (message) => addLog(message, 'error')
+    });
+    
     try {
       while (true) {
         const { value, done } = await reader.read();
         if (done) break;
-        
-        inputBuffer.current += value;
-        
-        // Process complete lines
-        let newlineIndex;
-        while ((newlineIndex = inputBuffer.current.indexOf('\n')) !== -1) {
-          const line = inputBuffer.current.substring(0, newlineIndex).trim();
-          inputBuffer.current = inputBuffer.current.substring(newlineIndex + 1);
-          
-          if (line) {
-            // Detect message type
-            let type = 'info';
-            if (line.includes('✓') || line.includes('success')) type = 'success';
-            else if (line.includes('✗') || line.includes('error') || line.includes('fail')) type = 'error';
-            else if (line.includes('!') || line.includes('warning')) type = 'warning';
-            
-            addLog(line, type);
-            
-            // Try to parse config info
-            parseConfigLine(line);
-          }
-        }
+        demux.push(value);
       }
     } catch (error) {
       if (error.name !== 'TypeError') {
@@ -187,6 +220,15 @@ const SerialConfigPage = () => {
     }
   };
 
+  // Fill the form from the device's config JSON (same fields as GET /config)
+  const applyDeviceConfig = (cfg) => {
+    if (cfg.deviceName) setDeviceName(cfg.deviceName);
+    if (cfg.wifiSSID) setWifiSSID(cfg.wifiSSID);
+    if (cfg.apSSID) setApSSID(cfg.apSSID);
+    if (cfg.boardType !== undefined) setBoardType(String(cfg.boardType));
+    setCurrentConfig(cfg);
+  };
+
   const sendCommand = async (cmd) => {
     if (!writer) {
       addLog('Not connected', 'error');
@@ -194,13 +236,36 @@ const SerialConfigPage = () => {
     }
     
     try {
-      await writer.write(cmd + '\n');
+      await writer.write(new TextEncoder().encode(cmd + '\n'));
       addLog(`> ${cmd}`, 'command');
     } catch (error) {
       addLog(`Send error: ${error.message}`, 'error');
     }
   };
 
+  const sendFrame = async (type, payload, target = writer) => {
+    if (!target) {
+      addLog('Not connected', 'error');
+      return;
+    }
+    
+    try {
+      // The leading newline ends any partial text line so the sync byte is seen
+      await target.write(new Uint8Array([0x0A]));
+      await target.write(encodeFrame(type, payload));
+    } catch (error) {
+      addLog(`Send error: ${error.message}`, 'error');
+    }
+  };
+
+  const toggleStream = async () => {
+    const period = streaming ? 0 : STREAM_PERIOD_MS;
+    await sendFrame(FRAME.STREAM, new Uint8Array([period & 0xFF, period >> 8]));
+    setStreaming(!streaming);
+    setSampleRate(0);
+    sampleCount.current = 0;
+  };
+
   const handleSubmitCommand = (e) => {
     e.preventDefault();
     if (command.trim()) {
@@ -214,12 +279,15 @@ const SerialConfigPage = () => {
       addLog('WiFi SSID is required', 'error');
       return;
     }
-    await sendCommand(`wifi ${wifiSSID} ${wifiPassword}`);
-    await new Promise(r => setTimeout(r, 500));
-    await sendCommand(`ap ${apSSID} ${apPassword}`);
-    await new Promise(r => setTimeout(r, 500));
-    await sendCommand(`name ${deviceName}`);
-    addLog('WiFi configuration applied. Type "restart" to apply changes.', 'success');
+    // One framed config push instead of a text command per field
+    await sendFrame(FRAME.SET_CONFIG, JSON.stringify({
+      deviceName,
+      wifiSSID,
+      wifiPassword,
+      apSSID,
+      apPassword
+    }));
+    addLog('WiFi configuration sent. Type "restart" to apply changes.', 'command');
   };
 
   const applyBoardConfig = async () => {
@@ -228,24 +296,18 @@ const SerialConfigPage = () => {
   };
 
   const applyPinConfig = async () => {
-    const pinCommands = [
-      `pin relay1 ${pins.relay1}`,
-      `pin relay2 ${pins.relay2}`,
-      `pin relay3 ${pins.relay3}`,
-      `pin relay4 ${pins.relay4}`,
-      `pin led ${pins.led}`,
-      `pin motor ${pins.motor}`,
-      `pin dht ${pins.dht}`,
-      `pin light ${pins.light}`,
-      `pin motion ${pins.motion}`
-    ];
-    
-    for (const cmd of pinCommands) {
-      await sendCommand(cmd);
-      await new Promise(r => setTimeout(r, 200));
-    }
-    
-    addLog('Pin configuration applied.', 'success');
+    await sendFrame(FRAME.SET_CONFIG, JSON.stringify({
+      relay1: pins.relay1,
+      relay2: pins.relay2,
+      relay3: pins.relay3,
+      relay4: pins.relay4,
+      ledPin: pins.led,
+      motorPin: pins.motor,
+      dhtPin: pins.dht,
+      lightPin: pins.light,
+      motionPin: pins.motion
+    }));
+    addLog('Pin configuration sent.', 'command');
   };
 
   const clearLogs = () => {
@@ -318,7 +380,10 @@ const SerialConfigPage = () => {
             ) : (
               <>
                 <button
-                  onClick={() => sendCommand('config')}
+                  onClick={() => {
+                    sendFrame(FRAME.GET_CONFIG);
+                    sendFrame(FRAME.GET_STATE);
+                  }}
                   className="px-4 py-2 rounded-xl bg-slate-700 hover:bg-slate-600 text-white flex items-center gap-2"
                 >
                   <RefreshCw size={18} />
@@ -502,6 +567,51 @@ const SerialConfigPage = () => {
             </div>
           </div>
 
+          {/* Live Data (binary stream) */}
+          <div className="glass-card section-padding">
+            <div className="flex items-center justify-between mb-4">
+              <div className="flex items-center gap-3">
+                <div className="w-10 h-10 rounded-xl bg-emerald-500/20 flex items-center justify-center">
+                  <Activity size={20} className="text-emerald-400" />
+                </div>
+                <h3 className="text-lg font-semibold text-white">Live Data</h3>
+              </div>
+              <button
+                onClick={toggleStream}
+                disabled={!connected}
+                className="px-4 py-2 rounded-xl bg-emerald-500/20 hover:bg-emerald-500/30 text-emerald-400 text-sm disabled:opacity-50"
+              >
+                {streaming ? 'Stop Stream' : 'Start Stream'}
+              </button>
+            </div>
+            
+            {liveSample ? (
+              <div className="grid grid-cols-2 sm:grid-cols-4 gap-3 text-sm">
+                <div className="p-3 rounded-xl bg-slate-800/30">
+                  <p className="text-slate-400 text-xs">Temperature</p>
+                  <p className="text-white font-semibold">{liveSample.temperature.toFixed(1)}°C</p>
+                </div>
+                <div className="p-3 rounded-xl bg-slate-800/30">
+                  <p className="text-slate-400 text-xs">Humidity</p>
+                  <p className="text-white font-semibold">{liveSample.humidity.toFixed(1)}%</p>
+                </div>
+                <div className="p-3 rounded-xl bg-slate-800/30">
+                  <p className="text-slate-400 text-xs">Light</p>
+                  <p className="text-white font-semibold">{liveSample.light}%</p>
+                </div>
+                <div className="p-3 rounded-xl bg-slate-800/30">
+                  <p className="text-slate-400 text-xs">Motion</p>
+                  <p className="text-white font-semibold">{liveSample.motion ? 'Detected' : 'None'}</p>
+                </div>
+              </div>
+            ) : (
+              <p className="text-slate-500 text-sm">Start the stream to read sensors over UART.</p>
+            )}
+            {streaming && (
+              <p className="text-xs text-slate-500 mt-3">{sampleRate} samples/s, seq {liveSample?.seq ?? '-'}</p>
+            )}
+          </div>
+
           {/* Quick Commands */}
           <div className="glass-card section-padding">
             <h3 className="text-lg font-semibold text-white mb-4">Quick Commands</h3>
@@ -13,6 +13,7 @@ import {
 } from 'lucide-react';
 import { useDevice } from '../context/DeviceContext';
 import { ESP32_CONFIG } from '../config/constants';
+import { sheetsService } from '../services/api';
 
 const SettingsPage = () => {
   const { connectToESP32, connectionStatus } = useDevice();
@@ -27,6 +28,7 @@ const SettingsPage = () => {
 
   const handleConnect = () => {
     connectToESP32(wsUrl);
+    sheetsService.setHubFromWebSocket(wsUrl);
   };
 
   const handleSave = () => {
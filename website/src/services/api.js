@@ -1,10 +1,61 @@
-import { GOOGLE_SHEETS_CONFIG } from '../config/constants';
+import { GOOGLE_SHEETS_CONFIG, ESP32_CONFIG } from '../config/constants';
+
+// The hub (GET /api) answers for itself only: its live state and the
+// samples logged since it booted, 404 for any other device. Device lists
+// and automation rules always come from the sheet, which holds every hub
+// and the dashboard's own rules.
 
 // Google Sheets API Service via Apps Script
 class GoogleSheetsService {
   constructor() {
     this.apiUrl = GOOGLE_SHEETS_CONFIG.API_URL;
     this.spreadsheetId = GOOGLE_SHEETS_CONFIG.SPREADSHEET_ID;
+    this.hubUrl = ESP32_CONFIG.API_URL;
+    this.hubDownUntil = 0;
+  }
+
+  // Point the local API at the hub the WebSocket connects to
+  setHubFromWebSocket(wsUrl) {
+    try {
+      const url = new URL(wsUrl);
+      this.hubUrl = `http://${url.hostname}/api`;
+      this.hubDownUntil = 0;
+    } catch (error) {
+      console.error('Invalid hub URL:', error);
+    }
+  }
+
+  async hubRequest(action, params) {
+    const url = new URL(this.hubUrl);
+    url.searchParams.append('action', action);
+    Object.entries(params).forEach(([key, value]) => {
+      url.searchParams.append(key, value);
+    });
+
+    const controller = new AbortController();
+    const timer = setTimeout(() => controller.abort(), ESP32_CONFIG.API_TIMEOUT);
+    try {
+      const response = await fetch(url.toString(), { signal: controller.signal });
+      // Reachable, but not this hub's device
+      if (response.status === 404) return null;
+      const data = await response.json();
+      if (!data.success) throw new Error(data.error || 'Hub request failed');
+      return data;
+    } finally {
+      clearTimeout(timer);
+    }
+  }
+
+  // Hub response, or null when the hub is skipped, down or not the owner
+  async tryHub(action, params = {}) {
+    if (Date.now() < this.hubDownUntil) return null;
+    try {
+      return await this.hubRequest(action, params);
+    } catch (error) {
+      console.warn('Hub API unavailable, using Google Sheets:', error.message);
+      this.hubDownUntil = Date.now() + ESP32_CONFIG.API_RETRY_INTERVAL;
+      return null;
+    }
   }
 
   async request(action, params = {}) {
@@ -73,6 +124,20 @@ class GoogleSheetsService {
     return this.request('getDevices');
   }
 
+  // Every device's last row from the sheet, with the hub's own entry
+  // replaced by its live state
+  async getDeviceStates() {
+    const [sheet, hub] = await Promise.all([
+      this.request('getDeviceStates'),
+      this.tryHub('getDeviceStates')
+    ]);
+    if (!hub) return sheet;
+    const live = hub.data || [];
+    const rows = (sheet && sheet.success && Array.isArray(sheet.data) ? sheet.data : [])
+      .filter(row => !live.some(state => state.deviceId === row.deviceId));
+    return { success: true, data: [...rows, ...live] };
+  }
+
   async saveDevice(device) {
     return this.request('saveDevice', { device });
   }
@@ -90,8 +155,21 @@ class GoogleSheetsService {
     return this.request('saveSensorData', { deviceId, value, timestamp });
   }
 
+  // The hub's own rows are the freshest, but it only has what it logged
+  // since boot, and rows logged before its clock was set have no
+  // timestamp. The sheet fills in everything older than the hub's first
+  // timestamped row.
   async getSensorHistory(deviceId, limit = 100) {
-    return this.request('getSensorHistory', { deviceId, limit });
+    const hub = await this.tryHub('getSensorHistory', { deviceId, limit });
+    const live = (hub && hub.data || []).filter(row => row.timestamp);
+    if (hub && live.length >= limit) return hub;
+
+    const sheet = await this.request('getSensorHistory', { deviceId, limit });
+    if (!live.length) return sheet;
+    const since = Date.parse(live[0].timestamp);
+    const older = (sheet && sheet.success && Array.isArray(sheet.data) ? sheet.data : [])
+      .filter(row => Date.parse(row.timestamp) < since);
+    return { success: true, data: [...older, ...live].slice(-limit) };
   }
 
   // ============ AUTOMATION ============
@@ -0,0 +1,127 @@
+// ESP32 serial protocol: text lines plus CRC-checked binary frames
+// Frame: [0xA5][type][len lo][len hi][payload...][crc lo][crc hi]
+// CRC-16/CCITT (init 0xFFFF) over type, length and payload.
+
+export const FRAME_SYNC = 0xA5;
+
+export const FRAME = {
+  GET_CONFIG: 0x01,
+  SET_CONFIG: 0x02,
+  GET_STATE: 0x03,
+  STREAM: 0x04,
+  ACK: 0x80,
+  CONFIG: 0x81,
+  STATE: 0x83,
+  SAMPLE: 0x84
+};
+
+// Same limit as FRAME_MAX_PAYLOAD in the firmware
+const MAX_PAYLOAD = 4096;
+
+export const crc16 = (bytes, crc = 0xFFFF) => {
+  for (const byte of bytes) {
+    crc ^= byte << 8;
+    for (let i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) & 0xFFFF : (crc << 1) & 0xFFFF;
+    }
+  }
+  return crc;
+};
+
+export const encodeFrame = (type, payload = new Uint8Array(0)) => {
+  if (typeof payload === 'string') payload = new TextEncoder().encode(payload);
+  if (payload.length > MAX_PAYLOAD) throw new Error('Frame too long');
+
+  const frame = new Uint8Array(payload.length + 6);
+  frame[0] = FRAME_SYNC;
+  frame[1] = type;
+  frame[2] = payload.length & 0xFF;
+  frame[3] = payload.length >> 8;
+  frame.set(payload, 4);
+
+  const crc = crc16(frame.subarray(1, payload.length + 4));
+  frame[payload.length + 4] = crc & 0xFF;
+  frame[payload.length + 5] = crc >> 8;
+  return frame;
+};
+
+// FRAME.SAMPLE payload: uint32 uptime ms + 16-byte SampleRecord
+export const decodeSample = (payload) => {
+  const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+  const flags = view.getUint8(17);
+  return {
+    uptimeMs: view.getUint32(0, true),
+    seq: view.getUint32(4, true),
+    temperature: view.getInt16(12, true) / 100,
+    humidity: view.getUint16(14, true) / 100,
+    light: view.getUint8(16),
+    motion: (flags & 0x01) !== 0,
+    relays: [1, 2, 3, 4].map(bit => (flags >> bit & 1) === 1)
+  };
+};
+
+// Splits the incoming byte stream into text lines and frames. A sync byte
+// only starts a frame outside a UTF-8 sequence (0xA5 is never a lead byte).
+export class SerialDemux {
+  constructor({ onLine, onFrame, onError }) {
+    this.onLine = onLine;
+    this.onFrame = onFrame;
+    this.onError = onError || (() => {});
+    this.decoder = new TextDecoder();
+    this.text = [];
+    this.utf8Pending = 0;
+    this.frame = null;
+  }
+
+  push(chunk) {
+    for (const byte of chunk) {
+      if (this.frame) {
+        this.feedFrame(byte);
+      } else if (byte === FRAME_SYNC && this.utf8Pending === 0) {
+        this.frame = { bytes: [], length: -1 };
+      } else {
+        this.feedText(byte);
+      }
+    }
+  }
+
+  feedText(byte) {
+    if (this.utf8Pending > 0 && (byte & 0xC0) === 0x80) this.utf8Pending--;
+    else if (byte >= 0xF0) this.utf8Pending = 3;
+    else if (byte >= 0xE0) this.utf8Pending = 2;
+    else if (byte >= 0xC0) this.utf8Pending = 1;
+    else this.utf8Pending = 0;
+
+    if (byte === 0x0A) {
+      const line = this.decoder.decode(new Uint8Array(this.text)).trim();
+      this.text = [];
+      if (line) this.onLine(line);
+    } else {
+      this.text.push(byte);
+    }
+  }
+
+  feedFrame(byte) {
+    const frame = this.frame;
+    frame.bytes.push(byte);
+
+    if (frame.bytes.length === 3) {
+      frame.length = frame.bytes[1] | (frame.bytes[2] << 8);
+      if (frame.length > MAX_PAYLOAD) {
+        this.frame = null;
+        this.onError('Frame too long');
+        return;
+      }
+    }
+    if (frame.length < 0 || frame.bytes.length < frame.length + 5) return;
+
+    this.frame = null;
+    const bytes = new Uint8Array(frame.bytes);
+    const crc = bytes[frame.length + 3] | (bytes[frame.length + 4] << 8);
+    if (crc !== crc16(bytes.subarray(0, frame.length + 3))) {
+      this.onError('Frame CRC mismatch');
+      return;
+    }
+    this.onFrame(bytes[0], bytes.subarray(3, frame.length + 3));
+  }
+}